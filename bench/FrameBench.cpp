@@ -0,0 +1,316 @@
+// Frame encode / decode throughput benchmarks.
+//
+// Build (Linux, requires Google Benchmark):
+//   g++ -std=c++11 -O2 -DNDEBUG -Isrc bench/FrameBench.cpp -lbenchmark -pthread -o frame-bench
+//
+// Every message of mqttsn::input::AllMessages is serialised and deserialised
+// through mqttsn::frame::Frame using both DefaultOptions (dynamic allocation
+// of the read message and storage) and BareMetalDefaultOptions (in place
+// allocation, fixed size storage). PUBLISH is additionally measured with
+// payloads from 0 B to 1 KB, which crosses the 3 bytes encoding of the
+// Length layer.
+
+// Fixed storage of BareMetalDefaultOptions needs to accommodate the largest payload
+#define DEFAULT_SEQ_FIXED_STORAGE_SIZE 1024
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "comms/comms.h"
+#include "mqttsn/Message.h"
+#include "mqttsn/frame/Frame.h"
+#include "mqttsn/input/AllMessages.h"
+#include "mqttsn/options/DefaultOptions.h"
+#include "mqttsn/options/BareMetalDefaultOptions.h"
+
+namespace
+{
+
+template <typename TOpts>
+struct Protocol
+{
+    typedef mqttsn::Message<
+        comms::option::IdInfoInterface,
+        comms::option::ReadIterator<const std::uint8_t*>,
+        comms::option::WriteIterator<std::uint8_t*>,
+        comms::option::LengthInfoInterface
+    > Message;
+
+    typedef mqttsn::input::AllMessages<Message, TOpts> AllMessages;
+    typedef mqttsn::frame::Frame<Message, AllMessages, TOpts> Stack;
+};
+
+const char TopicName[] = "sensors/building-1/floor-2/temperature";
+const char ClientIdStr[] = "bench-client-0001";
+const std::size_t MaxPayloadLen = 1024U;
+const std::size_t MaxFrameLen = MaxPayloadLen + 16U;
+
+template <typename TStorage>
+void assignString(TStorage& storage, const char* str)
+{
+    storage = str;
+}
+
+template <typename TStorage>
+void assignData(TStorage& storage, std::size_t len)
+{
+    storage.clear();
+    for (std::size_t idx = 0U; idx < len; ++idx) {
+        storage.push_back(static_cast<std::uint8_t>(idx));
+    }
+}
+
+// Messages with no variable length fields are benchmarked default constructed
+template <typename TMsg>
+void fill(TMsg& msg, std::size_t payloadLen)
+{
+    static_cast<void>(msg);
+    static_cast<void>(payloadLen);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Connect<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    msg.field_duration().value() = 60U;
+    assignString(msg.field_clientId().value(), ClientIdStr);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Gwinfo<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    assignData(msg.field_gwAdd().value(), 6U);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Willtopic<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    assignString(msg.field_willTopic().value(), TopicName);
+    msg.doRefresh();
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Willtopicupd<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    assignString(msg.field_willTopic().value(), TopicName);
+    msg.doRefresh();
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Willmsg<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    assignData(msg.field_willMsg().value(), payloadLen);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Willmsgupd<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    assignData(msg.field_willMsg().value(), payloadLen);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Register<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    msg.field_msgId().value() = 1U;
+    assignString(msg.field_topicName().value(), TopicName);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Publish<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    msg.field_topicId().value() = 1U;
+    msg.field_msgId().value() = 1U;
+    assignData(msg.field_data().value(), payloadLen);
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Subscribe<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    msg.field_msgId().value() = 1U;
+    assignString(msg.field_topicName().field().value(), TopicName);
+    msg.doRefresh();
+}
+
+template <typename TBase, typename TOpt>
+void fill(mqttsn::message::Unsubscribe<TBase, TOpt>& msg, std::size_t payloadLen)
+{
+    static_cast<void>(payloadLen);
+    msg.field_msgId().value() = 1U;
+    assignString(msg.field_topicName().field().value(), TopicName);
+    msg.doRefresh();
+}
+
+template <typename TOpts, typename TMsg>
+std::size_t encode(TMsg& msg, std::vector<std::uint8_t>& buf)
+{
+    typename Protocol<TOpts>::Stack stack;
+    buf.resize(MaxFrameLen);
+    auto iter = &buf[0];
+    auto es = stack.write(msg, iter, buf.size());
+    if (es != comms::ErrorStatus::Success) {
+        return 0U;
+    }
+
+    auto len = static_cast<std::size_t>(iter - &buf[0]);
+    buf.resize(len);
+    return len;
+}
+
+void reportThroughput(benchmark::State& state, std::size_t frameLen)
+{
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(frameLen));
+}
+
+template <typename TOpts, typename TMsg>
+void benchWrite(benchmark::State& state, std::size_t payloadLen)
+{
+    typedef typename Protocol<TOpts>::Stack Stack;
+
+    Stack stack;
+    TMsg msg;
+    fill(msg, payloadLen);
+
+    std::vector<std::uint8_t> buf;
+    auto frameLen = encode<TOpts>(msg, buf);
+    if (frameLen == 0U) {
+        state.SkipWithError("Failed to encode message");
+        return;
+    }
+
+    buf.resize(MaxFrameLen);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(&msg);
+        auto iter = &buf[0];
+        auto es = stack.write(msg, iter, buf.size());
+        benchmark::DoNotOptimize(es);
+        benchmark::DoNotOptimize(iter);
+        benchmark::ClobberMemory();
+    }
+
+    reportThroughput(state, frameLen);
+}
+
+template <typename TOpts, typename TMsg>
+void benchRead(benchmark::State& state, std::size_t payloadLen)
+{
+    typedef typename Protocol<TOpts>::Stack Stack;
+    typedef typename Stack::MsgPtr MsgPtr;
+
+    Stack stack;
+    TMsg msg;
+    fill(msg, payloadLen);
+
+    std::vector<std::uint8_t> buf;
+    auto frameLen = encode<TOpts>(msg, buf);
+    if (frameLen == 0U) {
+        state.SkipWithError("Failed to encode message");
+        return;
+    }
+
+    for (auto _ : state) {
+        MsgPtr msgPtr;
+        const std::uint8_t* iter = &buf[0];
+        auto es = stack.read(msgPtr, iter, buf.size());
+        if (es != comms::ErrorStatus::Success) {
+            state.SkipWithError("Failed to decode message");
+            break;
+        }
+        benchmark::DoNotOptimize(msgPtr.get());
+        benchmark::DoNotOptimize(iter);
+    }
+
+    reportThroughput(state, frameLen);
+}
+
+template <typename TOpts, typename TMsg>
+void registerMsg(const std::string& optsName)
+{
+    auto prefix = optsName + "/" + TMsg::doName();
+    benchmark::RegisterBenchmark(
+        (prefix + "/write").c_str(),
+        [](benchmark::State& state)
+        {
+            benchWrite<TOpts, TMsg>(state, 16U);
+        });
+
+    benchmark::RegisterBenchmark(
+        (prefix + "/read").c_str(),
+        [](benchmark::State& state)
+        {
+            benchRead<TOpts, TMsg>(state, 16U);
+        });
+}
+
+template <typename TOpts, std::size_t TIdx, std::size_t TCount>
+struct MsgsRegistrar
+{
+    static void registerAll(const std::string& optsName)
+    {
+        typedef typename std::tuple_element<TIdx, typename Protocol<TOpts>::AllMessages>::type MsgType;
+        registerMsg<TOpts, MsgType>(optsName);
+        MsgsRegistrar<TOpts, TIdx + 1, TCount>::registerAll(optsName);
+    }
+};
+
+template <typename TOpts, std::size_t TCount>
+struct MsgsRegistrar<TOpts, TCount, TCount>
+{
+    static void registerAll(const std::string& optsName)
+    {
+        static_cast<void>(optsName);
+    }
+};
+
+template <typename TOpts>
+void registerPublish(const std::string& optsName)
+{
+    typedef mqttsn::message::Publish<typename Protocol<TOpts>::Message, TOpts> PublishMsg;
+    auto prefix = optsName + "/PUBLISH/payload";
+    benchmark::RegisterBenchmark(
+        (prefix + "/write").c_str(),
+        [](benchmark::State& state)
+        {
+            benchWrite<TOpts, PublishMsg>(state, static_cast<std::size_t>(state.range(0)));
+        })->RangeMultiplier(4)->Range(0, static_cast<std::int64_t>(MaxPayloadLen));
+
+    benchmark::RegisterBenchmark(
+        (prefix + "/read").c_str(),
+        [](benchmark::State& state)
+        {
+            benchRead<TOpts, PublishMsg>(state, static_cast<std::size_t>(state.range(0)));
+        })->RangeMultiplier(4)->Range(0, static_cast<std::int64_t>(MaxPayloadLen));
+}
+
+template <typename TOpts>
+void registerOptions(const std::string& optsName)
+{
+    static const std::size_t MsgsCount = std::tuple_size<typename Protocol<TOpts>::AllMessages>::value;
+    MsgsRegistrar<TOpts, 0U, MsgsCount>::registerAll(optsName);
+    registerPublish<TOpts>(optsName);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    registerOptions<mqttsn::options::DefaultOptions>("Default");
+    registerOptions<mqttsn::options::BareMetalDefaultOptions>("BareMetal");
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Includes
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <ctime>
+
+#include "platform/linux/UdpEventLoop.h"
+
+// Defines
+#define DEFAULT_GW_ADDRESS "127.0.0.1"
+#define DEFAULT_GW_PORT 10000
+
+#define SUB_TOPIC "my/sub/topic/#"
+#define PUB_TOPIC "my/pub/topic/1"
+#define PUB_PERIOD_MS 10000
+
+// Statics
+
+static mqttsn::client::UdpEventLoop eventLoop;
+static bool connected = false;
+static bool running = true;
+
+// Support functions
+
+static unsigned long long nowMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000U + ts.tv_nsec / 1000000U;
+}
+
+static void messageReport(void* userData, const MqttsnMessageInfo* msgInfo)
+{
+    static_cast<void>(userData);
+    std::printf("Rx Message: %s %.*s\n",
+        (msgInfo->topic != nullptr) ? msgInfo->topic : "<predefined>",
+        static_cast<int>(msgInfo->msgLen),
+        reinterpret_cast<const char*>(msgInfo->msg));
+}
+
+static void subscribeComplete(void* userData, MqttsnAsyncOpStatus status, MqttsnQoS qos)
+{
+    static_cast<void>(userData);
+    std::printf("Subscribe complete: status=%d qos=%d\n", status, qos);
+}
+
+static void publishComplete(void* userData, MqttsnAsyncOpStatus status)
+{
+    static_cast<void>(userData);
+    std::printf("Publish complete: status=%d\n", status);
+}
+
+static void connectComplete(void* userData, MqttsnAsyncOpStatus status)
+{
+    static_cast<void>(userData);
+    if (status != MqttsnAsyncOpStatus_Successful) {
+        std::printf("MQTT-SN connect failed: status=%d\n", status);
+        running = false;
+        return;
+    }
+
+    std::printf("Connected to MQTT-SN gateway\n");
+    connected = true;
+    mqttsn_client_subscribe(eventLoop.client(), SUB_TOPIC, MqttsnQoS_AtLeastOnceDelivery, &subscribeComplete, nullptr);
+}
+
+static void publish()
+{
+    // The payload must be preserved until the publish operation is complete
+    static std::string payload;
+    static int counter = 0;
+    payload = "{\"counter\":" + std::to_string(counter) + "}";
+    ++counter;
+
+    auto result =
+        mqttsn_client_publish(
+            eventLoop.client(),
+            PUB_TOPIC,
+            reinterpret_cast<const unsigned char*>(payload.c_str()),
+            static_cast<unsigned>(payload.size()),
+            MqttsnQoS_AtLeastOnceDelivery,
+            false,
+            &publishComplete,
+            nullptr);
+
+    if (result != MqttsnErrorCode_Success) {
+        std::printf("Publish failed: error=%d\n", result);
+    }
+}
+
+// Main functions
+
+int main(int argc, const char* argv[])
+{
+    const char* gwAddress = (1 < argc) ? argv[1] : DEFAULT_GW_ADDRESS;
+    auto gwPort = static_cast<std::uint16_t>((2 < argc) ? std::atoi(argv[2]) : DEFAULT_GW_PORT);
+    const char* clientId = (3 < argc) ? argv[3] : "linux-client";
+
+    if (!eventLoop.open(gwAddress, gwPort)) {
+        std::printf("Failed to open UDP socket to %s:%u\n", gwAddress, static_cast<unsigned>(gwPort));
+        return -1;
+    }
+
+    auto client = eventLoop.client();
+    mqttsn_client_set_message_report_callback(client, &messageReport, nullptr);
+    mqttsn_client_set_searchgw_enabled(client, false);
+    if (mqttsn_client_start(client) != MqttsnErrorCode_Success) {
+        std::printf("Failed to start MQTT-SN client\n");
+        return -1;
+    }
+
+    std::printf("Connecting to %s:%u as %s\n", gwAddress, static_cast<unsigned>(gwPort), clientId);
+    mqttsn_client_connect(client, clientId, 60, true, nullptr, &connectComplete, nullptr);
+
+    auto nextPublish = nowMs() + PUB_PERIOD_MS;
+    while (running) {
+        auto now = nowMs();
+        if (nextPublish <= now) {
+            if (connected) {
+                publish();
+            }
+            nextPublish = now + PUB_PERIOD_MS;
+        }
+
+        if (eventLoop.runOnce(static_cast<int>(nextPublish - now)) < 0) {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -43,6 +43,12 @@
 #define MQTT_SOCKET_TIMEOUT 15
 #endif
 
+// MQTT_LOOP_BUDGET_MS : Time in milliseconds loop() may spend processing the received
+//  datagrams. Override by passing the budget to loop().
+#ifndef MQTT_LOOP_BUDGET_MS
+#define MQTT_LOOP_BUDGET_MS 5
+#endif
+
 // MQTT_MAX_TRANSFER_SIZE : limit how much data is passed to the network client
 //  in each write call. Needed for the Arduino Wifi Shield. Leave undefined to
 //  pass the entire MQTT packet in each write call.
@@ -129,9 +135,17 @@ private:
    bool isSubscribed = false;
    bool isUnsubscribed = false;
    bool isPublished = false;
+   bool isStarted = false;
+   bool stopPending = false;
+   MqttsnAsyncOpCompleteReportFn connectCb = NULL;
+   void* connectCbData = NULL;
+   MqttsnAsyncOpCompleteReportFn disconnectCb = NULL;
+   void* disconnectCbData = NULL;
    WiFiUDP udp;
    uint8_t rxBuffer[MQTT_MAX_PACKET_SIZE];
-   void handleUDPRxComms();
+   boolean handleUDPRxComms();
+   void service(unsigned long budgetMs);
+   void stopClient();
 
 public:
    PubSubClient();
@@ -201,11 +215,23 @@ public:
    boolean subscribe(const char* topic);
    boolean subscribe(const char* topic, int8_t qos);
    boolean unsubscribe(const char* topic);
+
+   // Non-blocking variants, return once the request is issued (or rejected).
+   // The outcome is reported to the callback (may be NULL) from within loop().
+   // Topic and payload buffers must stay valid until then.
+   boolean connectAsync(const char* id, MqttsnAsyncOpCompleteReportFn callback, void* data, boolean cleanSession = true);
+   boolean disconnectAsync(MqttsnAsyncOpCompleteReportFn callback, void* data);
+   boolean publishAsync(const char* topic, const uint8_t* payload, unsigned int plength, uint8_t qos, boolean retained, MqttsnAsyncOpCompleteReportFn callback, void* data);
+   boolean subscribeAsync(const char* topic, int8_t qos, MqttsnSubscribeCompleteReportFn callback, void* data);
+   boolean unsubscribeAsync(const char* topic, MqttsnAsyncOpCompleteReportFn callback, void* data);
+
+   // Process all the pending datagrams (within MQTT_LOOP_BUDGET_MS) and expired timers
    boolean loop();
+   boolean loop(unsigned long budgetMs);
    boolean connected();
    int state();
 
-   friend void mqttsn_send(void* userData, const unsigned char* buf, unsigned bufLen, bool broadcast);
+   friend void mqttsn_send(void* userData, const MqttsnIoVec* vec, unsigned count, bool broadcast);
    friend void mqttsn_timer(void* userData, unsigned ms);
    friend unsigned mqttsn_cancel_timer(void* userData);
    friend void mqttsn_message_handler(void* userData, const MqttsnMessageInfo* msgInfo);
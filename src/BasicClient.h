@@ -19,6 +19,7 @@
 #pragma once
 
 #include <type_traits>
+#include <array>
 #include <vector>
 #include <algorithm>
 #include <iterator>
@@ -33,6 +34,17 @@
 #include "mqttsn/input/ClientInputMessages.h"
 #include "mqttsn/options/ClientDefaultOptions.h"
 #include "details/WriteBufStorageType.h"
+#include "details/RegInfoRegistry.h"
+#include "details/OutboundQueue.h"
+#include "details/OutboundJournal.h"
+#include "details/RetransmitTimer.h"
+#include "details/CongestionControl.h"
+#include "details/ClientStats.h"
+#include "details/TraceRing.h"
+#include "details/PublishStream.h"
+#include "details/FrameLength.h"
+#include "details/InQos2Index.h"
+#include "PredefinedTopics.h"
 
 //#include <iostream>
 
@@ -66,27 +78,6 @@ using GwInfoStorageTypeT =
 
 //-----------------------------------------------------------
 
-template <typename TInfo, typename TOpts, bool THasRegisteredTopicsLimit>
-struct RegInfoStorageType;
-
-template <typename TInfo, typename TOpts>
-struct RegInfoStorageType<TInfo, TOpts, true>
-{
-    typedef comms::util::StaticVector<TInfo, TOpts::RegisteredTopicsLimit> Type;
-};
-
-template <typename TInfo, typename TOpts>
-struct RegInfoStorageType<TInfo, TOpts, false>
-{
-    typedef std::vector<TInfo> Type;
-};
-
-template <typename TInfo, typename TOpts>
-using RegInfoStorageTypeT =
-    typename RegInfoStorageType<TInfo, TOpts, TOpts::HasRegisteredTopicsLimit>::Type;
-
-//-----------------------------------------------------------
-
 template <typename TOpts, bool THasStaticSize>
 struct TopicNameStorageOpt;
 
@@ -150,6 +141,71 @@ using ClientIdStorageOptT =
 
 //-----------------------------------------------------------
 
+template <typename TOpts, bool THasMaxInflightPublishes>
+struct InflightPublishesLimit;
+
+template <typename TOpts>
+struct InflightPublishesLimit<TOpts, true>
+{
+    static_assert(0U < TOpts::MaxInflightPublishes, "At least one publish must be allowed");
+    static const std::size_t Value = TOpts::MaxInflightPublishes;
+};
+
+template <typename TOpts>
+struct InflightPublishesLimit<TOpts, false>
+{
+    static const std::size_t Value = 1U;
+};
+
+template <typename TOpts>
+using InflightPublishesLimitT =
+    InflightPublishesLimit<TOpts, TOpts::HasMaxInflightPublishes>;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasMaxPendingInboundQos2>
+struct PendingInboundQos2Limit;
+
+template <typename TOpts>
+struct PendingInboundQos2Limit<TOpts, true>
+{
+    static_assert(0U < TOpts::MaxPendingInboundQos2, "At least one pending message must be allowed");
+    static const std::size_t Value = TOpts::MaxPendingInboundQos2;
+};
+
+template <typename TOpts>
+struct PendingInboundQos2Limit<TOpts, false>
+{
+    static const std::size_t Value = 1U;
+};
+
+template <typename TOpts>
+using PendingInboundQos2LimitT =
+    PendingInboundQos2Limit<TOpts, TOpts::HasMaxPendingInboundQos2>;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasPredefinedTopics>
+struct PredefinedTopicsMapType;
+
+template <typename TOpts>
+struct PredefinedTopicsMapType<TOpts, true>
+{
+    typedef PredefinedTopicsMap<typename TOpts::PredefinedTopics> Type;
+};
+
+template <typename TOpts>
+struct PredefinedTopicsMapType<TOpts, false>
+{
+    typedef NoPredefinedTopicsMap Type;
+};
+
+template <typename TOpts>
+using PredefinedTopicsMapTypeT =
+    typename PredefinedTopicsMapType<TOpts, TOpts::HasPredefinedTopics>::Type;
+
+//-----------------------------------------------------------
+
 mqttsn::field::QosVal translateQosValue(MqttsnQoS val)
 {
     static_assert(
@@ -186,7 +242,9 @@ MqttsnQoS translateQosValue(mqttsn::field::QosVal val)
 template <typename TClientOpts>
 class BasicClient
 {
-    typedef details::WriteBufStorageTypeT<TClientOpts> WriteBufStorage;
+    typedef details::WriteBufTypeT<TClientOpts> WriteBuf;
+    typedef details::OutputBatchBufStorageTypeT<TClientOpts> OutputBatchBufStorage;
+    typedef details::OutputBatchFramesStorageTypeT<MqttsnOutputFrame, TClientOpts> OutputBatchFramesStorage;
 
     typedef mqttsn::Message<
         comms::option::IdInfoInterface,
@@ -251,6 +309,8 @@ class BasicClient
         MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
         bool m_retain = false;
         bool m_ackReceived = false;
+        std::uint16_t m_replayMsgId = 0U; // resent from journal after restart
+        bool m_streamed = false; // sent from the publish stream frame
     };
 
     struct PublishIdOp : public PublishOpBase
@@ -260,6 +320,7 @@ class BasicClient
     struct PublishOp : public PublishOpBase
     {
         const char* m_topic = nullptr;
+        MqttsnTopicHandle m_topicHandle = MQTTSN_INVALID_TOPIC_HANDLE;
         bool m_registered = false;
         bool m_didRegistration = false;
         bool m_shortName = false;
@@ -440,6 +501,37 @@ public:
         static const auto MaxVal =
             std::numeric_limits<decltype(m_retryPeriod)>::max() / 1000;
         m_retryPeriod = std::min(val * 1000, MaxVal);
+        m_rtt.reset(m_retryPeriod);
+    }
+
+    void setRetransmitTimeoutBounds(unsigned minTimeout, unsigned maxTimeout)
+    {
+        m_rtt.setBounds(minTimeout, maxTimeout);
+    }
+
+    unsigned retransmitTimeout() const
+    {
+        return m_rtt.timeout();
+    }
+
+    void setCongestionBackoff(unsigned baseDelay, unsigned maxDelay)
+    {
+        m_congestion.setBackoff(baseDelay, maxDelay);
+    }
+
+    bool getStats(MqttsnClientStats& stats) const
+    {
+        return m_stats.get(stats);
+    }
+
+    void setTraceClock(MqttsnTraceClockFn fn, void* data)
+    {
+        m_trace.setClock(fn, data);
+    }
+
+    std::size_t getTrace(MqttsnTraceEntry* buf, std::size_t count) const
+    {
+        return m_trace.copy(buf, count);
     }
 
     void setRetryCount(unsigned val)
@@ -470,12 +562,44 @@ public:
 
     void setSendOutputDataCallback(MqttsnSendOutputDataFn cb, void* data)
     {
-        if (cb != nullptr) {
+        if ((cb != nullptr) && WriteBuf::Enabled) {
             m_sendOutputDataFn = cb;
             m_sendOutputDataData = data;
         }
     }
 
+    void setSendOutputBatchCallback(MqttsnSendOutputBatchFn cb, void* data)
+    {
+        m_sendOutputBatchFn = cb;
+        m_sendOutputBatchData = data;
+    }
+
+    void setSendOutputVecCallback(MqttsnSendOutputVecFn cb, void* data)
+    {
+        if (!WriteBuf::Enabled) {
+            return;
+        }
+
+        m_sendOutputVecFn = cb;
+        m_sendOutputVecData = data;
+    }
+
+    void setOutputBufferProvider(
+        MqttsnAllocOutputBufFn allocCb,
+        MqttsnCommitOutputBufFn commitCb,
+        void* data)
+    {
+        if ((allocCb == nullptr) || (commitCb == nullptr)) {
+            m_allocOutputBufFn = nullptr;
+            m_commitOutputBufFn = nullptr;
+            return;
+        }
+
+        m_allocOutputBufFn = allocCb;
+        m_commitOutputBufFn = commitCb;
+        m_outputBufProviderData = data;
+    }
+
     void setGwStatusReportCallback(MqttsnGwStatusReportFn cb, void* data)
     {
         m_gwStatusReportFn = cb;
@@ -494,6 +618,55 @@ public:
         m_msgReportData = data;
     }
 
+    void setBufferReleaseCallback(MqttsnBufferReleaseFn cb, void* data)
+    {
+        m_bufReleaseFn = cb;
+        m_bufReleaseData = data;
+    }
+
+    void setOutboundQueuePolicy(MqttsnOutboundQueuePolicy policy)
+    {
+        if ((MqttsnOutboundQueuePolicy_DropOldest <= policy) &&
+            (policy < MqttsnOutboundQueuePolicy_ValuesLimit)) {
+            m_outQueuePolicy = policy;
+        }
+    }
+
+    void setOutboundQueueReportCallback(unsigned highWaterMark, MqttsnOutboundQueueReportFn cb, void* data)
+    {
+        m_outQueueHighWaterMark = highWaterMark;
+        m_outQueueReportFn = cb;
+        m_outQueueReportData = data;
+    }
+
+    std::size_t outboundQueueCount() const
+    {
+        return m_outQueue.size();
+    }
+
+    MqttsnErrorCode setJournal(
+        const MqttsnJournalStore* store,
+        MqttsnAsyncOpCompleteReportFn replayCb,
+        void* replayData)
+    {
+        if (m_running) {
+            return MqttsnErrorCode_AlreadyStarted;
+        }
+
+        if ((!OutboundJournal::Enabled) || (!m_journal.setStore(store))) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        m_journalReplayReportFn = replayCb;
+        m_journalReplayReportData = replayData;
+        return MqttsnErrorCode_Success;
+    }
+
+    void setJournalDropReportCallback(MqttsnJournalDropReportFn cb, void* data)
+    {
+        m_journal.setDropReportCallback(cb, data);
+    }
+
     void setSearchgwEnabled(bool value)
     {
         m_searchgwEnabled = value;
@@ -502,6 +675,7 @@ public:
     void sendSearchGw()
     {
         sendGwSearchReq();
+        flushOutputBatch();
     }
 
     void discardGw(std::uint8_t gwId)
@@ -556,7 +730,11 @@ public:
 
         if ((m_nextTickProgramFn == nullptr) ||
             (m_cancelNextTickWaitFn == nullptr) ||
-            (m_sendOutputDataFn == nullptr) ||
+            ((m_sendOutputDataFn == nullptr) &&
+             (m_sendOutputBatchFn == nullptr) &&
+             (m_sendOutputVecFn == nullptr) &&
+             (m_allocOutputBufFn == nullptr)) ||
+            ((!WriteBuf::Enabled) && (m_allocOutputBufFn == nullptr)) ||
             (m_msgReportFn == nullptr)) {
             return MqttsnErrorCode_BadParam;
         }
@@ -573,11 +751,28 @@ public:
 
         m_pingCount = 0;
         m_connectionStatus = ConnectionStatus::Disconnected;
+        m_rtt.reset(m_retryPeriod);
+        m_congestion.reset(InflightPublishesLimit);
+        m_congestionHoldUntil = 0;
 
         m_currOp = Op::None;
+        for (auto& slot : m_publishSlots) {
+            slot.m_op = Op::None;
+            slot.m_queued = false;
+        }
+        m_inflightPublishes = 0U;
+        m_pubStream.reset();
+        m_outQueue.clear();
+        m_outQueueDropped = 0U;
         m_tickDelay = 0U;
 
+        if (m_journal.active()) {
+            // Continue allocation of message IDs after the journaled ones
+            m_msgId = m_journal.open();
+        }
+
         checkGwSearchReq();
+        flushOutputBatch();
         programNextTimeout();
         return MqttsnErrorCode_Success;
     }
@@ -590,6 +785,11 @@ public:
 
         auto guard = apiCall();
         m_running = false;
+        for (auto& info : m_inQos2Msgs) {
+            if (info.m_loanBuf != nullptr) {
+                resetInQos2Msg(info);
+            }
+        }
         return MqttsnErrorCode_Success;
     }
 
@@ -603,8 +803,8 @@ public:
         m_timestamp += m_tickDelay;
         m_tickDelay = 0U;
 
+        auto guard = apiCall();
         checkTimeouts();
-        programNextTimeout();
     }
 
     std::size_t processData(ReadIterator& iter, std::size_t len)
@@ -615,6 +815,7 @@ public:
 
         auto guard = apiCall();
         std::size_t consumed = 0;
+        bool dropping = false;
         while (true) {
             auto iterTmp = iter;
             MsgPtr msg;
@@ -623,6 +824,13 @@ public:
                 break;
             }
 
+            if ((es != comms::ErrorStatus::Success) && (!dropping)) {
+                // Count once per skipped chunk, not per byte
+                m_stats.frameDropped();
+                trace(MqttsnTraceEvent_DataDropped, MqttsnStatsOp_ValuesLimit);
+            }
+            dropping = (es != comms::ErrorStatus::Success);
+
             if (es == comms::ErrorStatus::ProtocolError) {
                 ++iter;
                 continue;
@@ -631,6 +839,10 @@ public:
             if (es == comms::ErrorStatus::Success) {
                 COMMS_ASSERT(msg);
                 m_lastRecvMsgTimestamp = m_timestamp;
+                m_stats.msgReceived(
+                    static_cast<unsigned>(msg->getId()),
+                    static_cast<std::size_t>(std::distance(iter, iterTmp)));
+                trace(MqttsnTraceEvent_MsgReceived, MqttsnStatsOp_ValuesLimit, static_cast<unsigned>(msg->getId()));
                 msg->dispatch(*this);
             }
 
@@ -641,18 +853,56 @@ public:
         return consumed;
     }
 
+    std::size_t processDatagrams(const MqttsnDatagram* datagrams, std::size_t count)
+    {
+        if (!m_running) {
+            return 0U;
+        }
+
+        auto guard = apiCall();
+        std::size_t idx = 0U;
+        for (; (idx < count) && m_running; ++idx) {
+            ReadIterator iter = datagrams[idx].buf;
+            processData(iter, datagrams[idx].bufLen);
+        }
+
+        return idx;
+    }
+
+    std::size_t processLoanedData(const std::uint8_t* buf, std::size_t len)
+    {
+        ReadIterator iter = buf;
+        if (m_bufReleaseFn == nullptr) {
+            return processData(iter, len);
+        }
+
+        COMMS_ASSERT(m_currLoanBuf == nullptr);
+        m_currLoanBuf = buf;
+        auto consumed = processData(iter, len);
+        m_currLoanBuf = nullptr;
+
+        if (!isLoanRetained(buf)) {
+            m_bufReleaseFn(m_bufReleaseData, buf);
+        }
+        return consumed;
+    }
+
     bool cancel()
     {
-        if (m_currOp == Op::None) {
+        if (!isBusy()) {
             return false;
         }
 
         COMMS_ASSERT(m_running);
         auto guard = apiCall();
 
-        auto fn = getFinaliseFunc();
-        COMMS_ASSERT(fn != nullptr);
-        (this->*(fn))(MqttsnAsyncOpStatus_Aborted);
+        if (m_currOp != Op::None) {
+            auto fn = getFinaliseFunc();
+            COMMS_ASSERT(fn != nullptr);
+            (this->*(fn))(MqttsnAsyncOpStatus_Aborted);
+        }
+
+        abortInflightPublishes(MqttsnAsyncOpStatus_Aborted);
         return true;
     }
 
@@ -672,11 +922,12 @@ public:
             return MqttsnErrorCode_AlreadyConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
         auto guard = apiCall();
+        m_congestion.seed(clientId, static_cast<std::uint32_t>(m_timestamp));
 
         m_currOp = Op::Connect;
 
@@ -708,7 +959,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -744,7 +995,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -769,6 +1020,81 @@ public:
         MqttsnAsyncOpCompleteReportFn callback,
         void* data)
     {
+        if (mustQueuePublish(qos)) {
+            if ((callback == nullptr) && (MqttsnQoS_AtLeastOnceDelivery <= qos)) {
+                return MqttsnErrorCode_BadParam;
+            }
+
+            return queuePublish(details::OutboundTopicKind::Id, topicId, nullptr, msg, msgLen, qos, retain, callback, data);
+        }
+
+        return publishNow(topicId, msg, msgLen, qos, retain, callback, data);
+    }
+
+    MqttsnErrorCode publish(
+        const char* topic,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        if (mustQueuePublish(qos)) {
+            if ((topic == nullptr) || (callback == nullptr)) {
+                return MqttsnErrorCode_BadParam;
+            }
+
+            return queuePublish(details::OutboundTopicKind::Name, 0U, topic, msg, msgLen, qos, retain, callback, data);
+        }
+
+        return publishNow(topic, msg, msgLen, qos, retain, callback, data);
+    }
+
+    MqttsnErrorCode publishBegin(
+        MqttsnTopicId topicId,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        if (!PublishStream::Enabled) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        if ((qos < MqttsnQoS_NoGwPublish) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        if (!m_pubStream.idle()) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        m_pubStream.open(topicId, qos, retain);
+        return MqttsnErrorCode_Success;
+    }
+
+    std::size_t publishWrite(const std::uint8_t* data, std::size_t len)
+    {
+        if (data == nullptr) {
+            return 0U;
+        }
+
+        return m_pubStream.write(data, len);
+    }
+
+    MqttsnErrorCode publishEnd(
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        if (!m_pubStream.writing()) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto qos = m_pubStream.qos();
         if (!m_running) {
             return MqttsnErrorCode_NotStarted;
         }
@@ -781,9 +1107,16 @@ public:
             return MqttsnErrorCode_Busy;
         }
 
-        if ((qos < MqttsnQoS_NoGwPublish) ||
-            (MqttsnQoS_ExactlyOnceDelivery < qos)) {
-            return MqttsnErrorCode_BadParam;
+        if ((qos != MqttsnQoS_NoGwPublish) && congestionThrottled()) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        PublishSlot* slot = nullptr;
+        if (MqttsnQoS_AtLeastOnceDelivery <= qos) {
+            slot = findFreePublishSlot();
+            if (slot == nullptr) {
+                return MqttsnErrorCode_Busy;
+            }
         }
 
         if ((callback == nullptr) && (MqttsnQoS_AtLeastOnceDelivery <= qos)) {
@@ -792,29 +1125,25 @@ public:
 
         auto guard = apiCall();
 
-        if (MqttsnQoS_AtLeastOnceDelivery <= qos) {
-            m_currOp = Op::PublishId;
-            auto* pubOp = newAsyncOp<PublishIdOp>(callback, data);
-            pubOp->m_topicId = topicId;
-            pubOp->m_msg = msg;
-            pubOp->m_msgLen = msgLen;
+        if (slot != nullptr) {
+            auto* pubOp = newPublishOp<PublishIdOp>(*slot, Op::PublishId);
+            pubOp->m_cb = callback;
+            pubOp->m_cbData = data;
+            pubOp->m_topicId = m_pubStream.topicId();
+            pubOp->m_msg = m_pubStream.payload();
+            pubOp->m_msgLen = m_pubStream.payloadLen();
             pubOp->m_qos = qos;
-            pubOp->m_retain = retain;
+            pubOp->m_retain = m_pubStream.retain();
+            pubOp->m_streamed = true;
+            m_pubStream.markSent();
 
-            bool result = doPublishId();
+            bool result = doPublishId(*slot);
             static_cast<void>(result);
             COMMS_ASSERT(result);
         }
         else {
-            sendPublish(
-                topicId,
-                allocMsgId(),
-                msg,
-                msgLen,
-                TopicIdTypeVal::PredefinedTopicId,
-                details::translateQosValue(qos),
-                retain,
-                false);
+            sendStreamedPublish(allocMsgId(), false);
+            m_pubStream.reset();
             if (callback != nullptr) {
                 callback(data, MqttsnAsyncOpStatus_Successful);
             }
@@ -823,8 +1152,15 @@ public:
         return MqttsnErrorCode_Success;
     }
 
-    MqttsnErrorCode publish(
-        const char* topic,
+    void publishAbort()
+    {
+        if (m_pubStream.writing()) {
+            m_pubStream.reset();
+        }
+    }
+
+    MqttsnErrorCode publishNow(
+        MqttsnTopicId topicId,
         const std::uint8_t* msg,
         std::size_t msgLen,
         MqttsnQoS qos,
@@ -840,37 +1176,244 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-
         if (m_currOp != Op::None) {
             return MqttsnErrorCode_Busy;
         }
 
-        if ((qos < MqttsnQoS_AtMostOnceDelivery) ||
-            (MqttsnQoS_ExactlyOnceDelivery < qos) ||
-            (callback == nullptr)) {
-            return MqttsnErrorCode_BadParam;
+        if ((qos != MqttsnQoS_NoGwPublish) && congestionThrottled()) {
+            return MqttsnErrorCode_Busy;
         }
 
-        auto guard = apiCall();
-        m_currOp = Op::Publish;
-        auto* pubOp = newOp<PublishOp>();
-        pubOp->m_topic = topic;
-        pubOp->m_msg = msg;
-        pubOp->m_msgLen = msgLen;
-        pubOp->m_qos = qos;
-        pubOp->m_retain = retain;
-        pubOp->m_cb = callback;
-        pubOp->m_cbData = data;
-        pubOp->m_shortName = isShortTopicName(topic);
-        if (pubOp->m_shortName) {
-            pubOp->m_topicId = shortTopicToTopicId(topic);
+        PublishSlot* slot = nullptr;
+        if (MqttsnQoS_AtLeastOnceDelivery <= qos) {
+            slot = findFreePublishSlot();
+            if (slot == nullptr) {
+                return MqttsnErrorCode_Busy;
+            }
         }
 
-        bool result = doPublish();
-        static_cast<void>(result);
-        COMMS_ASSERT(result);
-
-        return MqttsnErrorCode_Success;
+        if ((qos < MqttsnQoS_NoGwPublish) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        if ((callback == nullptr) && (MqttsnQoS_AtLeastOnceDelivery <= qos)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto guard = apiCall();
+
+        if (slot != nullptr) {
+            auto* pubOp = newPublishOp<PublishIdOp>(*slot, Op::PublishId);
+            pubOp->m_cb = callback;
+            pubOp->m_cbData = data;
+            pubOp->m_topicId = topicId;
+            pubOp->m_msg = msg;
+            pubOp->m_msgLen = msgLen;
+            pubOp->m_qos = qos;
+            pubOp->m_retain = retain;
+
+            bool result = doPublishId(*slot);
+            static_cast<void>(result);
+            COMMS_ASSERT(result);
+        }
+        else {
+            sendPublish(
+                topicId,
+                allocMsgId(),
+                msg,
+                msgLen,
+                TopicIdTypeVal::PredefinedTopicId,
+                details::translateQosValue(qos),
+                retain,
+                false);
+            if (callback != nullptr) {
+                callback(data, MqttsnAsyncOpStatus_Successful);
+            }
+        }
+
+        return MqttsnErrorCode_Success;
+    }
+
+    MqttsnErrorCode publishNow(
+        const char* topic,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        if ((m_connectionStatus != ConnectionStatus::Connected) && (qos != MqttsnQoS_NoGwPublish)) {
+            return MqttsnErrorCode_NotConnected;
+        }
+
+        if ((m_currOp != Op::None) || congestionThrottled()) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        auto* slot = findFreePublishSlot();
+        if (slot == nullptr) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        if ((qos < MqttsnQoS_AtMostOnceDelivery) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos) ||
+            (callback == nullptr)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto predefinedTopicId = PredefinedTopics::findId(topic);
+        if (predefinedTopicId != 0U) {
+            return publishNow(predefinedTopicId, msg, msgLen, qos, retain, callback, data);
+        }
+
+        auto guard = apiCall();
+        auto* pubOp = newPublishOp<PublishOp>(*slot, Op::Publish);
+        pubOp->m_topic = topic;
+        pubOp->m_msg = msg;
+        pubOp->m_msgLen = msgLen;
+        pubOp->m_qos = qos;
+        pubOp->m_retain = retain;
+        pubOp->m_cb = callback;
+        pubOp->m_cbData = data;
+        pubOp->m_shortName = isShortTopicName(topic);
+        if (pubOp->m_shortName) {
+            pubOp->m_topicId = shortTopicToTopicId(topic);
+        }
+
+        bool result = doPublish(*slot);
+        static_cast<void>(result);
+        COMMS_ASSERT(result);
+
+        return MqttsnErrorCode_Success;
+    }
+
+    MqttsnTopicHandle resolveTopic(const char* topic)
+    {
+        if ((!m_running) || (topic == nullptr) || (topic[0] == '\0')) {
+            return MQTTSN_INVALID_TOPIC_HANDLE;
+        }
+
+        auto predefinedTopicId = PredefinedTopics::findId(topic);
+        if (predefinedTopicId != 0U) {
+            return DirectTopicHandleFlag | predefinedTopicId;
+        }
+
+        if (isShortTopicName(topic)) {
+            return DirectTopicHandleFlag | ShortTopicHandleFlag | shortTopicToTopicId(topic);
+        }
+
+        auto* regInfo = m_regInfos.findByName(topic);
+        if (regInfo == nullptr) {
+            if (!m_regInfos.canPin()) {
+                return MQTTSN_INVALID_TOPIC_HANDLE;
+            }
+
+            // Registered with the gateway on first publish
+            regInfo = &m_regInfos.update(topic, std::strlen(topic), 0U, false);
+        }
+
+        return static_cast<MqttsnTopicHandle>(m_regInfos.pin(*regInfo));
+    }
+
+    void releaseTopic(MqttsnTopicHandle handle)
+    {
+        if ((handle & DirectTopicHandleFlag) != 0U) {
+            return;
+        }
+
+        auto* regInfo = m_regInfos.findByHandle(handle);
+        if (regInfo != nullptr) {
+            m_regInfos.unpin(*regInfo);
+        }
+    }
+
+    MqttsnErrorCode publishHandle(
+        MqttsnTopicHandle handle,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        if (mustQueuePublish(qos)) {
+            if ((handle == MQTTSN_INVALID_TOPIC_HANDLE) || (callback == nullptr)) {
+                return MqttsnErrorCode_BadParam;
+            }
+
+            return queuePublish(details::OutboundTopicKind::Handle, handle, nullptr, msg, msgLen, qos, retain, callback, data);
+        }
+
+        return publishHandleNow(handle, msg, msgLen, qos, retain, callback, data);
+    }
+
+    MqttsnErrorCode publishHandleNow(
+        MqttsnTopicHandle handle,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        auto topicId = static_cast<MqttsnTopicId>(handle & 0xffffU);
+        bool directTopic = ((handle & DirectTopicHandleFlag) != 0U);
+        if (directTopic && ((handle & ShortTopicHandleFlag) == 0U)) {
+            return publishNow(topicId, msg, msgLen, qos, retain, callback, data);
+        }
+
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        if (m_connectionStatus != ConnectionStatus::Connected) {
+            return MqttsnErrorCode_NotConnected;
+        }
+
+        if ((m_currOp != Op::None) || congestionThrottled()) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        auto* slot = findFreePublishSlot();
+        if (slot == nullptr) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        if ((qos < MqttsnQoS_AtMostOnceDelivery) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos) ||
+            (callback == nullptr)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        if ((!directTopic) && (m_regInfos.findByHandle(handle) == nullptr)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto guard = apiCall();
+        auto* pubOp = newPublishOp<PublishOp>(*slot, Op::Publish);
+        pubOp->m_topicHandle = handle;
+        pubOp->m_msg = msg;
+        pubOp->m_msgLen = msgLen;
+        pubOp->m_qos = qos;
+        pubOp->m_retain = retain;
+        pubOp->m_cb = callback;
+        pubOp->m_cbData = data;
+        pubOp->m_shortName = directTopic;
+        if (directTopic) {
+            pubOp->m_topicId = topicId;
+        }
+
+        bool result = doPublish(*slot);
+        static_cast<void>(result);
+        COMMS_ASSERT(result);
+
+        return MqttsnErrorCode_Success;
     }
 
     MqttsnErrorCode subscribe(
@@ -888,7 +1431,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -930,7 +1473,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -941,6 +1484,11 @@ public:
             return MqttsnErrorCode_BadParam;
         }
 
+        auto predefinedTopicId = PredefinedTopics::findId(topic);
+        if (predefinedTopicId != 0U) {
+            return subscribe(predefinedTopicId, qos, callback, data);
+        }
+
         auto guard = apiCall();
 
         m_currOp = Op::Subscribe;
@@ -976,7 +1524,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1011,7 +1559,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy() || congestionHold()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1019,6 +1567,11 @@ public:
             return MqttsnErrorCode_BadParam;
         }
 
+        auto predefinedTopicId = PredefinedTopics::findId(topic);
+        if (predefinedTopicId != 0U) {
+            return unsubscribe(predefinedTopicId, callback, data);
+        }
+
         auto guard = apiCall();
 
         m_currOp = Op::Unsubscribe;
@@ -1050,7 +1603,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1092,7 +1645,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1129,7 +1682,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1164,7 +1717,7 @@ public:
             return MqttsnErrorCode_NotConnected;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1197,7 +1750,7 @@ public:
             return MqttsnErrorCode_NotSleeping;
         }
 
-        if (m_currOp != Op::None) {
+        if (isBusy()) {
             return MqttsnErrorCode_Busy;
         }
 
@@ -1272,10 +1825,16 @@ public:
             return;
         }
 
+        sampleRtt(*op, MqttsnStatsOp_Connect);
+
         auto returnCode = msg.field_returnCode().value();
+        if (holdOnCongestion(*op, returnCode)) {
+            return;
+        }
 
         if (returnCode == ReturnCodeVal::Accepted) {
             m_connectionStatus = ConnectionStatus::Connected;
+            m_congestion.acknowledged();
         }
 
         do {
@@ -1306,6 +1865,7 @@ public:
         bool emptyTopic =
             (op->m_willInfo.topic == nullptr) || (op->m_willInfo.topic[0] == '\0');
 
+        sampleRtt(*op, MqttsnStatsOp_Connect);
         op->m_lastMsgTimestamp = m_timestamp;
         op->m_willTopicSent = true;
         if (emptyTopic) {
@@ -1327,6 +1887,7 @@ public:
             return;
         }
 
+        sampleRtt(*op, MqttsnStatsOp_Connect);
         op->m_lastMsgTimestamp = m_timestamp;
         WillmsgMsg outMsg;
 
@@ -1354,34 +1915,45 @@ public:
 
     void handle(RegackMsg& msg)
     {
-        if (m_currOp != Op::Publish) {
+        auto* slot = findPublishSlot(msg.field_msgId().value());
+        if ((slot == nullptr) || (slot->m_op != Op::Publish)) {
             return;
         }
 
-        auto* op = opPtr<PublishOp>();
+        auto* op = publishOpPtr<PublishOp>(*slot);
 
         if (!op->m_didRegistration) {
             return;
         }
 
-        if (msg.field_msgId().value() != op->m_msgId) {
+        sampleRtt(*op, MqttsnStatsOp_Register);
+        auto retCodeValue = msg.field_returnCode().value();
+        if (holdOnCongestion(*op, retCodeValue)) {
             return;
         }
 
-        auto retCodeValue = msg.field_returnCode().value();
-
         if (retCodeValue != ReturnCodeVal::Accepted) {
-            finalisePublishOp(retCodeToStatus(retCodeValue));
+            finalisePublishOp(*slot, retCodeToStatus(retCodeValue));
             return;
         }
 
+        m_congestion.acknowledged();
         op->m_lastMsgTimestamp = m_timestamp;
         op->m_registered = true;
         op->m_topicId = msg.field_topicId().value();
         op->m_attempt = 0;
 
-        updateRegInfo(op->m_topic, std::strlen(op->m_topic), op->m_topicId);
-        bool result = doPublish();
+        if (op->m_topicHandle != MQTTSN_INVALID_TOPIC_HANDLE) {
+            auto* regInfo = m_regInfos.findByHandle(op->m_topicHandle);
+            if (regInfo != nullptr) {
+                updateRegInfo(regInfo->m_topic.c_str(), regInfo->m_topic.size(), op->m_topicId);
+            }
+        }
+        else {
+            updateRegInfo(op->m_topic, std::strlen(op->m_topic), op->m_topicId);
+        }
+
+        bool result = doPublish(*slot);
         static_cast<void>(result);
         COMMS_ASSERT(result);
     }
@@ -1394,7 +1966,8 @@ public:
                 auto msgInfo = MqttsnMessageInfo();
 
                 msgInfo.topic = topicName;
-                if (topicName == nullptr) {
+                if ((topicName == nullptr) ||
+                    (msg.field_flags().field_topicIdType().value() == TopicIdTypeVal::PredefinedTopicId)) {
                     msgInfo.topicId = msg.field_topicId().value();
                 }
 
@@ -1407,30 +1980,30 @@ public:
                 m_msgReportFn(m_msgReportData, &msgInfo);
             };
 
-        auto iter = m_regInfos.end();
+        RegInfo* regInfo = nullptr;
         if (msg.field_flags().field_topicIdType().value() == TopicIdTypeVal::Normal) {
-            iter = std::find_if(
-                m_regInfos.begin(), m_regInfos.end(),
-                [&msg](typename RegInfosList::const_reference elem) -> bool
-                {
-                    return elem.m_allocated && (elem.m_topicId == msg.field_topicId().value());
-                });
-
-            if (iter == m_regInfos.end()) {
+            regInfo = m_regInfos.findById(msg.field_topicId().value());
+            if (regInfo == nullptr) {
                 sendPuback(msg.field_topicId().value(), msg.field_msgId().value(), ReturnCodeVal::InvalidTopicId);
             }
         }
 
         const char* topicName = nullptr;
-        if (iter != m_regInfos.end()) {
-            topicName = iter->m_topic.c_str();
+        if (regInfo != nullptr) {
+            topicName = regInfo->m_topic.c_str();
+        }
+
+        bool usingPredefinedTopicId =
+            msg.field_flags().field_topicIdType().value() == TopicIdTypeVal::PredefinedTopicId;
+        if (usingPredefinedTopicId) {
+            topicName = PredefinedTopics::findName(msg.field_topicId().value());
         }
 
         char shortTopicName[3] = {0};
         bool usingShortTopic =
             msg.field_flags().field_topicIdType().value() == TopicIdTypeVal::ShortTopicName;
         if (usingShortTopic) {
-            COMMS_ASSERT(iter == m_regInfos.end());
+            COMMS_ASSERT(regInfo == nullptr);
             topicIdToShortTopic(msg.field_topicId().value(), &shortTopicName[0]);
             topicName = &shortTopicName[0];
         }
@@ -1449,7 +2022,10 @@ public:
 
         if ((topicName == nullptr) &&
             (msg.field_flags().field_topicIdType().value() != TopicIdTypeVal::PredefinedTopicId)) {
-            m_lastInMsg = LastInMsgInfo();
+            auto* info = findInQos2Msg(msg.field_msgId().value());
+            if (info != nullptr) {
+                resetInQos2Msg(*info);
+            }
             return;
         }
 
@@ -1461,27 +2037,53 @@ public:
 
         COMMS_ASSERT(msg.field_flags().field_qos().value() == mqttsn::field::QosVal::ExactlyOnceDelivery);
 
+        auto* infoPtr = findInQos2Msg(msg.field_msgId().value());
+        if (infoPtr == nullptr) {
+            infoPtr = allocInQos2Msg();
+        }
+
+        if (infoPtr == nullptr) {
+            // All the slots await their PUBREL, no PUBREC, so the gateway
+            // sends it again later
+            return;
+        }
+
+        auto& info = *infoPtr;
         bool newMessage =
             ((!msg.field_flags().field_high().getBitValue_Dup()) ||
-             (msg.field_topicId().value() != m_lastInMsg.m_topicId) ||
-             (msg.field_msgId().value() != m_lastInMsg.m_msgId) ||
-             (m_lastInMsg.m_reported) ||
-             (usingShortTopic != m_lastInMsg.m_usingShortTopicName));
+             (!info.m_valid) ||
+             (msg.field_topicId().value() != info.m_topicId) ||
+             (msg.field_msgId().value() != info.m_msgId) ||
+             (info.m_reported) ||
+             (usingShortTopic != info.m_usingShortTopicName) ||
+             (usingPredefinedTopicId != info.m_usingPredefinedTopicId));
 
         if (newMessage) {
-            m_lastInMsg = LastInMsgInfo();
-
-            m_lastInMsg.m_topicId = msg.field_topicId().value();
-            m_lastInMsg.m_msgId = msg.field_msgId().value();
-            m_lastInMsg.m_retain = msg.field_flags().field_mid().getBitValue_Retain();
-            m_lastInMsg.m_usingShortTopicName = usingShortTopic;
+            resetInQos2Msg(info);
+
+            info.m_valid = true;
+            info.m_topicId = msg.field_topicId().value();
+            info.m_msgId = msg.field_msgId().value();
+            info.m_retain = msg.field_flags().field_mid().getBitValue_Retain();
+            info.m_usingShortTopicName = usingShortTopic;
+            info.m_usingPredefinedTopicId = usingPredefinedTopicId;
             if (usingShortTopic) {
-                std::copy(std::begin(shortTopicName), std::end(shortTopicName), std::begin(m_lastInMsg.m_shortTopic));
+                std::copy(std::begin(shortTopicName), std::end(shortTopicName), std::begin(info.m_shortTopic));
             }
+            m_inQos2Index.assign(inQos2MsgSlot(info), info.m_msgId);
         }
 
         auto& msgData = msg.field_data().value();
-        m_lastInMsg.m_msgData.assign(msgData.begin(), msgData.end());
+        releaseInQos2MsgLoan(info);
+        if (m_currLoanBuf != nullptr) {
+            info.m_msgData.clear();
+            info.m_loanBuf = m_currLoanBuf;
+            info.m_loanData = &(*msgData.begin());
+            info.m_loanDataLen = msgData.size();
+        }
+        else {
+            info.m_msgData.assign(msgData.begin(), msgData.end());
+        }
 
         PubrecMsg recMsg;
         recMsg.field_msgId().value() = msg.field_msgId().value();
@@ -1493,28 +2095,22 @@ public:
         auto retCodeValue = msg.field_returnCode().value();
 
         if (retCodeValue == ReturnCodeVal::InvalidTopicId) {
+            m_stats.invalidTopicAck();
 
-            auto iter = std::find_if(
-                m_regInfos.begin(), m_regInfos.end(),
-                [&msg](typename RegInfosList::const_reference elem) -> bool
-                {
-                    return elem.m_allocated && (elem.m_topicId == msg.field_topicId().value());
-                });
-
-            if (iter != m_regInfos.end()) {
-                dropRegInfo(iter);
+            auto* regInfo = m_regInfos.findById(msg.field_topicId().value());
+            if (regInfo != nullptr) {
+                forgetRegInfo(*regInfo);
             }
         }
 
-        if ((m_currOp != Op::Publish) && (m_currOp != Op::PublishId)) {
+        auto* slot = findPublishSlot(msg.field_msgId().value());
+        if (slot == nullptr) {
             return;
         }
 
-        auto* op = opPtr<PublishOpBase>();
-
+        auto* op = publishOpPtr<PublishOpBase>(*slot);
 
-        if ((msg.field_topicId().value() != op->m_topicId) ||
-            (msg.field_msgId().value() != op->m_msgId)) {
+        if (msg.field_topicId().value() != op->m_topicId) {
             return;
         }
 
@@ -1524,100 +2120,112 @@ public:
             return;
         }
 
+        sampleRtt(*op, MqttsnStatsOp_Publish);
+        if (holdOnCongestion(*op, retCodeValue)) {
+            return;
+        }
+
         do {
             if ((op->m_qos < MqttsnQoS_AtLeastOnceDelivery) ||
                 (retCodeValue != ReturnCodeVal::InvalidTopicId) ||
-                (m_currOp != Op::Publish) ||
-                (opPtr<PublishOp>()->m_didRegistration)) {
+                (slot->m_op != Op::Publish) ||
+                (publishOpPtr<PublishOp>(*slot)->m_didRegistration)) {
                 break;
             }
 
             op->m_lastMsgTimestamp = m_timestamp;
             op->m_topicId = 0U;
             op->m_attempt = 0;
-            opPtr<PublishOp>()->m_registered = false;
-            doPublish();
+            publishOpPtr<PublishOp>(*slot)->m_registered = false;
+            doPublish(*slot);
             return;
         } while (false);
 
-        finalisePublishOp(retCodeToStatus(retCodeValue));
+        finalisePublishOp(*slot, retCodeToStatus(retCodeValue));
     }
 
     void handle(PubrecMsg& msg)
     {
-        if ((m_currOp != Op::Publish) && (m_currOp != Op::PublishId)) {
-            return;
-        }
-
-        auto* op = opPtr<PublishOpBase>();
-
-        if (msg.field_msgId().value() != op->m_msgId) {
+        auto* slot = findPublishSlot(msg.field_msgId().value());
+        if (slot == nullptr) {
             return;
         }
 
+        auto* op = publishOpPtr<PublishOpBase>(*slot);
+        sampleRtt(*op, MqttsnStatsOp_Publish);
         op->m_lastMsgTimestamp = m_timestamp;
         op->m_ackReceived = true;
+        m_journal.markReleased(publishSlotIdx(*slot));
         sendPubrel(op->m_msgId);
     }
 
     void handle(PubrelMsg& msg)
     {
-        if (m_lastInMsg.m_msgId != msg.field_msgId().value()) {
-            m_lastInMsg = LastInMsgInfo();
+        auto* infoPtr = findInQos2Msg(msg.field_msgId().value());
+        if (infoPtr == nullptr) {
             return;
         }
 
+        auto& info = *infoPtr;
+
         PubcompMsg compMsg;
         compMsg.field_msgId().value() = msg.field_msgId().value();
         sendMessage(compMsg);
 
-        if (!m_lastInMsg.m_reported) {
+        if (!info.m_reported) {
             auto msgInfo = MqttsnMessageInfo();
 
-            if (m_lastInMsg.m_usingShortTopicName) {
-                msgInfo.topic = &m_lastInMsg.m_shortTopic[0];
+            if (info.m_usingShortTopicName) {
+                msgInfo.topic = &info.m_shortTopic[0];
+            }
+            else if (info.m_usingPredefinedTopicId) {
+                msgInfo.topic = PredefinedTopics::findName(info.m_topicId);
+                msgInfo.topicId = info.m_topicId;
             }
             else {
-                auto iter = std::find_if(
-                    m_regInfos.begin(), m_regInfos.end(),
-                    [this](typename RegInfosList::const_reference elem) -> bool
-                    {
-                        return elem.m_allocated && (elem.m_topicId == m_lastInMsg.m_topicId);
-                    });
-
-                if (iter != m_regInfos.end()) {
-                    msgInfo.topic = iter->m_topic.c_str();
+                auto* regInfo = m_regInfos.findById(info.m_topicId);
+                if (regInfo != nullptr) {
+                    msgInfo.topic = regInfo->m_topic.c_str();
                 }
 
-                msgInfo.topicId = m_lastInMsg.m_topicId;
+                msgInfo.topicId = info.m_topicId;
             }
 
-            msgInfo.msg = &(*m_lastInMsg.m_msgData.begin());
-            msgInfo.msgLen = m_lastInMsg.m_msgData.size();
+            if (info.m_loanBuf != nullptr) {
+                msgInfo.msg = info.m_loanData;
+                msgInfo.msgLen = static_cast<unsigned>(info.m_loanDataLen);
+            }
+            else {
+                msgInfo.msg = &(*info.m_msgData.begin());
+                msgInfo.msgLen = info.m_msgData.size();
+            }
             msgInfo.qos = MqttsnQoS_ExactlyOnceDelivery;
-            msgInfo.retain = m_lastInMsg.m_retain;
+            msgInfo.retain = info.m_retain;
 
-            m_lastInMsg.m_reported = true;
+            info.m_reported = true;
+            m_inQos2Index.markReported(inQos2MsgSlot(info));
 
             COMMS_ASSERT(m_msgReportFn != nullptr);
             m_msgReportFn(m_msgReportData, &msgInfo);
+            releaseInQos2MsgLoan(info);
         }
     }
 
     void handle(PubcompMsg& msg)
     {
-        if ((m_currOp != Op::Publish) && (m_currOp != Op::PublishId)) {
+        auto* slot = findPublishSlot(msg.field_msgId().value());
+        if (slot == nullptr) {
             return;
         }
 
-        auto* op = opPtr<PublishOpBase>();
+        auto* op = publishOpPtr<PublishOpBase>(*slot);
 
-        if ((msg.field_msgId().value() != op->m_msgId) ||
-            (!op->m_ackReceived)) {
+        if (!op->m_ackReceived) {
             return;
         }
 
-        finalisePublishOp(MqttsnAsyncOpStatus_Successful);
+        sampleRtt(*op, MqttsnStatsOp_Publish);
+        finalisePublishOp(*slot, MqttsnAsyncOpStatus_Successful);
     }
 
     void handle(SubackMsg& msg)
@@ -1636,20 +2244,15 @@ public:
             return;
         }
 
+        sampleRtt(*opPtr<OpBase>(), MqttsnStatsOp_Subscribe);
         auto retCodeValue = msg.field_returnCode().value();
         if ((retCodeValue == ReturnCodeVal::InvalidTopicId) &&
             (m_currOp == Op::Subscribe) &&
             (opPtr<SubscribeOp>()->m_topicId != 0U)) {
 
-            auto iter = std::find_if(
-                m_regInfos.begin(), m_regInfos.end(),
-                [this](typename RegInfosList::const_reference elem) -> bool
-                {
-                    return elem.m_allocated && (elem.m_topicId == opPtr<SubscribeOp>()->m_topicId);
-                });
-
-            if (iter != m_regInfos.end()) {
-                dropRegInfo(iter);
+            auto* regInfo = m_regInfos.findById(opPtr<SubscribeOp>()->m_topicId);
+            if (regInfo != nullptr) {
+                forgetRegInfo(*regInfo);
             }
 
             op->m_attempt = 0;
@@ -1659,6 +2262,10 @@ public:
             return;
         }
 
+        if (holdOnCongestion(*opPtr<OpBase>(), retCodeValue)) {
+            return;
+        }
+
         auto qosValue = details::translateQosValue(msg.field_flags().field_qos().value());
         if (retCodeValue != ReturnCodeVal::Accepted) {
             op->m_qos = qosValue;
@@ -1680,6 +2287,7 @@ public:
         }
 
         op->m_qos = qosValue;
+        m_congestion.acknowledged();
         finaliseSubscribeOp(MqttsnAsyncOpStatus_Successful);
     }
 
@@ -1695,6 +2303,8 @@ public:
             return;
         }
 
+        sampleRtt(*op, MqttsnStatsOp_Unsubscribe);
+
         do {
             if (m_currOp != Op::Unsubscribe) {
                 break;
@@ -1706,20 +2316,15 @@ public:
                 break;
             }
 
-            auto iter = std::find_if(
-                m_regInfos.begin(), m_regInfos.end(),
-                [downcastedOp](typename RegInfosList::const_reference elem) -> bool
-                {
-                    return elem.m_allocated && (elem.m_topicId == downcastedOp->m_topicId);
-                });
-
-            if (iter == m_regInfos.end()) {
+            auto* regInfo = m_regInfos.findById(downcastedOp->m_topicId);
+            if (regInfo == nullptr) {
                 break;
             }
 
-            iter->m_locked = false;
+            m_regInfos.setLocked(*regInfo, false);
         } while (false);
 
+        m_congestion.acknowledged();
         finaliseUnsubscribeOp(MqttsnAsyncOpStatus_Successful);
     }
 
@@ -1734,6 +2339,9 @@ public:
     {
         static_cast<void>(msg);
         bool pinging = (0U < m_pingCount);
+        if (m_pingCount == 1U) {
+            sampleRtt(static_cast<unsigned>(m_timestamp - m_lastPingTimestamp), MqttsnStatsOp_Ping);
+        }
         m_pingCount = 0U;
 
         if (pinging || (m_currOp != Op::CheckMessages)) {
@@ -1749,6 +2357,10 @@ public:
     {
         static_cast<void>(msg);
 
+        if ((m_currOp == Op::Disconnect) || (m_currOp == Op::Sleep)) {
+            sampleRtt(*opPtr<OpBase>(), MqttsnStatsOp_Disconnect);
+        }
+
         if (m_currOp == Op::Disconnect) {
             finaliseDisconnectOp(MqttsnAsyncOpStatus_Successful);
             return;
@@ -1760,7 +2372,7 @@ public:
             return;
         }
 
-        if (m_currOp == Op::None) {
+        if (!isBusy()) {
             reportGwDisconnected();
             return;
         }
@@ -1775,6 +2387,8 @@ public:
             return;
         }
 
+        sampleRtt(*opPtr<OpBase>(), MqttsnStatsOp_WillUpdate);
+
         finaliseWillTopicUpdateOp(retCodeToStatus(msg.field_returnCode().value()));
     }
 
@@ -1784,6 +2398,8 @@ public:
             return;
         }
 
+        sampleRtt(*opPtr<OpBase>(), MqttsnStatsOp_WillUpdate);
+
         finaliseWillMsgUpdateOp(retCodeToStatus(msg.field_returnCode().value()));
     }
 
@@ -1797,8 +2413,6 @@ private:
     typedef typename comms::util::AlignedUnion<
         ConnectOp,
         DisconnectOp,
-        PublishIdOp,
-        PublishOp,
         SubscribeIdOp,
         SubscribeOp,
         UnsubscribeIdOp,
@@ -1809,22 +2423,41 @@ private:
         CheckMessagesOp
     >::Type OpStorageType;
 
-    using InputMessages = mqttsn::input::ClientInputMessages<Message, ProtOpts>;
-    typedef mqttsn::frame::Frame<Message, InputMessages, ProtOpts> ProtStack;
-    typedef typename ProtStack::MsgPtr MsgPtr;
+    typedef typename comms::util::AlignedUnion<
+        PublishIdOp,
+        PublishOp
+    >::Type PublishOpStorageType;
+
+    static const std::size_t InflightPublishesLimit =
+        details::InflightPublishesLimitT<TClientOpts>::Value;
 
-    struct RegInfo
+    typedef details::OutboundQueueTypeT<TopicNameType, DataType, TClientOpts, InflightPublishesLimit> OutboundQueue;
+    typedef typename OutboundQueue::Ref OutboundQueueRef;
+
+    struct PublishSlot
     {
-        Timestamp m_timestamp = 0U;
-        TopicNameType m_topic;
-        TopicIdType m_topicId = 0U;
-        bool m_allocated = false;
-        bool m_locked = false;
+        Op m_op = Op::None;
+        PublishOpStorageType m_storage;
+        bool m_queued = false; // publishes the outbound queue entry
+        OutboundQueueRef m_queuedRef = OutboundQueueRef();
     };
 
-    typedef details::RegInfoStorageTypeT<RegInfo, TClientOpts> RegInfosList;
+    typedef std::array<PublishSlot, InflightPublishesLimit> PublishSlotsList;
+
+    typedef details::OutboundJournalTypeT<TopicNameType, DataType, TClientOpts, InflightPublishesLimit> OutboundJournal;
+    typedef details::ClientStatsTypeT<TClientOpts> ClientStats;
+    typedef details::TraceRingTypeT<TClientOpts> TraceRing;
+    typedef details::PublishStreamTypeT<TClientOpts> PublishStream;
 
-    struct LastInMsgInfo
+    using InputMessages = mqttsn::input::ClientInputMessages<Message, ProtOpts>;
+    typedef mqttsn::frame::Frame<Message, InputMessages, ProtOpts> ProtStack;
+    typedef typename ProtStack::MsgPtr MsgPtr;
+
+    typedef details::RegInfoRegistry<TopicNameType, TopicIdType, TClientOpts> RegInfosList;
+    typedef details::PredefinedTopicsMapTypeT<TClientOpts> PredefinedTopics;
+    typedef typename RegInfosList::RegInfo RegInfo;
+
+    struct InQos2MsgInfo
     {
         DataType m_msgData;
         MqttsnTopicId m_topicId = 0;
@@ -1833,78 +2466,100 @@ private:
         bool m_retain = false;
         bool m_reported = false;
         bool m_usingShortTopicName = false;
+        bool m_usingPredefinedTopicId = false;
+        bool m_valid = false;
+        const std::uint8_t* m_loanBuf = nullptr;
+        const std::uint8_t* m_loanData = nullptr;
+        std::size_t m_loanDataLen = 0U;
     };
 
-    void updateRegInfo(const char* topic, std::size_t topicLen, TopicIdType topicId, bool locked = false)
+    static const std::size_t PendingInboundQos2Limit =
+        details::PendingInboundQos2LimitT<TClientOpts>::Value;
+
+    typedef std::array<InQos2MsgInfo, PendingInboundQos2Limit> InQos2MsgsList;
+    typedef details::InQos2Index<PendingInboundQos2Limit> InQos2MsgsIndex;
+
+    InQos2MsgInfo* findInQos2Msg(std::uint16_t msgId)
     {
-        auto iter = std::find_if(
-            m_regInfos.begin(), m_regInfos.end(),
-            [topic, topicLen](typename RegInfosList::const_reference elem) -> bool
-            {
-                return
-                    elem.m_allocated &&
-                    elem.m_topic.size() == topicLen &&
-                    std::equal(elem.m_topic.begin(), elem.m_topic.end(), topic);
-            });
+        return inQos2MsgPtr(m_inQos2Index.find(msgId));
+    }
 
-        if (iter != m_regInfos.end()) {
-            iter->m_timestamp = m_timestamp;
-            iter->m_topicId = topicId;
-            iter->m_locked = (iter->m_locked || locked);
-            return;
+    // The message IDs are chosen by the gateway, the slot awaiting PUBREL
+    // must never be taken over, the reported ones are only kept to detect
+    // duplicates.
+    InQos2MsgInfo* allocInQos2Msg()
+    {
+        return inQos2MsgPtr(m_inQos2Index.reusable());
+    }
+
+    InQos2MsgInfo* inQos2MsgPtr(std::size_t slot)
+    {
+        if (slot == InQos2MsgsIndex::NoSlot) {
+            return nullptr;
         }
 
-        iter = std::find_if(
-            m_regInfos.begin(), m_regInfos.end(),
-            [](typename RegInfosList::const_reference elem) -> bool
-            {
-                return !elem.m_allocated;
-            });
+        return &m_inQos2Msgs[slot];
+    }
 
-        if (iter != m_regInfos.end()) {
-            iter->m_timestamp = m_timestamp;
-            iter->m_topic.assign(topic, topic + topicLen);
-            iter->m_topicId = topicId;
-            iter->m_allocated = true;
-            iter->m_locked = locked;
+    std::size_t inQos2MsgSlot(const InQos2MsgInfo& info) const
+    {
+        return static_cast<std::size_t>(&info - &m_inQos2Msgs[0]);
+    }
+
+    bool isLoanRetained(const std::uint8_t* buf) const
+    {
+        return
+            std::any_of(
+                m_inQos2Msgs.begin(), m_inQos2Msgs.end(),
+                [buf](typename InQos2MsgsList::const_reference elem) -> bool
+                {
+                    return elem.m_loanBuf == buf;
+                });
+    }
+
+    void releaseInQos2MsgLoan(InQos2MsgInfo& info)
+    {
+        auto* buf = info.m_loanBuf;
+        if (buf == nullptr) {
             return;
         }
 
-        RegInfo info;
-        info.m_timestamp = m_timestamp;
-        info.m_topic.assign(topic, topicLen);
-        info.m_topicId = topicId;
-        info.m_allocated = true;
-        info.m_locked = locked;
+        info.m_loanBuf = nullptr;
+        info.m_loanData = nullptr;
+        info.m_loanDataLen = 0U;
 
-        if (m_regInfos.size() < m_regInfos.max_size()) {
-            m_regInfos.push_back(std::move(info));
+        if ((buf == m_currLoanBuf) || isLoanRetained(buf)) {
+            // released by processLoanedData() or when other pending message is done
             return;
         }
 
-        iter = std::min_element(
-            m_regInfos.begin(), m_regInfos.end(),
-            [](typename RegInfosList::const_reference elem1,
-               typename RegInfosList::const_reference elem2) -> bool
-            {
-                if (elem1.m_locked == elem2.m_locked) {
-                    return (elem1.m_timestamp < elem2.m_timestamp);
-                }
-
-                if (elem1.m_locked) {
-                    return false;
-                }
+        COMMS_ASSERT(m_bufReleaseFn != nullptr);
+        m_bufReleaseFn(m_bufReleaseData, buf);
+    }
 
-                return true;
-            });
+    void resetInQos2Msg(InQos2MsgInfo& info)
+    {
+        releaseInQos2MsgLoan(info);
+        if (info.m_valid) {
+            m_inQos2Index.release(inQos2MsgSlot(info));
+        }
+        info = InQos2MsgInfo();
+    }
 
-        COMMS_ASSERT(iter != m_regInfos.end());
-        *iter = info;
+    void updateRegInfo(const char* topic, std::size_t topicLen, TopicIdType topicId, bool locked = false)
+    {
+        m_regInfos.update(topic, topicLen, topicId, locked);
     }
 
-    void dropRegInfo(typename RegInfosList::iterator iter)
+    void forgetRegInfo(RegInfo& info)
     {
-        *iter = RegInfo();
+        if (RegInfosList::isPinned(info)) {
+            // Topic handle remains valid, registered again on next publish
+            m_regInfos.clearTopicId(info);
+            return;
+        }
+
+        m_regInfos.drop(info);
     }
 
     template <typename TOp>
@@ -1919,6 +2574,7 @@ private:
         static_assert(sizeof(TOp) <= sizeof(m_opStorage), "Invalid storage size");
         auto op = new (&m_opStorage) TOp();
         op->m_lastMsgTimestamp = m_timestamp;
+        trace(MqttsnTraceEvent_OpStart, statsOpFor(m_currOp));
         return op;
     }
 
@@ -1933,6 +2589,65 @@ private:
         return op;
     }
 
+    template <typename TOp>
+    static TOp* publishOpPtr(PublishSlot& slot)
+    {
+        return reinterpret_cast<TOp*>(&slot.m_storage);
+    }
+
+    template <typename TOp>
+    TOp* newPublishOp(PublishSlot& slot, Op op)
+    {
+        static_assert(sizeof(TOp) <= sizeof(slot.m_storage), "Invalid storage size");
+        COMMS_ASSERT(slot.m_op == Op::None);
+        auto pubOp = new (&slot.m_storage) TOp();
+        pubOp->m_lastMsgTimestamp = m_timestamp;
+        slot.m_op = op;
+        ++m_inflightPublishes;
+        trace(MqttsnTraceEvent_OpStart, MqttsnStatsOp_Publish, 0U, publishTraceKey(slot));
+        return pubOp;
+    }
+
+    PublishSlot* findFreePublishSlot()
+    {
+        if (InflightPublishesLimit <= m_inflightPublishes) {
+            return nullptr;
+        }
+
+        auto iter =
+            std::find_if(
+                m_publishSlots.begin(), m_publishSlots.end(),
+                [this](typename PublishSlotsList::const_reference elem) -> bool
+                {
+                    // The slots of journaled publishes are reserved until resent
+                    return
+                        (elem.m_op == Op::None) &&
+                        (!m_journal.replayPending(publishSlotIdx(elem)));
+                });
+
+        if (iter == m_publishSlots.end()) {
+            return nullptr;
+        }
+
+        return &(*iter);
+    }
+
+    PublishSlot* findPublishSlot(std::uint16_t msgId)
+    {
+        auto& slot = m_publishSlots[msgId % InflightPublishesLimit];
+        if ((slot.m_op == Op::None) ||
+            (publishOpPtr<PublishOpBase>(slot)->m_msgId != msgId)) {
+            return nullptr;
+        }
+
+        return &slot;
+    }
+
+    bool isBusy() const
+    {
+        return (m_currOp != Op::None) || (0U < m_inflightPublishes);
+    }
+
     typename GwInfoStorage::iterator findGwInfo(GwIdValueType id)
     {
         return
@@ -2002,14 +2717,14 @@ private:
         return static_cast<unsigned>(nextSearchTimestamp - m_timestamp);
     }
 
-    unsigned calcCurrentOpTimeout()
+    Timestamp calcOpRetryTimestamp(const OpBase& op) const
     {
-        if (m_currOp == Op::None) {
-            return NoTimeout;
-        }
+        return std::max(op.m_lastMsgTimestamp + m_rtt.timeout(), m_congestionHoldUntil);
+    }
 
-        auto* op = opPtr<OpBase>();
-        auto nextOpTimestamp = op->m_lastMsgTimestamp + m_retryPeriod;
+    unsigned calcOpTimeout(const OpBase& op) const
+    {
+        auto nextOpTimestamp = calcOpRetryTimestamp(op);
         if (nextOpTimestamp <= m_timestamp) {
             return 1U;
         }
@@ -2017,13 +2732,44 @@ private:
         return static_cast<unsigned>(nextOpTimestamp - m_timestamp);
     }
 
+    unsigned calcCurrentOpTimeout()
+    {
+        unsigned delay = NoTimeout;
+        if (m_currOp != Op::None) {
+            delay = calcOpTimeout(*opPtr<OpBase>());
+        }
+
+        if (m_inflightPublishes == 0U) {
+            return delay;
+        }
+
+        for (auto& slot : m_publishSlots) {
+            if (slot.m_op != Op::None) {
+                delay = std::min(delay, calcOpTimeout(*publishOpPtr<OpBase>(slot)));
+            }
+        }
+
+        return delay;
+    }
+
+    unsigned calcCongestionHoldTimeout()
+    {
+        // The timestamp is updated when the timer expires, the held back
+        // requests are accepted (and the queued ones sent) afterwards.
+        if (!congestionHold()) {
+            return NoTimeout;
+        }
+
+        return static_cast<unsigned>(m_congestionHoldUntil - m_timestamp);
+    }
+
     unsigned calcPingTimeout()
     {
         if (m_connectionStatus != ConnectionStatus::Connected) {
             return NoTimeout;
         }
 
-        auto pingTimestamp = m_lastPingTimestamp + m_retryPeriod;
+        auto pingTimestamp = m_lastPingTimestamp + m_rtt.timeout();
         if (m_pingCount == 0) {
             pingTimestamp =
                 std::min(m_lastSentMsgTimestamp, m_lastRecvMsgTimestamp) + m_keepAlivePeriod;
@@ -2047,6 +2793,7 @@ private:
         delay = std::min(delay, std::max(1U, calcSearchGwSendTimeout()));
         delay = std::min(delay, calcCurrentOpTimeout());
         delay = std::min(delay, calcPingTimeout());
+        delay = std::min(delay, calcCongestionHoldTimeout());
 
         if (delay == NoTimeout) {
             return;
@@ -2121,16 +2868,21 @@ private:
         }
 
         COMMS_ASSERT(0U < m_lastPingTimestamp);
-        if (m_timestamp < (m_lastPingTimestamp + m_retryPeriod)) {
+        if (m_timestamp < (m_lastPingTimestamp + m_rtt.timeout())) {
             return;
         }
 
+        m_rttExpired = true;
+        m_stats.pingTimeout();
+
         if (m_retryCount <= m_pingCount) {
             reportGwDisconnected();
             return;
         }
 
+        m_stats.retransmit(MqttsnStatsOp_Ping);
         sendPing();
+        trace(MqttsnTraceEvent_OpRetry, MqttsnStatsOp_Ping, m_pingCount);
     }
 
     void checkOpTimeout()
@@ -2140,17 +2892,19 @@ private:
         }
 
         auto* op = opPtr<OpBase>();
-        if (m_timestamp < (op->m_lastMsgTimestamp + m_retryPeriod)) {
+        if (m_timestamp < calcOpRetryTimestamp(*op)) {
             return;
         }
 
+        reportOpExpired(*op);
+
         typedef bool (BasicClient<TClientOpts>::*DoOpFunc)();
         static const DoOpFunc OpTimeoutFuncMap[] =
         {
             &BasicClient::doConnect,
             &BasicClient::doDisconnect,
-            &BasicClient::doPublishId,
-            &BasicClient::doPublish,
+            nullptr, // publish ops are tracked in m_publishSlots
+            nullptr,
             &BasicClient::doSubscribeId,
             &BasicClient::doSubscribe,
             &BasicClient::doUnsubscribeId,
@@ -2171,6 +2925,8 @@ private:
 
         COMMS_ASSERT(fn != nullptr);
         if ((this->*(fn))()) {
+            m_stats.retransmit(statsOpFor(m_currOp));
+            trace(MqttsnTraceEvent_OpRetry, statsOpFor(m_currOp), op->m_attempt);
             op->m_lastMsgTimestamp = m_timestamp;
             return;
         }
@@ -2180,16 +2936,151 @@ private:
         (this->*finaliseFn)(MqttsnAsyncOpStatus_NoResponse);
     }
 
+    void checkPublishOpsTimeout()
+    {
+        if (m_inflightPublishes == 0U) {
+            return;
+        }
+
+        for (auto& slot : m_publishSlots) {
+            if (slot.m_op == Op::None) {
+                continue;
+            }
+
+            auto* op = publishOpPtr<OpBase>(slot);
+            if (m_timestamp < calcOpRetryTimestamp(*op)) {
+                continue;
+            }
+
+            reportOpExpired(*op);
+
+            auto statsOp = MqttsnStatsOp_Publish;
+            bool result = false;
+            if (slot.m_op == Op::Publish) {
+                if (!publishOpPtr<PublishOp>(slot)->m_registered) {
+                    statsOp = MqttsnStatsOp_Register;
+                }
+                result = doPublish(slot);
+            }
+            else {
+                result = doPublishId(slot);
+            }
+
+            if (!result) {
+                finalisePublishOp(slot, MqttsnAsyncOpStatus_NoResponse);
+                continue;
+            }
+
+            m_stats.retransmit(statsOp);
+            trace(MqttsnTraceEvent_OpRetry, statsOp, op->m_attempt, publishTraceKey(slot));
+
+            if (slot.m_op != Op::None) {
+                op->m_lastMsgTimestamp = m_timestamp;
+            }
+        }
+    }
+
     void checkTimeouts()
     {
         if (m_timestamp < m_nextTimeoutTimestamp) {
             return;
         }
 
+        m_rttExpired = false;
         checkAvailableGateways();
         checkGwSearchReq();
         checkPing();
         checkOpTimeout();
+        checkPublishOpsTimeout();
+
+        if (m_rttExpired) {
+            // Single backoff for all the messages timed out together
+            m_rtt.backoff();
+        }
+    }
+
+    bool congestionHold() const
+    {
+        return m_timestamp < m_congestionHoldUntil;
+    }
+
+    bool congestionThrottled() const
+    {
+        return congestionHold() || (m_congestion.window() <= m_inflightPublishes);
+    }
+
+    /// @return true when the op is retried after the hold off
+    bool holdOnCongestion(OpBase& op, ReturnCodeVal retCode)
+    {
+        if (retCode != ReturnCodeVal::Congestion) {
+            return false;
+        }
+
+        m_congestionHoldUntil = m_timestamp + m_congestion.signal();
+        if (m_retryCount <= op.m_attempt) {
+            return false;
+        }
+
+        op.m_lastMsgTimestamp = m_timestamp;
+        return true;
+    }
+
+    void reportOpExpired(const OpBase& op)
+    {
+        // Resending after the congestion hold off doesn't mean the message was lost
+        if ((op.m_lastMsgTimestamp + m_rtt.timeout()) < m_congestionHoldUntil) {
+            return;
+        }
+
+        m_rttExpired = true;
+    }
+
+    void sampleRtt(const OpBase& op, MqttsnStatsOp statsOp)
+    {
+        // Karn's rule: ambiguous for retransmitted messages
+        if (op.m_attempt == 1U) {
+            sampleRtt(static_cast<unsigned>(m_timestamp - op.m_lastMsgTimestamp), statsOp);
+        }
+    }
+
+    void sampleRtt(unsigned rtt, MqttsnStatsOp statsOp)
+    {
+        m_rtt.sample(rtt);
+        m_stats.rtt(statsOp, rtt);
+    }
+
+    void trace(MqttsnTraceEvent event, MqttsnStatsOp op, unsigned arg = 0U, unsigned key = 0U)
+    {
+        m_trace.record(m_timestamp, event, op, arg, key);
+    }
+
+    unsigned publishTraceKey(const PublishSlot& slot) const
+    {
+        return static_cast<unsigned>(publishSlotIdx(slot)) + 1U;
+    }
+
+    static MqttsnStatsOp statsOpFor(Op op)
+    {
+        static const MqttsnStatsOp Map[] = {
+            /* Op::None */ MqttsnStatsOp_ValuesLimit,
+            /* Op::Connect */ MqttsnStatsOp_Connect,
+            /* Op::Disconnect */ MqttsnStatsOp_Disconnect,
+            /* Op::PublishId */ MqttsnStatsOp_Publish,
+            /* Op::Publish */ MqttsnStatsOp_Publish,
+            /* Op::SubscribeId */ MqttsnStatsOp_Subscribe,
+            /* Op::Subscribe */ MqttsnStatsOp_Subscribe,
+            /* Op::UnsubscribeId */ MqttsnStatsOp_Unsubscribe,
+            /* Op::Unsubscribe */ MqttsnStatsOp_Unsubscribe,
+            /* Op::WillTopicUpdate */ MqttsnStatsOp_WillUpdate,
+            /* Op::WillMsgUpdate */ MqttsnStatsOp_WillUpdate,
+            /* Op::Sleep */ MqttsnStatsOp_Disconnect,
+            /* Op::CheckMessages */ MqttsnStatsOp_Ping,
+        };
+        static const std::size_t MapSize = std::extent<decltype(Map)>::value;
+        static_assert(MapSize == static_cast<std::size_t>(Op::NumOfValues), "Map above is incorrect");
+
+        COMMS_ASSERT(static_cast<std::size_t>(op) < MapSize);
+        return Map[static_cast<std::size_t>(op)];
     }
 
     bool addNewGw(GwIdValueType id, unsigned duration)
@@ -2223,31 +3114,164 @@ private:
 
     void sendMessage(const Message& msg, bool broadcast = false)
     {
-        if (m_sendOutputDataFn == nullptr) {
+        if (m_sendOutputBatchFn != nullptr) {
+            batchMessage(msg, broadcast);
+            return;
+        }
+
+        if (m_allocOutputBufFn != nullptr) {
+            provideMessage(msg, broadcast);
+            return;
+        }
+
+        if ((m_sendOutputDataFn == nullptr) && (m_sendOutputVecFn == nullptr)) {
             COMMS_ASSERT(!"Unexpected send");
             return;
         }
 
-        m_writeBuf.resize(std::max(m_writeBuf.size(), m_stack.length(msg)));
-        COMMS_ASSERT(!m_writeBuf.empty());
-        auto writeIter = comms::writeIteratorFor<Message>(&m_writeBuf[0]);
-        auto es = m_stack.write(msg, writeIter, m_writeBuf.size());
+        auto len = m_stack.length(msg);
+        auto* buf = m_writeBuf.reserve(len);
+        COMMS_ASSERT(buf != nullptr);
+        if (buf == nullptr) {
+            // Buffer is too small
+            return;
+        }
+
+        auto writeIter = comms::writeIteratorFor<Message>(buf);
+        auto es = m_stack.write(msg, writeIter, len);
         COMMS_ASSERT(es == comms::ErrorStatus::Success);
         if (es != comms::ErrorStatus::Success) {
-            // Buffer is too small
             return;
         }
 
         auto writtenBytes = static_cast<std::size_t>(
-            std::distance(comms::writeIteratorFor<Message>(&m_writeBuf[0]), writeIter));
+            std::distance(comms::writeIteratorFor<Message>(buf), writeIter));
+
+        m_lastSentMsgTimestamp = m_timestamp;
+        m_stats.msgSent(static_cast<unsigned>(msg.getId()), writtenBytes);
+        trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, static_cast<unsigned>(msg.getId()));
+        sendOutput(buf, writtenBytes, broadcast);
+    }
+
+    void provideMessage(const Message& msg, bool broadcast)
+    {
+        auto len = m_stack.length(msg);
+        auto* buf = m_allocOutputBufFn(m_outputBufProviderData, static_cast<unsigned>(len), broadcast);
+        if (buf == nullptr) {
+            // No room in the transport, treated as lost
+            return;
+        }
+
+        auto writeIter = comms::writeIteratorFor<Message>(buf);
+        auto es = m_stack.write(msg, writeIter, len);
+        COMMS_ASSERT(es == comms::ErrorStatus::Success);
+        if (es != comms::ErrorStatus::Success) {
+            m_commitOutputBufFn(m_outputBufProviderData, buf, 0U, broadcast);
+            return;
+        }
+
+        m_lastSentMsgTimestamp = m_timestamp;
+        m_stats.msgSent(static_cast<unsigned>(msg.getId()), len);
+        trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, static_cast<unsigned>(msg.getId()));
+        m_commitOutputBufFn(m_outputBufProviderData, buf, static_cast<unsigned>(len), broadcast);
+    }
+
+    void sendOutput(const std::uint8_t* buf, std::size_t len, bool broadcast)
+    {
+        if (m_sendOutputVecFn != nullptr) {
+            auto vec = MqttsnIoVec();
+            vec.buf = buf;
+            vec.bufLen = static_cast<unsigned>(len);
+            m_sendOutputVecFn(m_sendOutputVecData, &vec, 1U, broadcast);
+            return;
+        }
+
+        m_sendOutputDataFn(m_sendOutputDataData, buf, static_cast<unsigned>(len), broadcast);
+    }
+
+    void batchMessage(const Message& msg, bool broadcast)
+    {
+        auto len = m_stack.length(msg);
+        if ((m_outputBatchFrames.size() == m_outputBatchFrames.max_size()) ||
+            ((m_outputBatchBuf.max_size() - m_outputBatchBuf.size()) < len)) {
+            flushOutputBatch();
+        }
+
+        auto offset = m_outputBatchBuf.size();
+        m_outputBatchBuf.resize(offset + len);
+        auto writeIter = comms::writeIteratorFor<Message>(&m_outputBatchBuf[offset]);
+        auto es = m_stack.write(msg, writeIter, len);
+        COMMS_ASSERT(es == comms::ErrorStatus::Success);
+        if (es != comms::ErrorStatus::Success) {
+            m_outputBatchBuf.resize(offset);
+            return;
+        }
+
+        auto frame = MqttsnOutputFrame();
+        frame.bufLen = static_cast<unsigned>(len);
+        frame.broadcast = broadcast;
+        m_outputBatchFrames.push_back(frame);
+        m_lastSentMsgTimestamp = m_timestamp;
+        m_stats.msgSent(static_cast<unsigned>(msg.getId()), len);
+        trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, static_cast<unsigned>(msg.getId()));
+    }
+
+    /// @brief Send already serialised frame, bypassing the protocol stack.
+    void sendFrame(const std::uint8_t* buf, std::size_t len, unsigned msgType)
+    {
+        if (m_sendOutputBatchFn != nullptr) {
+            if ((m_outputBatchFrames.size() == m_outputBatchFrames.max_size()) ||
+                ((m_outputBatchBuf.max_size() - m_outputBatchBuf.size()) < len)) {
+                flushOutputBatch();
+            }
+
+            m_outputBatchBuf.insert(m_outputBatchBuf.end(), buf, buf + len);
+            auto frame = MqttsnOutputFrame();
+            frame.bufLen = static_cast<unsigned>(len);
+            m_outputBatchFrames.push_back(frame);
+            m_lastSentMsgTimestamp = m_timestamp;
+            m_stats.msgSent(msgType, len);
+            trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, msgType);
+            return;
+        }
+
+        if ((m_sendOutputDataFn == nullptr) && (m_sendOutputVecFn == nullptr)) {
+            COMMS_ASSERT(!"Unexpected send");
+            return;
+        }
 
         m_lastSentMsgTimestamp = m_timestamp;
-        m_sendOutputDataFn(m_sendOutputDataData, &m_writeBuf[0], writtenBytes, broadcast);
+        m_stats.msgSent(msgType, len);
+        trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, msgType);
+        sendOutput(buf, len, false);
+    }
+
+    void flushOutputBatch()
+    {
+        if (m_outputBatchFrames.empty()) {
+            return;
+        }
+
+        // The buffer may have been reallocated while accumulating
+        std::size_t offset = 0U;
+        for (auto& frame : m_outputBatchFrames) {
+            frame.buf = &m_outputBatchBuf[offset];
+            offset += frame.bufLen;
+        }
+
+        COMMS_ASSERT(m_sendOutputBatchFn != nullptr);
+        m_sendOutputBatchFn(
+            m_sendOutputBatchData,
+            &m_outputBatchFrames[0],
+            static_cast<unsigned>(m_outputBatchFrames.size()));
+        m_outputBatchFrames.clear();
+        m_outputBatchBuf.clear();
     }
 
     template <typename TOp>
-    void finaliseOp()
+    void finaliseOp(MqttsnAsyncOpStatus status)
     {
+        trace(MqttsnTraceEvent_OpComplete, statsOpFor(m_currOp), status);
         auto* op = opPtr<TOp>();
         op->~TOp();
         m_currOp = Op::None;
@@ -2284,11 +3308,11 @@ private:
         return true;
     }
 
-    bool doPublishId()
+    bool doPublishId(PublishSlot& slot)
     {
-        COMMS_ASSERT (m_currOp == Op::PublishId);
+        COMMS_ASSERT (slot.m_op == Op::PublishId);
 
-        auto* op = opPtr<PublishIdOp>();
+        auto* op = publishOpPtr<PublishIdOp>(slot);
         if (m_retryCount <= op->m_attempt) {
             return false;
         }
@@ -2297,38 +3321,47 @@ private:
         ++op->m_attempt;
 
         if (firstAttempt && (MqttsnQoS_AtLeastOnceDelivery <= op->m_qos)) {
-            op->m_msgId = allocMsgId();
+            op->m_msgId = op->m_replayMsgId;
+            if (op->m_msgId == 0U) {
+                op->m_msgId = allocPublishMsgId(slot);
+                journalPublish(slot, details::JournalTopicKind::Predefined, nullptr);
+            }
         }
 
-        if ((!firstAttempt) &&
-            (op->m_ackReceived) &&
+        if ((op->m_ackReceived) &&
             (MqttsnQoS_ExactlyOnceDelivery <= op->m_qos)) {
             sendPubrel(op->m_msgId);
             return true;
         }
 
-        sendPublish(
-            op->m_topicId,
-            op->m_msgId,
-            op->m_msg,
-            op->m_msgLen,
-            TopicIdTypeVal::PredefinedTopicId,
-            details::translateQosValue(op->m_qos),
-            op->m_retain,
-            !firstAttempt);
+        bool duplicate = (!firstAttempt) || (op->m_replayMsgId != 0U);
+        if (op->m_streamed) {
+            sendStreamedPublish(op->m_msgId, duplicate);
+        }
+        else {
+            sendPublish(
+                op->m_topicId,
+                op->m_msgId,
+                op->m_msg,
+                op->m_msgLen,
+                TopicIdTypeVal::PredefinedTopicId,
+                details::translateQosValue(op->m_qos),
+                op->m_retain,
+                duplicate);
+        }
 
         if (op->m_qos <= MqttsnQoS_AtMostOnceDelivery) {
-            finalisePublishOp(MqttsnAsyncOpStatus_Successful);
+            finalisePublishOp(slot, MqttsnAsyncOpStatus_Successful);
         }
 
         return true;
     }
 
-    bool doPublish()
+    bool doPublish(PublishSlot& slot)
     {
-        COMMS_ASSERT (m_currOp == Op::Publish);
+        COMMS_ASSERT (slot.m_op == Op::Publish);
 
-        auto* op = opPtr<PublishOp>();
+        auto* op = publishOpPtr<PublishOp>(slot);
         if (m_retryCount <= op->m_attempt) {
             return false;
         }
@@ -2342,35 +3375,55 @@ private:
                 break;
             }
 
-            auto iter = std::find_if(
-                m_regInfos.begin(), m_regInfos.end(),
-                [op](typename RegInfosList::const_reference elem) -> bool
-                {
-                    return elem.m_allocated && (elem.m_topic == op->m_topic);
-                });
+            const char* topic = op->m_topic;
+            RegInfo* regInfo = nullptr;
+            if (op->m_topicHandle != MQTTSN_INVALID_TOPIC_HANDLE) {
+                regInfo = m_regInfos.findByHandle(op->m_topicHandle);
+                if (regInfo == nullptr) {
+                    // Released and evicted
+                    finalisePublishOp(slot, MqttsnAsyncOpStatus_InvalidId);
+                    return true;
+                }
 
-            if (iter != m_regInfos.end()) {
+                topic = regInfo->m_topic.c_str();
+            }
+            else {
+                regInfo = m_regInfos.findByName(topic);
+            }
+
+            if ((regInfo != nullptr) && (regInfo->m_topicId != 0U)) {
                 op->m_registered = true;
-                op->m_topicId = iter->m_topicId;
-                iter->m_timestamp = m_timestamp;
+                op->m_topicId = regInfo->m_topicId;
+                m_regInfos.touch(*regInfo);
                 break;
             }
 
             op->m_didRegistration = true;
-            op->m_msgId = allocMsgId();
-            sendRegister(op->m_msgId, op->m_topic);
+            op->m_msgId = allocPublishMsgId(slot);
+            sendRegister(op->m_msgId, topic);
             return true;
         } while (false);
 
-        op->m_msgId = 0U;
-        if (firstAttempt && (MqttsnQoS_AtLeastOnceDelivery <= op->m_qos)) {
-            op->m_msgId = allocMsgId();
+        if (firstAttempt) {
+            op->m_msgId = 0U;
+            if (MqttsnQoS_AtLeastOnceDelivery <= op->m_qos) {
+                op->m_msgId = op->m_replayMsgId;
+            }
+
+            if ((op->m_msgId == 0U) && (MqttsnQoS_AtLeastOnceDelivery <= op->m_qos)) {
+                op->m_msgId = allocPublishMsgId(slot);
+                if (op->m_shortName) {
+                    journalPublish(slot, details::JournalTopicKind::Short, nullptr);
+                }
+                else {
+                    journalPublish(slot, details::JournalTopicKind::Name, publishOpTopic(*op));
+                }
+            }
         }
 
         COMMS_ASSERT((op->m_registered) || (op->m_shortName));
 
-        if ((!firstAttempt) &&
-            (op->m_ackReceived) &&
+        if ((op->m_ackReceived) &&
             (MqttsnQoS_ExactlyOnceDelivery <= op->m_qos)) {
             sendPubrel(op->m_msgId);
             return true;
@@ -2389,10 +3442,10 @@ private:
             topicIdType,
             details::translateQosValue(op->m_qos),
             op->m_retain,
-            !firstAttempt);
+            (!firstAttempt) || (op->m_replayMsgId != 0U));
 
         if (op->m_qos <= MqttsnQoS_AtMostOnceDelivery) {
-            finalisePublishOp(MqttsnAsyncOpStatus_Successful);
+            finalisePublishOp(slot, MqttsnAsyncOpStatus_Successful);
         }
 
         return true;
@@ -2660,6 +3713,14 @@ private:
         pubMsg.field_topicId().value() = topicId;
         pubMsg.field_msgId().value() = msgId;
 
+        if ((m_sendOutputVecFn != nullptr) &&
+            (m_sendOutputBatchFn == nullptr) &&
+            (m_allocOutputBufFn == nullptr) &&
+            (0U < msgLen)) {
+            sendPublishVec(pubMsg, msg, msgLen);
+            return;
+        }
+
         auto& dataStorage = pubMsg.field_data().value();
         using DataStorage = typename std::decay<decltype(dataStorage)>::type;
         dataStorage = DataStorage(msg, msgLen);
@@ -2667,6 +3728,75 @@ private:
         sendMessage(pubMsg);
     }
 
+    void sendPublishVec(const PublishMsg& pubMsg, const std::uint8_t* msg, std::size_t msgLen)
+    {
+        // Only the header is serialised (with empty data), the length is
+        // patched to cover the message data sent as the second part
+        auto headerLen = m_stack.length(pubMsg);
+        auto frameLen = headerLen + msgLen;
+        static const std::size_t LongFormLimit = 0xffffU;
+        if (LongFormLimit < (frameLen + details::FrameLengthLongFormExtra)) {
+            COMMS_ASSERT(!"Message is too long");
+            return;
+        }
+
+        auto* buf = m_writeBuf.reserve(headerLen + details::FrameLengthLongFormExtra);
+        COMMS_ASSERT(buf != nullptr);
+        if (buf == nullptr) {
+            return;
+        }
+
+        auto writeIter = comms::writeIteratorFor<Message>(buf + details::FrameLengthLongFormExtra);
+        auto es = m_stack.write(pubMsg, writeIter, headerLen);
+        COMMS_ASSERT(es == comms::ErrorStatus::Success);
+        if (es != comms::ErrorStatus::Success) {
+            return;
+        }
+
+        auto offset = details::patchFrameLength(buf, frameLen);
+        MqttsnIoVec vec[2];
+        vec[0].buf = buf + offset;
+        vec[0].bufLen = static_cast<unsigned>(frameLen - msgLen);
+        vec[1].buf = msg;
+        vec[1].bufLen = static_cast<unsigned>(msgLen);
+
+        m_lastSentMsgTimestamp = m_timestamp;
+        m_stats.msgSent(static_cast<unsigned>(pubMsg.getId()), frameLen);
+        trace(MqttsnTraceEvent_MsgSent, MqttsnStatsOp_ValuesLimit, static_cast<unsigned>(pubMsg.getId()));
+        m_sendOutputVecFn(m_sendOutputVecData, vec, 2U, false);
+    }
+
+    void sendStreamedPublish(std::uint16_t msgId, bool duplicate)
+    {
+        PublishMsg pubMsg;
+        pubMsg.field_flags().field_topicIdType().value() = TopicIdTypeVal::PredefinedTopicId;
+        pubMsg.field_flags().field_mid().setBitValue_Retain(m_pubStream.retain());
+        pubMsg.field_flags().field_qos().value() = details::translateQosValue(m_pubStream.qos());
+        pubMsg.field_flags().field_high().setBitValue_Dup(duplicate);
+        pubMsg.field_topicId().value() = m_pubStream.topicId();
+        pubMsg.field_msgId().value() = msgId;
+
+        if ((m_sendOutputBatchFn == nullptr) && (m_allocOutputBufFn != nullptr)) {
+            // Serialised straight into the transport buffer, the stream
+            // buffer keeps the payload for the retransmissions
+            auto& dataStorage = pubMsg.field_data().value();
+            using DataStorage = typename std::decay<decltype(dataStorage)>::type;
+            dataStorage = DataStorage(m_pubStream.payload(), m_pubStream.payloadLen());
+            provideMessage(pubMsg, false);
+            return;
+        }
+
+        // Only the header is written, the payload is already in place
+        auto writeIter = comms::writeIteratorFor<Message>(m_pubStream.header());
+        auto es = m_stack.write(pubMsg, writeIter, PublishStream::HeaderLen - PublishStream::ShortFormOffset);
+        COMMS_ASSERT(es == comms::ErrorStatus::Success);
+        static_cast<void>(es);
+
+        std::size_t len = 0U;
+        auto* frame = m_pubStream.frame(len);
+        sendFrame(frame, len, static_cast<unsigned>(pubMsg.getId()));
+    }
+
     void sendPuback(
         MqttsnTopicId topicId,
         std::uint16_t msgId,
@@ -2699,6 +3829,7 @@ private:
     void reportGwDisconnected()
     {
         m_connectionStatus = ConnectionStatus::Disconnected;
+        m_rtt.reset(m_retryPeriod); // next connection may be to other gateway
 
         if (m_gwDisconnectReportFn != nullptr) {
             m_gwDisconnectReportFn(m_gwDisconnectReportData);
@@ -2711,6 +3842,21 @@ private:
         return m_msgId;
     }
 
+    std::size_t publishSlotIdx(const PublishSlot& slot) const
+    {
+        return static_cast<std::size_t>(&slot - &m_publishSlots[0]);
+    }
+
+    std::uint16_t allocPublishMsgId(const PublishSlot& slot)
+    {
+        // The slot is located by "msgId % InflightPublishesLimit"
+        auto idx = publishSlotIdx(slot);
+        do {
+            ++m_msgId;
+        } while ((m_msgId % InflightPublishesLimit) != idx);
+        return m_msgId;
+    }
+
     template <typename TOp, Op TCurr>
     void finaliseAsyncOp(MqttsnAsyncOpStatus status)
     {
@@ -2721,7 +3867,7 @@ private:
         auto* cb = op->m_cb;
         auto* cbData = op->m_cbData;
 
-        finaliseOp<TOp>();
+        finaliseOp<TOp>(status);
         COMMS_ASSERT(m_currOp == Op::None);
         COMMS_ASSERT(cb != nullptr);
         cb(cbData, status);
@@ -2739,10 +3885,10 @@ private:
         auto* cbData = op->m_cbData;
 
         if (m_currOp == TCurr1) {
-            finaliseOp<TOp1>();
+            finaliseOp<TOp1>(status);
         }
         else {
-            finaliseOp<TOp2>();
+            finaliseOp<TOp2>(status);
         }
 
         COMMS_ASSERT(m_currOp == Op::None);
@@ -2760,9 +3906,47 @@ private:
         finaliseAsyncOp<DisconnectOp, Op::Disconnect>(status);
     }
 
-    void finalisePublishOp(MqttsnAsyncOpStatus status)
+    void finalisePublishOp(PublishSlot& slot, MqttsnAsyncOpStatus status)
+    {
+        COMMS_ASSERT((slot.m_op == Op::Publish) || (slot.m_op == Op::PublishId));
+        COMMS_ASSERT(0U < m_inflightPublishes);
+
+        auto* op = publishOpPtr<PublishOpBase>(slot);
+        auto* cb = op->m_cb;
+        auto* cbData = op->m_cbData;
+        bool streamed = op->m_streamed;
+
+        // The application is notified, must not be resent after restart
+        m_journal.markDone(publishSlotIdx(slot));
+        if (status == MqttsnAsyncOpStatus_Successful) {
+            m_congestion.acknowledged();
+        }
+
+        if (slot.m_op == Op::Publish) {
+            publishOpPtr<PublishOp>(slot)->~PublishOp();
+        }
+        else {
+            publishOpPtr<PublishIdOp>(slot)->~PublishIdOp();
+        }
+
+        trace(MqttsnTraceEvent_OpComplete, MqttsnStatsOp_Publish, status, publishTraceKey(slot));
+        slot.m_op = Op::None;
+        --m_inflightPublishes;
+        releaseQueuedPublish(slot);
+        if (streamed) {
+            m_pubStream.reset();
+        }
+        COMMS_ASSERT(cb != nullptr);
+        cb(cbData, status);
+    }
+
+    void abortInflightPublishes(MqttsnAsyncOpStatus status)
     {
-        finaliseAsyncDoubleOp<PublishOp, Op::Publish, PublishIdOp, Op::PublishId>(status);
+        for (auto& slot : m_publishSlots) {
+            if (slot.m_op != Op::None) {
+                finalisePublishOp(slot, status);
+            }
+        }
     }
 
     void finaliseSubscribeOp(MqttsnAsyncOpStatus status)
@@ -2773,10 +3957,10 @@ private:
         auto* cbData = op->m_cbData;
 
         if (m_currOp == Op::Subscribe) {
-            finaliseOp<SubscribeOp>();
+            finaliseOp<SubscribeOp>(status);
         }
         else {
-            finaliseOp<SubscribeIdOp>();
+            finaliseOp<SubscribeIdOp>(status);
         }
         COMMS_ASSERT(m_currOp == Op::None);
         COMMS_ASSERT(cb != nullptr);
@@ -2814,8 +3998,8 @@ private:
         {
             &BasicClient::finaliseConnectOp,
             &BasicClient::finaliseDisconnectOp,
-            &BasicClient::finalisePublishOp,
-            &BasicClient::finalisePublishOp,
+            nullptr, // publish ops are tracked in m_publishSlots
+            nullptr,
             &BasicClient::finaliseSubscribeOp,
             &BasicClient::finaliseSubscribeOp,
             &BasicClient::finaliseUnsubscribeOp,
@@ -2858,11 +4042,257 @@ private:
         return status;
     }
 
+    bool mustQueuePublish(MqttsnQoS qos)
+    {
+        return
+            OutboundQueue::Enabled &&
+            m_running &&
+            (qos != MqttsnQoS_NoGwPublish) &&
+            ((!m_outQueue.empty()) ||
+             (m_connectionStatus != ConnectionStatus::Connected) ||
+             (m_currOp != Op::None) ||
+             congestionThrottled() ||
+             (findFreePublishSlot() == nullptr));
+    }
+
+    MqttsnErrorCode queuePublish(
+        details::OutboundTopicKind kind,
+        std::uint32_t topicRef,
+        const char* topic,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        MqttsnAsyncOpCompleteReportFn callback,
+        void* data)
+    {
+        if ((qos < MqttsnQoS_AtMostOnceDelivery) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos) ||
+            ((msg == nullptr) && (0U < msgLen))) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        std::size_t topicLen = 0U;
+        if (topic != nullptr) {
+            topicLen = std::strlen(topic);
+        }
+
+        if (!m_outQueue.fits(topicLen, msgLen)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto guard = apiCall();
+        details::OutboundMsgInfo info;
+        info.m_cb = callback;
+        info.m_cbData = data;
+        info.m_topicRef = topicRef;
+        info.m_qos = qos;
+        info.m_retain = retain;
+        info.m_kind = kind;
+
+        while (!m_outQueue.push(info, topic, topicLen, msg, msgLen)) {
+            ++m_outQueueDropped;
+            if ((m_outQueuePolicy == MqttsnOutboundQueuePolicy_DropNewest) || m_outQueue.empty()) {
+                reportOutboundQueue();
+                return MqttsnErrorCode_Busy;
+            }
+
+            auto dropped = m_outQueue.dropFront();
+            reportOutboundQueue();
+            if (dropped.m_cb != nullptr) {
+                dropped.m_cb(dropped.m_cbData, MqttsnAsyncOpStatus_Aborted);
+            }
+        }
+
+        if (m_outQueue.size() == m_outQueueHighWaterMark) {
+            reportOutboundQueue();
+        }
+
+        return MqttsnErrorCode_Success;
+    }
+
+    void reportOutboundQueue()
+    {
+        if (m_outQueueReportFn != nullptr) {
+            m_outQueueReportFn(
+                m_outQueueReportData,
+                static_cast<unsigned>(m_outQueue.size()),
+                static_cast<unsigned>(m_outQueueDropped));
+        }
+    }
+
+    void drainOutboundQueue()
+    {
+        if ((!OutboundQueue::Enabled) || m_outQueueDraining) {
+            return;
+        }
+
+        m_outQueueDraining = true;
+        while ((!m_outQueue.empty()) &&
+               m_running &&
+               (m_connectionStatus == ConnectionStatus::Connected) &&
+               (m_currOp == Op::None) &&
+               (!congestionThrottled())) {
+            auto* slot = findFreePublishSlot();
+            if (slot == nullptr) {
+                break;
+            }
+
+            // The publish will be assigned the same free slot and refers
+            // to the topic and data of the entry until it is complete
+            auto ref = m_outQueue.take();
+            auto info = m_outQueue.info(ref);
+            auto* msg = m_outQueue.data(ref);
+            auto msgLen = m_outQueue.dataLen(ref);
+            slot->m_queued = true;
+            slot->m_queuedRef = ref;
+            auto es = MqttsnErrorCode_Success;
+            if (info.m_kind == details::OutboundTopicKind::Name) {
+                es = publishNow(m_outQueue.topic(ref), msg, msgLen, info.m_qos, info.m_retain, info.m_cb, info.m_cbData);
+            }
+            else if (info.m_kind == details::OutboundTopicKind::Id) {
+                es = publishNow(static_cast<MqttsnTopicId>(info.m_topicRef), msg, msgLen, info.m_qos, info.m_retain, info.m_cb, info.m_cbData);
+            }
+            else {
+                es = publishHandleNow(info.m_topicRef, msg, msgLen, info.m_qos, info.m_retain, info.m_cb, info.m_cbData);
+            }
+
+            if ((slot->m_op == Op::None) && slot->m_queued) {
+                // Not using the slot, the entry is not needed any more
+                releaseQueuedPublish(*slot);
+            }
+
+            if ((es != MqttsnErrorCode_Success) && (info.m_cb != nullptr)) {
+                // Only stale topic handle is expected here
+                info.m_cb(info.m_cbData, MqttsnAsyncOpStatus_InvalidId);
+            }
+        }
+        m_outQueueDraining = false;
+    }
+
+    void releaseQueuedPublish(PublishSlot& slot)
+    {
+        if (!slot.m_queued) {
+            return;
+        }
+
+        slot.m_queued = false;
+        m_outQueue.release(slot.m_queuedRef);
+    }
+
+    const char* publishOpTopic(const PublishOp& op)
+    {
+        if (op.m_topicHandle == MQTTSN_INVALID_TOPIC_HANDLE) {
+            return op.m_topic;
+        }
+
+        auto* regInfo = m_regInfos.findByHandle(op.m_topicHandle);
+        if (regInfo == nullptr) {
+            return nullptr;
+        }
+
+        return regInfo->m_topic.c_str();
+    }
+
+    void journalPublish(PublishSlot& slot, details::JournalTopicKind kind, const char* topic)
+    {
+        if (!m_journal.active()) {
+            return;
+        }
+
+        auto* op = publishOpPtr<PublishOpBase>(slot);
+        details::JournalRecord rec;
+        rec.m_msgId = op->m_msgId;
+        rec.m_topicId = op->m_topicId;
+        rec.m_qos = op->m_qos;
+        rec.m_retain = op->m_retain;
+        rec.m_kind = kind;
+
+        std::size_t topicLen = 0U;
+        if (topic != nullptr) {
+            topicLen = std::strlen(topic);
+        }
+
+        m_journal.append(publishSlotIdx(slot), rec, topic, topicLen, op->m_msg, op->m_msgLen);
+    }
+
+    static void journalReplayComplete(void* data, MqttsnAsyncOpStatus status)
+    {
+        auto* client = reinterpret_cast<BasicClient<TClientOpts>*>(data);
+        if (client->m_journalReplayReportFn != nullptr) {
+            client->m_journalReplayReportFn(client->m_journalReplayReportData, status);
+        }
+    }
+
+    void replayJournal()
+    {
+        if (!OutboundJournal::Enabled) {
+            return;
+        }
+
+        while (m_running &&
+               (m_connectionStatus == ConnectionStatus::Connected) &&
+               (m_currOp == Op::None) &&
+               (!congestionThrottled())) {
+            auto idx = m_journal.nextReplaySlot();
+            if (InflightPublishesLimit <= idx) {
+                break;
+            }
+
+            // Resent in the original order, wait for the slot to be released
+            auto& slot = m_publishSlots[idx];
+            if (slot.m_op != Op::None) {
+                break;
+            }
+
+            auto rec = m_journal.loadReplay(idx);
+            PublishOpBase* op = nullptr;
+            if (rec.m_released || (rec.m_kind == details::JournalTopicKind::Predefined)) {
+                op = newPublishOp<PublishIdOp>(slot, Op::PublishId);
+            }
+            else {
+                auto* pubOp = newPublishOp<PublishOp>(slot, Op::Publish);
+                pubOp->m_shortName = (rec.m_kind == details::JournalTopicKind::Short);
+                if (!pubOp->m_shortName) {
+                    pubOp->m_topic = m_journal.replayTopic(idx);
+                }
+                op = pubOp;
+            }
+
+            op->m_cb = &BasicClient<TClientOpts>::journalReplayComplete;
+            op->m_cbData = this;
+            op->m_topicId = rec.m_topicId;
+            op->m_msg = m_journal.replayData(idx);
+            op->m_msgLen = m_journal.replayDataLen(idx);
+            op->m_qos = rec.m_qos;
+            op->m_retain = rec.m_retain;
+            op->m_ackReceived = rec.m_released;
+            op->m_replayMsgId = rec.m_msgId;
+
+            bool result = false;
+            if (slot.m_op == Op::PublishId) {
+                result = doPublishId(slot);
+            }
+            else {
+                result = doPublish(slot);
+            }
+            static_cast<void>(result);
+            COMMS_ASSERT(result);
+        }
+    }
+
     void apiCallExit()
     {
         COMMS_ASSERT(0U < m_callStackCount);
+        if (m_callStackCount == 1U) {
+            replayJournal();
+            drainOutboundQueue();
+        }
+
         --m_callStackCount;
         if (m_callStackCount == 0U) {
+            m_journal.commit();
+            flushOutputBatch();
             programNextTimeout();
         }
     }
@@ -2942,6 +4372,10 @@ private:
     unsigned m_callStackCount = 0U;
     unsigned m_pingCount = 0;
     unsigned m_retryPeriod = DefaultRetryPeriod;
+    details::RetransmitTimer m_rtt;
+    bool m_rttExpired = false;
+    details::CongestionControl m_congestion;
+    Timestamp m_congestionHoldUntil = 0;
     unsigned m_retryCount = DefaultRetryCount;
     unsigned m_keepAlivePeriod = 0;
     ConnectionStatus m_connectionStatus = ConnectionStatus::Disconnected;
@@ -2955,9 +4389,28 @@ private:
     Op m_currOp = Op::None;
     OpStorageType m_opStorage;
 
+    PublishSlotsList m_publishSlots;
+    std::size_t m_inflightPublishes = 0U;
+
     RegInfosList m_regInfos;
 
-    LastInMsgInfo m_lastInMsg;
+    OutboundQueue m_outQueue;
+    MqttsnOutboundQueuePolicy m_outQueuePolicy = MqttsnOutboundQueuePolicy_DropOldest;
+    std::size_t m_outQueueHighWaterMark = 0U;
+    std::size_t m_outQueueDropped = 0U;
+    MqttsnOutboundQueueReportFn m_outQueueReportFn = nullptr;
+    void* m_outQueueReportData = nullptr;
+    bool m_outQueueDraining = false;
+
+    OutboundJournal m_journal;
+    ClientStats m_stats;
+    TraceRing m_trace;
+    PublishStream m_pubStream;
+    MqttsnAsyncOpCompleteReportFn m_journalReplayReportFn = nullptr;
+    void* m_journalReplayReportData = nullptr;
+
+    InQos2MsgsList m_inQos2Msgs;
+    InQos2MsgsIndex m_inQos2Index;
 
     MqttsnNextTickProgramFn m_nextTickProgramFn = nullptr;
     void* m_nextTickProgramData = nullptr;
@@ -2968,6 +4421,16 @@ private:
     MqttsnSendOutputDataFn m_sendOutputDataFn = nullptr;
     void* m_sendOutputDataData = nullptr;
 
+    MqttsnSendOutputBatchFn m_sendOutputBatchFn = nullptr;
+    void* m_sendOutputBatchData = nullptr;
+
+    MqttsnSendOutputVecFn m_sendOutputVecFn = nullptr;
+    void* m_sendOutputVecData = nullptr;
+
+    MqttsnAllocOutputBufFn m_allocOutputBufFn = nullptr;
+    MqttsnCommitOutputBufFn m_commitOutputBufFn = nullptr;
+    void* m_outputBufProviderData = nullptr;
+
     MqttsnGwStatusReportFn m_gwStatusReportFn = nullptr;
     void* m_gwStatusReportData = nullptr;
 
@@ -2977,9 +4440,17 @@ private:
     MqttsnMessageReportFn m_msgReportFn = nullptr;
     void* m_msgReportData = nullptr;
 
-    WriteBufStorage m_writeBuf;
+    MqttsnBufferReleaseFn m_bufReleaseFn = nullptr;
+    void* m_bufReleaseData = nullptr;
+    const std::uint8_t* m_currLoanBuf = nullptr;
+
+    WriteBuf m_writeBuf;
+    OutputBatchBufStorage m_outputBatchBuf;
+    OutputBatchFramesStorage m_outputBatchFrames;
 
     static const unsigned DefaultAdvertisePeriod = 30 * 60 * 1000;
+    static const MqttsnTopicHandle DirectTopicHandleFlag = 0x80000000U;
+    static const MqttsnTopicHandle ShortTopicHandleFlag = 0x40000000U;
     static const unsigned DefaultRetryPeriod = 15 * 1000;
     static const unsigned DefaultRetryCount = 3;
     static const std::uint8_t DefaultBroadcastRadius = 0U;
@@ -0,0 +1,1818 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <cstring>
+
+#include "comms/comms.h"
+#include "comms/util/ScopeGuard.h"
+#include "mqttsn/gateway/common.h"
+#include "mqttsn/Message.h"
+#include "mqttsn/frame/Frame.h"
+#include "mqttsn/input/ServerInputMessages.h"
+#include "mqttsn/options/ServerDefaultOptions.h"
+#include "details/RegInfoRegistry.h"
+#include "details/TimingWheel.h"
+#include "gateway/details/SessionPool.h"
+
+namespace mqttsn
+{
+
+namespace gateway
+{
+
+namespace details
+{
+
+template <typename TOpts, bool THasStaticSize>
+struct TopicNameStorageOpt;
+
+template <typename TOpts>
+struct TopicNameStorageOpt<TOpts, true>
+{
+    typedef comms::option::FixedSizeStorage<TOpts::TopicNameStaticStorageSize> Type;
+};
+
+template <typename TOpts>
+struct TopicNameStorageOpt<TOpts, false>
+{
+    typedef comms::option::EmptyOption Type;
+};
+
+template <typename TOpts>
+using TopicNameStorageOptT =
+    typename TopicNameStorageOpt<TOpts, TOpts::HasTopicNameStaticStorageSize>::Type;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasStaticSize>
+struct DataStorageOpt;
+
+template <typename TOpts>
+struct DataStorageOpt<TOpts, true>
+{
+    typedef comms::option::FixedSizeStorage<TOpts::MessageDataStaticStorageSize> Type;
+};
+
+template <typename TOpts>
+struct DataStorageOpt<TOpts, false>
+{
+    typedef comms::option::EmptyOption Type;
+};
+
+template <typename TOpts>
+using DataStorageOptT =
+    typename DataStorageOpt<TOpts, TOpts::HasMessageDataStaticStorageSize>::Type;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasStaticSize>
+struct ClientIdStorageOpt;
+
+template <typename TOpts>
+struct ClientIdStorageOpt<TOpts, true>
+{
+    typedef comms::option::FixedSizeStorage<TOpts::ClientIdStaticStorageSize> Type;
+};
+
+template <typename TOpts>
+struct ClientIdStorageOpt<TOpts, false>
+{
+    typedef comms::option::EmptyOption Type;
+};
+
+template <typename TOpts>
+using ClientIdStorageOptT =
+    typename ClientIdStorageOpt<TOpts, TOpts::HasClientIdStaticStorageSize>::Type;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool TAllStatic>
+class WriteBufStorageType;
+
+template <typename TOpts>
+class WriteBufStorageType<TOpts, true>
+{
+    static const std::size_t Size1 =
+        (TOpts::ClientIdStaticStorageSize > TOpts::TopicNameStaticStorageSize) ?
+            TOpts::ClientIdStaticStorageSize : TOpts::TopicNameStaticStorageSize;
+
+    static const std::size_t Size2 =
+        (Size1 > TOpts::MessageDataStaticStorageSize) ?
+            Size1 : TOpts::MessageDataStaticStorageSize;
+
+    static const std::size_t MaxOverhead = 10U;
+
+public:
+    static const std::size_t Capacity = Size2 + MaxOverhead;
+    typedef comms::util::StaticVector<std::uint8_t, Capacity> Type;
+};
+
+template <typename TOpts>
+class WriteBufStorageType<TOpts, false>
+{
+public:
+    typedef std::vector<std::uint8_t> Type;
+};
+
+template <typename TOpts>
+using WriteBufStorageTypeT =
+    typename WriteBufStorageType<
+        TOpts,
+        TOpts::HasClientIdStaticStorageSize &&
+        TOpts::HasTopicNameStaticStorageSize &&
+        TOpts::HasMessageDataStaticStorageSize
+    >::Type;
+
+//-----------------------------------------------------------
+
+template <typename TTopicId, typename TOpts, bool THasSessionTopicsLimit>
+struct SessionTopicIdsStorageType;
+
+template <typename TTopicId, typename TOpts>
+struct SessionTopicIdsStorageType<TTopicId, TOpts, true>
+{
+    typedef comms::util::StaticVector<TTopicId, TOpts::SessionTopicsLimit> Type;
+};
+
+template <typename TTopicId, typename TOpts>
+struct SessionTopicIdsStorageType<TTopicId, TOpts, false>
+{
+    typedef std::vector<TTopicId> Type;
+};
+
+template <typename TTopicId, typename TOpts>
+using SessionTopicIdsStorageTypeT =
+    typename SessionTopicIdsStorageType<TTopicId, TOpts, TOpts::HasSessionTopicsLimit>::Type;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasMaxPendingInboundQos2>
+struct PendingInboundQos2Limit;
+
+template <typename TOpts>
+struct PendingInboundQos2Limit<TOpts, true>
+{
+    static_assert(0U < TOpts::MaxPendingInboundQos2, "At least one pending message must be allowed");
+    static const std::size_t Value = TOpts::MaxPendingInboundQos2;
+};
+
+template <typename TOpts>
+struct PendingInboundQos2Limit<TOpts, false>
+{
+    static const std::size_t Value = 1U;
+};
+
+template <typename TOpts>
+using PendingInboundQos2LimitT =
+    PendingInboundQos2Limit<TOpts, TOpts::HasMaxPendingInboundQos2>;
+
+//-----------------------------------------------------------
+
+template <typename TOpts, bool THasTopicsLimit>
+struct TopicsRegistryOptions;
+
+template <typename TOpts>
+struct TopicsRegistryOptions<TOpts, true>
+{
+    static_assert(TOpts::TopicsLimit < 0xfffe, "Too many topics");
+    static const bool HasRegisteredTopicsLimit = true;
+    static const std::size_t RegisteredTopicsLimit = TOpts::TopicsLimit;
+};
+
+template <typename TOpts>
+struct TopicsRegistryOptions<TOpts, false>
+{
+    static const bool HasRegisteredTopicsLimit = false;
+};
+
+template <typename TOpts>
+using TopicsRegistryOptionsT =
+    TopicsRegistryOptions<TOpts, TOpts::HasTopicsLimit>;
+
+//-----------------------------------------------------------
+
+inline mqttsn::field::QosVal translateQosValue(MqttsnQoS val)
+{
+    if (val == MqttsnQoS_NoGwPublish) {
+        return mqttsn::field::QosVal::NoGwPublish;
+    }
+
+    return static_cast<mqttsn::field::QosVal>(val);
+}
+
+inline MqttsnQoS translateQosValue(mqttsn::field::QosVal val)
+{
+    if (val == mqttsn::field::QosVal::NoGwPublish) {
+        return MqttsnQoS_NoGwPublish;
+    }
+
+    return static_cast<MqttsnQoS>(val);
+}
+
+}  // namespace details
+
+/// @brief MQTT-SN gateway protocol engine.
+/// @details Manages sessions of many clients communicating over the
+///     datagram transport driven by the application. The transport address
+///     of every client is identified by the application defined
+///     @ref MqttsnGwPeerId. The messages published by the clients as well
+///     as the subscription requests are forwarded to the broker side
+///     via the report callbacks, while the messages from the broker are
+///     delivered to the clients using publish(). The time measurement
+///     contract is the same as of the client: the requested timeouts
+///     are reported via "next tick program" callback and tick() is
+///     expected to be invoked on expiry. The timeouts of all the sessions
+///     are kept in a single timing wheel.
+/// @tparam TGwOpts Options parsed with @ref mqttsn::gateway::ParsedOptions.
+template <typename TGwOpts>
+class BasicGateway
+{
+    typedef details::WriteBufStorageTypeT<TGwOpts> WriteBufStorage;
+
+    typedef mqttsn::Message<
+        comms::option::IdInfoInterface,
+        comms::option::ReadIterator<const std::uint8_t*>,
+        comms::option::WriteIterator<std::uint8_t*>,
+        comms::option::Handler<BasicGateway<TGwOpts> >,
+        comms::option::LengthInfoInterface
+    > Message;
+
+    typedef unsigned long long Timestamp;
+
+    using TopicIdTypeVal = mqttsn::field::FlagsMembersCommon::TopicIdTypeVal;
+    using ReturnCodeVal = mqttsn::field::ReturnCodeVal;
+
+    class ProtOpts : public mqttsn::options::ServerDefaultOptions
+    {
+        using Base = mqttsn::options::ServerDefaultOptions;
+
+    public:
+
+        struct field : public Base::field
+        {
+            using ClientId = comms::option::app::OrigDataView;
+            using Data = comms::option::app::OrigDataView;
+            using GwAdd = comms::option::app::OrigDataView;
+            using TopicName = comms::option::app::OrigDataView;
+            using WillMsg = comms::option::app::OrigDataView;
+            using WillTopic = comms::option::app::OrigDataView;
+        };
+
+        struct frame : public Base::frame
+        {
+            struct FrameLayers : public Base::frame::FrameLayers
+            {
+                using Id = comms::option::app::InPlaceAllocation;
+            }; // struct FrameLayers
+
+        }; // struct frame
+    };
+
+    class StorageOptions : public mqttsn::options::ServerDefaultOptions
+    {
+        using Base = mqttsn::options::ServerDefaultOptions;
+    public:
+        struct field : public Base::field
+        {
+            using ClientId = details::ClientIdStorageOptT<TGwOpts>;
+            using Data = details::DataStorageOptT<TGwOpts>;
+            using TopicName = details::TopicNameStorageOptT<TGwOpts>;
+        };
+    };
+
+public:
+    typedef typename mqttsn::field::GwId<ProtOpts>::ValueType GwIdValueType;
+    typedef typename mqttsn::field::TopicName<StorageOptions>::ValueType TopicNameType;
+    typedef typename mqttsn::field::Data<StorageOptions>::ValueType DataType;
+    typedef typename mqttsn::field::TopicId<StorageOptions>::ValueType TopicIdType;
+    typedef typename mqttsn::field::ClientId<StorageOptions>::ValueType ClientIdType;
+
+    typedef mqttsn::message::Advertise<Message, ProtOpts> AdvertiseMsg;
+    typedef mqttsn::message::Searchgw<Message, ProtOpts> SearchgwMsg;
+    typedef mqttsn::message::Gwinfo<Message, ProtOpts> GwinfoMsg;
+    typedef mqttsn::message::Connect<Message, ProtOpts> ConnectMsg;
+    typedef mqttsn::message::Connack<Message, ProtOpts> ConnackMsg;
+    typedef mqttsn::message::Willtopicreq<Message, ProtOpts> WilltopicreqMsg;
+    typedef mqttsn::message::Willtopic<Message, ProtOpts> WilltopicMsg;
+    typedef mqttsn::message::Willmsgreq<Message, ProtOpts> WillmsgreqMsg;
+    typedef mqttsn::message::Willmsg<Message, ProtOpts> WillmsgMsg;
+    typedef mqttsn::message::Register<Message, ProtOpts> RegisterMsg;
+    typedef mqttsn::message::Regack<Message, ProtOpts> RegackMsg;
+    typedef mqttsn::message::Publish<Message, ProtOpts> PublishMsg;
+    typedef mqttsn::message::Puback<Message, ProtOpts> PubackMsg;
+    typedef mqttsn::message::Pubrec<Message, ProtOpts> PubrecMsg;
+    typedef mqttsn::message::Pubrel<Message, ProtOpts> PubrelMsg;
+    typedef mqttsn::message::Pubcomp<Message, ProtOpts> PubcompMsg;
+    typedef mqttsn::message::Subscribe<Message, ProtOpts> SubscribeMsg;
+    typedef mqttsn::message::Suback<Message, ProtOpts> SubackMsg;
+    typedef mqttsn::message::Unsubscribe<Message, ProtOpts> UnsubscribeMsg;
+    typedef mqttsn::message::Unsuback<Message, ProtOpts> UnsubackMsg;
+    typedef mqttsn::message::Pingreq<Message, ProtOpts> PingreqMsg;
+    typedef mqttsn::message::Pingresp<Message, ProtOpts> PingrespMsg;
+    typedef mqttsn::message::Disconnect<Message, ProtOpts> DisconnectMsg;
+    typedef mqttsn::message::Willtopicupd<Message, ProtOpts> WilltopicupdMsg;
+    typedef mqttsn::message::Willtopicresp<Message, ProtOpts> WilltopicrespMsg;
+    typedef mqttsn::message::Willmsgupd<Message, ProtOpts> WillmsgupdMsg;
+    typedef mqttsn::message::Willmsgresp<Message, ProtOpts> WillmsgrespMsg;
+
+    BasicGateway() = default;
+    ~BasicGateway() noexcept = default;
+
+    typedef typename Message::ReadIterator ReadIterator;
+
+    void setGwId(GwIdValueType val)
+    {
+        m_gwId = val;
+    }
+
+    /// @brief Set period (in seconds) of ADVERTISE broadcasts, 0 to disable.
+    void setAdvertisePeriod(std::uint16_t val)
+    {
+        m_advertisePeriod = val;
+    }
+
+    void setRetryPeriod(unsigned val)
+    {
+        static const auto MaxVal =
+            std::numeric_limits<decltype(m_retryPeriod)>::max() / 1000;
+        m_retryPeriod = std::min(val, MaxVal) * 1000;
+    }
+
+    void setRetryCount(unsigned val)
+    {
+        m_retryCount = std::max(1U, val);
+    }
+
+    void setNextTickProgramCallback(MqttsnNextTickProgramFn cb, void* data)
+    {
+        if (cb != nullptr) {
+            m_nextTickProgramFn = cb;
+            m_nextTickProgramData = data;
+        }
+    }
+
+    void setCancelNextTickWaitCallback(MqttsnCancelNextTickWaitFn cb, void* data)
+    {
+        if (cb != nullptr) {
+            m_cancelNextTickWaitFn = cb;
+            m_cancelNextTickWaitData = data;
+        }
+    }
+
+    void setSendOutputDataCallback(MqttsnGwSendOutputDataFn cb, void* data)
+    {
+        if (cb != nullptr) {
+            m_sendOutputDataFn = cb;
+            m_sendOutputDataData = data;
+        }
+    }
+
+    void setConnectReportCallback(MqttsnGwConnectReportFn cb, void* data)
+    {
+        m_connectReportFn = cb;
+        m_connectReportData = data;
+    }
+
+    void setClientDisconnectReportCallback(MqttsnGwClientDisconnectReportFn cb, void* data)
+    {
+        m_disconnectReportFn = cb;
+        m_disconnectReportData = data;
+    }
+
+    void setPublishReportCallback(MqttsnGwPublishReportFn cb, void* data)
+    {
+        m_publishReportFn = cb;
+        m_publishReportData = data;
+    }
+
+    void setSubscribeReportCallback(MqttsnGwSubscribeReportFn cb, void* data)
+    {
+        m_subscribeReportFn = cb;
+        m_subscribeReportData = data;
+    }
+
+    void setUnsubscribeReportCallback(MqttsnGwUnsubscribeReportFn cb, void* data)
+    {
+        m_unsubscribeReportFn = cb;
+        m_unsubscribeReportData = data;
+    }
+
+    void setPublishCompleteReportCallback(MqttsnGwPublishCompleteReportFn cb, void* data)
+    {
+        m_publishCompleteReportFn = cb;
+        m_publishCompleteReportData = data;
+    }
+
+    std::size_t sessionsCount() const
+    {
+        return m_sessions.size();
+    }
+
+    MqttsnErrorCode start()
+    {
+        if (m_running) {
+            return MqttsnErrorCode_AlreadyStarted;
+        }
+
+        if ((m_nextTickProgramFn == nullptr) ||
+            (m_cancelNextTickWaitFn == nullptr) ||
+            (m_sendOutputDataFn == nullptr)) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        m_running = true;
+
+        m_sessions.forEach(
+            [this](Session& session)
+            {
+                m_wheel.cancel(session.m_timer);
+            });
+        m_sessions.clear();
+        m_topics.clear();
+        m_lastAdvertiseTimestamp = 0;
+        m_tickDelay = 0U;
+
+        auto guard = apiCall();
+        checkAdvertise();
+        return MqttsnErrorCode_Success;
+    }
+
+    MqttsnErrorCode stop()
+    {
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        auto guard = apiCall();
+        m_running = false;
+        return MqttsnErrorCode_Success;
+    }
+
+    void tick()
+    {
+        if (!m_running) {
+            return;
+        }
+
+        COMMS_ASSERT(m_callStackCount == 0U);
+        m_timestamp += m_tickDelay;
+        m_tickDelay = 0U;
+
+        auto guard = apiCall();
+        checkTimeouts();
+    }
+
+    /// @brief Process data received from the client.
+    /// @return Number of consumed bytes.
+    std::size_t processData(MqttsnGwPeerId peer, ReadIterator& iter, std::size_t len)
+    {
+        if (!m_running) {
+            return 0U;
+        }
+
+        auto guard = apiCall();
+        std::size_t consumed = 0;
+        while (true) {
+            auto iterTmp = iter;
+            MsgPtr msg;
+            auto es = m_stack.read(msg, iterTmp, len - consumed);
+            if (es == comms::ErrorStatus::NotEnoughData) {
+                break;
+            }
+
+            if (es == comms::ErrorStatus::ProtocolError) {
+                ++iter;
+                continue;
+            }
+
+            if (es == comms::ErrorStatus::Success) {
+                COMMS_ASSERT(msg);
+                m_currPeer = peer;
+                m_currSession = m_sessions.find(peer);
+                if (m_currSession != nullptr) {
+                    m_currSession->m_lastRecvTimestamp = m_timestamp;
+                }
+
+                msg->dispatch(*this);
+                m_currSession = nullptr;
+            }
+
+            consumed += static_cast<std::size_t>(std::distance(iter, iterTmp));
+            iter = iterTmp;
+        }
+
+        return consumed;
+    }
+
+    /// @brief Publish message to the connected client.
+    /// @details The topic ID is allocated by the gateway and registered with
+    ///     the client (if needed) prior to sending the message. Only single
+    ///     publish per client can be in progress, its completion is reported
+    ///     via publish complete report callback. The topic and message buffers
+    ///     must be preserved until then.
+    MqttsnErrorCode publish(
+        MqttsnGwPeerId peer,
+        const char* topic,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        if ((topic == nullptr) || (topic[0] == '\0')) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        TopicIdTypeVal topicIdType = TopicIdTypeVal::Normal;
+        TopicIdType topicId = 0U;
+        if (isShortTopicName(topic)) {
+            topicIdType = TopicIdTypeVal::ShortTopicName;
+            topicId = shortTopicToTopicId(topic);
+        }
+
+        return publishInternal(peer, topic, topicIdType, topicId, msg, msgLen, qos, retain);
+    }
+
+    /// @brief Publish message to the connected client using predefined topic ID.
+    MqttsnErrorCode publish(
+        MqttsnGwPeerId peer,
+        MqttsnTopicId topicId,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        return publishInternal(peer, nullptr, TopicIdTypeVal::PredefinedTopicId, topicId, msg, msgLen, qos, retain);
+    }
+
+    /// @brief Terminate the client's session.
+    /// @details Sends DISCONNECT to the client, the publish in progress
+    ///     (if any) is reported as aborted. The disconnect report callback
+    ///     is not invoked.
+    MqttsnErrorCode disconnect(MqttsnGwPeerId peer)
+    {
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        auto* session = m_sessions.find(peer);
+        if ((session == nullptr) || (session->m_state == SessionState::Dropping)) {
+            return MqttsnErrorCode_NotConnected;
+        }
+
+        auto guard = apiCall();
+        sendDisconnect(peer);
+        releaseSession(*session, false, false);
+        return MqttsnErrorCode_Success;
+    }
+
+    void handle(SearchgwMsg& msg)
+    {
+        static_cast<void>(msg);
+        GwinfoMsg outMsg;
+        outMsg.field_gwId().value() = m_gwId;
+        sendMessage(m_currPeer, outMsg, true);
+    }
+
+    void handle(ConnectMsg& msg)
+    {
+        auto peer = m_currPeer;
+        auto* session = m_currSession;
+        bool abortPublish = false;
+        if (session != nullptr) {
+            if (session->m_state == SessionState::Dropping) {
+                return;
+            }
+
+            abortPublish = (session->m_outPub.m_state != OutPublishState::None);
+            session->m_outPub = OutPublish();
+            if (msg.field_flags().field_mid().getBitValue_CleanSession()) {
+                forgetAllTopicIds(*session);
+            }
+        }
+        else {
+            session = m_sessions.alloc(peer);
+            if (session == nullptr) {
+                sendConnack(peer, ReturnCodeVal::Congestion);
+                return;
+            }
+
+            m_currSession = session;
+        }
+
+        auto& clientId = msg.field_clientId().value();
+        session->m_clientId.assign(clientId.data(), clientId.size());
+        session->m_lastRecvTimestamp = m_timestamp;
+        session->m_keepAlivePeriod = msg.field_duration().value() * 1000U;
+        session->m_cleanSession = msg.field_flags().field_mid().getBitValue_CleanSession();
+        session->m_hasWill = msg.field_flags().field_mid().getBitValue_Will();
+        session->m_willTopic.clear();
+        session->m_willMsg.clear();
+        session->m_inQos2MsgIds.clear();
+
+        if (session->m_hasWill) {
+            session->m_state = SessionState::AwaitingWillTopic;
+            rescheduleSession(*session);
+            WilltopicreqMsg outMsg;
+            sendMessage(peer, outMsg);
+        }
+
+        if (abortPublish) {
+            reportPublishComplete(peer, MqttsnAsyncOpStatus_Aborted);
+            session = m_sessions.find(peer);
+        }
+
+        if ((session != nullptr) && (!session->m_hasWill)) {
+            completeConnect(*session);
+        }
+    }
+
+    void handle(WilltopicMsg& msg)
+    {
+        auto* session = m_currSession;
+        if ((session == nullptr) || (session->m_state != SessionState::AwaitingWillTopic)) {
+            return;
+        }
+
+        auto& topic = msg.field_willTopic().value();
+        if (topic.empty()) {
+            session->m_hasWill = false;
+            completeConnect(*session);
+            return;
+        }
+
+        session->m_willTopic.assign(topic.data(), topic.size());
+        session->m_willQos = details::translateQosValue(msg.field_flags().field().field_qos().value());
+        session->m_willRetain = msg.field_flags().field().field_mid().getBitValue_Retain();
+        session->m_state = SessionState::AwaitingWillMsg;
+        WillmsgreqMsg outMsg;
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(WillmsgMsg& msg)
+    {
+        auto* session = m_currSession;
+        if ((session == nullptr) || (session->m_state != SessionState::AwaitingWillMsg)) {
+            return;
+        }
+
+        auto& data = msg.field_willMsg().value();
+        session->m_willMsg.assign(data.begin(), data.end());
+        completeConnect(*session);
+    }
+
+    void handle(RegisterMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& topic = msg.field_topicName().value();
+        auto topicId = allocTopicId(topic.data(), topic.size());
+        auto retCode = ReturnCodeVal::Accepted;
+        if ((topicId == 0U) || (!addKnownTopicId(*session, topicId))) {
+            topicId = 0U;
+            retCode = ReturnCodeVal::Congestion;
+        }
+
+        RegackMsg outMsg;
+        outMsg.field_topicId().value() = topicId;
+        outMsg.field_msgId().value() = msg.field_msgId().value();
+        outMsg.field_returnCode().value() = retCode;
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(RegackMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& op = session->m_outPub;
+        if ((op.m_state != OutPublishState::Registering) ||
+            (op.m_msgId != msg.field_msgId().value())) {
+            return;
+        }
+
+        auto retCode = msg.field_returnCode().value();
+        if (retCode != ReturnCodeVal::Accepted) {
+            finalisePublish(*session, retCodeToStatus(retCode));
+            return;
+        }
+
+        op.m_state = OutPublishState::Publishing;
+        op.m_attempt = 0U;
+        op.m_msgId = 0U;
+        if (MqttsnQoS_AtMostOnceDelivery < op.m_qos) {
+            op.m_msgId = allocMsgId(*session);
+        }
+
+        doPublish(*session);
+    }
+
+    void handle(PublishMsg& msg)
+    {
+        auto peer = m_currPeer;
+        auto qos = details::translateQosValue(msg.field_flags().field_qos().value());
+        auto topicIdType = msg.field_flags().field_topicIdType().value();
+        auto topicId = msg.field_topicId().value();
+        auto msgId = msg.field_msgId().value();
+
+        auto* session = m_currSession;
+        if (qos == MqttsnQoS_NoGwPublish) {
+            if (topicIdType == TopicIdTypeVal::Normal) {
+                return;
+            }
+        }
+        else {
+            session = activeSession();
+            if (session == nullptr) {
+                return;
+            }
+        }
+
+        auto msgInfo = MqttsnMessageInfo();
+        char shortTopic[3] = {0};
+        if (topicIdType == TopicIdTypeVal::Normal) {
+            auto* regInfo = m_topics.findById(topicId);
+            if (regInfo == nullptr) {
+                sendPuback(peer, topicId, msgId, ReturnCodeVal::InvalidTopicId);
+                return;
+            }
+
+            m_topics.touch(*regInfo);
+            // The registry may be updated from within the callback
+            m_topicBuf = regInfo->m_topic;
+            msgInfo.topic = m_topicBuf.c_str();
+        }
+        else if (topicIdType == TopicIdTypeVal::ShortTopicName) {
+            topicIdToShortTopic(topicId, &shortTopic[0]);
+            msgInfo.topic = &shortTopic[0];
+        }
+        else {
+            msgInfo.topicId = topicId;
+        }
+
+        if (qos == MqttsnQoS_ExactlyOnceDelivery) {
+            bool pending = hasInQos2MsgId(*session, msgId);
+            if (pending && msg.field_flags().field_high().getBitValue_Dup()) {
+                // Already forwarded, PUBREC was lost
+                sendPubrec(peer, msgId);
+                return;
+            }
+
+            if ((!pending) &&
+                (session->m_inQos2MsgIds.size() == session->m_inQos2MsgIds.max_size())) {
+                // All the entries await their PUBREL, no PUBREC, so the client
+                // sends it again later
+                return;
+            }
+        }
+
+        auto& msgData = msg.field_data().value();
+        msgInfo.msg = msgData.begin();
+        msgInfo.msgLen = static_cast<unsigned>(msgData.size());
+        msgInfo.qos = qos;
+        msgInfo.retain = msg.field_flags().field_mid().getBitValue_Retain();
+
+        bool accepted =
+            (m_publishReportFn != nullptr) &&
+            m_publishReportFn(m_publishReportData, peer, &msgInfo);
+
+        if (qos <= MqttsnQoS_AtMostOnceDelivery) {
+            return;
+        }
+
+        if ((!accepted) || (qos == MqttsnQoS_AtLeastOnceDelivery)) {
+            sendPuback(peer, topicId, msgId, accepted ? ReturnCodeVal::Accepted : ReturnCodeVal::Congestion);
+            return;
+        }
+
+        session = m_sessions.find(peer);
+        if ((session != nullptr) &&
+            (!hasInQos2MsgId(*session, msgId)) &&
+            (session->m_inQos2MsgIds.size() < session->m_inQos2MsgIds.max_size())) {
+            session->m_inQos2MsgIds.push_back(msgId);
+        }
+
+        sendPubrec(peer, msgId);
+    }
+
+    void handle(PubackMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& op = session->m_outPub;
+        if ((op.m_state != OutPublishState::Publishing) ||
+            (op.m_msgId != msg.field_msgId().value())) {
+            return;
+        }
+
+        auto retCode = msg.field_returnCode().value();
+        if ((op.m_qos == MqttsnQoS_ExactlyOnceDelivery) &&
+            (retCode == ReturnCodeVal::Accepted)) {
+            // PUBREC is expected instead
+            return;
+        }
+
+        if (retCode == ReturnCodeVal::InvalidTopicId) {
+            forgetTopicId(*session, op.m_topicId);
+        }
+
+        finalisePublish(*session, retCodeToStatus(retCode));
+    }
+
+    void handle(PubrecMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& op = session->m_outPub;
+        if ((op.m_qos != MqttsnQoS_ExactlyOnceDelivery) ||
+            (op.m_msgId != msg.field_msgId().value())) {
+            return;
+        }
+
+        if ((op.m_state != OutPublishState::Publishing) &&
+            (op.m_state != OutPublishState::Releasing)) {
+            return;
+        }
+
+        if (op.m_state == OutPublishState::Publishing) {
+            op.m_state = OutPublishState::Releasing;
+            op.m_attempt = 0U;
+        }
+
+        doPublish(*session);
+    }
+
+    void handle(PubrelMsg& msg)
+    {
+        auto* session = m_currSession;
+        if (session != nullptr) {
+            auto& msgIds = session->m_inQos2MsgIds;
+            auto iter = std::find(msgIds.begin(), msgIds.end(), msg.field_msgId().value());
+            if (iter != msgIds.end()) {
+                msgIds.erase(iter);
+            }
+        }
+
+        PubcompMsg outMsg;
+        outMsg.field_msgId().value() = msg.field_msgId().value();
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(PubcompMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& op = session->m_outPub;
+        if ((op.m_state != OutPublishState::Releasing) ||
+            (op.m_msgId != msg.field_msgId().value())) {
+            return;
+        }
+
+        finalisePublish(*session, MqttsnAsyncOpStatus_Successful);
+    }
+
+    void handle(SubscribeMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto peer = m_currPeer;
+        auto topicIdType = msg.field_flags().field_topicIdType().value();
+        auto qos = details::translateQosValue(msg.field_flags().field_qos().value());
+        const char* topic = nullptr;
+        char shortTopic[3] = {0};
+        MqttsnTopicId reportedTopicId = 0U;
+        TopicIdType subackTopicId = 0U;
+        auto retCode = ReturnCodeVal::Accepted;
+
+        if (topicIdType == TopicIdTypeVal::Normal) {
+            auto& topicName = msg.field_topicName().field().value();
+            m_topicBuf.assign(topicName.data(), topicName.size());
+            topic = m_topicBuf.c_str();
+            if (!hasWildcards(topic)) {
+                subackTopicId = allocTopicId(topicName.data(), topicName.size());
+                if ((subackTopicId == 0U) || (!addKnownTopicId(*session, subackTopicId))) {
+                    subackTopicId = 0U;
+                    retCode = ReturnCodeVal::Congestion;
+                }
+            }
+        }
+        else if (topicIdType == TopicIdTypeVal::ShortTopicName) {
+            topicIdToShortTopic(msg.field_topicId().field().value(), &shortTopic[0]);
+            topic = &shortTopic[0];
+        }
+        else {
+            reportedTopicId = msg.field_topicId().field().value();
+            subackTopicId = reportedTopicId;
+        }
+
+        if ((retCode == ReturnCodeVal::Accepted) &&
+            ((m_subscribeReportFn == nullptr) ||
+             (!m_subscribeReportFn(m_subscribeReportData, peer, topic, reportedTopicId, &qos)))) {
+            retCode = ReturnCodeVal::NotSupported;
+        }
+
+        SubackMsg outMsg;
+        outMsg.field_flags().field_qos().value() = details::translateQosValue(qos);
+        outMsg.field_topicId().value() = subackTopicId;
+        outMsg.field_msgId().value() = msg.field_msgId().value();
+        outMsg.field_returnCode().value() = retCode;
+        sendMessage(peer, outMsg);
+    }
+
+    void handle(UnsubscribeMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto peer = m_currPeer;
+        auto topicIdType = msg.field_flags().field_topicIdType().value();
+        const char* topic = nullptr;
+        char shortTopic[3] = {0};
+        MqttsnTopicId reportedTopicId = 0U;
+        if (topicIdType == TopicIdTypeVal::Normal) {
+            auto& topicName = msg.field_topicName().field().value();
+            m_topicBuf.assign(topicName.data(), topicName.size());
+            topic = m_topicBuf.c_str();
+        }
+        else if (topicIdType == TopicIdTypeVal::ShortTopicName) {
+            topicIdToShortTopic(msg.field_topicId().field().value(), &shortTopic[0]);
+            topic = &shortTopic[0];
+        }
+        else {
+            reportedTopicId = msg.field_topicId().field().value();
+        }
+
+        if (m_unsubscribeReportFn != nullptr) {
+            m_unsubscribeReportFn(m_unsubscribeReportData, peer, topic, reportedTopicId);
+        }
+
+        UnsubackMsg outMsg;
+        outMsg.field_msgId().value() = msg.field_msgId().value();
+        sendMessage(peer, outMsg);
+    }
+
+    void handle(PingreqMsg& msg)
+    {
+        static_cast<void>(msg);
+        if (m_currSession == nullptr) {
+            sendDisconnect(m_currPeer);
+            return;
+        }
+
+        PingrespMsg outMsg;
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(DisconnectMsg& msg)
+    {
+        auto peer = m_currPeer;
+        auto* session = m_currSession;
+        if ((session == nullptr) || (session->m_state == SessionState::Dropping)) {
+            sendDisconnect(peer);
+            return;
+        }
+
+        if ((msg.field_duration().doesExist()) &&
+            (msg.field_duration().field().value() != 0U)) {
+            session->m_state = SessionState::Asleep;
+            session->m_keepAlivePeriod = msg.field_duration().field().value() * 1000U;
+            bool abortPublish = (session->m_outPub.m_state != OutPublishState::None);
+            sendDisconnect(peer);
+            if (abortPublish) {
+                finalisePublish(*session, MqttsnAsyncOpStatus_Aborted);
+                return;
+            }
+
+            rescheduleSession(*session);
+            return;
+        }
+
+        sendDisconnect(peer);
+        releaseSession(*session, true, false);
+    }
+
+    void handle(WilltopicupdMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& topic = msg.field_willTopic().value();
+        session->m_hasWill = !topic.empty();
+        session->m_willTopic.assign(topic.data(), topic.size());
+        if (session->m_hasWill) {
+            session->m_willQos = details::translateQosValue(msg.field_flags().field().field_qos().value());
+            session->m_willRetain = msg.field_flags().field().field_mid().getBitValue_Retain();
+        }
+        else {
+            session->m_willMsg.clear();
+        }
+
+        WilltopicrespMsg outMsg;
+        outMsg.field_returnCode().value() = ReturnCodeVal::Accepted;
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(WillmsgupdMsg& msg)
+    {
+        auto* session = activeSession();
+        if (session == nullptr) {
+            return;
+        }
+
+        auto& data = msg.field_willMsg().value();
+        session->m_willMsg.assign(data.begin(), data.end());
+
+        WillmsgrespMsg outMsg;
+        outMsg.field_returnCode().value() = ReturnCodeVal::Accepted;
+        sendMessage(m_currPeer, outMsg);
+    }
+
+    void handle(Message& msg)
+    {
+        static_cast<void>(msg);
+    }
+
+private:
+    enum class SessionState
+    {
+        AwaitingWillTopic,
+        AwaitingWillMsg,
+        Active,
+        Asleep,
+        Dropping
+    };
+
+    enum class OutPublishState
+    {
+        None,
+        Registering,
+        Publishing,
+        Releasing
+    };
+
+    struct OutPublish
+    {
+        const char* m_topic = nullptr;
+        const std::uint8_t* m_msg = nullptr;
+        std::size_t m_msgLen = 0U;
+        Timestamp m_lastMsgTimestamp = 0;
+        unsigned m_attempt = 0U;
+        TopicIdType m_topicId = 0U;
+        std::uint16_t m_msgId = 0U;
+        TopicIdTypeVal m_topicIdType = TopicIdTypeVal::Normal;
+        MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
+        OutPublishState m_state = OutPublishState::None;
+        bool m_retain = false;
+    };
+
+    typedef details::SessionTopicIdsStorageTypeT<TopicIdType, TGwOpts> SessionTopicIdsStorage;
+    typedef mqttsn::client::details::TimingWheel<> Wheel;
+    typedef comms::util::StaticVector<
+        std::uint16_t,
+        details::PendingInboundQos2LimitT<TGwOpts>::Value
+    > InQos2MsgIds;
+
+    struct Session
+    {
+        MqttsnGwPeerId m_peer = 0U;
+        ClientIdType m_clientId;
+        TopicNameType m_willTopic;
+        DataType m_willMsg;
+        mqttsn::client::details::TimingWheelEntry m_timer;
+        Timestamp m_lastRecvTimestamp = 0;
+        unsigned m_keepAlivePeriod = 0U;
+        SessionTopicIdsStorage m_topicIds;
+        OutPublish m_outPub;
+        InQos2MsgIds m_inQos2MsgIds;
+        std::uint16_t m_msgId = 0U;
+        MqttsnQoS m_willQos = MqttsnQoS_AtMostOnceDelivery;
+        SessionState m_state = SessionState::AwaitingWillTopic;
+        bool m_willRetain = false;
+        bool m_hasWill = false;
+        bool m_cleanSession = false;
+    };
+
+    typedef details::SessionPool<Session, TGwOpts> SessionsList;
+
+    using InputMessages = mqttsn::input::ServerInputMessages<Message, ProtOpts>;
+    typedef mqttsn::frame::Frame<Message, InputMessages, ProtOpts> ProtStack;
+    typedef typename ProtStack::MsgPtr MsgPtr;
+
+    typedef mqttsn::client::details::RegInfoRegistry<
+        TopicNameType,
+        TopicIdType,
+        details::TopicsRegistryOptionsT<TGwOpts>
+    > TopicsRegistry;
+
+    MqttsnErrorCode publishInternal(
+        MqttsnGwPeerId peer,
+        const char* topic,
+        TopicIdTypeVal topicIdType,
+        TopicIdType topicId,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        if (!m_running) {
+            return MqttsnErrorCode_NotStarted;
+        }
+
+        if (((msg == nullptr) && (0U < msgLen)) ||
+            (qos < MqttsnQoS_AtMostOnceDelivery) ||
+            (MqttsnQoS_ExactlyOnceDelivery < qos) ||
+            (m_writeBuf.max_size() < (msgLen + MaxPublishOverhead))) {
+            return MqttsnErrorCode_BadParam;
+        }
+
+        auto* session = m_sessions.find(peer);
+        if ((session == nullptr) || (session->m_state != SessionState::Active)) {
+            return MqttsnErrorCode_NotConnected;
+        }
+
+        if (session->m_outPub.m_state != OutPublishState::None) {
+            return MqttsnErrorCode_Busy;
+        }
+
+        auto guard = apiCall();
+        auto& op = session->m_outPub;
+        op = OutPublish();
+        op.m_topic = topic;
+        op.m_msg = msg;
+        op.m_msgLen = msgLen;
+        op.m_topicIdType = topicIdType;
+        op.m_topicId = topicId;
+        op.m_qos = qos;
+        op.m_retain = retain;
+        op.m_state = OutPublishState::Publishing;
+
+        if (topicIdType == TopicIdTypeVal::Normal) {
+            op.m_topicId = allocTopicId(topic, std::strlen(topic));
+            if (op.m_topicId == 0U) {
+                op = OutPublish();
+                return MqttsnErrorCode_Busy;
+            }
+
+            if (!knowsTopicId(*session, op.m_topicId)) {
+                // Referenced from the REGISTER on, the client may know the ID
+                // even if REGACK is lost
+                if (!addKnownTopicId(*session, op.m_topicId)) {
+                    op = OutPublish();
+                    return MqttsnErrorCode_Busy;
+                }
+
+                op.m_state = OutPublishState::Registering;
+            }
+        }
+
+        if ((op.m_state == OutPublishState::Registering) ||
+            (MqttsnQoS_AtMostOnceDelivery < qos)) {
+            op.m_msgId = allocMsgId(*session);
+        }
+
+        doPublish(*session);
+        return MqttsnErrorCode_Success;
+    }
+
+    void doPublish(Session& session)
+    {
+        auto& op = session.m_outPub;
+        ++op.m_attempt;
+        op.m_lastMsgTimestamp = m_timestamp;
+
+        if (op.m_state == OutPublishState::Registering) {
+            RegisterMsg msg;
+            msg.field_topicId().value() = op.m_topicId;
+            msg.field_msgId().value() = op.m_msgId;
+            msg.field_topicName().value() = op.m_topic;
+            sendMessage(session.m_peer, msg);
+            rescheduleSession(session);
+            return;
+        }
+
+        if (op.m_state == OutPublishState::Releasing) {
+            PubrelMsg msg;
+            msg.field_msgId().value() = op.m_msgId;
+            sendMessage(session.m_peer, msg);
+            rescheduleSession(session);
+            return;
+        }
+
+        COMMS_ASSERT(op.m_state == OutPublishState::Publishing);
+        PublishMsg msg;
+        msg.field_flags().field_topicIdType().value() = op.m_topicIdType;
+        msg.field_flags().field_mid().setBitValue_Retain(op.m_retain);
+        msg.field_flags().field_qos().value() = details::translateQosValue(op.m_qos);
+        msg.field_flags().field_high().setBitValue_Dup(1U < op.m_attempt);
+        msg.field_topicId().value() = op.m_topicId;
+        msg.field_msgId().value() = op.m_msgId;
+
+        auto& dataStorage = msg.field_data().value();
+        using DataStorage = typename std::decay<decltype(dataStorage)>::type;
+        dataStorage = DataStorage(op.m_msg, op.m_msgLen);
+        sendMessage(session.m_peer, msg);
+
+        if (op.m_qos <= MqttsnQoS_AtMostOnceDelivery) {
+            finalisePublish(session, MqttsnAsyncOpStatus_Successful);
+            return;
+        }
+
+        rescheduleSession(session);
+    }
+
+    /// @pre Must be the last operation on the session, it may be released
+    ///     from within the callback.
+    void finalisePublish(Session& session, MqttsnAsyncOpStatus status)
+    {
+        if ((session.m_outPub.m_state == OutPublishState::Registering) &&
+            (status != MqttsnAsyncOpStatus_Successful)) {
+            forgetTopicId(session, session.m_outPub.m_topicId);
+        }
+
+        session.m_outPub = OutPublish();
+        rescheduleSession(session);
+        reportPublishComplete(session.m_peer, status);
+    }
+
+    void reportPublishComplete(MqttsnGwPeerId peer, MqttsnAsyncOpStatus status)
+    {
+        if (m_publishCompleteReportFn != nullptr) {
+            m_publishCompleteReportFn(m_publishCompleteReportData, peer, status);
+        }
+    }
+
+    void completeConnect(Session& session)
+    {
+        auto peer = session.m_peer;
+        auto willInfo = MqttsnWillInfo();
+        if (session.m_hasWill) {
+            willInfo = sessionWillInfo(session);
+        }
+
+        bool accepted =
+            (m_connectReportFn == nullptr) ||
+            m_connectReportFn(
+                m_connectReportData,
+                peer,
+                session.m_clientId.c_str(),
+                session.m_hasWill ? &willInfo : nullptr,
+                session.m_cleanSession);
+
+        auto* sessionPtr = m_sessions.find(peer);
+        if (sessionPtr == nullptr) {
+            return;
+        }
+
+        if (!accepted) {
+            sendConnack(peer, ReturnCodeVal::NotSupported);
+            releaseSession(*sessionPtr, false, false);
+            return;
+        }
+
+        sessionPtr->m_state = SessionState::Active;
+        rescheduleSession(*sessionPtr);
+        sendConnack(peer, ReturnCodeVal::Accepted);
+    }
+
+    static MqttsnWillInfo sessionWillInfo(const Session& session)
+    {
+        auto willInfo = MqttsnWillInfo();
+        willInfo.topic = session.m_willTopic.c_str();
+        if (!session.m_willMsg.empty()) {
+            willInfo.msg = &session.m_willMsg[0];
+        }
+        willInfo.msgLen = static_cast<unsigned>(session.m_willMsg.size());
+        willInfo.qos = session.m_willQos;
+        willInfo.retain = session.m_willRetain;
+        return willInfo;
+    }
+
+    /// @brief Release the session, optionally reporting the disconnection.
+    /// @details The session is marked as being dropped while the callbacks
+    ///     are invoked, so it cannot be released twice.
+    void releaseSession(Session& session, bool report, bool lost)
+    {
+        auto peer = session.m_peer;
+        bool connected =
+            (session.m_state == SessionState::Active) ||
+            (session.m_state == SessionState::Asleep);
+        bool abortPublish = (session.m_outPub.m_state != OutPublishState::None);
+        session.m_state = SessionState::Dropping;
+        session.m_outPub = OutPublish();
+        m_wheel.cancel(session.m_timer);
+
+        if (abortPublish) {
+            reportPublishComplete(peer, lost ? MqttsnAsyncOpStatus_NoResponse : MqttsnAsyncOpStatus_Aborted);
+        }
+
+        if (report && connected && (m_disconnectReportFn != nullptr)) {
+            auto willInfo = MqttsnWillInfo();
+            bool reportWill = lost && session.m_hasWill;
+            if (reportWill) {
+                willInfo = sessionWillInfo(session);
+            }
+
+            m_disconnectReportFn(m_disconnectReportData, peer, reportWill ? &willInfo : nullptr);
+        }
+
+        if (m_currSession == &session) {
+            m_currSession = nullptr;
+        }
+
+        forgetAllTopicIds(session);
+        m_sessions.release(peer);
+    }
+
+    Session* activeSession()
+    {
+        if ((m_currSession != nullptr) &&
+            (m_currSession->m_state == SessionState::Active)) {
+            return m_currSession;
+        }
+
+        if ((m_currSession == nullptr) ||
+            (m_currSession->m_state == SessionState::Asleep)) {
+            sendDisconnect(m_currPeer);
+        }
+        return nullptr;
+    }
+
+    Timestamp sessionExpiryTimestamp(const Session& session) const
+    {
+        if ((session.m_state == SessionState::AwaitingWillTopic) ||
+            (session.m_state == SessionState::AwaitingWillMsg)) {
+            return session.m_lastRecvTimestamp + (static_cast<Timestamp>(m_retryPeriod) * m_retryCount);
+        }
+
+        if (session.m_keepAlivePeriod == 0U) {
+            return NoExpiry;
+        }
+
+        // The client is considered lost after 1.5 keep alive periods of silence
+        return
+            session.m_lastRecvTimestamp +
+            session.m_keepAlivePeriod +
+            (session.m_keepAlivePeriod / 2U);
+    }
+
+    void rescheduleSession(Session& session)
+    {
+        if (session.m_state == SessionState::Dropping) {
+            return;
+        }
+
+        auto expiry = sessionExpiryTimestamp(session);
+        if (session.m_outPub.m_state != OutPublishState::None) {
+            expiry = std::min(expiry, session.m_outPub.m_lastMsgTimestamp + m_retryPeriod);
+        }
+
+        if (expiry == NoExpiry) {
+            m_wheel.cancel(session.m_timer);
+            return;
+        }
+
+        session.m_timer.m_data = &session;
+        m_wheel.schedule(session.m_timer, expiry);
+    }
+
+    void checkSessionTimeouts(Session& session)
+    {
+        if (sessionExpiryTimestamp(session) <= m_timestamp) {
+            releaseSession(session, true, true);
+            return;
+        }
+
+        auto& op = session.m_outPub;
+        if ((op.m_state != OutPublishState::None) &&
+            ((op.m_lastMsgTimestamp + m_retryPeriod) <= m_timestamp)) {
+            if (m_retryCount <= op.m_attempt) {
+                finalisePublish(session, MqttsnAsyncOpStatus_NoResponse);
+                return;
+            }
+
+            doPublish(session);
+            return;
+        }
+
+        rescheduleSession(session);
+    }
+
+    void checkTimeouts()
+    {
+        m_wheel.advance(
+            m_timestamp,
+            [this](mqttsn::client::details::TimingWheelEntry& entry)
+            {
+                checkSessionTimeouts(*reinterpret_cast<Session*>(entry.m_data));
+            });
+
+        checkAdvertise();
+    }
+
+    void checkAdvertise()
+    {
+        if ((m_advertisePeriod == 0U) ||
+            ((m_lastAdvertiseTimestamp != 0U) &&
+             (m_timestamp < (m_lastAdvertiseTimestamp + advertisePeriodMs())))) {
+            return;
+        }
+
+        AdvertiseMsg msg;
+        msg.field_gwId().value() = m_gwId;
+        msg.field_duration().value() = m_advertisePeriod;
+        sendMessage(MQTTSN_GW_BROADCAST_PEER, msg, true);
+        m_lastAdvertiseTimestamp = m_timestamp;
+    }
+
+    Timestamp advertisePeriodMs() const
+    {
+        return static_cast<Timestamp>(m_advertisePeriod) * 1000U;
+    }
+
+    bool updateTimestamp()
+    {
+        if (!isTimerActive()) {
+            return false;
+        }
+
+        COMMS_ASSERT(m_cancelNextTickWaitFn != nullptr);
+        m_timestamp += m_cancelNextTickWaitFn(m_cancelNextTickWaitData);
+        m_tickDelay = 0U;
+        checkTimeouts();
+        return true;
+    }
+
+    void programNextTimeout()
+    {
+        if (!m_running) {
+            return;
+        }
+
+        Timestamp nextTimestamp = m_wheel.nextEvent();
+        if (m_advertisePeriod != 0U) {
+            nextTimestamp = std::min(nextTimestamp, m_lastAdvertiseTimestamp + advertisePeriodMs());
+        }
+
+        if (nextTimestamp == NoExpiry) {
+            return;
+        }
+
+        unsigned delay = 1U;
+        if (m_timestamp < nextTimestamp) {
+            delay = static_cast<unsigned>(std::min<Timestamp>(nextTimestamp - m_timestamp, NoTimeout - 1U));
+        }
+
+        COMMS_ASSERT(m_nextTickProgramFn != nullptr);
+        m_nextTickProgramFn(m_nextTickProgramData, delay);
+        m_tickDelay = delay;
+    }
+
+    TopicIdType allocTopicId(const char* topic, std::size_t topicLen)
+    {
+        auto* regInfo = m_topics.findByName(topic, topicLen);
+        if (regInfo != nullptr) {
+            m_topics.touch(*regInfo);
+            return regInfo->m_topicId;
+        }
+
+        for (unsigned attempt = 0U; attempt < MaxTopicId; ++attempt) {
+            ++m_lastTopicId;
+            if ((m_lastTopicId == 0U) || (MaxTopicId < m_lastTopicId)) {
+                m_lastTopicId = 1U;
+            }
+
+            if (m_topics.findById(m_lastTopicId) == nullptr) {
+                m_topics.update(topic, topicLen, m_lastTopicId, false);
+                return m_lastTopicId;
+            }
+        }
+
+        return 0U;
+    }
+
+    static bool hasInQos2MsgId(const Session& session, std::uint16_t msgId)
+    {
+        return
+            std::find(session.m_inQos2MsgIds.begin(), session.m_inQos2MsgIds.end(), msgId) !=
+                session.m_inQos2MsgIds.end();
+    }
+
+    static bool knowsTopicId(const Session& session, TopicIdType topicId)
+    {
+        return
+            std::find(session.m_topicIds.begin(), session.m_topicIds.end(), topicId) !=
+                session.m_topicIds.end();
+    }
+
+    /// @brief Record the topic ID known to the session.
+    /// @details The known topic IDs are referenced in the registry, so they
+    ///     are never evicted and reused for other topics while any session
+    ///     may still publish with them.
+    /// @return false when the session cannot know any more topic IDs or
+    ///     the topic cannot be referenced any more.
+    bool addKnownTopicId(Session& session, TopicIdType topicId)
+    {
+        if (knowsTopicId(session, topicId)) {
+            return true;
+        }
+
+        auto& ids = session.m_topicIds;
+        if (ids.max_size() <= ids.size()) {
+            return false;
+        }
+
+        auto* regInfo = m_topics.findById(topicId);
+        if ((regInfo == nullptr) || (!m_topics.addRef(*regInfo))) {
+            return false;
+        }
+
+        ids.push_back(topicId);
+        return true;
+    }
+
+    void forgetTopicId(Session& session, TopicIdType topicId)
+    {
+        auto& ids = session.m_topicIds;
+        auto iter = std::find(ids.begin(), ids.end(), topicId);
+        if (iter != ids.end()) {
+            ids.erase(iter);
+            releaseTopicId(topicId);
+        }
+    }
+
+    void forgetAllTopicIds(Session& session)
+    {
+        for (auto topicId : session.m_topicIds) {
+            releaseTopicId(topicId);
+        }
+
+        session.m_topicIds.clear();
+    }
+
+    void releaseTopicId(TopicIdType topicId)
+    {
+        auto* regInfo = m_topics.findById(topicId);
+        COMMS_ASSERT(regInfo != nullptr);
+        if (regInfo != nullptr) {
+            m_topics.releaseRef(*regInfo);
+        }
+    }
+
+    static std::uint16_t allocMsgId(Session& session)
+    {
+        ++session.m_msgId;
+        if (session.m_msgId == 0U) {
+            ++session.m_msgId;
+        }
+        return session.m_msgId;
+    }
+
+    void sendMessage(MqttsnGwPeerId peer, const Message& msg, bool broadcast = false)
+    {
+        m_writeBuf.resize(std::max(m_writeBuf.size(), m_stack.length(msg)));
+        COMMS_ASSERT(!m_writeBuf.empty());
+        auto writeIter = comms::writeIteratorFor<Message>(&m_writeBuf[0]);
+        auto es = m_stack.write(msg, writeIter, m_writeBuf.size());
+        COMMS_ASSERT(es == comms::ErrorStatus::Success);
+        if (es != comms::ErrorStatus::Success) {
+            // Buffer is too small
+            return;
+        }
+
+        auto writtenBytes = static_cast<unsigned>(
+            std::distance(comms::writeIteratorFor<Message>(&m_writeBuf[0]), writeIter));
+
+        COMMS_ASSERT(m_sendOutputDataFn != nullptr);
+        m_sendOutputDataFn(m_sendOutputDataData, peer, &m_writeBuf[0], writtenBytes, broadcast);
+    }
+
+    void sendConnack(MqttsnGwPeerId peer, ReturnCodeVal retCode)
+    {
+        ConnackMsg msg;
+        msg.field_returnCode().value() = retCode;
+        sendMessage(peer, msg);
+    }
+
+    void sendPuback(
+        MqttsnGwPeerId peer,
+        TopicIdType topicId,
+        std::uint16_t msgId,
+        ReturnCodeVal retCode)
+    {
+        PubackMsg msg;
+        msg.field_topicId().value() = topicId;
+        msg.field_msgId().value() = msgId;
+        msg.field_returnCode().value() = retCode;
+        sendMessage(peer, msg);
+    }
+
+    void sendPubrec(MqttsnGwPeerId peer, std::uint16_t msgId)
+    {
+        PubrecMsg msg;
+        msg.field_msgId().value() = msgId;
+        sendMessage(peer, msg);
+    }
+
+    void sendDisconnect(MqttsnGwPeerId peer)
+    {
+        DisconnectMsg msg;
+        sendMessage(peer, msg);
+    }
+
+    static MqttsnAsyncOpStatus retCodeToStatus(ReturnCodeVal val)
+    {
+        static const MqttsnAsyncOpStatus Map[] = {
+            /* ReturnCodeVal_Accepted */ MqttsnAsyncOpStatus_Successful,
+            /* ReturnCodeVal_Congestion */ MqttsnAsyncOpStatus_Congestion,
+            /* ReturnCodeVal_InvalidTopicId */ MqttsnAsyncOpStatus_InvalidId,
+            /* ReturnCodeVal_NotSupported */ MqttsnAsyncOpStatus_NotSupported
+        };
+
+        static const std::size_t MapSize =
+            std::extent<decltype(Map)>::value;
+
+        static_assert(MapSize == (unsigned)ReturnCodeVal::ValuesLimit,
+            "Map is incorrect");
+
+        MqttsnAsyncOpStatus status = MqttsnAsyncOpStatus_NotSupported;
+        if (static_cast<unsigned>(val) < MapSize) {
+            status = Map[static_cast<unsigned>(val)];
+        }
+
+        return status;
+    }
+
+    void apiCallExit()
+    {
+        COMMS_ASSERT(0U < m_callStackCount);
+        --m_callStackCount;
+        if (m_callStackCount == 0U) {
+            programNextTimeout();
+        }
+    }
+
+#ifdef _MSC_VER
+    // VC compiler
+    auto apiCall()
+#else
+    auto apiCall() -> decltype(comms::util::makeScopeGuard(std::bind(&BasicGateway<TGwOpts>::apiCallExit, this)))
+#endif
+    {
+        ++m_callStackCount;
+        if (m_callStackCount == 1U) {
+            updateTimestamp();
+        }
+
+        return
+            comms::util::makeScopeGuard(
+                std::bind(
+                    &BasicGateway<TGwOpts>::apiCallExit,
+                    this));
+    }
+
+    bool isTimerActive() const
+    {
+        return (m_tickDelay != 0U);
+    }
+
+    static bool hasWildcards(const char* topic)
+    {
+        return std::strpbrk(topic, "+#") != nullptr;
+    }
+
+    static bool isShortTopicName(const char* topic)
+    {
+        COMMS_ASSERT(topic != nullptr);
+        auto checkCharFunc =
+            [](char ch)
+            {
+                return
+                    (ch != '\0') &&
+                    (ch != '+') &&
+                    (ch != '#');
+            };
+
+        if ((!checkCharFunc(topic[0])) ||
+            (!checkCharFunc(topic[1]))) {
+            return false;
+        }
+
+        return topic[2] == '\0';
+    }
+
+    static MqttsnTopicId shortTopicToTopicId(const char* topic)
+    {
+        return
+            static_cast<MqttsnTopicId>(
+                (static_cast<MqttsnTopicId>(topic[0]) << 8) | static_cast<std::uint8_t>(topic[1]));
+    }
+
+    static void topicIdToShortTopic(MqttsnTopicId topicId, char* topicOut)
+    {
+        topicOut[0] = static_cast<char>((topicId >> 8) & 0xff);
+        topicOut[1] = static_cast<char>(topicId & 0xff);
+        topicOut[2] = '\0';
+    }
+
+    static const Timestamp NoExpiry = Wheel::NoExpiry;
+    static const unsigned NoTimeout = std::numeric_limits<unsigned>::max();
+    static const unsigned DefaultRetryPeriod = 15 * 1000;
+    static const unsigned DefaultRetryCount = 3;
+    static const unsigned MaxTopicId = 0xfffe;
+    static const std::size_t MaxPublishOverhead = 7U;
+    static const Timestamp DefaultStartTimestamp = 100;
+
+    ProtStack m_stack;
+    SessionsList m_sessions;
+    TopicsRegistry m_topics;
+    Wheel m_wheel = Wheel(DefaultStartTimestamp);
+    Timestamp m_timestamp = DefaultStartTimestamp;
+    Timestamp m_lastAdvertiseTimestamp = 0;
+    TopicNameType m_topicBuf;
+    MqttsnGwPeerId m_currPeer = 0U;
+    Session* m_currSession = nullptr;
+
+    unsigned m_callStackCount = 0U;
+    unsigned m_retryPeriod = DefaultRetryPeriod;
+    unsigned m_retryCount = DefaultRetryCount;
+    unsigned m_tickDelay = 0U;
+    TopicIdType m_lastTopicId = 0U;
+    std::uint16_t m_advertisePeriod = 0U;
+    GwIdValueType m_gwId = 0U;
+    bool m_running = false;
+
+    MqttsnNextTickProgramFn m_nextTickProgramFn = nullptr;
+    void* m_nextTickProgramData = nullptr;
+
+    MqttsnCancelNextTickWaitFn m_cancelNextTickWaitFn = nullptr;
+    void* m_cancelNextTickWaitData = nullptr;
+
+    MqttsnGwSendOutputDataFn m_sendOutputDataFn = nullptr;
+    void* m_sendOutputDataData = nullptr;
+
+    MqttsnGwConnectReportFn m_connectReportFn = nullptr;
+    void* m_connectReportData = nullptr;
+
+    MqttsnGwClientDisconnectReportFn m_disconnectReportFn = nullptr;
+    void* m_disconnectReportData = nullptr;
+
+    MqttsnGwPublishReportFn m_publishReportFn = nullptr;
+    void* m_publishReportData = nullptr;
+
+    MqttsnGwSubscribeReportFn m_subscribeReportFn = nullptr;
+    void* m_subscribeReportData = nullptr;
+
+    MqttsnGwUnsubscribeReportFn m_unsubscribeReportFn = nullptr;
+    void* m_unsubscribeReportData = nullptr;
+
+    MqttsnGwPublishCompleteReportFn m_publishCompleteReportFn = nullptr;
+    void* m_publishCompleteReportData = nullptr;
+
+    WriteBufStorage m_writeBuf;
+};
+
+}  // namespace gateway
+
+}  // namespace mqttsn
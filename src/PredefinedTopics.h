@@ -0,0 +1,299 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <type_traits>
+
+#include "mqttsn/client/common.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Entry of the predefined topics catalogue.
+/// @details The catalogue is provided to the client with
+///     @ref option::PredefinedTopics option as a type defining
+///     @b static @b constexpr array of the entries named @b Topics:
+///     @code
+///     struct MyTopics
+///     {
+///         static constexpr mqttsn::client::PredefinedTopicInfo Topics[] = {
+///             {"sensors/temperature", 1},
+///             {"sensors/humidity", 2}
+///         };
+///     };
+///
+///     // Required before C++17
+///     constexpr mqttsn::client::PredefinedTopicInfo MyTopics::Topics[];
+///     @endcode
+///     The same IDs must be configured on the gateway.
+///     The names and IDs of every pair of the entries are compared at
+///     compile time, so the catalogue is limited to
+///     @ref MaxPredefinedTopicsCount entries. With the default limits
+///     of GCC about 400 entries (depending on the length of the names)
+///     can be checked, larger catalogues require raising
+///     @b -fconstexpr-ops-limit (or @b -fconstexpr-steps with Clang).
+struct PredefinedTopicInfo
+{
+    const char* m_topic;
+    MqttsnTopicId m_topicId;
+};
+
+/// @brief Maximal number of entries of the predefined topics catalogue.
+static const std::size_t MaxPredefinedTopicsCount = 1024U;
+
+namespace details
+{
+
+constexpr bool predefinedTopicsEqual(const char* str1, const char* str2)
+{
+    return
+        (*str1 == *str2) &&
+        ((*str1 == '\0') || predefinedTopicsEqual(str1 + 1, str2 + 1));
+}
+
+// The checks of the catalogue split the range of entries in halves, so
+// the recursion depth grows with log2 of the entries count (plus the
+// length of the compared topic names) and stays far below the default
+// constexpr depth limit of the compilers (512). The number of evaluated
+// operations grows with the square of the count though.
+
+template <typename TTopics>
+constexpr std::size_t predefinedTopicsCount()
+{
+    return std::extent<decltype(TTopics::Topics)>::value;
+}
+
+template <typename TTopics>
+constexpr MqttsnTopicId predefinedTopicIdIn(const char* topic, std::size_t from, std::size_t to);
+
+template <typename TTopics>
+constexpr MqttsnTopicId predefinedTopicIdOr(
+    MqttsnTopicId topicId,
+    const char* topic,
+    std::size_t from,
+    std::size_t to)
+{
+    return (topicId != 0U) ? topicId : predefinedTopicIdIn<TTopics>(topic, from, to);
+}
+
+template <typename TTopics>
+constexpr MqttsnTopicId predefinedTopicIdIn(const char* topic, std::size_t from, std::size_t to)
+{
+    return
+        (to <= from) ? 0U :
+        ((to - from) == 1U) ?
+            (predefinedTopicsEqual(TTopics::Topics[from].m_topic, topic) ? TTopics::Topics[from].m_topicId : 0U) :
+        predefinedTopicIdOr<TTopics>(
+            predefinedTopicIdIn<TTopics>(topic, from, from + ((to - from) / 2U)),
+            topic,
+            from + ((to - from) / 2U),
+            to);
+}
+
+template <typename TTopics>
+constexpr bool predefinedTopicIdsValidIn(std::size_t from, std::size_t to)
+{
+    return
+        (to <= from) ||
+        (((to - from) == 1U) ?
+            ((TTopics::Topics[from].m_topicId != 0U) &&
+             (TTopics::Topics[from].m_topicId != 0xffff) &&
+             (TTopics::Topics[from].m_topic != nullptr) &&
+             (TTopics::Topics[from].m_topic[0] != '\0')) :
+            (predefinedTopicIdsValidIn<TTopics>(from, from + ((to - from) / 2U)) &&
+             predefinedTopicIdsValidIn<TTopics>(from + ((to - from) / 2U), to)));
+}
+
+/// @brief Check the name (or ID) of the entry @b idx differs from the
+///     ones of all the entries in [from, to).
+template <typename TTopics>
+constexpr bool predefinedTopicUniqueIn(std::size_t idx, std::size_t from, std::size_t to, bool byName)
+{
+    return
+        (to <= from) ||
+        (((to - from) == 1U) ?
+            (byName ?
+                (!predefinedTopicsEqual(TTopics::Topics[idx].m_topic, TTopics::Topics[from].m_topic)) :
+                (TTopics::Topics[idx].m_topicId != TTopics::Topics[from].m_topicId)) :
+            (predefinedTopicUniqueIn<TTopics>(idx, from, from + ((to - from) / 2U), byName) &&
+             predefinedTopicUniqueIn<TTopics>(idx, from + ((to - from) / 2U), to, byName)));
+}
+
+/// @brief Check the name (or ID) of every entry in [from, to) differs
+///     from the ones of all the following entries.
+template <typename TTopics>
+constexpr bool predefinedTopicsUniqueIn(std::size_t from, std::size_t to, bool byName)
+{
+    return
+        (to <= from) ||
+        (((to - from) == 1U) ?
+            predefinedTopicUniqueIn<TTopics>(from, from + 1U, predefinedTopicsCount<TTopics>(), byName) :
+            (predefinedTopicsUniqueIn<TTopics>(from, from + ((to - from) / 2U), byName) &&
+             predefinedTopicsUniqueIn<TTopics>(from + ((to - from) / 2U), to, byName)));
+}
+
+/// @brief FNV-1a hash of the topic string.
+constexpr std::uint32_t predefinedTopicHash(const char* topic, std::uint32_t hash = 2166136261U)
+{
+    return
+        (*topic == '\0') ? hash :
+        predefinedTopicHash(topic + 1, (hash ^ static_cast<std::uint8_t>(*topic)) * 16777619U);
+}
+
+/// @brief Lookup of the predefined topics catalogue in both directions.
+/// @details Open addressing hash indices (by name and by ID) are built
+///     once per catalogue on first use and shared by all the clients.
+template <typename TTopics>
+class PredefinedTopicsMap
+{
+public:
+    static const std::size_t Count = std::extent<decltype(TTopics::Topics)>::value;
+
+    static_assert(0U < Count, "The predefined topics catalogue is empty");
+    // Also keeps the entry indices below NoIdx
+    static_assert(Count <= MaxPredefinedTopicsCount, "Too many predefined topics");
+    static_assert(predefinedTopicIdsValidIn<TTopics>(0U, Count), "Invalid predefined topic entry");
+    static_assert(
+        (MaxPredefinedTopicsCount < Count) || predefinedTopicsUniqueIn<TTopics>(0U, Count, true),
+        "Duplicate predefined topic name");
+    static_assert(
+        (MaxPredefinedTopicsCount < Count) || predefinedTopicsUniqueIn<TTopics>(0U, Count, false),
+        "Duplicate predefined topic ID");
+
+    /// @return Predefined ID of the topic, 0 if not found.
+    static MqttsnTopicId findId(const char* topic)
+    {
+        auto& idx = index();
+        auto bucket = static_cast<std::size_t>(predefinedTopicHash(topic)) & Mask;
+        while (true) {
+            auto elemIdx = idx.m_byName[bucket];
+            if (elemIdx == NoIdx) {
+                return 0U;
+            }
+
+            if (predefinedTopicsEqual(TTopics::Topics[elemIdx].m_topic, topic)) {
+                return TTopics::Topics[elemIdx].m_topicId;
+            }
+
+            bucket = (bucket + 1) & Mask;
+        }
+    }
+
+    /// @return Topic name of the predefined ID, nullptr if not found.
+    static const char* findName(MqttsnTopicId topicId)
+    {
+        auto& idx = index();
+        auto bucket = idHash(topicId);
+        while (true) {
+            auto elemIdx = idx.m_byId[bucket];
+            if (elemIdx == NoIdx) {
+                return nullptr;
+            }
+
+            if (TTopics::Topics[elemIdx].m_topicId == topicId) {
+                return TTopics::Topics[elemIdx].m_topic;
+            }
+
+            bucket = (bucket + 1) & Mask;
+        }
+    }
+
+private:
+    static constexpr std::size_t bucketsCount(std::size_t count, std::size_t buckets = 1U)
+    {
+        return (count * 2U <= buckets) ? buckets : bucketsCount(count, buckets * 2U);
+    }
+
+    static const std::size_t BucketsCount = bucketsCount(Count);
+    static const std::size_t Mask = BucketsCount - 1U;
+    static const std::uint16_t NoIdx = 0xffff;
+
+    struct Index
+    {
+        Index()
+        {
+            m_byName.fill(static_cast<std::uint16_t>(NoIdx));
+            m_byId.fill(static_cast<std::uint16_t>(NoIdx));
+            for (std::size_t elemIdx = 0U; elemIdx < Count; ++elemIdx) {
+                auto& info = TTopics::Topics[elemIdx];
+                auto bucket = static_cast<std::size_t>(predefinedTopicHash(info.m_topic)) & Mask;
+                while (m_byName[bucket] != NoIdx) {
+                    bucket = (bucket + 1) & Mask;
+                }
+                m_byName[bucket] = static_cast<std::uint16_t>(elemIdx);
+
+                bucket = idHash(info.m_topicId);
+                while (m_byId[bucket] != NoIdx) {
+                    bucket = (bucket + 1) & Mask;
+                }
+                m_byId[bucket] = static_cast<std::uint16_t>(elemIdx);
+            }
+        }
+
+        std::array<std::uint16_t, BucketsCount> m_byName;
+        std::array<std::uint16_t, BucketsCount> m_byId;
+    };
+
+    static std::size_t idHash(MqttsnTopicId topicId)
+    {
+        return (static_cast<std::size_t>(topicId) * 40503U) & Mask;
+    }
+
+    static const Index& index()
+    {
+        static const Index Idx;
+        return Idx;
+    }
+};
+
+class NoPredefinedTopicsMap
+{
+public:
+    static MqttsnTopicId findId(const char* topic)
+    {
+        static_cast<void>(topic);
+        return 0U;
+    }
+
+    static const char* findName(MqttsnTopicId topicId)
+    {
+        static_cast<void>(topicId);
+        return nullptr;
+    }
+};
+
+}  // namespace details
+
+/// @brief Compile time lookup of the predefined topic ID.
+/// @return ID of the topic in the catalogue, 0 if not found.
+template <typename TTopics>
+constexpr MqttsnTopicId predefinedTopicId(const char* topic)
+{
+    return details::predefinedTopicIdIn<TTopics>(topic, 0U, details::predefinedTopicsCount<TTopics>());
+}
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -10,7 +10,7 @@
 
 // MQTT-SN support functions    
 
-void mqttsn_send(void* userData, const unsigned char* buf, unsigned bufLen, bool broadcast)
+void mqttsn_send(void* userData, const MqttsnIoVec* vec, unsigned count, bool broadcast)
 {
     PubSubClient *psc = static_cast<PubSubClient *>(userData);
 
@@ -20,7 +20,10 @@ void mqttsn_send(void* userData, const unsigned char* buf, unsigned bufLen, bool
     else {
         psc->udp.beginPacket(psc->ip,psc->port);
     }
-    psc->udp.write(buf, bufLen);
+    // PUBLISH data is written straight from the application buffer
+    for (unsigned idx = 0; idx < count; ++idx) {
+        psc->udp.write(vec[idx].buf, vec[idx].bufLen);
+    }
 
     psc->udp.endPacket();
 }
@@ -63,9 +66,18 @@ void mqttsn_connect_complete(void* userData, MqttsnAsyncOpStatus status)
 
     if (status == MqttsnAsyncOpStatus_Successful) {
       psc->isConnected = true;
+      psc->_state = MQTT_CONNECTED;
     }
     else {
       psc->isErrored = true;
+      psc->_state = MQTT_CONNECT_FAILED;
+      psc->stopPending = true; // stopped by loop(), not from within the client's callback
+    }
+
+    MqttsnAsyncOpCompleteReportFn cb = psc->connectCb;
+    psc->connectCb = NULL;
+    if (cb != NULL) {
+      cb(psc->connectCbData, status);
     }
 }
 
@@ -81,6 +93,14 @@ void mqttsn_disconnect_complete(void* userData, MqttsnAsyncOpStatus status)
   else {
     psc->isErrored = true;
   }
+
+  psc->stopPending = true;
+
+  MqttsnAsyncOpCompleteReportFn cb = psc->disconnectCb;
+  psc->disconnectCb = NULL;
+  if (cb != NULL) {
+    cb(psc->disconnectCbData, status);
+  }
 }
 
 // MQTT-SN subscribe complete
@@ -125,16 +145,63 @@ void mqttsn_publish_complete(void* userData, MqttsnAsyncOpStatus status)
     }
 }
 
-void PubSubClient::handleUDPRxComms() {
+// Completion of async operation issued without callback
+
+void mqttsn_ignore_complete(void* userData, MqttsnAsyncOpStatus status)
+{
+    (void)userData;
+    (void)status;
+}
+
+void mqttsn_ignore_subscribe_complete(void* userData, MqttsnAsyncOpStatus status, MqttsnQoS qos)
+{
+    (void)userData;
+    (void)status;
+    (void)qos;
+}
+
+boolean PubSubClient::handleUDPRxComms() {
     int packetSize = udp.parsePacket();
-    if(packetSize) {
-      int rxd = udp.read(rxBuffer, sizeof(rxBuffer));
-      unsigned consumed = mqttsn_client_process_data(_snClient, rxBuffer, rxd);
-      if (consumed < rxd) {
-        printf("Error: Consumed size wrong\n");
+    if(packetSize <= 0) {
+      return false;
+    }
+
+    int rxd = udp.read(rxBuffer, sizeof(rxBuffer));
+    unsigned consumed = mqttsn_client_process_data(_snClient, rxBuffer, rxd);
+    if (consumed < rxd) {
+      printf("Error: Consumed size wrong\n");
+    }
+    udp.flush();
+    return true;
+}
+
+// Drain the received datagrams within the budget, then run the expired timers
+
+void PubSubClient::service(unsigned long budgetMs) {
+    unsigned long startMs = millis();
+    while (handleUDPRxComms()) {
+      if (budgetMs <= (millis() - startMs)) {
+        break;
       }
-      udp.flush();
     }
+
+    timer.run();
+
+    if (stopPending) {
+      stopClient();
+    }
+}
+
+void PubSubClient::stopClient() {
+    stopPending = false;
+    if (!isStarted) {
+      return;
+    }
+
+    mqttsn_client_stop(_snClient);
+    udp.stop();
+    isStarted = false;
+    isConnected = false;
 }
 
 // END MQTT-SN support
@@ -152,7 +219,7 @@ PubSubClient::PubSubClient() {
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -177,7 +244,7 @@ PubSubClient::PubSubClient(Client& client) {
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -203,7 +270,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -229,7 +296,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -256,7 +323,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -283,7 +350,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -310,7 +377,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -336,7 +403,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -362,7 +429,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& s
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -389,7 +456,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -416,7 +483,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -442,7 +509,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -468,7 +535,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, St
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -495,7 +562,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -522,7 +589,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -549,7 +616,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
     _snClient = mqttsn_client_new();
 
     void *vpThis = static_cast<void*>(this);
-    mqttsn_client_set_send_output_data_callback(_snClient, &mqttsn_send, vpThis);
+    mqttsn_client_set_send_output_vec_callback(_snClient, &mqttsn_send, vpThis);
     mqttsn_client_set_next_tick_program_callback(_snClient, &mqttsn_timer, vpThis);
     mqttsn_client_set_cancel_next_tick_wait_callback(_snClient, &mqttsn_cancel_timer, vpThis);
     mqttsn_client_set_message_report_callback(_snClient, &mqttsn_message_handler, vpThis);
@@ -584,12 +651,26 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 }
 
 boolean PubSubClient::connect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession) {
-    if (!isConnected) {
+    if (!connectAsync(id, NULL, NULL, cleanSession)) {
+        return false;
+    }
+
+    while(!isConnected && !isErrored) {
+        service(MQTT_LOOP_BUDGET_MS);
+        yield();
+    }
+
+    return !isErrored;
+}
+
+boolean PubSubClient::connectAsync(const char* id, MqttsnAsyncOpCompleteReportFn callback, void* data, boolean cleanSession) {
+    if (!isConnected && !isStarted) {
 
         udp.begin(port);
 
         isConnected = false;
         isErrored = false;
+        stopPending = false;
 
         MqttsnErrorCode result = mqttsn_client_start(_snClient);
         if(result != MqttsnErrorCode_Success) {
@@ -599,6 +680,8 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
             return false;
         }
 
+        isStarted = true;
+
         /*
             MqttsnErrorCode mqttsn_client_connect(
             MqttsnClientHandle client,
@@ -613,24 +696,14 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
         // TODO: LWT NOT SUPPORTED YET
         // TODO: I don't seem to be able to provide a user/password ?
+        connectCb = callback;
+        connectCbData = data;
         result = mqttsn_client_connect(_snClient, id, this->keepAlive, cleanSession, NULL, &mqttsn_connect_complete, this);
         if(result != MqttsnErrorCode_Success) {
 
             _state = MQTT_CONNECT_FAILED;
-            udp.stop();
-            return false;
-        }
-
-        while(!isConnected && !isErrored) {
-            handleUDPRxComms();
-            timer.run();
-            delay(50);
-        }
-
-        if(isErrored) {
-//            _state = MQTT_CONNECTION_TIMEOUT;
-            _state = MQTT_CONNECT_FAILED;
-            udp.stop();
+            connectCb = NULL;
+            stopClient();
             return false;
         }
 
@@ -640,12 +713,16 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 }
 
 boolean PubSubClient::loop() {
-    
-    if(isConnected) {
-        handleUDPRxComms();
-        return true;
+    return loop(MQTT_LOOP_BUDGET_MS);
+}
+
+boolean PubSubClient::loop(unsigned long budgetMs) {
+    if(!isStarted) {
+        return false;
     }
-    return false;
+
+    service(budgetMs);
+    return isConnected;
 }
 
 boolean PubSubClient::publish(const char* topic, const char* payload) {
@@ -694,9 +771,8 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
 
     while(!isPublished && !isErrored)
     {
-      handleUDPRxComms();
-      timer.run();
-      delay(50);
+      service(MQTT_LOOP_BUDGET_MS);
+      yield();
     }
 
     return (!isErrored);
@@ -744,14 +820,36 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
 
     while(!isPublished && !isErrored)
     {
-      handleUDPRxComms();
-      timer.run();
-      delay(50);
+      service(MQTT_LOOP_BUDGET_MS);
+      yield();
     }
 
     return (!isErrored);
 }
 
+boolean PubSubClient::publishAsync(const char* topic, const uint8_t* payload, unsigned int plength, uint8_t qos, boolean retained, MqttsnAsyncOpCompleteReportFn callback, void* data) {
+
+    if (!isConnected) {
+        return false;
+    }
+
+    if (callback == NULL) {
+        callback = &mqttsn_ignore_complete;
+    }
+
+    MqttsnErrorCode result = mqttsn_client_publish(
+      _snClient,
+      topic,
+      (const unsigned char *)payload,
+      plength,
+      (MqttsnQoS)qos,
+      retained,
+      callback,
+      data);
+
+    return (result == MqttsnErrorCode_Success);
+}
+
 #if false
 
 boolean PubSubClient::beginPublish(const char* topic, unsigned int plength, boolean retained) {
@@ -791,9 +889,8 @@ int PubSubClient::endPublish() {
 
     while(!isPublished && !isErrored)
     {
-      handleUDPRxComms();
-      timer.run();
-      delay(50);
+      service(MQTT_LOOP_BUDGET_MS);
+      yield();
     }
 
     return (!isErrored);
@@ -847,9 +944,8 @@ boolean PubSubClient::subscribe(const char* topic, int8_t qos) {
 
     while(!isSubscribed && !isErrored)
     {
-        handleUDPRxComms();
-        timer.run();
-        delay(50);
+        service(MQTT_LOOP_BUDGET_MS);
+        yield();
     }
  
     return !isErrored;
@@ -882,14 +978,52 @@ boolean PubSubClient::unsubscribe(const char* topic) {
 
     while(!isUnsubscribed && !isErrored)
     {
-        handleUDPRxComms();
-        timer.run();
-        delay(50);
+        service(MQTT_LOOP_BUDGET_MS);
+        yield();
     }
 
     return !isErrored;
 }
 
+boolean PubSubClient::subscribeAsync(const char* topic, int8_t qos, MqttsnSubscribeCompleteReportFn callback, void* data) {
+
+    if (!isConnected || (topic == 0)) {
+        return false;
+    }
+
+    if (callback == NULL) {
+        callback = &mqttsn_ignore_subscribe_complete;
+    }
+
+    MqttsnErrorCode result = mqttsn_client_subscribe(
+        _snClient,
+        topic,
+        (MqttsnQoS)qos, /* max QoS */
+        callback,
+        data);
+
+    return (result == MqttsnErrorCode_Success);
+}
+
+boolean PubSubClient::unsubscribeAsync(const char* topic, MqttsnAsyncOpCompleteReportFn callback, void* data) {
+
+    if (!isConnected || (topic == 0)) {
+        return false;
+    }
+
+    if (callback == NULL) {
+        callback = &mqttsn_ignore_complete;
+    }
+
+    MqttsnErrorCode result = mqttsn_client_unsubscribe(
+        _snClient,
+        topic,
+        callback,
+        data);
+
+    return (result == MqttsnErrorCode_Success);
+}
+
 void PubSubClient::disconnect() {
 
     if(!isConnected)
@@ -907,23 +1041,37 @@ void PubSubClient::disconnect() {
         goto errorexit;
 
     while(isConnected && !isErrored) {
-        handleUDPRxComms();
-        timer.run();
-        delay(50);
+        service(MQTT_LOOP_BUDGET_MS);
+        yield();
     }
 
 errorexit:
 
-    mqttsn_client_stop(_snClient);
-
-    isConnected = false;
+    disconnectCb = NULL;
+    stopClient();
     isErrored = false;
-
-    udp.stop();
+    _state = MQTT_DISCONNECTED;
 
     return;
 }
 
+boolean PubSubClient::disconnectAsync(MqttsnAsyncOpCompleteReportFn callback, void* data) {
+
+    if(!isConnected)
+        return false;
+
+    disconnectCb = callback;
+    disconnectCbData = data;
+    MqttsnErrorCode result = mqttsn_client_disconnect(_snClient, mqttsn_disconnect_complete, this);
+    if(result != MqttsnErrorCode_Success) {
+        disconnectCb = NULL;
+        return false;
+    }
+
+    _state = MQTT_DISCONNECTED;
+    return true;
+}
+
 boolean PubSubClient::connected() {
     return isConnected;
 }
@@ -24,8 +24,86 @@
 namespace
 {
 
+#ifdef MQTTSN_CLIENT_MAX_INFLIGHT_PUBLISHES
+typedef mqttsn::client::option::MaxInflightPublishes<MQTTSN_CLIENT_MAX_INFLIGHT_PUBLISHES> MaxInflightPublishesOption;
+#else
+typedef std::tuple<> MaxInflightPublishesOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_OUTPUT_BATCH_FRAMES_LIMIT
+typedef mqttsn::client::option::OutputBatchFramesLimit<MQTTSN_CLIENT_OUTPUT_BATCH_FRAMES_LIMIT> OutputBatchFramesLimitOption;
+#else
+typedef std::tuple<> OutputBatchFramesLimitOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_MAX_PENDING_INBOUND_QOS2
+typedef mqttsn::client::option::MaxPendingInboundQos2<MQTTSN_CLIENT_MAX_PENDING_INBOUND_QOS2> MaxPendingInboundQos2Option;
+#else
+typedef std::tuple<> MaxPendingInboundQos2Option;
+#endif
+
+#ifdef MQTTSN_CLIENT_PREDEFINED_TOPICS_HEADER
+// The header is expected to define MqttsnClientPredefinedTopics catalogue type
+#include MQTTSN_CLIENT_PREDEFINED_TOPICS_HEADER
+typedef mqttsn::client::option::PredefinedTopics<MqttsnClientPredefinedTopics> PredefinedTopicsOption;
+#else
+typedef std::tuple<> PredefinedTopicsOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_OUTBOUND_QUEUE_LIMIT
+typedef mqttsn::client::option::OutboundQueueLimit<MQTTSN_CLIENT_OUTBOUND_QUEUE_LIMIT> OutboundQueueLimitOption;
+#else
+typedef std::tuple<> OutboundQueueLimitOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_OUTBOUND_QUEUE_DATA_SIZE
+typedef mqttsn::client::option::OutboundQueueDataSize<MQTTSN_CLIENT_OUTBOUND_QUEUE_DATA_SIZE> OutboundQueueDataSizeOption;
+#else
+typedef std::tuple<> OutboundQueueDataSizeOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_OUTBOUND_JOURNAL
+typedef mqttsn::client::option::OutboundJournal OutboundJournalOption;
+#else
+typedef std::tuple<> OutboundJournalOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_STATS
+typedef mqttsn::client::option::Stats StatsOption;
+#else
+typedef std::tuple<> StatsOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_TRACE_RING_SIZE
+typedef mqttsn::client::option::TraceRingSize<MQTTSN_CLIENT_TRACE_RING_SIZE> TraceRingSizeOption;
+#else
+typedef std::tuple<> TraceRingSizeOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_PUBLISH_STREAM
+typedef mqttsn::client::option::PublishStream PublishStreamOption;
+#else
+typedef std::tuple<> PublishStreamOption;
+#endif
+
+#ifdef MQTTSN_CLIENT_OUTPUT_BUFFER_PROVIDER
+typedef mqttsn::client::option::OutputBufferProvider OutputBufferProviderOption;
+#else
+typedef std::tuple<> OutputBufferProviderOption;
+#endif
+
 typedef std::tuple<
-    
+    MaxInflightPublishesOption,
+    OutputBatchFramesLimitOption,
+    MaxPendingInboundQos2Option,
+    PredefinedTopicsOption,
+    OutboundQueueLimitOption,
+    OutboundQueueDataSizeOption,
+    OutboundJournalOption,
+    StatsOption,
+    TraceRingSizeOption,
+    PublishStreamOption,
+    OutputBufferProviderOption
 > ClientOptions;
 
 typedef mqttsn::client::ParsedOptions<ClientOptions> ParsedClientOptions;
@@ -79,6 +157,34 @@ void mqttsn_client_set_send_output_data_callback(
     clientObj->setSendOutputDataCallback(fn, data);
 }
 
+void mqttsn_client_set_send_output_batch_callback(
+    MqttsnClientHandle client,
+    MqttsnSendOutputBatchFn fn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setSendOutputBatchCallback(fn, data);
+}
+
+void mqttsn_client_set_send_output_vec_callback(
+    MqttsnClientHandle client,
+    MqttsnSendOutputVecFn fn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setSendOutputVecCallback(fn, data);
+}
+
+void mqttsn_client_set_output_buffer_provider(
+    MqttsnClientHandle client,
+    MqttsnAllocOutputBufFn allocFn,
+    MqttsnCommitOutputBufFn commitFn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setOutputBufferProvider(allocFn, commitFn, data);
+}
+
 void mqttsn_client_set_gw_status_report_callback(
     MqttsnClientHandle client,
     MqttsnGwStatusReportFn fn,
@@ -106,6 +212,58 @@ void mqttsn_client_set_message_report_callback(
     clientObj->setMessageReportCallback(fn, data);
 }
 
+void mqttsn_client_set_buffer_release_callback(
+    MqttsnClientHandle client,
+    MqttsnBufferReleaseFn fn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setBufferReleaseCallback(fn, data);
+}
+
+void mqttsn_client_set_outbound_queue_policy(
+    MqttsnClientHandle client,
+    MqttsnOutboundQueuePolicy policy)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setOutboundQueuePolicy(policy);
+}
+
+void mqttsn_client_set_outbound_queue_report_callback(
+    MqttsnClientHandle client,
+    unsigned highWaterMark,
+    MqttsnOutboundQueueReportFn fn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setOutboundQueueReportCallback(highWaterMark, fn, data);
+}
+
+unsigned mqttsn_client_get_outbound_queue_count(MqttsnClientHandle client)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return static_cast<unsigned>(clientObj->outboundQueueCount());
+}
+
+MqttsnErrorCode mqttsn_client_set_journal(
+    MqttsnClientHandle client,
+    const MqttsnJournalStore* store,
+    MqttsnAsyncOpCompleteReportFn replayCallback,
+    void* replayData)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->setJournal(store, replayCallback, replayData);
+}
+
+void mqttsn_client_set_journal_drop_report_callback(
+    MqttsnClientHandle client,
+    MqttsnJournalDropReportFn fn,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setJournalDropReportCallback(fn, data);
+}
+
 MqttsnErrorCode mqttsn_client_start(MqttsnClientHandle client)
 {
     auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
@@ -127,6 +285,24 @@ unsigned mqttsn_client_process_data(
     return clientObj->processData(from, len);
 }
 
+unsigned mqttsn_client_process_datagrams(
+    MqttsnClientHandle client,
+    const MqttsnDatagram* datagrams,
+    unsigned count)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return static_cast<unsigned>(clientObj->processDatagrams(datagrams, count));
+}
+
+unsigned mqttsn_client_process_loaned_data(
+    void* client,
+    const unsigned char* from,
+    unsigned len)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->processLoanedData(from, len);
+}
+
 void mqttsn_client_tick(void* client)
 {
     auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
@@ -139,6 +315,50 @@ void mqttsn_client_set_retry_period(MqttsnClientHandle client, unsigned value)
     clientObj->setRetryPeriod(value);
 }
 
+void mqttsn_client_set_retransmit_timeout_bounds(MqttsnClientHandle client, unsigned minMs, unsigned maxMs)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setRetransmitTimeoutBounds(minMs, maxMs);
+}
+
+unsigned mqttsn_client_get_retransmit_timeout(MqttsnClientHandle client)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->retransmitTimeout();
+}
+
+void mqttsn_client_set_congestion_backoff(MqttsnClientHandle client, unsigned baseMs, unsigned maxMs)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setCongestionBackoff(baseMs, maxMs);
+}
+
+bool mqttsn_client_get_stats(MqttsnClientHandle client, MqttsnClientStats* stats)
+{
+    if (stats == nullptr) {
+        return false;
+    }
+
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->getStats(*stats);
+}
+
+void mqttsn_client_set_trace_clock(MqttsnClientHandle client, MqttsnTraceClockFn fn, void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->setTraceClock(fn, data);
+}
+
+unsigned mqttsn_client_get_trace(MqttsnClientHandle client, MqttsnTraceEntry* buf, unsigned count)
+{
+    if (buf == nullptr) {
+        return 0U;
+    }
+
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return static_cast<unsigned>(clientObj->getTrace(buf, count));
+}
+
 void mqttsn_client_set_retry_count(MqttsnClientHandle client, unsigned value)
 {
     auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
@@ -237,6 +457,36 @@ MqttsnErrorCode mqttsn_client_publish_id(
     return clientObj->publish(topicId, msg, msgLen, qos, retain, callback, data);
 }    
 
+MqttsnErrorCode mqttsn_client_publish_begin(
+    MqttsnClientHandle client,
+    MqttsnTopicId topicId,
+    MqttsnQoS qos,
+    bool retain)
+{
+    return reinterpret_cast<MqttsnClient*>(client)->publishBegin(topicId, qos, retain);
+}
+
+unsigned mqttsn_client_publish_write(
+    MqttsnClientHandle client,
+    const unsigned char* buf,
+    unsigned bufLen)
+{
+    return static_cast<unsigned>(reinterpret_cast<MqttsnClient*>(client)->publishWrite(buf, bufLen));
+}
+
+MqttsnErrorCode mqttsn_client_publish_end(
+    MqttsnClientHandle client,
+    MqttsnAsyncOpCompleteReportFn callback,
+    void* data)
+{
+    return reinterpret_cast<MqttsnClient*>(client)->publishEnd(callback, data);
+}
+
+void mqttsn_client_publish_abort(MqttsnClientHandle client)
+{
+    reinterpret_cast<MqttsnClient*>(client)->publishAbort();
+}
+
 MqttsnErrorCode mqttsn_client_publish(
     MqttsnClientHandle client,
     const char* topic,
@@ -251,6 +501,32 @@ MqttsnErrorCode mqttsn_client_publish(
     return clientObj->publish(topic, msg, msgLen, qos, retain, callback, data);
 }    
 
+MqttsnTopicHandle mqttsn_client_resolve_topic(MqttsnClientHandle client, const char* topic)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->resolveTopic(topic);
+}
+
+void mqttsn_client_release_topic(MqttsnClientHandle client, MqttsnTopicHandle handle)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    clientObj->releaseTopic(handle);
+}
+
+MqttsnErrorCode mqttsn_client_publish_handle(
+    MqttsnClientHandle client,
+    MqttsnTopicHandle handle,
+    const unsigned char* msg,
+    unsigned msgLen,
+    MqttsnQoS qos,
+    bool retain,
+    MqttsnAsyncOpCompleteReportFn callback,
+    void* data)
+{
+    auto* clientObj = reinterpret_cast<MqttsnClient*>(client);
+    return clientObj->publishHandle(handle, msg, msgLen, qos, retain, callback, data);
+}
+
 MqttsnErrorCode mqttsn_client_subscribe_id(
     MqttsnClientHandle client,
     MqttsnTopicId topicId,
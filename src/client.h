@@ -81,6 +81,65 @@ void mqttsn_client_set_send_output_data_callback(
     MqttsnClientHandle client,
     MqttsnSendOutputDataFn fn,
     void* data);
+
+/// @brief Set callback to send multiple frames over I/O link at once.
+/// @details When set, takes precedence over the callback set by
+///     mqttsn_client_set_send_output_data_callback(). The messages
+///     produced during a single call to the library are accumulated and
+///     reported together when the call returns, allowing usage of
+///     vectored send operations (like @b sendmmsg() on Linux) or packing
+///     multiple frames into a single radio transmission.
+///     The accumulated frames are also flushed early when the maximal number
+///     of frames (@b MQTTSN_CLIENT_OUTPUT_BATCH_FRAMES_LIMIT, see
+///     @ref mqttsn::client::option::OutputBatchFramesLimit) is reached.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] fn Callback function, NULL to disable batching.
+/// @param[in] data Pointer to any user data structure. It will passed as one 
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_send_output_batch_callback(
+    MqttsnClientHandle client,
+    MqttsnSendOutputBatchFn fn,
+    void* data);
+
+/// @brief Set callback to send frames composed of several parts.
+/// @details When set, takes precedence over the callback set by
+///     mqttsn_client_set_send_output_data_callback(), but not over the
+///     batch one. The PUBLISH messages are reported as two parts: the
+///     serialised header and the message data provided by the application,
+///     which is not copied into the internal buffer of the library.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] fn Callback function, NULL to disable.
+/// @param[in] data Pointer to any user data structure. It will passed as one 
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_send_output_vec_callback(
+    MqttsnClientHandle client,
+    MqttsnSendOutputVecFn fn,
+    void* data);
+
+/// @brief Set callbacks providing the transport buffers to serialise the
+///     frames into.
+/// @details When set, takes precedence over the callbacks set by
+///     mqttsn_client_set_send_output_data_callback() and
+///     mqttsn_client_set_send_output_vec_callback(), but not over the
+///     batch one. Every frame is written by the library straight into the
+///     buffer returned by @b allocFn (lwIP pbuf, registered buffer, radio
+///     FIFO, etc.) and passed to @b commitFn to be sent, without the
+///     intermediate copy. When the library is compiled with
+///     @b MQTTSN_CLIENT_OUTPUT_BUFFER_PROVIDER, there is no internal write
+///     buffer at all: the provider must be set prior to
+///     mqttsn_client_start() and the callbacks set by
+///     mqttsn_client_set_send_output_data_callback() and
+///     mqttsn_client_set_send_output_vec_callback() are ignored.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] allocFn Buffer allocation callback, NULL to disable.
+/// @param[in] commitFn Callback to send the serialised frame, NULL to disable.
+/// @param[in] data Pointer to any user data structure. It will passed as one 
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_output_buffer_provider(
+    MqttsnClientHandle client,
+    MqttsnAllocOutputBufFn allocFn,
+    MqttsnCommitOutputBufFn commitFn,
+    void* data);
     
 /// @brief Set callback to report status of the gateway.
 /// @details The callback is invoked when gateway status has changed.
@@ -114,7 +173,85 @@ void mqttsn_client_set_message_report_callback(
     MqttsnClientHandle client,
     MqttsnMessageReportFn fn,
     void* data);
+
+/// @brief Set callback to return buffers loaned to the library.
+/// @details Required for mqttsn_client_process_loaned_data() to keep the
+///     loaned buffers instead of copying their contents.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] fn Callback function.
+/// @param[in] data Pointer to any user data structure. It will passed as one 
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_buffer_release_callback(
+    MqttsnClientHandle client,
+    MqttsnBufferReleaseFn fn,
+    void* data);
     
+/// @brief Set policy applied when the outbound queue is full.
+/// @details The outbound queue is available when the library is compiled
+///     with @b MQTTSN_CLIENT_OUTBOUND_QUEUE_LIMIT defined. The default
+///     policy is @ref MqttsnOutboundQueuePolicy_DropOldest.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] policy Drop policy.
+void mqttsn_client_set_outbound_queue_policy(
+    MqttsnClientHandle client,
+    MqttsnOutboundQueuePolicy policy);
+
+/// @brief Set callback to report the outbound queue usage.
+/// @details The callback is invoked when the number of queued messages
+///     reaches the provided high water mark as well as when a message
+///     is dropped due to the queue being full.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] highWaterMark Number of queued messages to report.
+/// @param[in] fn Callback function.
+/// @param[in] data Pointer to any user data structure. It will passed as one
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_outbound_queue_report_callback(
+    MqttsnClientHandle client,
+    unsigned highWaterMark,
+    MqttsnOutboundQueueReportFn fn,
+    void* data);
+
+/// @brief Get number of the messages in the outbound queue.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+unsigned mqttsn_client_get_outbound_queue_count(MqttsnClientHandle client);
+
+/// @brief Set persistent storage of the outbound publishes journal.
+/// @details The journal is available when the library is compiled
+///     with @b MQTTSN_CLIENT_OUTBOUND_JOURNAL defined. Every QoS1/QoS2
+///     publish is recorded when sent for the first time and marked
+///     when its delivery is complete (or reported as failed). The records
+///     not marked this way (due to reboot) are published again with
+///     the same message ID and DUP flag set once the client connects
+///     after mqttsn_client_start(). The writes are committed to the
+///     storage once per invocation of the library's API function.
+///     Must be called before mqttsn_client_start().
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] store Storage description, copied by the library. NULL disables the journal.
+/// @param[in] replayCallback Callback reporting completion of every republished message. May be NULL.
+/// @param[in] replayData Pointer to any user data structure. It will passed as one
+///     of the parameters in callback invocation. May be NULL.
+/// @return Error code indicating success/failure status of the operation.
+///     @ref MqttsnErrorCode_BadParam is returned when the storage geometry is
+///     invalid or the journal is not compiled in.
+MqttsnErrorCode mqttsn_client_set_journal(
+    MqttsnClientHandle client,
+    const MqttsnJournalStore* store,
+    MqttsnAsyncOpCompleteReportFn replayCallback,
+    void* replayData);
+
+/// @brief Set callback reporting the publishes which could not be kept
+///     in the outbound journal.
+/// @details Such publishes are still delivered, but are not going to be
+///     resent after reboot. Ignored when the journal is not compiled in.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] fn Callback function, NULL to disable.
+/// @param[in] data Pointer to any user data structure. It will passed as one
+///     of the parameters in callback invocation. May be NULL.
+void mqttsn_client_set_journal_drop_report_callback(
+    MqttsnClientHandle client,
+    MqttsnJournalDropReportFn fn,
+    void* data);
+
 /// @brief Start the library's operation.
 /// @details The function will check whether all necessary callback functions
 ///     were set. In not @ref MqttsnErrorCode_BadParam will be returned.
@@ -145,6 +282,39 @@ MqttsnErrorCode mqttsn_client_stop(MqttsnClientHandle client);
 ///     can be removed from the holding buffer.
 unsigned mqttsn_client_process_data(MqttsnClientHandle client, const unsigned char* buf, unsigned bufLen);
 
+/// @brief Provide multiple datagrams, received over I/O link, to the library
+///     for processing.
+/// @details Equivalent to calling mqttsn_client_process_data() for every
+///     datagram in the list, but the pending time measurement is cancelled
+///     and reprogrammed only once for the whole batch. Useful when
+///     draining the socket with multiple datagrams at once (like
+///     @b recvmmsg() on Linux). Every datagram is expected to contain
+///     complete messages, the unprocessed remainder of the datagram is
+///     discarded.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] datagrams Pointer to the list of datagrams.
+/// @param[in] count Number of datagrams in the list.
+/// @return Number of processed datagrams. May be less than @b count if the
+///     library's operation has been stopped in the middle of processing.
+unsigned mqttsn_client_process_datagrams(MqttsnClientHandle client, const MqttsnDatagram* datagrams, unsigned count);
+
+/// @brief Loan the buffer of received data to the library for processing.
+/// @details Same as mqttsn_client_process_data(), but the ownership of the
+///     buffer is passed to the library. The payload of the incoming
+///     exactly-once (QoS2) message is not copied, the library keeps referencing
+///     it in the buffer until the message is reported upon reception of
+///     @b PUBREL. The buffer is returned via the callback set by
+///     mqttsn_client_set_buffer_release_callback(), and must not be modified
+///     or freed until then. If the callback is not set, the function behaves
+///     exactly as mqttsn_client_process_data().
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] buf Pointer to the loaned buffer of data to process.
+/// @param[in] bufLen Number of bytes in the data buffer.
+/// @return Number of processed bytes.
+/// @note At most one loaned buffer is held by the library at a time, it is
+///     also released when the operation is stopped using mqttsn_client_stop().
+unsigned mqttsn_client_process_loaned_data(MqttsnClientHandle client, const unsigned char* buf, unsigned bufLen);
+
 /// @brief Notify client about requested time expiry.
 /// @details The reported amount of milliseconds needs to be from the 
 ///     last request to program timer via callback (set by
@@ -163,11 +333,72 @@ void mqttsn_client_tick(MqttsnClientHandle client);
 /// @details Some messages, sent to the gateway, may require acknowledgement by 
 ///     the latter. The delay (in seconds) between such attempts to resend the
 ///     message may be specified using this function. The default value is
-///     @b 15 seconds.
+///     @b 15 seconds. It is the initial retransmission timeout, used until
+///     the round trip time to the gateway is measured. After that the timeout
+///     is calculated from the smoothed round trip time and its variance
+///     (see RFC 6298) and doubled on every expiry, within the bounds set by
+///     mqttsn_client_set_retransmit_timeout_bounds().
 /// @param[in] client Handle returned by mqttsn_client_new() function.
 /// @param[in] value Number of @b seconds to wait before making an attempt to resend.
 void mqttsn_client_set_retry_period(MqttsnClientHandle client, unsigned value);
 
+/// @brief Set bounds of the retransmission timeout.
+/// @details The measurements of the round trip time are taken only from the
+///     messages that were not resent. They are reset when the library is
+///     started and when the gateway is reported disconnected. The default
+///     bounds are @b 200 milliseconds and @b 60 seconds.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] minMs Minimal timeout in @b milliseconds.
+/// @param[in] maxMs Maximal timeout in @b milliseconds.
+void mqttsn_client_set_retransmit_timeout_bounds(MqttsnClientHandle client, unsigned minMs, unsigned maxMs);
+
+/// @brief Get current retransmission timeout in @b milliseconds.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+unsigned mqttsn_client_get_retransmit_timeout(MqttsnClientHandle client);
+
+/// @brief Set hold off after the gateway reports congestion.
+/// @details When the gateway rejects a request with the @b congestion return code,
+///     the client stops sending new publishes, registrations and subscriptions
+///     for a random duration between half and full value of the current delay,
+///     then retries the rejected request. The delay starts at @b baseMs and doubles
+///     with every consecutive congestion report up to @b maxMs. The number of the
+///     publishes awaiting acknowledgement at the same time is halved as well and
+///     grows back as the gateway acknowledges them. The default values are
+///     @b 1 and @b 60 seconds.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] baseMs Initial hold off delay in @b milliseconds.
+/// @param[in] maxMs Maximal hold off delay in @b milliseconds.
+void mqttsn_client_set_congestion_backoff(MqttsnClientHandle client, unsigned baseMs, unsigned maxMs);
+
+/// @brief Retrieve statistics of the client.
+/// @details The statistics are collected only when the library is compiled
+///     with @b MQTTSN_CLIENT_STATS defined.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[out] stats Statistics, zeroed when not collected.
+/// @return true in case statistics are collected, false otherwise.
+bool mqttsn_client_get_stats(MqttsnClientHandle client, MqttsnClientStats* stats);
+
+/// @brief Set callback reading high resolution counter stored in trace entries.
+/// @details Relevant only when the library is compiled with
+///     @b MQTTSN_CLIENT_TRACE_RING_SIZE defined. The callback is invoked for
+///     every recorded entry, it is expected to be very cheap (like reading
+///     CPU cycle counter register).
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] fn Callback, may be NULL.
+/// @param[in] data User data passed as the parameter to the callback.
+void mqttsn_client_set_trace_clock(MqttsnClientHandle client, MqttsnTraceClockFn fn, void* data);
+
+/// @brief Retrieve the latest trace entries.
+/// @details The entries are recorded only when the library is compiled with
+///     @b MQTTSN_CLIENT_TRACE_RING_SIZE defined. The retrieved entries may be
+///     stored in a binary file and converted to Chrome trace format with
+///     @b tools/linux/trace2json.cpp utility.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[out] buf Buffer to copy the entries to, the oldest one first.
+/// @param[in] count Maximal number of entries to copy.
+/// @return Number of copied entries.
+unsigned mqttsn_client_get_trace(MqttsnClientHandle client, MqttsnTraceEntry* buf, unsigned count);
+
 /// @brief Set number of retry attempts to perform before reporting unsuccessful result of the operation.
 /// @details Some messages, sent to the gateway, may require acknowledgement by 
 ///     the latter. The amount of retry attempts before reporting unsuccessful result
@@ -230,7 +461,8 @@ void mqttsn_client_discard_all_gw(MqttsnClientHandle client);
 ///     This function provides an ability to cancel existing operation to allow
 ///     issue of the new request. When successfully cancelled the callback of 
 ///     the asyncrhonous operation will report @ref MqttsnAsyncOpStatus_Aborted
-///     as operation result status. 
+///     as operation result status. All the publish operations that are
+///     still in flight (see mqttsn_client_publish()) are cancelled as well.
 /// @param[in] client Handle returned by mqttsn_client_new() function.
 /// @return true in case an asynchronous operation was cancelled,
 ///     false otherwise.
@@ -312,7 +544,8 @@ MqttsnErrorCode mqttsn_client_disconnect(
 /// @details When publish operation is complete, the provided callback
 ///     will be invoked. Note, that
 ///     the callback will be invoked immediately for publish operation with
-///     QoS=-1 or QoS=0.
+///     QoS=-1 or QoS=0. Publish operations with QoS=1 or QoS=2 occupy an
+///     in flight slot the same way as described for mqttsn_client_publish().
 ///
 ///     @b IMPORTANT : The buffer containing message data must be preserved
 ///     intact until the end of the operation (provided callback is invoked).
@@ -340,12 +573,78 @@ MqttsnErrorCode mqttsn_client_publish_id(
     void* data
 );
 
+/// @brief Start streaming publish with predefined topic ID.
+/// @details Available only when the library is compiled with
+///     @b MQTTSN_CLIENT_PUBLISH_STREAM. The payload is then appended with
+///     mqttsn_client_publish_write() straight into the frame buffer, after
+///     the reserved space for the header, and sent with
+///     mqttsn_client_publish_end(), so large payloads don't need to be
+///     assembled by the application first. Only one stream may be open
+///     and it is held until the publish is complete.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] topicId Predefined topic ID.
+/// @param[in] qos Quality of service level.
+/// @param[in] retain Retain flag.
+/// @return Error code indicating success/failure status of the operation,
+///     @ref MqttsnErrorCode_Busy when previous stream is still in use,
+///     @ref MqttsnErrorCode_BadParam when the stream is not supported.
+MqttsnErrorCode mqttsn_client_publish_begin(
+    MqttsnClientHandle client,
+    MqttsnTopicId topicId,
+    MqttsnQoS qos,
+    bool retain);
+
+/// @brief Append payload data to the publish started with
+///     mqttsn_client_publish_begin().
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] buf Pointer to buffer containing payload chunk.
+/// @param[in] bufLen Number of bytes in the buffer.
+/// @return Number of appended bytes, less than @b bufLen when the frame
+///     buffer is full.
+unsigned mqttsn_client_publish_write(
+    MqttsnClientHandle client,
+    const unsigned char* buf,
+    unsigned bufLen);
+
+/// @brief Send the streamed publish.
+/// @details Behaves like mqttsn_client_publish_id() with the streamed payload.
+///     When @ref MqttsnErrorCode_Busy is returned, the stream stays open and
+///     the call may be repeated later.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] callback Callback to be invoked when operation is complete,
+///     can be NULL for QoS=-1 or QoS=0.
+/// @param[in] data Pointer to any user data, it will be passed as the first
+///     parameter to the invoked completion report callback, can be NULL.
+/// @return Error code indicating success/failure status of the operation.
+MqttsnErrorCode mqttsn_client_publish_end(
+    MqttsnClientHandle client,
+    MqttsnAsyncOpCompleteReportFn callback,
+    void* data);
+
+/// @brief Discard the streamed publish which hasn't been sent yet.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+void mqttsn_client_publish_abort(MqttsnClientHandle client);
+
 /// @brief Publish message with topic string.
 /// @details When publish operation is complete, the provided callback
 ///     will be invoked. Note, that
 ///     the callback MAY be invoked immediately for publish operation with
 ///     QoS=0 if requested topic is already registered.
 ///
+///     By default only one publish operation may be in progress. When the
+///     library is compiled with @b MQTTSN_CLIENT_MAX_INFLIGHT_PUBLISHES
+///     defined to a value greater than 1, up to that number of publish
+///     operations may await their acknowledgement at the same time. Other
+///     (non publish) operations still require all the in flight publishes
+///     to complete first.
+///
+///     When the library is compiled with @b MQTTSN_CLIENT_OUTBOUND_QUEUE_LIMIT
+///     defined, the publish requests issued while the client is not
+///     connected, asleep or busy are not rejected. The topic and data are
+///     copied into the outbound queue and published once the client
+///     is connected and idle again. Queued messages dropped due to the queue
+///     being full report @ref MqttsnAsyncOpStatus_Aborted.
+///
 ///     @b IMPORTANT : The buffer containing message data must be preserved
 ///     intact until the end of the operation (provided callback is invoked).
 /// @param[in] client Handle returned by mqttsn_client_new() function.
@@ -370,6 +669,62 @@ MqttsnErrorCode mqttsn_client_publish(
     void* data
 );
 
+/// @brief Resolve topic string into a handle for repeated publishes.
+/// @details The registration information of the topic is pinned, i.e. it
+///     is not evicted from the registry when other topics get registered.
+///     Resolving the same topic again returns the same handle and adds
+///     one more pin, every call must be balanced by its own
+///     mqttsn_client_release_topic().
+///     The registration with the gateway is performed on the first
+///     publish using the handle (see mqttsn_client_publish_handle()). If the
+///     gateway rejects the topic ID later on, the topic is transparently
+///     registered again on the next publish.
+///     Predefined and short topic names get their handle without using
+///     the registry.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] topic Topic string.
+/// @return Handle of the topic, @ref MQTTSN_INVALID_TOPIC_HANDLE in case
+///     the client is not started or there is no space to pin the topic.
+MqttsnTopicHandle mqttsn_client_resolve_topic(MqttsnClientHandle client, const char* topic);
+
+/// @brief Release the topic handle returned by mqttsn_client_resolve_topic().
+/// @details Removes the pin added by one mqttsn_client_resolve_topic() call.
+///     When the last pin is removed, the registration information may be
+///     evicted, and the handle must not be used any more.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] handle Topic handle.
+void mqttsn_client_release_topic(MqttsnClientHandle client, MqttsnTopicHandle handle);
+
+/// @brief Publish message with topic handle.
+/// @details Similar to mqttsn_client_publish(), but avoids the topic string
+///     lookup and comparison on every call. Stale (released and evicted)
+///     handle is reported as @ref MqttsnAsyncOpStatus_InvalidId or
+///     rejected with @ref MqttsnErrorCode_BadParam.
+///
+///     @b IMPORTANT : The buffer containing message data must be preserved
+///     intact until the end of the operation (provided callback is invoked).
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @param[in] handle Topic handle returned by mqttsn_client_resolve_topic().
+/// @param[in] msg Pointer to buffer containing data to be published.
+/// @param[in] msgLen Size of the buffer containing data to be published.
+/// @param[in] qos Quality of service level.
+/// @param[in] retain Retain flag.
+/// @param[in] callback Callback to be invoked when operation is complete,
+///     must @b NOT be NULL.
+/// @param[in] data Pointer to any user data, it will be passed as the first
+///     parameter to the invoked completion report callback, can be NULL.
+/// @return Error code indicating success/failure status of the operation.
+MqttsnErrorCode mqttsn_client_publish_handle(
+    MqttsnClientHandle client,
+    MqttsnTopicHandle handle,
+    const unsigned char* msg,
+    unsigned msgLen,
+    MqttsnQoS qos,
+    bool retain,
+    MqttsnAsyncOpCompleteReportFn callback,
+    void* data
+);
+
 /// @brief Subscribe to topic having predefined topic ID.
 /// @details When subscribe operation is complete, the provided callback
 ///     will be invoked. 
@@ -0,0 +1,377 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief C++20 coroutine interface of the client.
+/// @details Every asynchronous operation of the client can be awaited
+///     with @b co_await, for example
+///     @code
+///     auto result = co_await client.publish("a/b", buf, len, MqttsnQoS_AtLeastOnceDelivery, false);
+///     @endcode
+///     The awaiter is a temporary object living in the coroutine frame and
+///     its address is the callback data passed to the client, so there is
+///     no allocation per await. The awaiting coroutine is resumed by the
+///     executor when the client reports the completion.
+///     Available only when the compiler supports coroutines, ignored otherwise.
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <coroutine>
+#include <type_traits>
+
+#include "client.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Result of awaited operation.
+struct AsyncOpResult
+{
+    /// @brief Error code returned when the operation was issued,
+    ///     @ref status is valid only if it is @ref MqttsnErrorCode_Success.
+    MqttsnErrorCode ec = MqttsnErrorCode_Success;
+    MqttsnAsyncOpStatus status = MqttsnAsyncOpStatus_Invalid;
+    /// @brief Granted QoS, subscribe only.
+    MqttsnQoS qos = MqttsnQoS_AtMostOnceDelivery;
+
+    bool successful() const
+    {
+        return (ec == MqttsnErrorCode_Success) && (status == MqttsnAsyncOpStatus_Successful);
+    }
+};
+
+/// @brief Node of the completed operation awaiting resumption.
+/// @details Embedded in every awaiter, the executors may link them
+///     into intrusive lists.
+struct AwaitNode
+{
+    std::coroutine_handle<> m_handle;
+    AwaitNode* m_next = nullptr;
+};
+
+/// @brief Executor resuming the coroutine directly from the completion
+///     callback of the client.
+/// @details The client has already finished with the completed operation,
+///     so the resumed coroutine may issue the next one right away.
+struct InlineExecutor
+{
+    void schedule(AwaitNode& node)
+    {
+        node.m_handle.resume();
+    }
+};
+
+/// @brief Executor queueing the completed operations until runPending().
+/// @details Used to keep the coroutines off the call stack of the client,
+///     the host invokes runPending() after mqttsn_client_process_data()
+///     and mqttsn_client_tick().
+class QueuedExecutor
+{
+public:
+    void schedule(AwaitNode& node)
+    {
+        node.m_next = nullptr;
+        if (m_tail == nullptr) {
+            m_head = &node;
+        }
+        else {
+            m_tail->m_next = &node;
+        }
+        m_tail = &node;
+    }
+
+    /// @brief Resume all the queued coroutines in order of completion.
+    /// @return Number of resumed coroutines.
+    unsigned runPending()
+    {
+        unsigned count = 0U;
+        while (m_head != nullptr) {
+            auto* node = m_head;
+            m_head = node->m_next;
+            if (m_head == nullptr) {
+                m_tail = nullptr;
+            }
+
+            ++count;
+            node->m_handle.resume(); // may schedule more
+        }
+        return count;
+    }
+
+    bool empty() const
+    {
+        return m_head == nullptr;
+    }
+
+private:
+    AwaitNode* m_head = nullptr;
+    AwaitNode* m_tail = nullptr;
+};
+
+/// @brief Coroutine interface of the client.
+/// @details Doesn't own the client handle. Only one operation may be
+///     in progress (apart from the publishes configured to be in flight
+///     concurrently), issuing another returns @ref MqttsnErrorCode_Busy
+///     in the result without suspending.
+/// @tparam TExecutor Type of the executor, must provide
+///     @b schedule(AwaitNode&) member function.
+template <typename TExecutor = InlineExecutor>
+class CoroClient
+{
+public:
+    /// @brief Awaiter of single operation.
+    /// @details Issues the operation when the coroutine suspends on it.
+    template <typename TIssue>
+    class Awaiter : private AwaitNode
+    {
+    public:
+        Awaiter(TExecutor& executor, TIssue&& issue)
+          : m_executor(executor),
+            m_issue(static_cast<TIssue&&>(issue))
+        {
+        }
+
+        Awaiter(const Awaiter&) = delete;
+        Awaiter& operator=(const Awaiter&) = delete;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            m_handle = handle;
+            m_result.ec = m_issue(this);
+            if (m_result.ec != MqttsnErrorCode_Success) {
+                return false;
+            }
+
+            // Completion may be reported before returning (QoS0 publish)
+            m_suspended = !m_completed;
+            return m_suspended;
+        }
+
+        AsyncOpResult await_resume() const noexcept
+        {
+            return m_result;
+        }
+
+        static void asyncOpComplete(void* data, MqttsnAsyncOpStatus status)
+        {
+            reinterpret_cast<Awaiter*>(data)->complete(status, MqttsnQoS_AtMostOnceDelivery);
+        }
+
+        static void subscribeComplete(void* data, MqttsnAsyncOpStatus status, MqttsnQoS qos)
+        {
+            reinterpret_cast<Awaiter*>(data)->complete(status, qos);
+        }
+
+    private:
+        void complete(MqttsnAsyncOpStatus status, MqttsnQoS qos)
+        {
+            m_result.status = status;
+            m_result.qos = qos;
+            m_completed = true;
+            if (m_suspended) {
+                m_executor.schedule(*this);
+            }
+        }
+
+        TExecutor& m_executor;
+        TIssue m_issue;
+        AsyncOpResult m_result;
+        bool m_suspended = false;
+        bool m_completed = false;
+    };
+
+    CoroClient(MqttsnClientHandle client, TExecutor& executor)
+      : m_client(client),
+        m_executor(executor)
+    {
+    }
+
+    MqttsnClientHandle handle() const
+    {
+        return m_client;
+    }
+
+    auto connect(
+        const char* clientId,
+        unsigned short keepAliveSeconds,
+        bool cleanSession,
+        const MqttsnWillInfo* willInfo = nullptr)
+    {
+        return makeAwaiter(
+            [client = m_client, clientId, keepAliveSeconds, cleanSession, willInfo](auto* awaiter)
+            {
+                return mqttsn_client_connect(
+                    client, clientId, keepAliveSeconds, cleanSession, willInfo,
+                    &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto reconnect()
+    {
+        return makeAwaiter(
+            [client = m_client](auto* awaiter)
+            {
+                return mqttsn_client_reconnect(
+                    client, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto disconnect()
+    {
+        return makeAwaiter(
+            [client = m_client](auto* awaiter)
+            {
+                return mqttsn_client_disconnect(
+                    client, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    /// @brief Publish message.
+    /// @details The message buffer must stay valid until the result
+    ///     is available, unless the outbound queue is configured.
+    auto publish(
+        const char* topic,
+        const unsigned char* msg,
+        unsigned msgLen,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        return makeAwaiter(
+            [client = m_client, topic, msg, msgLen, qos, retain](auto* awaiter)
+            {
+                return mqttsn_client_publish(
+                    client, topic, msg, msgLen, qos, retain,
+                    &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto publishId(
+        MqttsnTopicId topicId,
+        const unsigned char* msg,
+        unsigned msgLen,
+        MqttsnQoS qos,
+        bool retain)
+    {
+        return makeAwaiter(
+            [client = m_client, topicId, msg, msgLen, qos, retain](auto* awaiter)
+            {
+                return mqttsn_client_publish_id(
+                    client, topicId, msg, msgLen, qos, retain,
+                    &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto subscribe(const char* topic, MqttsnQoS qos)
+    {
+        return makeAwaiter(
+            [client = m_client, topic, qos](auto* awaiter)
+            {
+                return mqttsn_client_subscribe(
+                    client, topic, qos,
+                    &std::remove_pointer_t<decltype(awaiter)>::subscribeComplete, awaiter);
+            });
+    }
+
+    auto subscribeId(MqttsnTopicId topicId, MqttsnQoS qos)
+    {
+        return makeAwaiter(
+            [client = m_client, topicId, qos](auto* awaiter)
+            {
+                return mqttsn_client_subscribe_id(
+                    client, topicId, qos,
+                    &std::remove_pointer_t<decltype(awaiter)>::subscribeComplete, awaiter);
+            });
+    }
+
+    auto unsubscribe(const char* topic)
+    {
+        return makeAwaiter(
+            [client = m_client, topic](auto* awaiter)
+            {
+                return mqttsn_client_unsubscribe(
+                    client, topic, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto unsubscribeId(MqttsnTopicId topicId)
+    {
+        return makeAwaiter(
+            [client = m_client, topicId](auto* awaiter)
+            {
+                return mqttsn_client_unsubscribe_id(
+                    client, topicId, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto willUpdate(const MqttsnWillInfo* willInfo)
+    {
+        return makeAwaiter(
+            [client = m_client, willInfo](auto* awaiter)
+            {
+                return mqttsn_client_will_update(
+                    client, willInfo, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto sleep(unsigned short duration)
+    {
+        return makeAwaiter(
+            [client = m_client, duration](auto* awaiter)
+            {
+                return mqttsn_client_sleep(
+                    client, duration, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+    auto checkMessages()
+    {
+        return makeAwaiter(
+            [client = m_client](auto* awaiter)
+            {
+                return mqttsn_client_check_messages(
+                    client, &std::remove_pointer_t<decltype(awaiter)>::asyncOpComplete, awaiter);
+            });
+    }
+
+private:
+    template <typename TIssue>
+    Awaiter<TIssue> makeAwaiter(TIssue&& issue)
+    {
+        return Awaiter<TIssue>(m_executor, static_cast<TIssue&&>(issue));
+    }
+
+    MqttsnClientHandle m_client = nullptr;
+    TExecutor& m_executor;
+};
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if __has_include(<coroutine>)
+#endif // #if defined(__cpp_impl_coroutine) && defined(__has_include)
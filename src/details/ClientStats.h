@@ -0,0 +1,148 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "mqttsn/client/common.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Statistics when not configured, all the updates compile to nothing.
+class NoClientStats
+{
+public:
+    static const bool Enabled = false;
+
+    void msgSent(unsigned, std::size_t) {}
+    void msgReceived(unsigned, std::size_t) {}
+    void frameDropped() {}
+    void invalidTopicAck() {}
+    void pingTimeout() {}
+    void retransmit(MqttsnStatsOp) {}
+    void rtt(MqttsnStatsOp, unsigned) {}
+
+    bool get(MqttsnClientStats& stats) const
+    {
+        std::memset(&stats, 0, sizeof(stats));
+        return false;
+    }
+};
+
+class ClientStats
+{
+public:
+    static const bool Enabled = true;
+
+    ClientStats()
+    {
+        std::memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+    void msgSent(unsigned msgId, std::size_t len)
+    {
+        if (msgId < MQTTSN_STATS_MSG_TYPES_LIMIT) {
+            ++m_stats.msgsSent[msgId];
+        }
+
+        m_stats.bytesSent += len;
+    }
+
+    void msgReceived(unsigned msgId, std::size_t len)
+    {
+        if (msgId < MQTTSN_STATS_MSG_TYPES_LIMIT) {
+            ++m_stats.msgsReceived[msgId];
+        }
+
+        m_stats.bytesReceived += len;
+    }
+
+    void frameDropped()
+    {
+        ++m_stats.framesDropped;
+    }
+
+    void invalidTopicAck()
+    {
+        ++m_stats.invalidTopicAcks;
+    }
+
+    void pingTimeout()
+    {
+        ++m_stats.pingTimeouts;
+    }
+
+    void retransmit(MqttsnStatsOp op)
+    {
+        ++m_stats.retransmits[op];
+    }
+
+    void rtt(MqttsnStatsOp op, unsigned value)
+    {
+        unsigned bucket = 0U;
+        while ((value != 0U) && (bucket < (MQTTSN_STATS_RTT_BUCKETS - 1U))) {
+            value >>= 1U;
+            ++bucket;
+        }
+
+        ++m_stats.rtt[op][bucket];
+    }
+
+    bool get(MqttsnClientStats& stats) const
+    {
+        stats = m_stats;
+        return true;
+    }
+
+private:
+    MqttsnClientStats m_stats;
+};
+
+template <bool THasStats>
+struct ClientStatsType;
+
+template <>
+struct ClientStatsType<true>
+{
+    typedef ClientStats Type;
+};
+
+template <>
+struct ClientStatsType<false>
+{
+    typedef NoClientStats Type;
+};
+
+template <typename TOpts>
+using ClientStatsTypeT =
+    typename ClientStatsType<TOpts::HasStats>::Type;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
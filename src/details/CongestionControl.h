@@ -0,0 +1,143 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Reaction to the congestion reported by the gateway.
+/// @details Every congestion signal halves the window of the requests
+///     allowed to await their acknowledgement at the same time and
+///     returns the duration to hold off sending. The hold off duration
+///     grows exponentially with consecutive signals, the actual value
+///     is randomly chosen between half of it and its full value, so the
+///     clients rejected at the same time do not retry together. Every
+///     @b window acknowledged requests increase the window by one.
+class CongestionControl
+{
+public:
+    static const unsigned DefaultBaseDelay = 1000U;
+    static const unsigned DefaultMaxDelay = 60U * 1000U;
+
+    void reset(std::size_t maxWindow)
+    {
+        m_maxWindow = std::max(std::size_t(1U), maxWindow);
+        m_window = m_maxWindow;
+        m_acks = 0U;
+        m_level = 0U;
+    }
+
+    void setBackoff(unsigned baseDelay, unsigned maxDelay)
+    {
+        m_baseDelay = std::max(1U, baseDelay);
+        m_maxDelay = std::max(m_baseDelay, maxDelay);
+    }
+
+    /// @brief Mix the client ID (FNV-1a hash) and other value into random seed.
+    void seed(const char* clientId, std::uint32_t value)
+    {
+        std::uint32_t hash = 2166136261U;
+        while ((clientId != nullptr) && (*clientId != '\0')) {
+            hash = (hash ^ static_cast<std::uint8_t>(*clientId)) * 16777619U;
+            ++clientId;
+        }
+
+        m_rand ^= hash ^ value;
+        if (m_rand == 0U) {
+            m_rand = DefaultSeed;
+        }
+    }
+
+    /// @return Duration (ms) to hold off sending.
+    unsigned signal()
+    {
+        m_window = std::max(std::size_t(1U), m_window / 2U);
+        m_acks = 0U;
+
+        auto delay = m_baseDelay;
+        for (unsigned idx = 0U; (idx < m_level) && (delay < m_maxDelay); ++idx) {
+            delay = ((m_maxDelay / 2U) < delay) ? m_maxDelay : (delay * 2U);
+        }
+
+        if (m_level < MaxLevel) {
+            ++m_level;
+        }
+
+        auto half = delay / 2U;
+        return (delay - half) + (nextRandom() % (half + 1U));
+    }
+
+    void acknowledged()
+    {
+        m_level = 0U;
+        if (m_maxWindow <= m_window) {
+            return;
+        }
+
+        ++m_acks;
+        if (m_acks < m_window) {
+            return;
+        }
+
+        m_acks = 0U;
+        ++m_window;
+    }
+
+    std::size_t window() const
+    {
+        return m_window;
+    }
+
+private:
+    static const unsigned MaxLevel = 16U;
+    static const std::uint32_t DefaultSeed = 2463534242U;
+
+    // xorshift32
+    std::uint32_t nextRandom()
+    {
+        m_rand ^= m_rand << 13U;
+        m_rand ^= m_rand >> 17U;
+        m_rand ^= m_rand << 5U;
+        return m_rand;
+    }
+
+    std::size_t m_maxWindow = 1U;
+    std::size_t m_window = 1U;
+    std::size_t m_acks = 0U;
+    unsigned m_level = 0U;
+    unsigned m_baseDelay = DefaultBaseDelay;
+    unsigned m_maxDelay = DefaultMaxDelay;
+    std::uint32_t m_rand = DefaultSeed;
+};
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,67 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Long form of the length field (0x01 followed by 2 bytes) takes
+///     2 bytes more than the short one.
+static const std::size_t FrameLengthLongFormExtra = 2U;
+
+/// @brief Patch the length field of the frame written with the short
+///     length form after @ref FrameLengthLongFormExtra reserved bytes.
+/// @details Used when the frame is serialised before its final length is
+///     known (the payload is appended or sent separately). Switches to
+///     the long form, written into the reserved bytes, when the short
+///     one cannot hold the length.
+/// @param[in] buf Beginning of the reserved bytes.
+/// @param[in, out] len Frame length with the short length form, updated
+///     to the actual frame length.
+/// @return Offset of the frame start from @b buf.
+inline std::size_t patchFrameLength(std::uint8_t* buf, std::size_t& len)
+{
+    static const std::size_t ShortFormLimit = 0xffU;
+    if (len <= ShortFormLimit) {
+        buf[FrameLengthLongFormExtra] = static_cast<std::uint8_t>(len);
+        return FrameLengthLongFormExtra;
+    }
+
+    len += FrameLengthLongFormExtra;
+    buf[0] = 0x01;
+    buf[1] = static_cast<std::uint8_t>(len >> 8);
+    buf[2] = static_cast<std::uint8_t>(len);
+    return 0U;
+}
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,245 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "comms/comms.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+constexpr std::size_t inQos2BucketsCount(std::size_t limit, std::size_t result = 1U)
+{
+    return (limit <= result) ? result : inQos2BucketsCount(limit, result << 1U);
+}
+
+/// @brief Index of the slots of the inbound QoS2 messages.
+/// @details Looks up the slot by the exact message ID in O(1) using open
+///     addressing with linear probing (the table is at most half full).
+///     The slots that may be reused are kept in a list, the free ones
+///     first, followed by the ones already reported to the application,
+///     the oldest report first. The slots awaiting PUBREL are not in
+///     the list, so they are never taken over.
+template <std::size_t TLimit>
+class InQos2Index
+{
+    static_assert((0U < TLimit) && (TLimit < 0xffff), "Invalid number of slots");
+
+    typedef std::uint16_t Index;
+    static const Index NoIndex = static_cast<Index>(-1);
+    static const std::size_t BucketsCount = inQos2BucketsCount(TLimit * 2U);
+
+public:
+    static const std::size_t NoSlot = TLimit;
+
+    InQos2Index()
+    {
+        m_buckets.fill(NoIndex);
+        for (std::size_t slot = 0U; slot < TLimit; ++slot) {
+            pushBack(slot);
+        }
+    }
+
+    /// @return Slot holding the message ID, @ref NoSlot if there is none.
+    std::size_t find(std::uint16_t msgId) const
+    {
+        auto bucket = bucketIdx(msgId);
+        while (m_buckets[bucket] != NoIndex) {
+            auto slot = m_buckets[bucket];
+            if (m_msgIds[slot] == msgId) {
+                return slot;
+            }
+            bucket = nextBucketIdx(bucket);
+        }
+        return NoSlot;
+    }
+
+    /// @return Slot to be used for new message, @ref NoSlot if all of
+    ///     them await PUBREL.
+    std::size_t reusable() const
+    {
+        if (m_first == NoIndex) {
+            return NoSlot;
+        }
+        return m_first;
+    }
+
+    /// @brief Record the message ID awaiting PUBREL in the slot.
+    void assign(std::size_t slot, std::uint16_t msgId)
+    {
+        COMMS_ASSERT(slot < TLimit);
+        eraseKey(slot);
+        unlink(slot);
+
+        m_msgIds[slot] = msgId;
+        m_keyed[slot] = true;
+        auto bucket = bucketIdx(msgId);
+        while (m_buckets[bucket] != NoIndex) {
+            COMMS_ASSERT(m_msgIds[m_buckets[bucket]] != msgId);
+            bucket = nextBucketIdx(bucket);
+        }
+        m_buckets[bucket] = static_cast<Index>(slot);
+    }
+
+    /// @brief The message was reported, the slot keeps its message ID only
+    ///     to detect duplicates and becomes the last one to be reused.
+    void markReported(std::size_t slot)
+    {
+        COMMS_ASSERT(slot < TLimit);
+        unlink(slot);
+        pushBack(slot);
+    }
+
+    /// @brief Forget the message ID of the slot and make it the first one
+    ///     to be reused.
+    void release(std::size_t slot)
+    {
+        COMMS_ASSERT(slot < TLimit);
+        eraseKey(slot);
+        unlink(slot);
+        pushFront(slot);
+    }
+
+private:
+    static std::size_t bucketIdx(std::uint16_t msgId)
+    {
+        // The message IDs are allocated sequentially by the gateway
+        return static_cast<std::size_t>(msgId) & (BucketsCount - 1U);
+    }
+
+    static std::size_t nextBucketIdx(std::size_t bucket)
+    {
+        return (bucket + 1U) & (BucketsCount - 1U);
+    }
+
+    void eraseKey(std::size_t slot)
+    {
+        if (!m_keyed[slot]) {
+            return;
+        }
+
+        m_keyed[slot] = false;
+        auto hole = bucketIdx(m_msgIds[slot]);
+        while (m_buckets[hole] != slot) {
+            COMMS_ASSERT(m_buckets[hole] != NoIndex);
+            hole = nextBucketIdx(hole);
+        }
+
+        // Shift back the following entries of the probe sequence
+        m_buckets[hole] = NoIndex;
+        auto bucket = nextBucketIdx(hole);
+        while (m_buckets[bucket] != NoIndex) {
+            auto home = bucketIdx(m_msgIds[m_buckets[bucket]]);
+            auto homeDist = (bucket - home) & (BucketsCount - 1U);
+            auto holeDist = (bucket - hole) & (BucketsCount - 1U);
+            if (holeDist <= homeDist) {
+                m_buckets[hole] = m_buckets[bucket];
+                m_buckets[bucket] = NoIndex;
+                hole = bucket;
+            }
+            bucket = nextBucketIdx(bucket);
+        }
+    }
+
+    void unlink(std::size_t slot)
+    {
+        if (!m_linked[slot]) {
+            return;
+        }
+
+        auto prev = m_prev[slot];
+        auto next = m_next[slot];
+        if (prev == NoIndex) {
+            m_first = next;
+        }
+        else {
+            m_next[prev] = next;
+        }
+
+        if (next == NoIndex) {
+            m_last = prev;
+        }
+        else {
+            m_prev[next] = prev;
+        }
+
+        m_linked[slot] = false;
+    }
+
+    void pushFront(std::size_t slot)
+    {
+        m_prev[slot] = NoIndex;
+        m_next[slot] = m_first;
+        if (m_first == NoIndex) {
+            m_last = static_cast<Index>(slot);
+        }
+        else {
+            m_prev[m_first] = static_cast<Index>(slot);
+        }
+        m_first = static_cast<Index>(slot);
+        m_linked[slot] = true;
+    }
+
+    void pushBack(std::size_t slot)
+    {
+        m_next[slot] = NoIndex;
+        m_prev[slot] = m_last;
+        if (m_last == NoIndex) {
+            m_first = static_cast<Index>(slot);
+        }
+        else {
+            m_next[m_last] = static_cast<Index>(slot);
+        }
+        m_last = static_cast<Index>(slot);
+        m_linked[slot] = true;
+    }
+
+    std::array<Index, BucketsCount> m_buckets;
+    std::array<std::uint16_t, TLimit> m_msgIds = {{0U}};
+    std::array<Index, TLimit> m_prev = {{0U}};
+    std::array<Index, TLimit> m_next = {{0U}};
+    std::array<bool, TLimit> m_keyed = {{false}};
+    std::array<bool, TLimit> m_linked = {{false}};
+    Index m_first = NoIndex;
+    Index m_last = NoIndex;
+};
+
+template <std::size_t TLimit>
+const typename InQos2Index<TLimit>::Index InQos2Index<TLimit>::NoIndex;
+
+template <std::size_t TLimit>
+const std::size_t InQos2Index<TLimit>::BucketsCount;
+
+template <std::size_t TLimit>
+const std::size_t InQos2Index<TLimit>::NoSlot;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
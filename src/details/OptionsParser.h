@@ -42,7 +42,18 @@ public:
     static const bool HasGwAddStaticStorageSize = false;
     static const bool HasClientIdStaticStorageSize = false;
     static const bool HasTopicNameStaticStorageSize = false;
-    static const bool HasMessageDataStaticStorageSize = false;    
+    static const bool HasMessageDataStaticStorageSize = false;
+    static const bool HasMaxInflightPublishes = false;
+    static const bool HasOutputBatchFramesLimit = false;
+    static const bool HasMaxPendingInboundQos2 = false;
+    static const bool HasPredefinedTopics = false;
+    static const bool HasOutboundQueueLimit = false;
+    static const bool HasOutboundQueueDataSize = false;
+    static const bool HasOutboundJournal = false;
+    static const bool HasStats = false;
+    static const bool HasTraceRingSize = false;
+    static const bool HasPublishStream = false;
+    static const bool HasOutputBufferProvider = false;
 };
 
 template <std::size_t TLimit, typename... TOptions>
@@ -122,6 +133,118 @@ public:
     static const std::size_t MessageDataStaticStorageSize = Option::Value;
 };
 
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::MaxInflightPublishes<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::MaxInflightPublishes<TLimit> Option;
+public:
+    static const bool HasMaxInflightPublishes = true;
+    static const std::size_t MaxInflightPublishes = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::OutputBatchFramesLimit<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::OutputBatchFramesLimit<TLimit> Option;
+public:
+    static const bool HasOutputBatchFramesLimit = true;
+    static const std::size_t OutputBatchFramesLimit = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::MaxPendingInboundQos2<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::MaxPendingInboundQos2<TLimit> Option;
+public:
+    static const bool HasMaxPendingInboundQos2 = true;
+    static const std::size_t MaxPendingInboundQos2 = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::OutboundQueueLimit<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::OutboundQueueLimit<TLimit> Option;
+public:
+    static const bool HasOutboundQueueLimit = true;
+    static const std::size_t OutboundQueueLimit = Option::Value;
+};
+
+template <std::size_t TSize, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::OutboundQueueDataSize<TSize>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::OutboundQueueDataSize<TSize> Option;
+public:
+    static const bool HasOutboundQueueDataSize = true;
+    static const std::size_t OutboundQueueDataSize = Option::Value;
+};
+
+template <typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::OutboundJournal,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+public:
+    static const bool HasOutboundJournal = true;
+};
+
+template <typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::Stats,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+public:
+    static const bool HasStats = true;
+};
+
+template <std::size_t TSize, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::TraceRingSize<TSize>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::TraceRingSize<TSize> Option;
+public:
+    static const bool HasTraceRingSize = true;
+    static const std::size_t TraceRingSize = Option::Value;
+};
+
+template <typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::PublishStream,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+public:
+    static const bool HasPublishStream = true;
+};
+
+template <typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::OutputBufferProvider,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+public:
+    static const bool HasOutputBufferProvider = true;
+};
+
+template <typename TTopics, typename... TOptions>
+class OptionsParser<
+    mqttsn::client::option::PredefinedTopics<TTopics>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::client::option::PredefinedTopics<TTopics> Option;
+public:
+    static const bool HasPredefinedTopics = true;
+    typedef typename Option::Type PredefinedTopics;
+};
 
 template <typename... TTupleOptions, typename... TOptions>
 class OptionsParser<
@@ -0,0 +1,691 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <limits>
+
+#include "comms/comms.h"
+#include "mqttsn/client/common.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+enum class JournalTopicKind : std::uint8_t
+{
+    Name,
+    Short,
+    Predefined
+};
+
+struct JournalRecord
+{
+    std::uint32_t m_seq = 0U;
+    std::uint16_t m_msgId = 0U;
+    std::uint16_t m_topicId = 0U;
+    MqttsnQoS m_qos = MqttsnQoS_AtLeastOnceDelivery;
+    bool m_retain = false;
+    bool m_released = false;
+    JournalTopicKind m_kind = JournalTopicKind::Name;
+};
+
+/// @brief Journal when not configured, never records anything.
+class NoOutboundJournal
+{
+public:
+    static const bool Enabled = false;
+
+    bool setStore(const MqttsnJournalStore* store)
+    {
+        static_cast<void>(store);
+        return false;
+    }
+
+    bool active() const
+    {
+        return false;
+    }
+
+    std::uint16_t open()
+    {
+        return 0U;
+    }
+
+    void setDropReportCallback(MqttsnJournalDropReportFn, void*) {}
+
+    bool append(std::size_t, JournalRecord&, const char*, std::size_t, const std::uint8_t*, std::size_t)
+    {
+        return false;
+    }
+
+    void markReleased(std::size_t) {}
+    void markDone(std::size_t) {}
+    void commit() {}
+
+    bool replayPending(std::size_t) const
+    {
+        return false;
+    }
+
+    std::size_t nextReplaySlot() const
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    JournalRecord loadReplay(std::size_t)
+    {
+        COMMS_ASSERT(!"Should not be called");
+        return JournalRecord();
+    }
+
+    const char* replayTopic(std::size_t) const
+    {
+        return nullptr;
+    }
+
+    const std::uint8_t* replayData(std::size_t) const
+    {
+        return nullptr;
+    }
+
+    std::size_t replayDataLen(std::size_t) const
+    {
+        return 0U;
+    }
+};
+
+/// @brief Journal of the outbound QoS1/QoS2 publishes in persistent storage.
+/// @details Every record holds a single publish, its state byte is
+///     updated in place (pending -> released -> done) by clearing bits.
+///     The records are appended sequentially, the sector following the
+///     one being written is always kept erased, the records still pending
+///     in it are copied to the current sector before erasing it. Every
+///     written record (including a copy) gets new write sequence number,
+///     the last written one is located by the highest of them on open,
+///     while the copies preserve the original order of the publishes.
+///     Only one record per publish slot can be pending, the slot is
+///     located by "msgId % TSlots". The records which cannot be kept
+///     (too big or no room left) are reported by the drop report callback.
+template <typename TTopicName, typename TData, std::size_t TSlots>
+class OutboundJournal
+{
+public:
+    static const bool Enabled = true;
+
+    bool setStore(const MqttsnJournalStore* store)
+    {
+        if (store == nullptr) {
+            m_store = MqttsnJournalStore();
+            return true;
+        }
+
+        if ((store->read == nullptr) ||
+            (store->write == nullptr) ||
+            (store->sectorSize < MinSectorSize) ||
+            ((store->sectorSize % Alignment) != 0U) ||
+            (store->size < (2U * store->sectorSize)) ||
+            ((store->size % store->sectorSize) != 0U)) {
+            return false;
+        }
+
+        m_store = *store;
+        return true;
+    }
+
+    void setDropReportCallback(MqttsnJournalDropReportFn cb, void* data)
+    {
+        m_dropReportFn = cb;
+        m_dropReportData = data;
+    }
+
+    bool active() const
+    {
+        return m_store.write != nullptr;
+    }
+
+    /// @brief Scan the storage for the pending records.
+    /// @return Message ID of the last written record.
+    std::uint16_t open()
+    {
+        std::fill(m_slots.begin(), m_slots.end(), SlotInfo());
+        m_sector = 0U;
+        m_pos = 0U;
+        m_nextSeq = 1U;
+        m_dirty = false;
+
+        if (!active()) {
+            return 0U;
+        }
+
+        bool found = false;
+        std::uint16_t lastMsgId = 0U;
+        std::size_t offset = 0U;
+        while ((offset + HeaderLen) <= m_store.size) {
+            Header hdr;
+            if (!readHeader(offset, hdr)) {
+                offset += Alignment;
+                continue;
+            }
+
+            if ((!found) || (m_nextSeq <= hdr.m_writeSeq)) {
+                found = true;
+                m_nextSeq = hdr.m_writeSeq + 1U;
+                lastMsgId = hdr.m_rec.m_msgId;
+                m_sector = offset / m_store.sectorSize;
+                m_pos = (offset % m_store.sectorSize) + hdr.m_len;
+            }
+
+            trackRecord(offset, hdr);
+            offset += hdr.m_len;
+        }
+
+        for (auto& info : m_slots) {
+            if (info.m_state == SlotState::Done) {
+                info = SlotInfo();
+            }
+        }
+
+        if (!found) {
+            eraseSector(0U);
+        }
+
+        prepareNextSector();
+        commit();
+        return lastMsgId;
+    }
+
+    /// @return true when the record is written, false when it is not
+    ///     active or the record is dropped.
+    bool append(
+        std::size_t slotIdx,
+        JournalRecord& rec,
+        const char* topic,
+        std::size_t topicLen,
+        const std::uint8_t* data,
+        std::size_t dataLen)
+    {
+        COMMS_ASSERT(slotIdx < TSlots);
+        auto& info = m_slots[slotIdx];
+        info = SlotInfo();
+        if (!active()) {
+            return false;
+        }
+
+        auto len = recordLen(topicLen + dataLen);
+        if ((m_store.sectorSize < len) || (0xffff < topicLen) || (0xffff < dataLen)) {
+            // Too big to be journaled
+            reportDropped(rec.m_msgId);
+            return false;
+        }
+
+        // The pending records moved out of the next sector may leave no
+        // room in the new one, all of them are compacted into the current
+        // sector after visiting every other one.
+        std::size_t rollovers = 0U;
+        while (m_store.sectorSize < (m_pos + len)) {
+            if ((sectorsCount() - 1U) <= rollovers) {
+                reportDropped(rec.m_msgId);
+                return false;
+            }
+
+            ++rollovers;
+            m_sector = (m_sector + 1U) % sectorsCount();
+            m_pos = 0U;
+            prepareNextSector();
+        }
+
+        auto writeSeq = m_nextSeq;
+        ++m_nextSeq;
+        rec.m_seq = writeSeq;
+
+        std::uint8_t hdrBuf[HeaderLen] = {0};
+        hdrBuf[0] = Magic0;
+        hdrBuf[1] = Magic1;
+        hdrBuf[StateOffset] = StatePending;
+        hdrBuf[3] =
+            static_cast<std::uint8_t>(
+                (static_cast<unsigned>(rec.m_qos) & 0x3U) |
+                (rec.m_retain ? 0x4U : 0U) |
+                (static_cast<unsigned>(rec.m_kind) << 4U));
+        writeU32(&hdrBuf[WriteSeqOffset], writeSeq);
+        writeU32(&hdrBuf[8], rec.m_seq);
+        writeU16(&hdrBuf[12], rec.m_msgId);
+        writeU16(&hdrBuf[14], rec.m_topicId);
+        writeU16(&hdrBuf[16], static_cast<std::uint16_t>(topicLen));
+        writeU16(&hdrBuf[18], static_cast<std::uint16_t>(dataLen));
+
+        auto crc = headerCrc(hdrBuf);
+        crc = crcUpdate(crc, reinterpret_cast<const std::uint8_t*>(topic), topicLen);
+        crc = crcUpdate(crc, data, dataLen);
+        writeU32(&hdrBuf[CrcOffset], ~crc);
+
+        auto offset = m_sector * m_store.sectorSize + m_pos;
+        write(offset, hdrBuf, HeaderLen);
+        write(offset + HeaderLen, reinterpret_cast<const std::uint8_t*>(topic), topicLen);
+        write(offset + HeaderLen + topicLen, data, dataLen);
+        m_pos += len;
+
+        info.m_writeSeq = writeSeq;
+        info.m_seq = rec.m_seq;
+        info.m_offset = offset;
+        info.m_msgId = rec.m_msgId;
+        info.m_state = SlotState::Live;
+        return true;
+    }
+
+    void markReleased(std::size_t slotIdx)
+    {
+        writeState(slotIdx, StateReleased);
+    }
+
+    void markDone(std::size_t slotIdx)
+    {
+        writeState(slotIdx, StateDone);
+        m_slots[slotIdx] = SlotInfo();
+    }
+
+    void commit()
+    {
+        if (!m_dirty) {
+            return;
+        }
+
+        m_dirty = false;
+        if (m_store.commit != nullptr) {
+            m_store.commit(m_store.data);
+        }
+    }
+
+    bool replayPending(std::size_t slotIdx) const
+    {
+        return m_slots[slotIdx].m_state == SlotState::Replay;
+    }
+
+    /// @return Index of the slot of the oldest record to replay,
+    ///     @b TSlots if none.
+    std::size_t nextReplaySlot() const
+    {
+        std::size_t result = TSlots;
+        for (std::size_t idx = 0U; idx < TSlots; ++idx) {
+            auto& info = m_slots[idx];
+            if ((info.m_state == SlotState::Replay) &&
+                ((result == TSlots) || (info.m_seq < m_slots[result].m_seq))) {
+                result = idx;
+            }
+        }
+        return result;
+    }
+
+    JournalRecord loadReplay(std::size_t slotIdx)
+    {
+        auto& info = m_slots[slotIdx];
+        COMMS_ASSERT(info.m_state == SlotState::Replay);
+        info.m_state = SlotState::Live;
+
+        Header hdr;
+        bool valid = readHeader(info.m_offset, hdr);
+        static_cast<void>(valid);
+        COMMS_ASSERT(valid);
+
+        auto& buf = m_bufs[slotIdx];
+        buf.m_topic.clear();
+        buf.m_data.clear();
+        auto pos = info.m_offset + HeaderLen;
+        readInto(pos, hdr.m_topicLen, buf.m_topic);
+        readInto(pos + hdr.m_topicLen, hdr.m_dataLen, buf.m_data);
+        return hdr.m_rec;
+    }
+
+    const char* replayTopic(std::size_t slotIdx) const
+    {
+        return m_bufs[slotIdx].m_topic.c_str();
+    }
+
+    const std::uint8_t* replayData(std::size_t slotIdx) const
+    {
+        return m_bufs[slotIdx].m_data.data();
+    }
+
+    std::size_t replayDataLen(std::size_t slotIdx) const
+    {
+        return m_bufs[slotIdx].m_data.size();
+    }
+
+private:
+    enum class SlotState : std::uint8_t
+    {
+        None,
+        Live,
+        Replay,
+        Done // used only during scan
+    };
+
+    struct SlotInfo
+    {
+        std::uint32_t m_writeSeq = 0U;
+        std::uint32_t m_seq = 0U;
+        std::size_t m_offset = 0U;
+        std::uint16_t m_msgId = 0U;
+        SlotState m_state = SlotState::None;
+    };
+
+    struct Buffer
+    {
+        TTopicName m_topic;
+        TData m_data;
+    };
+
+    struct Header
+    {
+        JournalRecord m_rec;
+        std::size_t m_topicLen = 0U;
+        std::size_t m_dataLen = 0U;
+        std::size_t m_len = 0U;
+        std::uint32_t m_writeSeq = 0U;
+        std::uint8_t m_state = 0U;
+    };
+
+    static const std::size_t HeaderLen = 24U;
+    static const std::size_t Alignment = 4U;
+    static const std::size_t MinSectorSize = 64U;
+    static const std::size_t StateOffset = 2U;
+    static const std::size_t WriteSeqOffset = 4U;
+    static const std::size_t CrcOffset = 20U;
+    static const std::uint8_t Magic0 = 'J';
+    static const std::uint8_t Magic1 = 'N';
+    static const std::uint8_t StatePending = 0xffU;
+    static const std::uint8_t StateReleased = 0x0fU;
+    static const std::uint8_t StateDone = 0x00U;
+
+    static std::size_t recordLen(std::size_t payloadLen)
+    {
+        return ((HeaderLen + payloadLen + Alignment - 1U) / Alignment) * Alignment;
+    }
+
+    static void writeU16(std::uint8_t* buf, std::uint16_t value)
+    {
+        buf[0] = static_cast<std::uint8_t>(value & 0xffU);
+        buf[1] = static_cast<std::uint8_t>((value >> 8U) & 0xffU);
+    }
+
+    static void writeU32(std::uint8_t* buf, std::uint32_t value)
+    {
+        writeU16(buf, static_cast<std::uint16_t>(value & 0xffffU));
+        writeU16(buf + 2U, static_cast<std::uint16_t>((value >> 16U) & 0xffffU));
+    }
+
+    static std::uint16_t readU16(const std::uint8_t* buf)
+    {
+        return static_cast<std::uint16_t>(buf[0] | (static_cast<unsigned>(buf[1]) << 8U));
+    }
+
+    static std::uint32_t readU32(const std::uint8_t* buf)
+    {
+        return
+            static_cast<std::uint32_t>(readU16(buf)) |
+            (static_cast<std::uint32_t>(readU16(buf + 2U)) << 16U);
+    }
+
+    static std::uint32_t crcUpdate(std::uint32_t crc, const std::uint8_t* buf, std::size_t len)
+    {
+        for (std::size_t idx = 0U; idx < len; ++idx) {
+            crc ^= buf[idx];
+            for (unsigned bit = 0U; bit < 8U; ++bit) {
+                crc = (crc >> 1U) ^ (0xedb88320U & (0U - (crc & 1U)));
+            }
+        }
+        return crc;
+    }
+
+    // The state byte is updated in place, not covered by CRC
+    static std::uint32_t headerCrc(const std::uint8_t* hdrBuf)
+    {
+        auto crc = crcUpdate(0xffffffffU, hdrBuf, StateOffset);
+        return crcUpdate(crc, hdrBuf + StateOffset + 1U, CrcOffset - StateOffset - 1U);
+    }
+
+    void reportDropped(std::uint16_t msgId)
+    {
+        if (m_dropReportFn != nullptr) {
+            m_dropReportFn(m_dropReportData, msgId);
+        }
+    }
+
+    std::size_t sectorsCount() const
+    {
+        return m_store.size / m_store.sectorSize;
+    }
+
+    void write(std::size_t offset, const std::uint8_t* buf, std::size_t len)
+    {
+        if (len == 0U) {
+            return;
+        }
+
+        m_store.write(m_store.data, static_cast<unsigned>(offset), buf, static_cast<unsigned>(len));
+        m_dirty = true;
+    }
+
+    void read(std::size_t offset, std::uint8_t* buf, std::size_t len) const
+    {
+        m_store.read(m_store.data, static_cast<unsigned>(offset), buf, static_cast<unsigned>(len));
+    }
+
+    template <typename TStorage>
+    void readInto(std::size_t offset, std::size_t len, TStorage& storage) const
+    {
+        std::uint8_t chunk[32];
+        while (0U < len) {
+            auto chunkLen = std::min(len, sizeof(chunk));
+            read(offset, chunk, chunkLen);
+            for (std::size_t idx = 0U; idx < chunkLen; ++idx) {
+                storage.push_back(static_cast<typename TStorage::value_type>(chunk[idx]));
+            }
+            offset += chunkLen;
+            len -= chunkLen;
+        }
+    }
+
+    bool readHeader(std::size_t offset, Header& hdr, std::uint8_t* hdrBuf)
+    {
+        read(offset, hdrBuf, HeaderLen);
+        if ((hdrBuf[0] != Magic0) || (hdrBuf[1] != Magic1)) {
+            return false;
+        }
+
+        hdr.m_state = hdrBuf[StateOffset];
+        hdr.m_rec.m_qos = static_cast<MqttsnQoS>(hdrBuf[3] & 0x3U);
+        hdr.m_rec.m_retain = ((hdrBuf[3] & 0x4U) != 0U);
+        hdr.m_rec.m_kind = static_cast<JournalTopicKind>((hdrBuf[3] >> 4U) & 0x3U);
+        hdr.m_rec.m_released = (hdr.m_state == StateReleased);
+        hdr.m_writeSeq = readU32(&hdrBuf[WriteSeqOffset]);
+        hdr.m_rec.m_seq = readU32(&hdrBuf[8]);
+        hdr.m_rec.m_msgId = readU16(&hdrBuf[12]);
+        hdr.m_rec.m_topicId = readU16(&hdrBuf[14]);
+        hdr.m_topicLen = readU16(&hdrBuf[16]);
+        hdr.m_dataLen = readU16(&hdrBuf[18]);
+        hdr.m_len = recordLen(hdr.m_topicLen + hdr.m_dataLen);
+        if (m_store.sectorSize < ((offset % m_store.sectorSize) + hdr.m_len)) {
+            return false;
+        }
+
+        return payloadCrc(offset, hdr, hdrBuf) == readU32(&hdrBuf[CrcOffset]);
+    }
+
+    bool readHeader(std::size_t offset, Header& hdr)
+    {
+        std::uint8_t hdrBuf[HeaderLen];
+        return readHeader(offset, hdr, hdrBuf);
+    }
+
+    // When "to" is provided, the payload is copied there while being read
+    std::uint32_t payloadCrc(
+        std::size_t offset,
+        const Header& hdr,
+        const std::uint8_t* hdrBuf,
+        std::size_t* to = nullptr)
+    {
+        auto crc = headerCrc(hdrBuf);
+        std::uint8_t chunk[32];
+        std::size_t pos = HeaderLen;
+        auto endPos = HeaderLen + hdr.m_topicLen + hdr.m_dataLen;
+        while (pos < endPos) {
+            auto chunkLen = std::min(endPos - pos, sizeof(chunk));
+            read(offset + pos, chunk, chunkLen);
+            crc = crcUpdate(crc, chunk, chunkLen);
+            if (to != nullptr) {
+                write(*to + pos, chunk, chunkLen);
+            }
+            pos += chunkLen;
+        }
+
+        return ~crc;
+    }
+
+    void trackRecord(std::size_t offset, const Header& hdr)
+    {
+        auto& info = m_slots[hdr.m_rec.m_msgId % TSlots];
+        if ((info.m_state != SlotState::None) && (hdr.m_writeSeq < info.m_writeSeq)) {
+            // Superseded by newer record or by a copy of the same one
+            return;
+        }
+
+        info.m_writeSeq = hdr.m_writeSeq;
+        info.m_seq = hdr.m_rec.m_seq;
+        info.m_offset = offset;
+        info.m_msgId = hdr.m_rec.m_msgId;
+        info.m_state = SlotState::Replay;
+        if (hdr.m_state == StateDone) {
+            info.m_state = SlotState::Done;
+        }
+    }
+
+    void writeState(std::size_t slotIdx, std::uint8_t state)
+    {
+        auto& info = m_slots[slotIdx];
+        if ((!active()) || (info.m_state == SlotState::None)) {
+            return;
+        }
+
+        write(info.m_offset + StateOffset, &state, 1U);
+    }
+
+    void eraseSector(std::size_t sector)
+    {
+        auto offset = sector * m_store.sectorSize;
+        if (m_store.erase != nullptr) {
+            m_store.erase(m_store.data, static_cast<unsigned>(offset), m_store.sectorSize);
+            m_dirty = true;
+            return;
+        }
+
+        std::uint8_t chunk[32];
+        std::fill(std::begin(chunk), std::end(chunk), 0xffU);
+        for (std::size_t pos = 0U; pos < m_store.sectorSize; pos += sizeof(chunk)) {
+            write(offset + pos, chunk, std::min(sizeof(chunk), m_store.sectorSize - pos));
+        }
+    }
+
+    // Keep the sector after the current one erased, moving pending records out of it
+    void prepareNextSector()
+    {
+        auto nextSector = (m_sector + 1U) % sectorsCount();
+        auto nextOffset = nextSector * m_store.sectorSize;
+        bool moved = false;
+        for (auto& info : m_slots) {
+            if ((info.m_state == SlotState::None) ||
+                (info.m_offset < nextOffset) ||
+                ((nextOffset + m_store.sectorSize) <= info.m_offset)) {
+                continue;
+            }
+
+            Header hdr;
+            std::uint8_t hdrBuf[HeaderLen];
+            if ((!readHeader(info.m_offset, hdr, hdrBuf)) ||
+                (m_store.sectorSize < (m_pos + hdr.m_len))) {
+                // Journal is too small to keep all the pending records
+                reportDropped(info.m_msgId);
+                info = SlotInfo();
+                continue;
+            }
+
+            auto offset = m_sector * m_store.sectorSize + m_pos;
+            info.m_writeSeq = m_nextSeq;
+            ++m_nextSeq;
+            writeU32(&hdrBuf[WriteSeqOffset], info.m_writeSeq);
+            writeU32(&hdrBuf[CrcOffset], payloadCrc(info.m_offset, hdr, hdrBuf, &offset));
+            write(offset, hdrBuf, HeaderLen);
+
+            info.m_offset = offset;
+            m_pos += hdr.m_len;
+            moved = true;
+        }
+
+        if (moved) {
+            // Copies must be persistent before the originals are erased
+            commit();
+        }
+
+        eraseSector(nextSector);
+    }
+
+    MqttsnJournalStore m_store = MqttsnJournalStore();
+    MqttsnJournalDropReportFn m_dropReportFn = nullptr;
+    void* m_dropReportData = nullptr;
+    std::array<SlotInfo, TSlots> m_slots;
+    std::array<Buffer, TSlots> m_bufs;
+    std::size_t m_sector = 0U;
+    std::size_t m_pos = 0U;
+    std::uint32_t m_nextSeq = 1U;
+    bool m_dirty = false;
+};
+
+template <typename TTopicName, typename TData, std::size_t TSlots, bool THasJournal>
+struct OutboundJournalType;
+
+template <typename TTopicName, typename TData, std::size_t TSlots>
+struct OutboundJournalType<TTopicName, TData, TSlots, true>
+{
+    typedef OutboundJournal<TTopicName, TData, TSlots> Type;
+};
+
+template <typename TTopicName, typename TData, std::size_t TSlots>
+struct OutboundJournalType<TTopicName, TData, TSlots, false>
+{
+    typedef NoOutboundJournal Type;
+};
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TSlots>
+using OutboundJournalTypeT =
+    typename OutboundJournalType<TTopicName, TData, TSlots, TOpts::HasOutboundJournal>::Type;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,592 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "comms/comms.h"
+#include "comms/util/StaticQueue.h"
+#include "mqttsn/client/common.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+enum class OutboundTopicKind : std::uint8_t
+{
+    Name,
+    Id,
+    Handle
+};
+
+struct OutboundMsgInfo
+{
+    MqttsnAsyncOpCompleteReportFn m_cb = nullptr;
+    void* m_cbData = nullptr;
+    std::uint32_t m_topicRef = 0U; // topic ID or handle
+    MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
+    bool m_retain = false;
+    OutboundTopicKind m_kind = OutboundTopicKind::Name;
+};
+
+enum class OutboundEntryState : std::uint8_t
+{
+    Pending,
+    Taken,
+    Done
+};
+
+/// @brief Outbound queue when not configured, never holds anything.
+template <typename TTopicName, typename TData>
+class NoOutboundQueue
+{
+public:
+    static const bool Enabled = false;
+
+    typedef std::size_t Ref;
+
+    bool empty() const
+    {
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        return 0U;
+    }
+
+    bool fits(std::size_t topicLen, std::size_t msgLen) const
+    {
+        static_cast<void>(topicLen);
+        static_cast<void>(msgLen);
+        return false;
+    }
+
+    bool push(const OutboundMsgInfo&, const char*, std::size_t, const std::uint8_t*, std::size_t)
+    {
+        return false;
+    }
+
+    Ref take()
+    {
+        COMMS_ASSERT(!"Should not be called");
+        return 0U;
+    }
+
+    OutboundMsgInfo dropFront()
+    {
+        COMMS_ASSERT(!"Should not be called");
+        return OutboundMsgInfo();
+    }
+
+    OutboundMsgInfo info(Ref) const
+    {
+        return OutboundMsgInfo();
+    }
+
+    const char* topic(Ref) const
+    {
+        return nullptr;
+    }
+
+    const std::uint8_t* data(Ref) const
+    {
+        return nullptr;
+    }
+
+    std::size_t dataLen(Ref) const
+    {
+        return 0U;
+    }
+
+    void release(Ref) {}
+
+    void clear() {}
+};
+
+/// @brief Entries of the outbound queue.
+/// @details The entries taken to be published stay in the queue, so the
+///     publish refers to their topic and data until it is complete, and
+///     don't count in its size any more. The entries are removed in the
+///     order of their insertion, once they are released or dropped.
+template <typename TEntry, std::size_t TLimit, std::size_t TInflightLimit>
+class OutboundQueueEntries
+{
+public:
+    typedef std::size_t Ref;
+
+    bool empty() const
+    {
+        return m_pendingCount == 0U;
+    }
+
+    std::size_t size() const
+    {
+        return m_pendingCount;
+    }
+
+    bool full() const
+    {
+        return (TLimit <= m_pendingCount) || m_queue.full();
+    }
+
+    TEntry& push()
+    {
+        COMMS_ASSERT(!full());
+        m_queue.push_back(TEntry());
+        ++m_pendingCount;
+        return m_queue.back();
+    }
+
+    /// @brief Mark the oldest pending entry as being published.
+    Ref take()
+    {
+        COMMS_ASSERT(!empty());
+        auto idx = m_queue.size() - m_pendingCount;
+        m_queue[idx].m_state = OutboundEntryState::Taken;
+        --m_pendingCount;
+        return m_frontRef + idx;
+    }
+
+    /// @brief Mark the oldest pending entry as dropped.
+    TEntry& drop()
+    {
+        COMMS_ASSERT(!empty());
+        auto& entry = m_queue[m_queue.size() - m_pendingCount];
+        entry.m_state = OutboundEntryState::Done;
+        --m_pendingCount;
+        return entry;
+    }
+
+    void release(Ref ref)
+    {
+        auto& entry = at(ref);
+        COMMS_ASSERT(entry.m_state == OutboundEntryState::Taken);
+        entry.m_state = OutboundEntryState::Done;
+    }
+
+    TEntry& at(Ref ref)
+    {
+        COMMS_ASSERT((ref - m_frontRef) < m_queue.size());
+        return m_queue[ref - m_frontRef];
+    }
+
+    const TEntry& at(Ref ref) const
+    {
+        COMMS_ASSERT((ref - m_frontRef) < m_queue.size());
+        return m_queue[ref - m_frontRef];
+    }
+
+    /// @return Oldest entry if it may be removed, nullptr otherwise.
+    const TEntry* doneFront() const
+    {
+        if (m_queue.empty() || (m_queue.front().m_state != OutboundEntryState::Done)) {
+            return nullptr;
+        }
+        return &m_queue.front();
+    }
+
+    void popFront()
+    {
+        m_queue.pop_front();
+        ++m_frontRef;
+    }
+
+    bool hasEntries() const
+    {
+        return !m_queue.empty();
+    }
+
+    void clear()
+    {
+        m_queue.clear();
+        m_pendingCount = 0U;
+    }
+
+private:
+    comms::util::StaticQueue<TEntry, TLimit + TInflightLimit> m_queue;
+    std::size_t m_pendingCount = 0U;
+    Ref m_frontRef = 0U;
+};
+
+/// @brief Fixed size queue, every entry has static storage for topic and data.
+template <typename TTopicName, typename TData, std::size_t TLimit, std::size_t TInflightLimit>
+class StaticOutboundQueue
+{
+    struct Entry;
+    typedef OutboundQueueEntries<Entry, TLimit, TInflightLimit> Entries;
+
+public:
+    static const bool Enabled = true;
+
+    typedef typename Entries::Ref Ref;
+
+    bool empty() const
+    {
+        return m_entries.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_entries.size();
+    }
+
+    bool fits(std::size_t topicLen, std::size_t msgLen) const
+    {
+        static const Entry Empty = Entry();
+        return
+            (topicLen <= Empty.m_topic.capacity()) &&
+            (msgLen <= Empty.m_data.capacity());
+    }
+
+    bool push(
+        const OutboundMsgInfo& info,
+        const char* topic,
+        std::size_t topicLen,
+        const std::uint8_t* msg,
+        std::size_t msgLen)
+    {
+        if (m_entries.full()) {
+            return false;
+        }
+
+        auto& entry = m_entries.push();
+        entry.m_info = info;
+        entry.m_topic.assign(topic, topicLen);
+        entry.m_data.assign(msg, msg + msgLen);
+        return true;
+    }
+
+    Ref take()
+    {
+        return m_entries.take();
+    }
+
+    OutboundMsgInfo dropFront()
+    {
+        auto info = m_entries.drop().m_info;
+        popDone();
+        return info;
+    }
+
+    OutboundMsgInfo info(Ref ref) const
+    {
+        return m_entries.at(ref).m_info;
+    }
+
+    const char* topic(Ref ref) const
+    {
+        return m_entries.at(ref).m_topic.c_str();
+    }
+
+    const std::uint8_t* data(Ref ref) const
+    {
+        return m_entries.at(ref).m_data.data();
+    }
+
+    std::size_t dataLen(Ref ref) const
+    {
+        return m_entries.at(ref).m_data.size();
+    }
+
+    void release(Ref ref)
+    {
+        m_entries.release(ref);
+        popDone();
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+    }
+
+private:
+    struct Entry
+    {
+        OutboundMsgInfo m_info;
+        TTopicName m_topic;
+        TData m_data;
+        OutboundEntryState m_state = OutboundEntryState::Pending;
+    };
+
+    void popDone()
+    {
+        while (m_entries.doneFront() != nullptr) {
+            m_entries.popFront();
+        }
+    }
+
+    Entries m_entries;
+};
+
+/// @brief Queue of descriptors referencing topics and data in a ring buffer.
+/// @details The ring is allocated on first use. The entries are always
+///     released in the order of their allocation, the space at the end
+///     of the ring that is too small for the next entry is skipped.
+///     The data of the entries being published remains in the ring until
+///     the publish is complete.
+template <typename TTopicName, typename TData, std::size_t TLimit, std::size_t TInflightLimit, std::size_t TDataSize>
+class RingOutboundQueue
+{
+    struct Entry;
+    typedef OutboundQueueEntries<Entry, TLimit, TInflightLimit> Entries;
+
+public:
+    static const bool Enabled = true;
+
+    typedef typename Entries::Ref Ref;
+
+    bool empty() const
+    {
+        return m_entries.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_entries.size();
+    }
+
+    bool fits(std::size_t topicLen, std::size_t msgLen) const
+    {
+        return (topicLen + 1U + msgLen) <= TDataSize;
+    }
+
+    bool push(
+        const OutboundMsgInfo& info,
+        const char* topic,
+        std::size_t topicLen,
+        const std::uint8_t* msg,
+        std::size_t msgLen)
+    {
+        if (m_entries.full()) {
+            return false;
+        }
+
+        // Topic is stored null terminated followed by the data
+        auto len = topicLen + 1U + msgLen;
+        std::size_t offset = 0U;
+        if (!alloc(len, offset)) {
+            return false;
+        }
+
+        auto* ptr = &m_ring[offset];
+        if (0U < topicLen) {
+            std::memcpy(ptr, topic, topicLen);
+        }
+        ptr[topicLen] = 0U;
+        if (0U < msgLen) {
+            std::memcpy(ptr + topicLen + 1U, msg, msgLen);
+        }
+
+        auto& entry = m_entries.push();
+        entry.m_info = info;
+        entry.m_offset = offset;
+        entry.m_topicLen = topicLen;
+        entry.m_msgLen = msgLen;
+        return true;
+    }
+
+    Ref take()
+    {
+        return m_entries.take();
+    }
+
+    OutboundMsgInfo dropFront()
+    {
+        auto info = m_entries.drop().m_info;
+        popDone();
+        return info;
+    }
+
+    OutboundMsgInfo info(Ref ref) const
+    {
+        return m_entries.at(ref).m_info;
+    }
+
+    const char* topic(Ref ref) const
+    {
+        return reinterpret_cast<const char*>(&m_ring[m_entries.at(ref).m_offset]);
+    }
+
+    const std::uint8_t* data(Ref ref) const
+    {
+        auto& entry = m_entries.at(ref);
+        return &m_ring[entry.m_offset + entry.m_topicLen + 1U];
+    }
+
+    std::size_t dataLen(Ref ref) const
+    {
+        return m_entries.at(ref).m_msgLen;
+    }
+
+    void release(Ref ref)
+    {
+        m_entries.release(ref);
+        popDone();
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_head = 0U;
+        m_tail = 0U;
+        m_wrapped = false;
+    }
+
+private:
+    struct Entry
+    {
+        OutboundMsgInfo m_info;
+        std::size_t m_offset = 0U;
+        std::size_t m_topicLen = 0U;
+        std::size_t m_msgLen = 0U;
+        OutboundEntryState m_state = OutboundEntryState::Pending;
+    };
+
+    void popDone()
+    {
+        while (true) {
+            auto* entry = m_entries.doneFront();
+            if (entry == nullptr) {
+                break;
+            }
+
+            releaseSpace(entry->m_offset, entry->m_topicLen + 1U + entry->m_msgLen);
+            m_entries.popFront();
+        }
+    }
+
+    bool alloc(std::size_t len, std::size_t& offset)
+    {
+        if (m_ring.empty()) {
+            m_ring.resize(TDataSize);
+        }
+
+        if (!m_entries.hasEntries()) {
+            clear();
+        }
+
+        if (!m_wrapped) {
+            if (len <= (TDataSize - m_tail)) {
+                offset = m_tail;
+            }
+            else if (len <= m_head) {
+                offset = 0U;
+                m_wrapped = true;
+            }
+            else {
+                return false;
+            }
+        }
+        else if (len <= (m_head - m_tail)) {
+            offset = m_tail;
+        }
+        else {
+            return false;
+        }
+
+        m_tail = offset + len;
+        return true;
+    }
+
+    void releaseSpace(std::size_t offset, std::size_t len)
+    {
+        if (m_wrapped && (offset < m_head)) {
+            m_wrapped = false;
+        }
+
+        m_head = offset + len;
+    }
+
+    Entries m_entries;
+    std::vector<std::uint8_t> m_ring;
+    std::size_t m_head = 0U;
+    std::size_t m_tail = 0U;
+    bool m_wrapped = false;
+};
+
+template <typename TOpts, bool THasDataSize>
+struct OutboundQueueDataSize;
+
+template <typename TOpts>
+struct OutboundQueueDataSize<TOpts, true>
+{
+    static_assert(0U < TOpts::OutboundQueueDataSize, "Data size must not be 0");
+    static const std::size_t Value = TOpts::OutboundQueueDataSize;
+};
+
+template <typename TOpts>
+struct OutboundQueueDataSize<TOpts, false>
+{
+    static const std::size_t Value = 4096U;
+};
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TInflightLimit, bool THasLimit, bool TAllStatic>
+struct OutboundQueueType;
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TInflightLimit, bool TAllStatic>
+struct OutboundQueueType<TTopicName, TData, TOpts, TInflightLimit, false, TAllStatic>
+{
+    typedef NoOutboundQueue<TTopicName, TData> Type;
+};
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TInflightLimit>
+struct OutboundQueueType<TTopicName, TData, TOpts, TInflightLimit, true, true>
+{
+    static_assert(0U < TOpts::OutboundQueueLimit, "At least one message must be allowed");
+    typedef StaticOutboundQueue<TTopicName, TData, TOpts::OutboundQueueLimit, TInflightLimit> Type;
+};
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TInflightLimit>
+struct OutboundQueueType<TTopicName, TData, TOpts, TInflightLimit, true, false>
+{
+    static_assert(0U < TOpts::OutboundQueueLimit, "At least one message must be allowed");
+    typedef RingOutboundQueue<
+        TTopicName,
+        TData,
+        TOpts::OutboundQueueLimit,
+        TInflightLimit,
+        OutboundQueueDataSize<TOpts, TOpts::HasOutboundQueueDataSize>::Value
+    > Type;
+};
+
+template <typename TTopicName, typename TData, typename TOpts, std::size_t TInflightLimit>
+using OutboundQueueTypeT =
+    typename OutboundQueueType<
+        TTopicName,
+        TData,
+        TOpts,
+        TInflightLimit,
+        TOpts::HasOutboundQueueLimit,
+        TOpts::HasTopicNameStaticStorageSize && TOpts::HasMessageDataStaticStorageSize
+    >::Type;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,248 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "mqttsn/client/common.h"
+#include "details/WriteBufStorageType.h"
+#include "details/FrameLength.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Publish stream when not configured, never opens.
+class NoPublishStream
+{
+public:
+    static const bool Enabled = false;
+    static const std::size_t ShortFormOffset = 0U;
+    static const std::size_t HeaderLen = 0U;
+
+    void reset() {}
+
+    bool idle() const
+    {
+        return true;
+    }
+
+    bool writing() const
+    {
+        return false;
+    }
+
+    void open(MqttsnTopicId, MqttsnQoS, bool) {}
+
+    std::size_t write(const std::uint8_t*, std::size_t)
+    {
+        return 0U;
+    }
+
+    void markSent() {}
+
+    MqttsnTopicId topicId() const
+    {
+        return 0U;
+    }
+
+    MqttsnQoS qos() const
+    {
+        return MqttsnQoS_AtMostOnceDelivery;
+    }
+
+    bool retain() const
+    {
+        return false;
+    }
+
+    const std::uint8_t* payload() const
+    {
+        return nullptr;
+    }
+
+    std::size_t payloadLen() const
+    {
+        return 0U;
+    }
+
+    std::uint8_t* header()
+    {
+        return nullptr;
+    }
+
+    const std::uint8_t* frame(std::size_t& len)
+    {
+        len = 0U;
+        return nullptr;
+    }
+};
+
+/// @brief Frame buffer of single streamed publish.
+/// @details The PUBLISH header is reserved with the 3 bytes (long) form
+///     of the length, the payload is appended right after it. The header
+///     itself is (re)written at @ref ShortFormOffset with the short
+///     length form on every send, and @ref frame() patches the length,
+///     so the frame goes out from the offset when it fits the short form.
+///     The buffer is kept until the publish is acknowledged to be resent
+///     as is.
+template <typename TBuf>
+class PublishStream
+{
+public:
+    static const bool Enabled = true;
+
+    static const std::size_t ShortFormOffset = FrameLengthLongFormExtra;
+
+    // Length, message type, flags, topic ID and message ID
+    static const std::size_t HeaderLen = 3U + 1U + 1U + 2U + 2U;
+
+    void reset()
+    {
+        m_buf.clear();
+        m_state = State::Idle;
+    }
+
+    bool idle() const
+    {
+        return m_state == State::Idle;
+    }
+
+    bool writing() const
+    {
+        return m_state == State::Writing;
+    }
+
+    void open(MqttsnTopicId topicId, MqttsnQoS qos, bool retain)
+    {
+        m_buf.clear();
+        m_buf.resize(HeaderLen);
+        m_topicId = topicId;
+        m_qos = qos;
+        m_retain = retain;
+        m_state = State::Writing;
+    }
+
+    /// @return Number of appended bytes, less than requested when full.
+    std::size_t write(const std::uint8_t* data, std::size_t len)
+    {
+        if (!writing()) {
+            return 0U;
+        }
+
+        auto count = std::min(len, capacity() - m_buf.size());
+        m_buf.insert(m_buf.end(), data, data + count);
+        return count;
+    }
+
+    void markSent()
+    {
+        m_state = State::Sent;
+    }
+
+    MqttsnTopicId topicId() const
+    {
+        return m_topicId;
+    }
+
+    MqttsnQoS qos() const
+    {
+        return m_qos;
+    }
+
+    bool retain() const
+    {
+        return m_retain;
+    }
+
+    const std::uint8_t* payload() const
+    {
+        return &m_buf[HeaderLen];
+    }
+
+    std::size_t payloadLen() const
+    {
+        return m_buf.size() - HeaderLen;
+    }
+
+    /// @brief Location of the header written with the short length form.
+    std::uint8_t* header()
+    {
+        return &m_buf[ShortFormOffset];
+    }
+
+    /// @brief Patch the length written into the header and get the frame.
+    const std::uint8_t* frame(std::size_t& len)
+    {
+        len = m_buf.size() - ShortFormOffset;
+        return &m_buf[patchFrameLength(&m_buf[0], len)];
+    }
+
+private:
+    enum class State
+    {
+        Idle,
+        Writing,
+        Sent
+    };
+
+    std::size_t capacity() const
+    {
+        // Long form length is limited to 16 bits
+        return std::min(m_buf.max_size(), std::size_t(0xffffU));
+    }
+
+    TBuf m_buf;
+    MqttsnTopicId m_topicId = 0U;
+    MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
+    bool m_retain = false;
+    State m_state = State::Idle;
+};
+
+template <typename TOpts, bool THasPublishStream>
+struct PublishStreamType;
+
+template <typename TOpts>
+struct PublishStreamType<TOpts, true>
+{
+    typedef PublishStream<WriteBufStorageTypeT<TOpts> > Type;
+};
+
+template <typename TOpts>
+struct PublishStreamType<TOpts, false>
+{
+    typedef NoPublishStream Type;
+};
+
+template <typename TOpts>
+using PublishStreamTypeT =
+    typename PublishStreamType<TOpts, TOpts::HasPublishStream>::Type;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,604 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <type_traits>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "comms/comms.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+constexpr std::size_t regInfoBucketsCount(std::size_t limit, std::size_t result = 1U)
+{
+    return (limit <= result) ? result : regInfoBucketsCount(limit, result << 1U);
+}
+
+template <typename TNode, typename TOpts, bool THasRegisteredTopicsLimit>
+struct RegInfoRegistryStorage;
+
+template <typename TNode, typename TOpts>
+struct RegInfoRegistryStorage<TNode, TOpts, true>
+{
+    static const bool Growing = false;
+    static const std::size_t BucketsCount = regInfoBucketsCount(TOpts::RegisteredTopicsLimit);
+
+    typedef typename std::conditional<
+        (TOpts::RegisteredTopicsLimit < 0xffff),
+        std::uint16_t,
+        std::uint32_t
+    >::type IndexType;
+
+    typedef comms::util::StaticVector<TNode, TOpts::RegisteredTopicsLimit> NodesList;
+    typedef std::array<IndexType, BucketsCount> BucketsList;
+};
+
+template <typename TNode, typename TOpts>
+struct RegInfoRegistryStorage<TNode, TOpts, false>
+{
+    static const bool Growing = true;
+    typedef std::uint32_t IndexType;
+    typedef std::vector<TNode> NodesList;
+    typedef std::vector<IndexType> BucketsList;
+};
+
+/// @brief Registry of the registered topics.
+/// @details Provides O(1) lookup of the registration info by topic ID and
+///     by topic name (using its hash), as well as O(1) choice of the
+///     least recently used entry to be evicted when the storage is full.
+///     The locked entries (subscriptions) are kept in a separate LRU list
+///     and evicted only when there are no unlocked ones. The pinned entries
+///     (referenced by topic handles or known topic IDs) are not evicted at
+///     all until their last reference is released, they are addressed by
+///     the handle combining the entry index and its generation.
+template <typename TTopicName, typename TTopicId, typename TOpts>
+class RegInfoRegistry
+{
+    struct Node;
+    typedef RegInfoRegistryStorage<Node, TOpts, TOpts::HasRegisteredTopicsLimit> Storage;
+    typedef typename Storage::IndexType Index;
+    static const Index NoIndex = static_cast<Index>(-1);
+
+    struct ListHead
+    {
+        Index m_first = NoIndex; // most recently used
+        Index m_last = NoIndex; // least recently used
+    };
+
+    struct Node
+    {
+        TTopicName m_topic;
+        TTopicId m_topicId = 0U;
+        std::uint32_t m_nameHash = 0U;
+        Index m_prev = NoIndex;
+        Index m_next = NoIndex;
+        Index m_nextById = NoIndex;
+        Index m_nextByName = NoIndex;
+        unsigned m_refCount = 0U;
+        std::uint16_t m_generation = 0U;
+        bool m_allocated = false;
+        bool m_locked = false;
+    };
+
+public:
+    typedef Node RegInfo;
+    typedef std::uint32_t Handle;
+
+    static const Handle NoHandle = 0U;
+
+    RegInfoRegistry()
+    {
+        resetBuckets();
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+        m_unlocked = ListHead();
+        m_locked = ListHead();
+        m_free = NoIndex;
+        m_pinnedCount = 0U;
+        resetBuckets();
+    }
+
+    RegInfo* findById(TTopicId topicId)
+    {
+        if ((topicId == 0U) || (m_nodes.empty())) {
+            return nullptr;
+        }
+
+        auto idx = m_idBuckets[bucketIdx(static_cast<std::uint32_t>(topicId))];
+        while (idx != NoIndex) {
+            auto& node = m_nodes[idx];
+            if (node.m_topicId == topicId) {
+                return &node;
+            }
+            idx = node.m_nextById;
+        }
+        return nullptr;
+    }
+
+    RegInfo* findByName(const char* topic, std::size_t topicLen)
+    {
+        if (m_nodes.empty()) {
+            return nullptr;
+        }
+
+        return findByName(topic, topicLen, calcHash(topic, topicLen));
+    }
+
+    RegInfo* findByName(const char* topic)
+    {
+        return findByName(topic, std::strlen(topic));
+    }
+
+    /// @brief Record topic ID for the topic name.
+    /// @details Updates existing entry or allocates new one, evicting
+    ///     the least recently used entry when the storage is full.
+    ///     The entry becomes the most recently used one.
+    RegInfo& update(const char* topic, std::size_t topicLen, TTopicId topicId, bool locked)
+    {
+        auto hash = calcHash(topic, topicLen);
+        auto* node = findByName(topic, topicLen, hash);
+        if (node != nullptr) {
+            setTopicId(*node, topicId);
+            setLocked(*node, node->m_locked || locked);
+            touch(*node);
+            return *node;
+        }
+
+        auto idx = allocNode();
+        auto& newNode = m_nodes[idx];
+        newNode.m_topic.assign(topic, topicLen);
+        newNode.m_nameHash = hash;
+        newNode.m_topicId = topicId;
+        newNode.m_allocated = true;
+        newNode.m_locked = locked;
+        newNode.m_generation = nextGeneration();
+        linkName(idx);
+        linkId(idx);
+        pushFront(list(locked), idx);
+        return newNode;
+    }
+
+    /// @brief Mark the entry as the most recently used one.
+    void touch(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        if (isPinned(info)) {
+            return;
+        }
+
+        auto idx = indexOf(info);
+        auto& head = list(info.m_locked);
+        if (head.m_first == idx) {
+            return;
+        }
+
+        unlink(head, idx);
+        pushFront(head, idx);
+    }
+
+    void setLocked(RegInfo& info, bool locked)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        if (info.m_locked == locked) {
+            return;
+        }
+
+        if (isPinned(info)) {
+            info.m_locked = locked;
+            return;
+        }
+
+        auto idx = indexOf(info);
+        unlink(list(info.m_locked), idx);
+        info.m_locked = locked;
+        pushFront(list(locked), idx);
+    }
+
+    void drop(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        auto idx = indexOf(info);
+        unlinkName(idx);
+        unlinkId(idx);
+        if (isPinned(info)) {
+            --m_pinnedCount;
+        }
+        else {
+            unlink(list(info.m_locked), idx);
+        }
+        info = Node();
+        info.m_next = m_free;
+        m_free = idx;
+    }
+
+    /// @brief Forget the topic ID, but keep the entry with its topic name.
+    void clearTopicId(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        setTopicId(info, 0U);
+    }
+
+    /// @brief Check whether one more entry can be pinned.
+    /// @details At least one entry of the fixed size storage must remain
+    ///     evictable to accommodate new registrations.
+    bool canPin() const
+    {
+        return Storage::Growing || ((m_pinnedCount + 1U) < m_nodes.max_size());
+    }
+
+    /// @brief Check whether the entry is excluded from eviction.
+    static bool isPinned(const RegInfo& info)
+    {
+        return info.m_refCount != 0U;
+    }
+
+    /// @brief Add reference to the entry, excluding it from eviction until
+    ///     the last reference is released.
+    /// @return false when the entry cannot be pinned.
+    bool addRef(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        if (info.m_refCount == 0U) {
+            if (!canPin()) {
+                return false;
+            }
+
+            unlink(list(info.m_locked), indexOf(info));
+            ++m_pinnedCount;
+        }
+
+        ++info.m_refCount;
+        return true;
+    }
+
+    /// @brief Release the reference added by addRef().
+    void releaseRef(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        COMMS_ASSERT(0U < info.m_refCount);
+        --info.m_refCount;
+        if (info.m_refCount == 0U) {
+            --m_pinnedCount;
+            pushFront(list(info.m_locked), indexOf(info));
+        }
+    }
+
+    /// @brief Add reference to the entry and return the handle to it.
+    /// @details Every successful call must be balanced by its own unpin().
+    /// @return Handle to the entry, @ref NoHandle when the entry cannot be pinned.
+    Handle pin(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        auto idx = indexOf(info);
+        if ((MaxHandleIndex <= idx) || (!addRef(info))) {
+            return NoHandle;
+        }
+
+        return (static_cast<Handle>(info.m_generation) << 16U) | (static_cast<Handle>(idx) + 1U);
+    }
+
+    /// @brief Release the reference added by pin().
+    void unpin(RegInfo& info)
+    {
+        COMMS_ASSERT(info.m_allocated);
+        if (!isPinned(info)) {
+            return;
+        }
+
+        releaseRef(info);
+    }
+
+    /// @return Entry referenced by the handle, nullptr if it doesn't exist any more.
+    RegInfo* findByHandle(Handle handle)
+    {
+        auto idx = static_cast<std::size_t>(handle & 0xffffU);
+        if ((idx == 0U) || (m_nodes.size() < idx)) {
+            return nullptr;
+        }
+
+        auto& node = m_nodes[idx - 1U];
+        if ((!node.m_allocated) ||
+            (static_cast<Handle>(node.m_generation) != (handle >> 16U))) {
+            return nullptr;
+        }
+
+        return &node;
+    }
+
+private:
+    typedef typename Storage::NodesList NodesList;
+
+    static const std::size_t MaxHandleIndex = 0xffffU;
+
+    std::uint16_t nextGeneration()
+    {
+        ++m_lastGeneration;
+        m_lastGeneration &= MaxGeneration;
+        if (m_lastGeneration == 0U) {
+            m_lastGeneration = 1U;
+        }
+        return m_lastGeneration;
+    }
+
+    static const std::uint16_t MaxGeneration = 0x7fffU;
+    typedef typename Storage::BucketsList BucketsList;
+
+    static std::uint32_t calcHash(const char* topic, std::size_t topicLen)
+    {
+        // FNV-1a
+        std::uint32_t hash = 2166136261U;
+        for (std::size_t idx = 0U; idx < topicLen; ++idx) {
+            hash ^= static_cast<std::uint8_t>(topic[idx]);
+            hash *= 16777619U;
+        }
+        return hash;
+    }
+
+    RegInfo* findByName(const char* topic, std::size_t topicLen, std::uint32_t hash)
+    {
+        auto idx = m_nameBuckets[bucketIdx(hash)];
+        while (idx != NoIndex) {
+            auto& node = m_nodes[idx];
+            if ((node.m_nameHash == hash) &&
+                (node.m_topic.size() == topicLen) &&
+                (std::equal(node.m_topic.begin(), node.m_topic.end(), topic))) {
+                return &node;
+            }
+            idx = node.m_nextByName;
+        }
+        return nullptr;
+    }
+
+    Index indexOf(const RegInfo& info) const
+    {
+        return static_cast<Index>(&info - &m_nodes[0]);
+    }
+
+    ListHead& list(bool locked)
+    {
+        if (locked) {
+            return m_locked;
+        }
+        return m_unlocked;
+    }
+
+    std::size_t bucketIdx(std::uint32_t hash) const
+    {
+        return static_cast<std::size_t>(hash) & (m_idBuckets.size() - 1U);
+    }
+
+    Index allocNode()
+    {
+        if (m_free != NoIndex) {
+            auto idx = m_free;
+            m_free = m_nodes[idx].m_next;
+            m_nodes[idx].m_next = NoIndex;
+            return idx;
+        }
+
+        if (m_nodes.size() < m_nodes.max_size()) {
+            m_nodes.emplace_back();
+            auto idx = static_cast<Index>(m_nodes.size() - 1U);
+            growBuckets(BoolTag<Storage::Growing>());
+            return idx;
+        }
+
+        auto* head = &m_unlocked;
+        if (head->m_last == NoIndex) {
+            head = &m_locked;
+        }
+
+        auto idx = head->m_last;
+        COMMS_ASSERT(idx != NoIndex);
+        drop(m_nodes[idx]);
+        COMMS_ASSERT(m_free == idx);
+        m_free = m_nodes[idx].m_next;
+        m_nodes[idx].m_next = NoIndex;
+        return idx;
+    }
+
+    void setTopicId(RegInfo& info, TTopicId topicId)
+    {
+        if (info.m_topicId == topicId) {
+            return;
+        }
+
+        auto idx = indexOf(info);
+        unlinkId(idx);
+        info.m_topicId = topicId;
+        linkId(idx);
+    }
+
+    void linkId(Index idx)
+    {
+        auto& node = m_nodes[idx];
+        if (node.m_topicId == 0U) {
+            return;
+        }
+
+        auto& bucket = m_idBuckets[bucketIdx(static_cast<std::uint32_t>(node.m_topicId))];
+        node.m_nextById = bucket;
+        bucket = idx;
+    }
+
+    void unlinkId(Index idx)
+    {
+        auto& node = m_nodes[idx];
+        if (node.m_topicId == 0U) {
+            return;
+        }
+
+        auto* next = &m_idBuckets[bucketIdx(static_cast<std::uint32_t>(node.m_topicId))];
+        while (*next != idx) {
+            COMMS_ASSERT(*next != NoIndex);
+            next = &m_nodes[*next].m_nextById;
+        }
+        *next = node.m_nextById;
+        node.m_nextById = NoIndex;
+    }
+
+    void linkName(Index idx)
+    {
+        auto& node = m_nodes[idx];
+        auto& bucket = m_nameBuckets[bucketIdx(node.m_nameHash)];
+        node.m_nextByName = bucket;
+        bucket = idx;
+    }
+
+    void unlinkName(Index idx)
+    {
+        auto& node = m_nodes[idx];
+        auto* next = &m_nameBuckets[bucketIdx(node.m_nameHash)];
+        while (*next != idx) {
+            COMMS_ASSERT(*next != NoIndex);
+            next = &m_nodes[*next].m_nextByName;
+        }
+        *next = node.m_nextByName;
+        node.m_nextByName = NoIndex;
+    }
+
+    void pushFront(ListHead& head, Index idx)
+    {
+        auto& node = m_nodes[idx];
+        node.m_prev = NoIndex;
+        node.m_next = head.m_first;
+        if (head.m_first != NoIndex) {
+            m_nodes[head.m_first].m_prev = idx;
+        }
+        head.m_first = idx;
+        if (head.m_last == NoIndex) {
+            head.m_last = idx;
+        }
+    }
+
+    void unlink(ListHead& head, Index idx)
+    {
+        auto& node = m_nodes[idx];
+        if (node.m_prev != NoIndex) {
+            m_nodes[node.m_prev].m_next = node.m_next;
+        }
+        else {
+            head.m_first = node.m_next;
+        }
+
+        if (node.m_next != NoIndex) {
+            m_nodes[node.m_next].m_prev = node.m_prev;
+        }
+        else {
+            head.m_last = node.m_prev;
+        }
+
+        node.m_prev = NoIndex;
+        node.m_next = NoIndex;
+    }
+
+    template <bool TValue>
+    using BoolTag = std::integral_constant<bool, TValue>;
+
+    void resetBuckets()
+    {
+        resetBuckets(BoolTag<Storage::Growing>());
+    }
+
+    void resetBuckets(BoolTag<false>)
+    {
+        std::fill(m_idBuckets.begin(), m_idBuckets.end(), NoIndex);
+        std::fill(m_nameBuckets.begin(), m_nameBuckets.end(), NoIndex);
+    }
+
+    void resetBuckets(BoolTag<true>)
+    {
+        m_idBuckets.assign(InitialBucketsCount, NoIndex);
+        m_nameBuckets.assign(InitialBucketsCount, NoIndex);
+    }
+
+    void growBuckets(BoolTag<false>)
+    {
+    }
+
+    void growBuckets(BoolTag<true>)
+    {
+        if (m_nodes.size() <= m_idBuckets.size()) {
+            return;
+        }
+
+        auto bucketsCount = m_idBuckets.size() * 2U;
+        m_idBuckets.assign(bucketsCount, NoIndex);
+        m_nameBuckets.assign(bucketsCount, NoIndex);
+        for (std::size_t idx = 0U; idx < m_nodes.size(); ++idx) {
+            auto& node = m_nodes[idx];
+            node.m_nextById = NoIndex;
+            node.m_nextByName = NoIndex;
+            if (!node.m_allocated) {
+                continue;
+            }
+
+            linkName(static_cast<Index>(idx));
+            linkId(static_cast<Index>(idx));
+        }
+    }
+
+    static const std::size_t InitialBucketsCount = 8U;
+
+    NodesList m_nodes;
+    BucketsList m_idBuckets;
+    BucketsList m_nameBuckets;
+    ListHead m_unlocked;
+    ListHead m_locked;
+    Index m_free = NoIndex;
+    std::size_t m_pinnedCount = 0U;
+    std::uint16_t m_lastGeneration = 0U;
+};
+
+template <typename TTopicName, typename TTopicId, typename TOpts>
+const typename RegInfoRegistry<TTopicName, TTopicId, TOpts>::Index
+RegInfoRegistry<TTopicName, TTopicId, TOpts>::NoIndex;
+
+template <typename TTopicName, typename TTopicId, typename TOpts>
+const std::size_t RegInfoRegistry<TTopicName, TTopicId, TOpts>::InitialBucketsCount;
+
+template <typename TTopicName, typename TTopicId, typename TOpts>
+const typename RegInfoRegistry<TTopicName, TTopicId, TOpts>::Handle
+RegInfoRegistry<TTopicName, TTopicId, TOpts>::NoHandle;
+
+template <typename TTopicName, typename TTopicId, typename TOpts>
+const std::size_t RegInfoRegistry<TTopicName, TTopicId, TOpts>::MaxHandleIndex;
+
+template <typename TTopicName, typename TTopicId, typename TOpts>
+const std::uint16_t RegInfoRegistry<TTopicName, TTopicId, TOpts>::MaxGeneration;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
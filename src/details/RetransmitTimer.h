@@ -0,0 +1,128 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <algorithm>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Retransmission timeout calculation as described in RFC 6298.
+/// @details The smoothed round trip time and its variance are kept scaled
+///     (by 8 and 4 respectively) to use integer arithmetic only. The
+///     samples are expected to be taken from the messages sent only
+///     once (Karn's rule). All the values are in milliseconds.
+class RetransmitTimer
+{
+public:
+    static const unsigned DefaultMinTimeout = 200U;
+    static const unsigned DefaultMaxTimeout = 60U * 1000U;
+
+    /// @brief Forget all the samples.
+    /// @param[in] initialTimeout Timeout used until the first sample.
+    void reset(unsigned initialTimeout)
+    {
+        m_srtt8 = 0U;
+        m_rttvar4 = 0U;
+        m_sampled = false;
+        m_initialTimeout = initialTimeout;
+        m_timeout = bound(initialTimeout);
+    }
+
+    void setBounds(unsigned minTimeout, unsigned maxTimeout)
+    {
+        m_minTimeout = std::max(1U, minTimeout);
+        m_maxTimeout = std::max(m_minTimeout, maxTimeout);
+        if (!m_sampled) {
+            m_timeout = bound(m_initialTimeout);
+            return;
+        }
+
+        m_timeout = bound(calcTimeout());
+    }
+
+    void sample(unsigned rtt)
+    {
+        if (!m_sampled) {
+            m_sampled = true;
+            m_srtt8 = rtt << 3U;
+            m_rttvar4 = rtt << 1U;
+        }
+        else {
+            auto srtt = m_srtt8 >> 3U;
+            auto delta = (srtt < rtt) ? (rtt - srtt) : (srtt - rtt);
+            m_srtt8 = m_srtt8 - srtt + rtt;
+            m_rttvar4 = m_rttvar4 - (m_rttvar4 >> 2U) + delta;
+        }
+
+        m_timeout = bound(calcTimeout());
+    }
+
+    /// @brief Double the timeout after its expiry.
+    void backoff()
+    {
+        if ((m_maxTimeout / 2U) < m_timeout) {
+            m_timeout = m_maxTimeout;
+            return;
+        }
+
+        m_timeout *= 2U;
+    }
+
+    unsigned timeout() const
+    {
+        return m_timeout;
+    }
+
+    unsigned srtt() const
+    {
+        return m_srtt8 >> 3U;
+    }
+
+private:
+    unsigned calcTimeout() const
+    {
+        return (m_srtt8 >> 3U) + std::max(1U, m_rttvar4);
+    }
+
+    unsigned bound(unsigned value) const
+    {
+        return std::min(std::max(value, m_minTimeout), m_maxTimeout);
+    }
+
+    unsigned m_srtt8 = 0U;
+    unsigned m_rttvar4 = 0U;
+    unsigned m_initialTimeout = 0U;
+    unsigned m_minTimeout = DefaultMinTimeout;
+    unsigned m_maxTimeout = DefaultMaxTimeout;
+    unsigned m_timeout = 0U;
+    bool m_sampled = false;
+};
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,303 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include "comms/comms.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Intrusive entry of the @ref TimingWheel.
+struct TimingWheelEntry
+{
+    TimingWheelEntry* m_prev = nullptr;
+    TimingWheelEntry* m_next = nullptr;
+    void* m_data = nullptr;
+    std::uint64_t m_expiry = 0U;
+    unsigned m_level = 0U;
+    unsigned m_slot = 0U;
+    bool m_scheduled = false;
+};
+
+/// @brief Hierarchical timing wheel.
+/// @details Every level has 64 slots, each slot of the level covers
+///     64 slots of the level below. Scheduling and cancellation are O(1),
+///     the entries are moved to the lower levels when their slot on the
+///     upper level is reached. Time is measured in abstract ticks
+///     (milliseconds in this library), provided by the owner.
+template <unsigned TLevels = 4U>
+class TimingWheel
+{
+    static const unsigned SlotBits = 6U;
+    static const unsigned SlotsCount = 1U << SlotBits;
+    static const std::uint64_t SlotMask = SlotsCount - 1U;
+    static const std::uint64_t MaxDelta = (std::uint64_t(1U) << (TLevels * SlotBits)) - 1U;
+
+    static_assert(0U < TLevels, "At least one level is required");
+    static_assert(TLevels * SlotBits < 64U, "Too many levels");
+
+public:
+    typedef TimingWheelEntry Entry;
+
+    static const std::uint64_t NoExpiry = std::numeric_limits<std::uint64_t>::max();
+
+    explicit TimingWheel(std::uint64_t now = 0U)
+      : m_now(now)
+    {
+        for (auto& level : m_slots) {
+            for (auto& slot : level) {
+                slot = nullptr;
+            }
+        }
+
+        for (auto& bits : m_occupied) {
+            bits = 0U;
+        }
+    }
+
+    std::uint64_t now() const
+    {
+        return m_now;
+    }
+
+    bool empty() const
+    {
+        return m_count == 0U;
+    }
+
+    /// @brief Schedule (or re-schedule) the entry to expire at the given time.
+    /// @details Expiry in the past or at the current time is treated as the
+    ///     next tick.
+    void schedule(Entry& entry, std::uint64_t expiry)
+    {
+        if (entry.m_scheduled) {
+            cancel(entry);
+        }
+
+        entry.m_expiry = std::max(expiry, m_now + 1U);
+        entry.m_scheduled = true;
+        ++m_count;
+        place(entry);
+    }
+
+    void cancel(Entry& entry)
+    {
+        if (!entry.m_scheduled) {
+            return;
+        }
+
+        unlink(entry);
+        entry.m_scheduled = false;
+        COMMS_ASSERT(0U < m_count);
+        --m_count;
+    }
+
+    /// @brief Time of the next event to be processed by advance().
+    /// @details It is either expiry of some entry or time when the entries
+    ///     need to be moved to the lower level, @ref NoExpiry if the
+    ///     wheel is empty.
+    std::uint64_t nextEvent() const
+    {
+        std::uint64_t result = NoExpiry;
+        for (unsigned level = 0U; level < TLevels; ++level) {
+            auto bits = m_occupied[level];
+            if (bits == 0U) {
+                continue;
+            }
+
+            auto shift = level * SlotBits;
+            auto currIdx = static_cast<unsigned>((m_now >> shift) & SlotMask);
+            // Rotate so that bit 0 corresponds to the slot after the current one
+            auto rotShift = (currIdx + 1U) & SlotMask;
+            auto rotated = rotr(bits, rotShift);
+            auto dist = static_cast<std::uint64_t>(ctz(rotated)) + 1U;
+            auto eventTime = (((m_now >> shift) + dist) << shift);
+            result = std::min(result, eventTime);
+        }
+        return result;
+    }
+
+    /// @brief Advance the time, invoking the provided function for every
+    ///     expired entry.
+    /// @details The entry is no longer scheduled when the function is
+    ///     invoked, it may be re-scheduled from within the function.
+    template <typename TFunc>
+    void advance(std::uint64_t now, TFunc&& func)
+    {
+        while (m_now < now) {
+            auto eventTime = nextEvent();
+            if (now < eventTime) {
+                m_now = now;
+                break;
+            }
+
+            m_now = eventTime;
+
+            for (auto level = TLevels - 1U; 0U < level; --level) {
+                auto shift = level * SlotBits;
+                if ((m_now & ((std::uint64_t(1U) << shift) - 1U)) != 0U) {
+                    continue;
+                }
+
+                cascade(level, static_cast<unsigned>((m_now >> shift) & SlotMask));
+            }
+
+            auto& head = m_slots[0][m_now & SlotMask];
+            while (head != nullptr) {
+                auto* entry = head;
+                if (m_now < entry->m_expiry) {
+                    // Expiry beyond the wheel's range
+                    unlink(*entry);
+                    place(*entry);
+                    continue;
+                }
+
+                cancel(*entry);
+                func(*entry);
+            }
+        }
+    }
+
+private:
+    static unsigned ctz(std::uint64_t value)
+    {
+        COMMS_ASSERT(value != 0U);
+        unsigned result = 0U;
+        while ((value & 0x1U) == 0U) {
+            value >>= 1U;
+            ++result;
+        }
+        return result;
+    }
+
+    static std::uint64_t rotr(std::uint64_t value, unsigned shift)
+    {
+        if (shift == 0U) {
+            return value;
+        }
+        return (value >> shift) | (value << (SlotsCount - shift));
+    }
+
+    void place(Entry& entry)
+    {
+        auto expiry = std::min(entry.m_expiry, m_now + MaxDelta);
+        auto delta = expiry - m_now;
+        COMMS_ASSERT(0U < delta);
+
+        unsigned level = 0U;
+        while ((level + 1U < TLevels) && ((delta >> ((level + 1U) * SlotBits)) != 0U)) {
+            ++level;
+        }
+
+        entry.m_level = level;
+        entry.m_slot = static_cast<unsigned>((expiry >> (level * SlotBits)) & SlotMask);
+        auto& head = m_slots[level][entry.m_slot];
+        entry.m_prev = nullptr;
+        entry.m_next = head;
+        if (head != nullptr) {
+            head->m_prev = &entry;
+        }
+        head = &entry;
+        m_occupied[level] |= (std::uint64_t(1U) << entry.m_slot);
+    }
+
+    void unlink(Entry& entry)
+    {
+        auto& head = m_slots[entry.m_level][entry.m_slot];
+        if (entry.m_prev != nullptr) {
+            entry.m_prev->m_next = entry.m_next;
+        }
+        else {
+            head = entry.m_next;
+        }
+
+        if (entry.m_next != nullptr) {
+            entry.m_next->m_prev = entry.m_prev;
+        }
+
+        entry.m_prev = nullptr;
+        entry.m_next = nullptr;
+        if (head == nullptr) {
+            m_occupied[entry.m_level] &= ~(std::uint64_t(1U) << entry.m_slot);
+        }
+    }
+
+    void cascade(unsigned level, unsigned slot)
+    {
+        auto* entry = m_slots[level][slot];
+        m_slots[level][slot] = nullptr;
+        m_occupied[level] &= ~(std::uint64_t(1U) << slot);
+        while (entry != nullptr) {
+            auto* next = entry->m_next;
+            if (entry->m_expiry <= m_now) {
+                // Expires right now
+                entry->m_level = 0U;
+                entry->m_slot = static_cast<unsigned>(m_now & SlotMask);
+                auto& head = m_slots[0][entry->m_slot];
+                entry->m_prev = nullptr;
+                entry->m_next = head;
+                if (head != nullptr) {
+                    head->m_prev = entry;
+                }
+                head = entry;
+                m_occupied[0] |= (std::uint64_t(1U) << entry->m_slot);
+            }
+            else {
+                place(*entry);
+            }
+            entry = next;
+        }
+    }
+
+    Entry* m_slots[TLevels][SlotsCount];
+    std::uint64_t m_occupied[TLevels];
+    std::uint64_t m_now = 0U;
+    std::size_t m_count = 0U;
+};
+
+template <unsigned TLevels>
+const std::uint64_t TimingWheel<TLevels>::NoExpiry;
+
+template <unsigned TLevels>
+const unsigned TimingWheel<TLevels>::SlotBits;
+
+template <unsigned TLevels>
+const unsigned TimingWheel<TLevels>::SlotsCount;
+
+template <unsigned TLevels>
+const std::uint64_t TimingWheel<TLevels>::SlotMask;
+
+template <unsigned TLevels>
+const std::uint64_t TimingWheel<TLevels>::MaxDelta;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -0,0 +1,132 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <algorithm>
+
+#include "mqttsn/client/common.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+/// @brief Trace when not configured, records nothing.
+class NoTraceRing
+{
+public:
+    static const bool Enabled = false;
+
+    void setClock(MqttsnTraceClockFn, void*) {}
+    void record(unsigned long long, MqttsnTraceEvent, MqttsnStatsOp, unsigned, unsigned) {}
+
+    std::size_t copy(MqttsnTraceEntry*, std::size_t) const
+    {
+        return 0U;
+    }
+};
+
+/// @brief Fixed size ring of the latest trace events.
+/// @details Recording overwrites the oldest entry, it doesn't allocate
+///     nor check anything but the optional clock callback.
+template <std::size_t TSize>
+class TraceRing
+{
+    static_assert((TSize != 0U) && ((TSize & (TSize - 1U)) == 0U),
+        "The trace ring size must be a power of two");
+
+public:
+    static const bool Enabled = true;
+
+    void setClock(MqttsnTraceClockFn fn, void* data)
+    {
+        m_clockFn = fn;
+        m_clockData = data;
+    }
+
+    void record(
+        unsigned long long timestamp,
+        MqttsnTraceEvent event,
+        MqttsnStatsOp op,
+        unsigned arg,
+        unsigned key)
+    {
+        auto& entry = m_entries[m_next & (TSize - 1U)];
+        ++m_next;
+        if (m_count < TSize) {
+            ++m_count;
+        }
+
+        entry.timestamp = timestamp;
+        entry.cycles = (m_clockFn != nullptr) ? m_clockFn(m_clockData) : 0U;
+        entry.event = static_cast<unsigned char>(event);
+        entry.op = static_cast<unsigned char>(op);
+        entry.arg = static_cast<unsigned short>(arg);
+        entry.key = key;
+    }
+
+    /// @brief Copy the latest entries, the oldest first.
+    std::size_t copy(MqttsnTraceEntry* buf, std::size_t count) const
+    {
+        count = std::min(count, m_count);
+        auto idx = m_next - count;
+        for (std::size_t pos = 0U; pos < count; ++pos, ++idx) {
+            buf[pos] = m_entries[idx & (TSize - 1U)];
+        }
+        return count;
+    }
+
+private:
+    std::array<MqttsnTraceEntry, TSize> m_entries;
+    std::size_t m_next = 0U;
+    std::size_t m_count = 0U;
+    MqttsnTraceClockFn m_clockFn = nullptr;
+    void* m_clockData = nullptr;
+};
+
+template <typename TOpts, bool THasTraceRing>
+struct TraceRingType;
+
+template <typename TOpts>
+struct TraceRingType<TOpts, true>
+{
+    typedef TraceRing<TOpts::TraceRingSize> Type;
+};
+
+template <typename TOpts>
+struct TraceRingType<TOpts, false>
+{
+    typedef NoTraceRing Type;
+};
+
+template <typename TOpts>
+using TraceRingTypeT =
+    typename TraceRingType<TOpts, TOpts::HasTraceRingSize>::Type;
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
@@ -18,6 +18,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 #include "comms/comms.h"
 
 namespace mqttsn
@@ -57,7 +61,8 @@ class WriteBufStorageType<TOpts, true>
     static const std::size_t MaxOverhead = 10U;
 
 public:
-    typedef comms::util::StaticVector<std::uint8_t, FinalSize + MaxOverhead> Type;
+    static const std::size_t Capacity = FinalSize + MaxOverhead;
+    typedef comms::util::StaticVector<std::uint8_t, Capacity> Type;
 
 };
 
@@ -78,6 +83,113 @@ using WriteBufStorageTypeT =
         TOpts::HasMessageDataStaticStorageSize
     >::Type;
 
+/// @brief Internal write buffer, grows up to the largest sent frame.
+template <typename TStorage>
+class WriteBuf
+{
+public:
+    static const bool Enabled = true;
+
+    /// @return Pointer to at least @b len bytes, nullptr when they don't fit.
+    std::uint8_t* reserve(std::size_t len)
+    {
+        if ((len == 0U) || (m_buf.max_size() < len)) {
+            return nullptr;
+        }
+
+        m_buf.resize(std::max(m_buf.size(), len));
+        return &m_buf[0];
+    }
+
+private:
+    TStorage m_buf;
+};
+
+/// @brief No internal write buffer, the frames are serialised into the
+///     buffers provided by the transport.
+class NoWriteBuf
+{
+public:
+    static const bool Enabled = false;
+
+    std::uint8_t* reserve(std::size_t)
+    {
+        return nullptr;
+    }
+};
+
+template <typename TOpts, bool THasOutputBufferProvider>
+class WriteBufType;
+
+template <typename TOpts>
+class WriteBufType<TOpts, true>
+{
+public:
+    typedef NoWriteBuf Type;
+};
+
+template <typename TOpts>
+class WriteBufType<TOpts, false>
+{
+public:
+    typedef WriteBuf<WriteBufStorageTypeT<TOpts> > Type;
+};
+
+template <typename TOpts>
+using WriteBufTypeT =
+    typename WriteBufType<TOpts, TOpts::HasOutputBufferProvider>::Type;
+
+template <typename TOpts, bool TAllStatic>
+class OutputBatchBufStorageType;
+
+template <typename TOpts>
+class OutputBatchBufStorageType<TOpts, true>
+{
+    static const std::size_t Capacity =
+        WriteBufStorageType<TOpts, true>::Capacity * TOpts::OutputBatchFramesLimit;
+public:
+    typedef comms::util::StaticVector<std::uint8_t, Capacity> Type;
+};
+
+template <typename TOpts>
+class OutputBatchBufStorageType<TOpts, false>
+{
+public:
+    typedef std::vector<std::uint8_t> Type;
+};
+
+template <typename TOpts>
+using OutputBatchBufStorageTypeT =
+    typename OutputBatchBufStorageType<
+        TOpts,
+        TOpts::HasGwAddStaticStorageSize &&
+        TOpts::HasClientIdStaticStorageSize &&
+        TOpts::HasTopicNameStaticStorageSize &&
+        TOpts::HasMessageDataStaticStorageSize &&
+        TOpts::HasOutputBatchFramesLimit
+    >::Type;
+
+template <typename TFrame, typename TOpts, bool THasOutputBatchFramesLimit>
+class OutputBatchFramesStorageType;
+
+template <typename TFrame, typename TOpts>
+class OutputBatchFramesStorageType<TFrame, TOpts, true>
+{
+public:
+    typedef comms::util::StaticVector<TFrame, TOpts::OutputBatchFramesLimit> Type;
+};
+
+template <typename TFrame, typename TOpts>
+class OutputBatchFramesStorageType<TFrame, TOpts, false>
+{
+public:
+    typedef std::vector<TFrame> Type;
+};
+
+template <typename TFrame, typename TOpts>
+using OutputBatchFramesStorageTypeT =
+    typename OutputBatchFramesStorageType<TFrame, TOpts, TOpts::HasOutputBatchFramesLimit>::Type;
+
 
 }  // namespace details
 
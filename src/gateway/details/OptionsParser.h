@@ -0,0 +1,138 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <tuple>
+
+#include "gateway/option.h"
+
+namespace mqttsn
+{
+
+namespace gateway
+{
+
+namespace details
+{
+
+template <typename... TOptions>
+class OptionsParser;
+
+template <>
+class OptionsParser<>
+{
+public:
+    static const bool HasSessionsLimit = false;
+    static const bool HasTopicsLimit = false;
+    static const bool HasSessionTopicsLimit = false;
+    static const bool HasMaxPendingInboundQos2 = false;
+    static const bool HasClientIdStaticStorageSize = false;
+    static const bool HasTopicNameStaticStorageSize = false;
+    static const bool HasMessageDataStaticStorageSize = false;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::SessionsLimit<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::SessionsLimit<TLimit> Option;
+public:
+    static const bool HasSessionsLimit = true;
+    static const std::size_t SessionsLimit = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::TopicsLimit<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::TopicsLimit<TLimit> Option;
+public:
+    static const bool HasTopicsLimit = true;
+    static const std::size_t TopicsLimit = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::SessionTopicsLimit<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::SessionTopicsLimit<TLimit> Option;
+public:
+    static const bool HasSessionTopicsLimit = true;
+    static const std::size_t SessionTopicsLimit = Option::Value;
+};
+
+template <std::size_t TLimit, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::MaxPendingInboundQos2<TLimit>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::MaxPendingInboundQos2<TLimit> Option;
+public:
+    static const bool HasMaxPendingInboundQos2 = true;
+    static const std::size_t MaxPendingInboundQos2 = Option::Value;
+};
+
+template <std::size_t TSize, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::ClientIdStaticStorageSize<TSize>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::ClientIdStaticStorageSize<TSize> Option;
+public:
+    static const bool HasClientIdStaticStorageSize = true;
+    static const std::size_t ClientIdStaticStorageSize = Option::Value;
+};
+
+template <std::size_t TSize, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::TopicNameStaticStorageSize<TSize>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::TopicNameStaticStorageSize<TSize> Option;
+public:
+    static const bool HasTopicNameStaticStorageSize = true;
+    static const std::size_t TopicNameStaticStorageSize = Option::Value;
+};
+
+template <std::size_t TSize, typename... TOptions>
+class OptionsParser<
+    mqttsn::gateway::option::MessageDataStaticStorageSize<TSize>,
+    TOptions...> : public OptionsParser<TOptions...>
+{
+    typedef mqttsn::gateway::option::MessageDataStaticStorageSize<TSize> Option;
+public:
+    static const bool HasMessageDataStaticStorageSize = true;
+    static const std::size_t MessageDataStaticStorageSize = Option::Value;
+};
+
+template <typename... TTupleOptions, typename... TOptions>
+class OptionsParser<
+    std::tuple<TTupleOptions...>,
+    TOptions...> : public OptionsParser<TTupleOptions..., TOptions...>
+{
+};
+
+}  // namespace details
+
+}  // namespace gateway
+
+}  // namespace mqttsn
@@ -0,0 +1,244 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <type_traits>
+#include <array>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <algorithm>
+
+#include "comms/comms.h"
+#include "mqttsn/gateway/common.h"
+
+namespace mqttsn
+{
+
+namespace gateway
+{
+
+namespace details
+{
+
+constexpr std::size_t sessionBucketsCount(std::size_t limit, std::size_t result = 1U)
+{
+    return (limit <= result) ? result : sessionBucketsCount(limit, result << 1U);
+}
+
+template <typename TNode, typename TOpts, bool THasSessionsLimit>
+struct SessionPoolStorage;
+
+template <typename TNode, typename TOpts>
+struct SessionPoolStorage<TNode, TOpts, true>
+{
+    static const bool Growing = false;
+    static const std::size_t BucketsCount = sessionBucketsCount(TOpts::SessionsLimit);
+    typedef comms::util::StaticVector<TNode, TOpts::SessionsLimit> NodesList;
+    typedef std::array<std::uint32_t, BucketsCount> BucketsList;
+};
+
+template <typename TNode, typename TOpts>
+struct SessionPoolStorage<TNode, TOpts, false>
+{
+    static const bool Growing = true;
+    // Deque doesn't relocate existing elements when growing
+    typedef std::deque<TNode> NodesList;
+    typedef std::vector<std::uint32_t> BucketsList;
+};
+
+/// @brief Pool of the client sessions indexed by their peer ID.
+/// @details The sessions never move in memory once allocated. The released
+///     sessions are kept in the free list and reused. Lookup by the peer ID
+///     is O(1) using chained hash index.
+/// @tparam TSession Session type, expected to be default constructible and
+///     to have @b m_peer data member of @ref MqttsnGwPeerId type.
+template <typename TSession, typename TOpts>
+class SessionPool
+{
+    static const std::uint32_t NoIndex = static_cast<std::uint32_t>(-1);
+    static const std::size_t InitialBucketsCount = 64U;
+
+    struct Node
+    {
+        TSession m_session;
+        std::uint32_t m_next = NoIndex;
+        bool m_allocated = false;
+    };
+
+    typedef SessionPoolStorage<Node, TOpts, TOpts::HasSessionsLimit> Storage;
+
+public:
+    SessionPool()
+    {
+        resetBuckets(BoolTag<Storage::Growing>());
+    }
+
+    std::size_t size() const
+    {
+        return m_count;
+    }
+
+    TSession* find(MqttsnGwPeerId peer)
+    {
+        auto idx = m_buckets[bucketIdx(peer)];
+        while (idx != NoIndex) {
+            auto& node = m_nodes[idx];
+            if (node.m_session.m_peer == peer) {
+                return &node.m_session;
+            }
+            idx = node.m_next;
+        }
+        return nullptr;
+    }
+
+    /// @brief Allocate new session for the peer.
+    /// @pre There is no session for the peer.
+    /// @return Default constructed session, NULL if the pool is exhausted.
+    TSession* alloc(MqttsnGwPeerId peer)
+    {
+        COMMS_ASSERT(find(peer) == nullptr);
+        std::uint32_t idx = NoIndex;
+        if (m_free != NoIndex) {
+            idx = m_free;
+            m_free = m_nodes[idx].m_next;
+        }
+        else if (m_nodes.size() < m_nodes.max_size()) {
+            m_nodes.emplace_back();
+            idx = static_cast<std::uint32_t>(m_nodes.size() - 1U);
+        }
+        else {
+            return nullptr;
+        }
+
+        ++m_count;
+        growBuckets(BoolTag<Storage::Growing>());
+
+        auto& node = m_nodes[idx];
+        node.m_allocated = true;
+        node.m_session.m_peer = peer;
+
+        auto& bucket = m_buckets[bucketIdx(peer)];
+        node.m_next = bucket;
+        bucket = idx;
+        return &node.m_session;
+    }
+
+    void release(MqttsnGwPeerId peer)
+    {
+        auto* next = &m_buckets[bucketIdx(peer)];
+        while (*next != NoIndex) {
+            auto idx = *next;
+            auto& node = m_nodes[idx];
+            if (node.m_session.m_peer != peer) {
+                next = &node.m_next;
+                continue;
+            }
+
+            *next = node.m_next;
+            node.m_session = TSession();
+            node.m_allocated = false;
+            node.m_next = m_free;
+            m_free = idx;
+            COMMS_ASSERT(0U < m_count);
+            --m_count;
+            return;
+        }
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+        m_free = NoIndex;
+        m_count = 0U;
+        resetBuckets(BoolTag<Storage::Growing>());
+    }
+
+    template <typename TFunc>
+    void forEach(TFunc&& func)
+    {
+        for (auto& node : m_nodes) {
+            if (node.m_allocated) {
+                func(node.m_session);
+            }
+        }
+    }
+
+private:
+    typedef typename Storage::NodesList NodesList;
+    typedef typename Storage::BucketsList BucketsList;
+
+    template <bool TValue>
+    using BoolTag = std::integral_constant<bool, TValue>;
+
+    std::size_t bucketIdx(MqttsnGwPeerId peer) const
+    {
+        auto hash = static_cast<std::uint64_t>(peer) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<std::size_t>(hash >> 32U) & (m_buckets.size() - 1U);
+    }
+
+    void resetBuckets(BoolTag<false>)
+    {
+        std::fill(m_buckets.begin(), m_buckets.end(), NoIndex);
+    }
+
+    void resetBuckets(BoolTag<true>)
+    {
+        m_buckets.assign(InitialBucketsCount, NoIndex);
+    }
+
+    void growBuckets(BoolTag<false>)
+    {
+    }
+
+    void growBuckets(BoolTag<true>)
+    {
+        if (m_count <= m_buckets.size()) {
+            return;
+        }
+
+        m_buckets.assign(m_buckets.size() * 2U, NoIndex);
+        for (std::size_t idx = 0U; idx < m_nodes.size(); ++idx) {
+            auto& node = m_nodes[idx];
+            if (!node.m_allocated) {
+                continue;
+            }
+
+            auto& bucket = m_buckets[bucketIdx(node.m_session.m_peer)];
+            node.m_next = bucket;
+            bucket = static_cast<std::uint32_t>(idx);
+        }
+    }
+
+    NodesList m_nodes;
+    BucketsList m_buckets;
+    std::uint32_t m_free = NoIndex;
+    std::size_t m_count = 0U;
+};
+
+template <typename TSession, typename TOpts>
+const std::uint32_t SessionPool<TSession, TOpts>::NoIndex;
+
+template <typename TSession, typename TOpts>
+const std::size_t SessionPool<TSession, TOpts>::InitialBucketsCount;
+
+}  // namespace details
+
+}  // namespace gateway
+
+}  // namespace mqttsn
@@ -86,6 +86,78 @@ typedef enum
     MqttsnAsyncOpStatus_Aborted, ///< The operation was cancelled using mqttsn_client_cancel() call.
 } MqttsnAsyncOpStatus;
 
+/// @brief Policy applied when the outbound queue is full.
+typedef enum
+{
+    MqttsnOutboundQueuePolicy_DropOldest, ///< Drop the oldest queued message, reported as @ref MqttsnAsyncOpStatus_Aborted.
+    MqttsnOutboundQueuePolicy_DropNewest, ///< Reject the new message with @ref MqttsnErrorCode_Busy.
+    MqttsnOutboundQueuePolicy_ValuesLimit ///< Limit for the values
+} MqttsnOutboundQueuePolicy;
+
+/// @brief Operation kinds tracked separately in @ref MqttsnClientStats.
+typedef enum
+{
+    MqttsnStatsOp_Connect, ///< CONNECT, including will topic and message exchange.
+    MqttsnStatsOp_Disconnect, ///< DISCONNECT, including entering the sleep mode.
+    MqttsnStatsOp_Register, ///< REGISTER issued as part of publish.
+    MqttsnStatsOp_Publish, ///< PUBLISH (and PUBREL) with QoS1 or QoS2.
+    MqttsnStatsOp_Subscribe, ///< SUBSCRIBE.
+    MqttsnStatsOp_Unsubscribe, ///< UNSUBSCRIBE.
+    MqttsnStatsOp_WillUpdate, ///< WILLTOPICUPD and WILLMSGUPD.
+    MqttsnStatsOp_Ping, ///< PINGREQ, including checking for messages while asleep.
+    MqttsnStatsOp_ValuesLimit ///< Limit for the values
+} MqttsnStatsOp;
+
+/// @brief Number of tracked message types, indexed by MQTT-SN message type value.
+#define MQTTSN_STATS_MSG_TYPES_LIMIT 0x1eU
+
+/// @brief Number of round trip time histogram buckets.
+/// @details Bucket @b 0 counts round trips shorter than 1 ms, bucket @b N
+///     counts the ones in range [2^(N-1), 2^N) ms, the last bucket counts
+///     everything longer.
+#define MQTTSN_STATS_RTT_BUCKETS 18U
+
+/// @brief Client statistics, retrieved with mqttsn_client_get_stats().
+/// @details All the counters are monotonic since creation of the client.
+typedef struct
+{
+    unsigned long msgsSent[MQTTSN_STATS_MSG_TYPES_LIMIT]; ///< Sent messages per message type.
+    unsigned long msgsReceived[MQTTSN_STATS_MSG_TYPES_LIMIT]; ///< Received messages per message type.
+    unsigned long long bytesSent; ///< Total bytes of the sent messages.
+    unsigned long long bytesReceived; ///< Total bytes of the successfully parsed received messages.
+    unsigned long framesDropped; ///< Received data that could not be parsed.
+    unsigned long invalidTopicAcks; ///< PUBACK reporting invalid topic ID.
+    unsigned long pingTimeouts; ///< PINGREQ left without response.
+    unsigned long retransmits[MqttsnStatsOp_ValuesLimit]; ///< Resent requests per operation kind.
+    unsigned long rtt[MqttsnStatsOp_ValuesLimit][MQTTSN_STATS_RTT_BUCKETS]; ///< Round trip time histograms per operation kind.
+} MqttsnClientStats;
+
+/// @brief Kind of the event recorded in @ref MqttsnTraceEntry.
+typedef enum
+{
+    MqttsnTraceEvent_OpStart, ///< Operation started by the API call (or the queue / journal replay).
+    MqttsnTraceEvent_OpRetry, ///< Request resent, @b arg is the attempt number.
+    MqttsnTraceEvent_OpComplete, ///< Completion callback is about to be invoked, @b arg is @ref MqttsnAsyncOpStatus.
+    MqttsnTraceEvent_MsgSent, ///< Message sent, @b arg is MQTT-SN message type.
+    MqttsnTraceEvent_MsgReceived, ///< Message received, @b arg is MQTT-SN message type.
+    MqttsnTraceEvent_DataDropped, ///< Received data could not be parsed.
+    MqttsnTraceEvent_ValuesLimit ///< Limit for the values
+} MqttsnTraceEvent;
+
+/// @brief Entry of the trace ring, retrieved with mqttsn_client_get_trace().
+typedef struct
+{
+    unsigned long long timestamp; ///< Library's time in milliseconds.
+    unsigned cycles; ///< Value returned by the trace clock callback, 0 when not set.
+    unsigned char event; ///< @ref MqttsnTraceEvent.
+    unsigned char op; ///< @ref MqttsnStatsOp, @ref MqttsnStatsOp_ValuesLimit for the events not related to operation.
+    unsigned short arg; ///< Event specific argument.
+    unsigned key; ///< 0 for the single outstanding operation, publish slot index + 1 for the publishes.
+} MqttsnTraceEntry;
+
+/// @brief Callback used to read a high resolution counter (CPU cycles) for trace entries.
+typedef unsigned (*MqttsnTraceClockFn)(void* data);
+
 /// @brief Handler used to access client specific data structures.
 /// @details Returned by mqttsn_client_new() function.
 typedef void* MqttsnClientHandle;
@@ -93,6 +165,12 @@ typedef void* MqttsnClientHandle;
 /// @brief Type used to hold Topic ID value.
 typedef unsigned short MqttsnTopicId;
 
+/// @brief Handle of the topic resolved with mqttsn_client_resolve_topic().
+typedef unsigned MqttsnTopicHandle;
+
+/// @brief Value of @ref MqttsnTopicHandle indicating failure to resolve the topic.
+#define MQTTSN_INVALID_TOPIC_HANDLE 0U
+
 /// @brief Will Information
 typedef struct
 {
@@ -114,6 +192,53 @@ typedef struct
     bool retain; ///< Retain flag of the message.
 } MqttsnMessageInfo;
 
+/// @brief Persistent storage of the outbound publishes journal.
+/// @details The storage is split into equal sectors (at least two). The
+///     journal appends records sequentially, never across the sector
+///     boundary, and erases the sector before reusing it. The state of
+///     the written record is only updated by clearing bits, so NOR flash
+///     can program it in place. All the written data is expected to become
+///     persistent when @b commit is invoked, which happens once per batch
+///     of library's processing.
+typedef struct
+{
+    unsigned size; ///< Total size of the storage in bytes, multiple of sectorSize.
+    unsigned sectorSize; ///< Size of the erase unit in bytes.
+    void (*read)(void* data, unsigned offset, unsigned char* buf, unsigned len); ///< Read stored bytes.
+    void (*write)(void* data, unsigned offset, const unsigned char* buf, unsigned len); ///< Write bytes, may be cached until commit.
+    void (*erase)(void* data, unsigned offset, unsigned len); ///< Erase the sector (all bytes read as 0xff afterwards). May be NULL, then 0xff bytes are written.
+    void (*commit)(void* data); ///< Make all the written data persistent (fsync, sector program).
+    void* data; ///< User data passed as first parameter to all the functions above.
+} MqttsnJournalStore;
+
+/// @brief Callback used to report outbound publish that is no longer kept
+///     in the journal.
+/// @details The callback is set using
+///     mqttsn_client_set_journal_drop_report_callback() function.
+///     Invoked when the record is too big for the journal sector or when
+///     there is no room left for it, because the storage is full of other
+///     pending records. The publish itself proceeds, but it is not going to
+///     be resent after reboot.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_journal_drop_report_callback() function.
+/// @param[in] msgId Message ID of the dropped publish.
+typedef void (*MqttsnJournalDropReportFn)(void* data, unsigned short msgId);
+
+/// @brief Received datagram information
+typedef struct
+{
+    const unsigned char* buf; ///< Pointer to the buffer containing datagram data.
+    unsigned bufLen; ///< Number of bytes in the datagram.
+} MqttsnDatagram;
+
+/// @brief Output frame information
+typedef struct
+{
+    const unsigned char* buf; ///< Pointer to the buffer containing frame data.
+    unsigned bufLen; ///< Number of bytes in the frame.
+    bool broadcast; ///< Indication whether frame needs to be broadcasted or sent directly to the gateway.
+} MqttsnOutputFrame;
+
 /// @brief Callback used to request time measurement.
 /// @details The callback is set using
 ///     mqttsn_client_set_next_tick_program_callback() function.
@@ -146,6 +271,71 @@ typedef unsigned (*MqttsnCancelNextTickWaitFn)(void* data);
 ///     sent directly to the gateway.
 typedef void (*MqttsnSendOutputDataFn)(void* data, const unsigned char* buf, unsigned bufLen, bool broadcast);
 
+/// @brief Callback used to request to send multiple frames to the gateway.
+/// @details The callback is set using
+///     mqttsn_client_set_send_output_batch_callback() function. All the
+///     frames produced during single call to the library are reported
+///     together, residing back to back in the single buffer. The
+///     reported data resides in internal data structures of the client library,
+///     and it can be updated right after the callback function returns.
+///     The callback is not allowed to invoke any other library function.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_send_output_batch_callback() function.
+/// @param[in] frames Pointer to the list of frames to send, every frame
+///     needs to be sent as a separate datagram.
+/// @param[in] count Number of frames in the list.
+typedef void (*MqttsnSendOutputBatchFn)(void* data, const MqttsnOutputFrame* frames, unsigned count);
+
+/// @brief Single element of the frame sent in parts.
+typedef struct
+{
+    const unsigned char* buf; ///< Pointer to the part data.
+    unsigned bufLen; ///< Number of bytes in the part.
+} MqttsnIoVec;
+
+/// @brief Callback used to request to send a frame composed of several parts.
+/// @details The callback is set using
+///     mqttsn_client_set_send_output_vec_callback() function. The parts
+///     need to be sent back to back as a single datagram (for example with
+///     @b sendmsg() on Linux). The PUBLISH messages are reported as the
+///     header serialised by the library followed by the message data
+///     provided by the application, other messages are reported as a single
+///     part. The reported data can be updated right after the callback
+///     function returns.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_send_output_vec_callback() function.
+/// @param[in] vec Pointer to the list of parts.
+/// @param[in] count Number of parts in the list.
+/// @param[in] broadcast Indication whether data needs to be broadcasted or
+///     sent directly to the gateway.
+typedef void (*MqttsnSendOutputVecFn)(void* data, const MqttsnIoVec* vec, unsigned count, bool broadcast);
+
+/// @brief Callback used to request a transport buffer to serialise the frame into.
+/// @details The callback is set using
+///     mqttsn_client_set_output_buffer_provider() function. The library
+///     writes the whole frame into the returned buffer and passes it to
+///     the @ref MqttsnCommitOutputBufFn callback right away.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_output_buffer_provider() function.
+/// @param[in] bufLen Number of bytes required for the frame.
+/// @param[in] broadcast Indication whether the frame needs to be broadcasted
+///     or sent directly to the gateway.
+/// @return Pointer to the writable buffer of at least @b bufLen bytes,
+///     NULL when there is none available, the frame is dropped then (and
+///     resent like a lost one when acknowledgement is expected).
+typedef unsigned char* (*MqttsnAllocOutputBufFn)(void* data, unsigned bufLen, bool broadcast);
+
+/// @brief Callback used to send the frame serialised into the buffer
+///     returned by @ref MqttsnAllocOutputBufFn.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_output_buffer_provider() function.
+/// @param[in] buf Pointer to the buffer returned by the allocation callback.
+/// @param[in] bufLen Number of bytes in the frame, 0 when the buffer needs to
+///     be released without sending anything.
+/// @param[in] broadcast Indication whether the frame needs to be broadcasted
+///     or sent directly to the gateway.
+typedef void (*MqttsnCommitOutputBufFn)(void* data, unsigned char* buf, unsigned bufLen, bool broadcast);
+
 /// @brief Callback used to report gateway status.
 /// @details The callback is set using
 ///     mqttsn_client_set_gw_status_report_callback() function.
@@ -183,6 +373,25 @@ typedef void (*MqttsnSubscribeCompleteReportFn)(void* data, MqttsnAsyncOpStatus
 /// @param[in] msgInfo Information about incoming message.
 typedef void (*MqttsnMessageReportFn)(void* data, const MqttsnMessageInfo* msgInfo);
 
+/// @brief Callback used to return ownership of the buffer loaned to the library.
+/// @details The callback is set using
+///     mqttsn_client_set_buffer_release_callback() function. It is invoked
+///     exactly once for every buffer passed to
+///     mqttsn_client_process_loaned_data(), either before the latter returns
+///     or later, when the held exactly-once message has been reported.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_buffer_release_callback() function.
+/// @param[in] buf Pointer to the released buffer, the same as passed to
+///     mqttsn_client_process_loaned_data().
+typedef void (*MqttsnBufferReleaseFn)(void* data, const unsigned char* buf);
+
+/// @brief Callback used to report the outbound queue reaching its high water mark.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_client_set_outbound_queue_report_callback() function.
+/// @param[in] count Number of the queued messages.
+/// @param[in] dropped Total number of messages dropped due to queue being full.
+typedef void (*MqttsnOutboundQueueReportFn)(void* data, unsigned count, unsigned dropped);
+
 #ifdef __cplusplus
 }
 #endif
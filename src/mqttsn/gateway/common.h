@@ -0,0 +1,99 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Common definition for MQTT-SN gateways.
+
+#pragma once
+
+#include "mqttsn/client/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // #ifdef __cplusplus
+
+/// @brief Identifier of the client's transport address.
+/// @details Assigned by the application (for example IPv4 address and UDP
+///     port combined into single value), the gateway uses it to identify
+///     the client's session.
+typedef unsigned long long MqttsnGwPeerId;
+
+/// @brief Peer ID used for the broadcast frames that are not sent as a reply
+///     to any particular client (ADVERTISE).
+#define MQTTSN_GW_BROADCAST_PEER 0ULL
+
+/// @brief Callback used to request sending of the binary data to the client.
+/// @param[in] data Pointer to user data object, passed as the last parameter
+///     when setting the callback.
+/// @param[in] peer Client the data needs to be sent to.
+/// @param[in] buf Pointer to the buffer containing the data, valid only
+///     during the callback.
+/// @param[in] bufLen Number of bytes in the buffer.
+/// @param[in] broadcast Indication whether the data needs to be broadcasted.
+typedef void (*MqttsnGwSendOutputDataFn)(void* data, MqttsnGwPeerId peer, const unsigned char* buf, unsigned bufLen, bool broadcast);
+
+/// @brief Callback used to report connection of the client.
+/// @details Invoked after the will information (if any) is received.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Connecting client.
+/// @param[in] clientId Client ID reported in the CONNECT message.
+/// @param[in] willInfo Will information, NULL if client doesn't have any.
+/// @param[in] cleanSession Clean session flag.
+/// @return true to accept the connection, false to reject it.
+typedef bool (*MqttsnGwConnectReportFn)(void* data, MqttsnGwPeerId peer, const char* clientId, const MqttsnWillInfo* willInfo, bool cleanSession);
+
+/// @brief Callback used to report termination of the client's session.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Disconnected client.
+/// @param[in] willInfo Will information that needs to be published on
+///     behalf of the client, NULL if the client has disconnected gracefully
+///     or doesn't have any will.
+typedef void (*MqttsnGwClientDisconnectReportFn)(void* data, MqttsnGwPeerId peer, const MqttsnWillInfo* willInfo);
+
+/// @brief Callback used to forward message published by the client to the broker.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Publishing client.
+/// @param[in] msgInfo Published message information.
+/// @return true if the message is accepted, false to reject it with
+///     "congestion" return code.
+typedef bool (*MqttsnGwPublishReportFn)(void* data, MqttsnGwPeerId peer, const MqttsnMessageInfo* msgInfo);
+
+/// @brief Callback used to forward subscription request of the client to the broker.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Subscribing client.
+/// @param[in] topic Topic filter, NULL when the client subscribes to predefined topic ID.
+/// @param[in] topicId Predefined topic ID, used only when @b topic is NULL.
+/// @param[in, out] qos Requested QoS, may be updated with the granted one.
+/// @return true if the subscription is accepted, false to reject it.
+typedef bool (*MqttsnGwSubscribeReportFn)(void* data, MqttsnGwPeerId peer, const char* topic, MqttsnTopicId topicId, MqttsnQoS* qos);
+
+/// @brief Callback used to forward unsubscription request of the client to the broker.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Unsubscribing client.
+/// @param[in] topic Topic filter, NULL when the client unsubscribes from predefined topic ID.
+/// @param[in] topicId Predefined topic ID, used only when @b topic is NULL.
+typedef void (*MqttsnGwUnsubscribeReportFn)(void* data, MqttsnGwPeerId peer, const char* topic, MqttsnTopicId topicId);
+
+/// @brief Callback used to report completion of the publish to the client.
+/// @param[in] data Pointer to user data object.
+/// @param[in] peer Client the message was published to.
+/// @param[in] status Status of the operation.
+typedef void (*MqttsnGwPublishCompleteReportFn)(void* data, MqttsnGwPeerId peer, MqttsnAsyncOpStatus status);
+
+#ifdef __cplusplus
+}
+#endif
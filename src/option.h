@@ -71,6 +71,88 @@ struct MessageDataStaticStorageSize
     static const std::size_t Value = TSize;
 };
 
+template <std::size_t TLimit>
+struct MaxInflightPublishes
+{
+    static const std::size_t Value = TLimit;
+};
+
+template <std::size_t TLimit>
+struct OutputBatchFramesLimit
+{
+    static const std::size_t Value = TLimit;
+};
+
+template <std::size_t TLimit>
+struct MaxPendingInboundQos2
+{
+    static const std::size_t Value = TLimit;
+};
+
+/// @brief Queue publishes issued while the client cannot send them.
+/// @details Up to @b TLimit messages issued while disconnected, asleep
+///     or busy are copied into internal queue and published when the
+///     connection is restored. When static storage sizes of both topic
+///     name and message data are provided, the queue is a fixed size
+///     one, otherwise the data is kept in a ring buffer
+///     (see @ref OutboundQueueDataSize).
+template <std::size_t TLimit>
+struct OutboundQueueLimit
+{
+    static const std::size_t Value = TLimit;
+};
+
+/// @brief Size of the ring buffer holding topics and data of the queued messages.
+/// @details Relevant only with @ref OutboundQueueLimit and dynamic storage,
+///     defaults to 4096 bytes.
+template <std::size_t TSize>
+struct OutboundQueueDataSize
+{
+    static const std::size_t Value = TSize;
+};
+
+/// @brief Keep journal of the outbound QoS1/QoS2 publishes in persistent storage.
+/// @details The storage is provided at runtime, the unacknowledged
+///     publishes recorded there are sent again with DUP flag
+///     after restart.
+struct OutboundJournal {};
+
+/// @brief Count sent and received messages, retransmissions and round
+///     trip times, see @ref MqttsnClientStats.
+struct Stats {};
+
+/// @brief Record the operations and messages into ring of @b TSize
+///     (power of two) latest trace entries, see @ref MqttsnTraceEntry.
+template <std::size_t TSize>
+struct TraceRingSize
+{
+    static const std::size_t Value = TSize;
+};
+
+/// @brief Allow streaming the payload of single publish straight into
+///     the frame buffer, see mqttsn_client_publish_begin().
+/// @details The buffer has the same type (and capacity with static
+///     storage sizes) as the write buffer of the client.
+struct PublishStream {};
+
+/// @brief The frames are expected to be serialised into the buffers
+///     provided by the transport, see mqttsn_client_set_output_buffer_provider().
+/// @details The client has no internal write buffer then, the provider
+///     must be set before the start and the data and vector send
+///     callbacks are ignored.
+struct OutputBufferProvider {};
+
+/// @brief Catalogue of predefined topics known to the gateway.
+/// @details The publishes, subscribes and unsubscribes to the listed topic
+///     names are sent with predefined topic ID without prior registration.
+///     See @ref mqttsn::client::PredefinedTopicInfo for the definition
+///     of the catalogue type.
+template <typename TTopics>
+struct PredefinedTopics
+{
+    typedef TTopics Type;
+};
+
 
 }  // namespace option
 
@@ -0,0 +1,190 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+static const std::size_t CacheLineSize = 64U;
+
+inline std::size_t roundUpPowerOfTwo(std::size_t value)
+{
+    std::size_t result = 1U;
+    while (result < value) {
+        result <<= 1U;
+    }
+    return result;
+}
+
+/// @brief Bounded lock-free multiple producers, single consumer ring.
+/// @details Every cell carries a sequence number telling whether it is
+///     free for the producer claiming the position or ready for the
+///     consumer (D. Vyukov's bounded queue). The producers contend only
+///     on the compare-exchange of the tail position.
+template <typename T>
+class MpscRing
+{
+public:
+    explicit MpscRing(std::size_t capacity)
+      : m_mask(roundUpPowerOfTwo(std::max(std::size_t(2U), capacity)) - 1U),
+        m_cells(new Cell[m_mask + 1U])
+    {
+        for (std::size_t idx = 0U; idx <= m_mask; ++idx) {
+            m_cells[idx].m_seq.store(idx, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    /// @brief Invoked by any producer thread.
+    /// @return false when full
+    bool push(T&& value)
+    {
+        auto pos = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = m_cells[pos & m_mask];
+            auto seq = cell.m_seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed)) {
+                    cell.m_value = std::move(value);
+                    cell.m_seq.store(pos + 1U, std::memory_order_release);
+                    return true;
+                }
+                continue;
+            }
+
+            if (diff < 0) {
+                return false;
+            }
+
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Invoked by the consumer thread only.
+    /// @return false when empty
+    bool pop(T& value)
+    {
+        auto& cell = m_cells[m_head & m_mask];
+        auto seq = cell.m_seq.load(std::memory_order_acquire);
+        if (seq != (m_head + 1U)) {
+            return false;
+        }
+
+        value = std::move(cell.m_value);
+        cell.m_seq.store(m_head + m_mask + 1U, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> m_seq;
+        T m_value;
+    };
+
+    const std::size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    char m_pad1[CacheLineSize];
+    std::atomic<std::size_t> m_tail{0U};
+    char m_pad2[CacheLineSize];
+    std::size_t m_head = 0U;
+};
+
+/// @brief Bounded lock-free single producer, single consumer ring.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(std::size_t capacity)
+      : m_mask(roundUpPowerOfTwo(std::max(std::size_t(1U), capacity)) - 1U),
+        m_values(new T[m_mask + 1U])
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    std::size_t capacity() const
+    {
+        return m_mask + 1U;
+    }
+
+    /// @brief Invoked by the producer thread only.
+    /// @return false when full
+    bool push(const T& value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if ((tail - m_head.load(std::memory_order_acquire)) == capacity()) {
+            return false;
+        }
+
+        m_values[tail & m_mask] = value;
+        m_tail.store(tail + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Invoked by the consumer thread only.
+    /// @return false when empty
+    bool pop(T& value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = m_values[head & m_mask];
+        m_head.store(head + 1U, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const std::size_t m_mask;
+    std::unique_ptr<T[]> m_values;
+    char m_pad1[CacheLineSize];
+    std::atomic<std::size_t> m_head{0U};
+    char m_pad2[CacheLineSize];
+    std::atomic<std::size_t> m_tail{0U};
+};
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
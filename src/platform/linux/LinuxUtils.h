@@ -0,0 +1,105 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace details
+{
+
+inline std::uint64_t monotonicMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return
+        static_cast<std::uint64_t>(ts.tv_sec) * 1000U +
+        static_cast<std::uint64_t>(ts.tv_nsec) / 1000000U;
+}
+
+inline bool resolveAddr(const char* host, std::uint16_t port, sockaddr_in& addr)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result = nullptr;
+    if ((getaddrinfo(host, nullptr, &hints, &result) != 0) || (result == nullptr)) {
+        return false;
+    }
+
+    std::memcpy(&addr, result->ai_addr, sizeof(addr));
+    addr.sin_port = htons(port);
+    freeaddrinfo(result);
+    return true;
+}
+
+inline bool bindUdpSocket(int fd, std::uint16_t port)
+{
+    int enabled = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &enabled, sizeof(enabled));
+
+    sockaddr_in localAddr;
+    std::memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    localAddr.sin_port = htons(port);
+    return bind(fd, reinterpret_cast<const sockaddr*>(&localAddr), sizeof(localAddr)) == 0;
+}
+
+inline bool addToEpoll(int epollFd, int fd)
+{
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+inline void closeFd(int& fd)
+{
+    if (0 <= fd) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+}  // namespace details
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
@@ -0,0 +1,172 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#if defined(__linux__)
+
+#include "platform/linux/MmapJournal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+MmapJournal::MmapJournal()
+{
+    std::memset(&m_store, 0, sizeof(m_store));
+}
+
+MmapJournal::~MmapJournal()
+{
+    close();
+}
+
+bool MmapJournal::open(const char* path, unsigned size, unsigned sectorSize)
+{
+    close();
+
+    if ((sectorSize == 0U) || (size == 0U) || ((size % sectorSize) != 0U)) {
+        return false;
+    }
+
+    m_fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if ((fstat(m_fd, &st) != 0) ||
+        ((static_cast<unsigned>(st.st_size) != size) && (ftruncate(m_fd, static_cast<off_t>(size)) != 0))) {
+        close();
+        return false;
+    }
+
+    auto* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    m_map = reinterpret_cast<unsigned char*>(map);
+    m_store.size = size;
+    m_store.sectorSize = sectorSize;
+    m_store.read = &MmapJournal::read;
+    m_store.write = &MmapJournal::write;
+    m_store.erase = &MmapJournal::erase;
+    m_store.commit = &MmapJournal::commit;
+    m_store.data = this;
+    return true;
+}
+
+void MmapJournal::close()
+{
+    if (m_map != nullptr) {
+        commit(this);
+        munmap(m_map, m_store.size);
+        m_map = nullptr;
+    }
+
+    if (0 <= m_fd) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    std::memset(&m_store, 0, sizeof(m_store));
+}
+
+void MmapJournal::read(void* data, unsigned offset, unsigned char* buf, unsigned len)
+{
+    auto* thisPtr = reinterpret_cast<MmapJournal*>(data);
+    if (!thisPtr->inRange(offset, len)) {
+        // Reads as erased
+        std::memset(buf, 0xff, len);
+        return;
+    }
+
+    std::memcpy(buf, thisPtr->m_map + offset, len);
+}
+
+void MmapJournal::write(void* data, unsigned offset, const unsigned char* buf, unsigned len)
+{
+    auto* thisPtr = reinterpret_cast<MmapJournal*>(data);
+    if (!thisPtr->inRange(offset, len)) {
+        return;
+    }
+
+    std::memcpy(thisPtr->m_map + offset, buf, len);
+    thisPtr->markDirty(offset, len);
+}
+
+void MmapJournal::erase(void* data, unsigned offset, unsigned len)
+{
+    auto* thisPtr = reinterpret_cast<MmapJournal*>(data);
+    if (!thisPtr->inRange(offset, len)) {
+        return;
+    }
+
+    std::memset(thisPtr->m_map + offset, 0xff, len);
+    thisPtr->markDirty(offset, len);
+}
+
+void MmapJournal::commit(void* data)
+{
+    auto* thisPtr = reinterpret_cast<MmapJournal*>(data);
+    if (thisPtr->m_dirtyEnd <= thisPtr->m_dirtyBegin) {
+        return;
+    }
+
+    // msync() requires page aligned address
+    static const std::size_t PageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto begin = (thisPtr->m_dirtyBegin / PageSize) * PageSize;
+    msync(thisPtr->m_map + begin, thisPtr->m_dirtyEnd - begin, MS_SYNC);
+    thisPtr->m_dirtyBegin = 0U;
+    thisPtr->m_dirtyEnd = 0U;
+}
+
+bool MmapJournal::inRange(unsigned offset, unsigned len) const
+{
+    return
+        (m_map != nullptr) &&
+        (offset <= m_store.size) &&
+        (len <= (m_store.size - offset));
+}
+
+void MmapJournal::markDirty(unsigned offset, unsigned len)
+{
+    if (m_dirtyEnd <= m_dirtyBegin) {
+        m_dirtyBegin = offset;
+        m_dirtyEnd = offset + len;
+        return;
+    }
+
+    m_dirtyBegin = std::min(m_dirtyBegin, static_cast<std::size_t>(offset));
+    m_dirtyEnd = std::max(m_dirtyEnd, static_cast<std::size_t>(offset) + len);
+}
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
@@ -0,0 +1,82 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+
+#include "client.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Storage of the outbound publishes journal in memory mapped file.
+/// @details The writes go directly to the mapping, the commit requested
+///     by the client (once per batch) synchronises only the modified
+///     range of pages with the file using single msync() call.
+///     Pass store() to mqttsn_client_set_journal().
+class MmapJournal
+{
+public:
+    MmapJournal();
+    ~MmapJournal();
+
+    MmapJournal(const MmapJournal&) = delete;
+    MmapJournal& operator=(const MmapJournal&) = delete;
+
+    /// @brief Open (create if needed) and map the journal file.
+    /// @param[in] path Path to the file.
+    /// @param[in] size Size of the journal, multiple of the sector size.
+    /// @param[in] sectorSize Size of the journal sector.
+    /// @return true on success
+    bool open(const char* path, unsigned size, unsigned sectorSize = 4096U);
+
+    void close();
+
+    /// @brief Storage description, valid until close().
+    const MqttsnJournalStore* store() const
+    {
+        return &m_store;
+    }
+
+private:
+    static void read(void* data, unsigned offset, unsigned char* buf, unsigned len);
+    static void write(void* data, unsigned offset, const unsigned char* buf, unsigned len);
+    static void erase(void* data, unsigned offset, unsigned len);
+    static void commit(void* data);
+
+    bool inRange(unsigned offset, unsigned len) const;
+    void markDirty(unsigned offset, unsigned len);
+
+    MqttsnJournalStore m_store;
+    int m_fd = -1;
+    unsigned char* m_map = nullptr;
+    std::size_t m_dirtyBegin = 0U;
+    std::size_t m_dirtyEnd = 0U;
+};
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
@@ -0,0 +1,437 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#if defined(__linux__)
+
+#include "platform/linux/ThreadedClient.h"
+#include "platform/linux/LinuxUtils.h"
+
+#include <cerrno>
+
+#include <sys/eventfd.h>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace
+{
+
+void signalEventFd(int fd, std::atomic<bool>& pending)
+{
+    // Only the first signal after the consumer's reset makes the syscall
+    if (pending.exchange(true)) {
+        return;
+    }
+
+    std::uint64_t value = 1U;
+    auto result = write(fd, &value, sizeof(value));
+    static_cast<void>(result);
+}
+
+void resetEventFd(int fd, std::atomic<bool>& pending)
+{
+    pending.store(false);
+    std::uint64_t value = 0U;
+    auto result = read(fd, &value, sizeof(value));
+    static_cast<void>(result);
+}
+
+}  // namespace
+
+ThreadedClient::ProducerCtx::~ProducerCtx()
+{
+    details::closeFd(m_eventFd);
+}
+
+void ThreadedClient::ProducerCtx::signal()
+{
+    if (m_signalPending.exchange(true)) {
+        return;
+    }
+
+    // The producer may be destroyed meanwhile
+    std::lock_guard<std::mutex> guard(m_eventFdLock);
+    if (0 <= m_eventFd) {
+        std::uint64_t value = 1U;
+        auto result = write(m_eventFd, &value, sizeof(value));
+        static_cast<void>(result);
+    }
+}
+
+void ThreadedClient::ProducerCtx::closeEventFd()
+{
+    std::lock_guard<std::mutex> guard(m_eventFdLock);
+    details::closeFd(m_eventFd);
+}
+
+ThreadedClient::ThreadedClient(std::size_t commandsCapacity)
+  : m_commands(commandsCapacity)
+{
+}
+
+ThreadedClient::~ThreadedClient()
+{
+    close();
+}
+
+bool ThreadedClient::open(const char* gwHost, std::uint16_t gwPort, std::uint16_t localPort)
+{
+    close();
+
+    if (!m_loop.open(gwHost, gwPort, localPort)) {
+        return false;
+    }
+
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if ((m_eventFd < 0) ||
+        (m_epollFd < 0) ||
+        (!details::addToEpoll(m_epollFd, m_eventFd)) ||
+        (!details::addToEpoll(m_epollFd, m_loop.fd()))) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ThreadedClient::close()
+{
+    stop();
+    details::closeFd(m_epollFd);
+    details::closeFd(m_eventFd);
+    m_loop.close();
+    m_backlog.clear();
+    m_freeActive.clear();
+    m_active.clear();
+}
+
+bool ThreadedClient::start()
+{
+    if (m_running || (m_epollFd < 0)) {
+        return false;
+    }
+
+    auto ec = mqttsn_client_start(client());
+    if ((ec != MqttsnErrorCode_Success) && (ec != MqttsnErrorCode_AlreadyStarted)) {
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread([this]() { run(); });
+    return true;
+}
+
+void ThreadedClient::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    m_running = false;
+    std::uint64_t value = 1U;
+    auto result = write(m_eventFd, &value, sizeof(value));
+    static_cast<void>(result);
+    m_thread.join();
+}
+
+std::unique_ptr<ThreadedClient::Producer> ThreadedClient::createProducer(std::size_t completionsCapacity)
+{
+    auto ctx = std::make_shared<ProducerCtx>(completionsCapacity);
+    ctx->m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ctx->m_eventFd < 0) {
+        return std::unique_ptr<Producer>();
+    }
+
+    return std::unique_ptr<Producer>(new Producer(*this, std::move(ctx)));
+}
+
+bool ThreadedClient::post(Command&& cmd)
+{
+    if (!m_commands.push(std::move(cmd))) {
+        return false;
+    }
+
+    signalEventFd(m_eventFd, m_wakeupPending);
+    return true;
+}
+
+void ThreadedClient::run()
+{
+    static const int MaxEvents = 2;
+    epoll_event events[MaxEvents];
+    while (m_running) {
+        int count = epoll_wait(m_epollFd, events, MaxEvents, -1);
+        if ((count < 0) && (errno != EINTR)) {
+            break;
+        }
+
+        for (int idx = 0; idx < count; ++idx) {
+            if (events[idx].data.fd == m_eventFd) {
+                resetEventFd(m_eventFd, m_wakeupPending);
+                continue;
+            }
+
+            m_loop.runOnce(0);
+        }
+
+        drainCommands();
+        startCommands();
+    }
+}
+
+void ThreadedClient::drainCommands()
+{
+    Command cmd;
+    while (m_commands.pop(cmd)) {
+        m_backlog.push_back(cmd);
+    }
+}
+
+void ThreadedClient::startCommands()
+{
+    while (!m_backlog.empty()) {
+        auto ec = startCommand(m_backlog.front());
+        if (ec == MqttsnErrorCode_Busy) {
+            // Retried after the next event
+            return;
+        }
+
+        m_backlog.pop_front();
+    }
+}
+
+MqttsnErrorCode ThreadedClient::startCommand(Command& cmd)
+{
+    auto* active = allocActive(cmd);
+    auto ec = MqttsnErrorCode_BadParam;
+    switch (cmd.m_type) {
+    case CommandType::Connect:
+        ec = mqttsn_client_connect(
+            client(), cmd.m_topic, cmd.m_keepAlive, cmd.m_flag, nullptr,
+            &ThreadedClient::asyncOpComplete, active);
+        break;
+
+    case CommandType::Disconnect:
+        ec = mqttsn_client_disconnect(client(), &ThreadedClient::asyncOpComplete, active);
+        break;
+
+    case CommandType::Publish:
+        ec = mqttsn_client_publish(
+            client(), cmd.m_topic, cmd.m_msg, static_cast<unsigned>(cmd.m_msgLen),
+            cmd.m_qos, cmd.m_flag, &ThreadedClient::asyncOpComplete, active);
+        break;
+
+    case CommandType::Subscribe:
+        ec = mqttsn_client_subscribe(
+            client(), cmd.m_topic, cmd.m_qos, &ThreadedClient::subscribeComplete, active);
+        break;
+
+    case CommandType::Unsubscribe:
+        ec = mqttsn_client_unsubscribe(client(), cmd.m_topic, &ThreadedClient::asyncOpComplete, active);
+        break;
+
+    default:
+        break;
+    }
+
+    if (ec == MqttsnErrorCode_Success) {
+        // The callback releases the active command, possibly already invoked
+        return ec;
+    }
+
+    if (ec == MqttsnErrorCode_Busy) {
+        active->m_producer.reset();
+        m_freeActive.push_back(active);
+        return ec;
+    }
+
+    complete(active, ec, MqttsnAsyncOpStatus_Invalid, MqttsnQoS_AtMostOnceDelivery);
+    return ec;
+}
+
+ThreadedClient::Command* ThreadedClient::allocActive(const Command& cmd)
+{
+    if (m_freeActive.empty()) {
+        m_active.emplace_back(new Command);
+        m_freeActive.push_back(m_active.back().get());
+    }
+
+    auto* active = m_freeActive.back();
+    m_freeActive.pop_back();
+    *active = cmd;
+    active->m_owner = this;
+    return active;
+}
+
+void ThreadedClient::complete(Command* cmd, MqttsnErrorCode ec, MqttsnAsyncOpStatus status, MqttsnQoS qos)
+{
+    if (cmd->m_cb != nullptr) {
+        Completion completion;
+        completion.m_cb = cmd->m_cb;
+        completion.m_cbData = cmd->m_cbData;
+        completion.m_ec = ec;
+        completion.m_status = status;
+        completion.m_qos = qos;
+
+        // Room is reserved by the producer when posting
+        auto& producer = *cmd->m_producer;
+        bool pushed = producer.m_completions.push(completion);
+        static_cast<void>(pushed);
+        producer.signal();
+    }
+
+    cmd->m_producer.reset();
+    m_freeActive.push_back(cmd);
+}
+
+void ThreadedClient::asyncOpComplete(void* data, MqttsnAsyncOpStatus status)
+{
+    auto* cmd = reinterpret_cast<Command*>(data);
+    cmd->m_owner->complete(cmd, MqttsnErrorCode_Success, status, MqttsnQoS_AtMostOnceDelivery);
+}
+
+void ThreadedClient::subscribeComplete(void* data, MqttsnAsyncOpStatus status, MqttsnQoS qos)
+{
+    auto* cmd = reinterpret_cast<Command*>(data);
+    cmd->m_owner->complete(cmd, MqttsnErrorCode_Success, status, qos);
+}
+
+ThreadedClient::Producer::Producer(ThreadedClient& owner, std::shared_ptr<ProducerCtx> ctx)
+  : m_owner(owner),
+    m_ctx(std::move(ctx))
+{
+}
+
+ThreadedClient::Producer::~Producer()
+{
+    // The requests in flight keep the rest of the context
+    m_ctx->closeEventFd();
+}
+
+MqttsnErrorCode ThreadedClient::Producer::connect(
+    const char* clientId,
+    unsigned keepAlivePeriod,
+    bool cleanSession,
+    CompleteFn callback,
+    void* data)
+{
+    Command cmd;
+    cmd.m_type = CommandType::Connect;
+    cmd.m_topic = clientId;
+    cmd.m_keepAlive = keepAlivePeriod;
+    cmd.m_flag = cleanSession;
+    cmd.m_cb = callback;
+    cmd.m_cbData = data;
+    return post(std::move(cmd));
+}
+
+MqttsnErrorCode ThreadedClient::Producer::disconnect(CompleteFn callback, void* data)
+{
+    Command cmd;
+    cmd.m_type = CommandType::Disconnect;
+    cmd.m_cb = callback;
+    cmd.m_cbData = data;
+    return post(std::move(cmd));
+}
+
+MqttsnErrorCode ThreadedClient::Producer::publish(
+    const char* topic,
+    const std::uint8_t* msg,
+    std::size_t msgLen,
+    MqttsnQoS qos,
+    bool retain,
+    CompleteFn callback,
+    void* data)
+{
+    Command cmd;
+    cmd.m_type = CommandType::Publish;
+    cmd.m_topic = topic;
+    cmd.m_msg = msg;
+    cmd.m_msgLen = msgLen;
+    cmd.m_qos = qos;
+    cmd.m_flag = retain;
+    cmd.m_cb = callback;
+    cmd.m_cbData = data;
+    return post(std::move(cmd));
+}
+
+MqttsnErrorCode ThreadedClient::Producer::subscribe(
+    const char* topic,
+    MqttsnQoS qos,
+    CompleteFn callback,
+    void* data)
+{
+    Command cmd;
+    cmd.m_type = CommandType::Subscribe;
+    cmd.m_topic = topic;
+    cmd.m_qos = qos;
+    cmd.m_cb = callback;
+    cmd.m_cbData = data;
+    return post(std::move(cmd));
+}
+
+MqttsnErrorCode ThreadedClient::Producer::unsubscribe(const char* topic, CompleteFn callback, void* data)
+{
+    Command cmd;
+    cmd.m_type = CommandType::Unsubscribe;
+    cmd.m_topic = topic;
+    cmd.m_cb = callback;
+    cmd.m_cbData = data;
+    return post(std::move(cmd));
+}
+
+std::size_t ThreadedClient::Producer::poll()
+{
+    resetEventFd(m_ctx->m_eventFd, m_ctx->m_signalPending);
+
+    std::size_t count = 0U;
+    Completion completion;
+    while (m_ctx->m_completions.pop(completion)) {
+        --m_outstanding;
+        ++count;
+        completion.m_cb(completion.m_cbData, completion.m_ec, completion.m_status, completion.m_qos);
+    }
+    return count;
+}
+
+MqttsnErrorCode ThreadedClient::Producer::post(Command&& cmd)
+{
+    bool reportRequired = (cmd.m_cb != nullptr);
+    if (reportRequired && (m_ctx->m_completions.capacity() <= m_outstanding)) {
+        return MqttsnErrorCode_Busy;
+    }
+
+    cmd.m_producer = m_ctx;
+    if (!m_owner.post(std::move(cmd))) {
+        return MqttsnErrorCode_Busy;
+    }
+
+    if (reportRequired) {
+        ++m_outstanding;
+    }
+    return MqttsnErrorCode_Success;
+}
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
@@ -0,0 +1,240 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "client.h"
+#include "platform/linux/ConcurrentRings.h"
+#include "platform/linux/UdpEventLoop.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Thread safe front-end of single MQTT-SN client over UDP on Linux.
+/// @details The client is owned by the I/O thread running @ref UdpEventLoop.
+///     The application threads issue the requests via their own
+///     @ref Producer objects, which post them into a lock-free multiple
+///     producers single consumer ring. The completions are delivered
+///     back through the per producer single producer single consumer
+///     rings and reported by Producer::poll() on the producer's thread.
+///
+///     The requests are executed in the order they were posted, the ones
+///     the client cannot start right away (busy) wait until it can.
+///     The topic and message buffers passed to the requests must stay
+///     valid until the completion is reported (or until stop() when
+///     no completion callback is provided).
+class ThreadedClient
+{
+public:
+    /// @brief Completion report callback.
+    /// @param[in] data User data passed to the request.
+    /// @param[in] ec Result of starting the request on the I/O thread,
+    ///     the status is @ref MqttsnAsyncOpStatus_Invalid unless it is
+    ///     @ref MqttsnErrorCode_Success.
+    /// @param[in] status Status of the completed operation.
+    /// @param[in] qos Granted QoS (subscribe only).
+    typedef void (*CompleteFn)(void* data, MqttsnErrorCode ec, MqttsnAsyncOpStatus status, MqttsnQoS qos);
+
+    class Producer;
+
+    /// @brief Constructor
+    /// @param[in] commandsCapacity Capacity of the requests ring (rounded
+    ///     up to the power of two).
+    explicit ThreadedClient(std::size_t commandsCapacity = 1024U);
+    ~ThreadedClient();
+
+    ThreadedClient(const ThreadedClient&) = delete;
+    ThreadedClient& operator=(const ThreadedClient&) = delete;
+
+    /// @brief Allocate the client and open the socket.
+    /// @details Parameters are the same as for UdpEventLoop::open().
+    bool open(const char* gwHost, std::uint16_t gwPort, std::uint16_t localPort = 0U);
+
+    /// @brief Stop the I/O thread and release all the resources.
+    void close();
+
+    /// @brief Handle of the client.
+    /// @details May be configured (message report callback, retry period, etc.)
+    ///     only before start(). The message report callback is invoked
+    ///     on the I/O thread.
+    MqttsnClientHandle client() const
+    {
+        return m_loop.client();
+    }
+
+    /// @brief Start the client and spawn the I/O thread.
+    bool start();
+
+    /// @brief Stop and join the I/O thread.
+    void stop();
+
+    /// @brief Create new producer, to be used by single application thread.
+    /// @param[in] completionsCapacity Maximal number of the requests with
+    ///     completion callback awaiting their report via Producer::poll().
+    std::unique_ptr<Producer> createProducer(std::size_t completionsCapacity = 256U);
+
+private:
+    enum class CommandType
+    {
+        Connect,
+        Disconnect,
+        Publish,
+        Subscribe,
+        Unsubscribe
+    };
+
+    struct Completion
+    {
+        CompleteFn m_cb = nullptr;
+        void* m_cbData = nullptr;
+        MqttsnErrorCode m_ec = MqttsnErrorCode_Success;
+        MqttsnAsyncOpStatus m_status = MqttsnAsyncOpStatus_Invalid;
+        MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
+    };
+
+    /// @details Shared by the producer and its requests in flight, the
+    ///     eventfd is closed by the producer's destructor, the rest is
+    ///     released with the last request.
+    struct ProducerCtx
+    {
+        explicit ProducerCtx(std::size_t capacity) : m_completions(capacity) {}
+        ~ProducerCtx();
+
+        void signal();
+        void closeEventFd();
+
+        details::SpscRing<Completion> m_completions;
+        std::atomic<bool> m_signalPending{false};
+        std::mutex m_eventFdLock;
+        int m_eventFd = -1;
+    };
+
+    struct Command
+    {
+        CommandType m_type = CommandType::Publish;
+        std::shared_ptr<ProducerCtx> m_producer;
+        const char* m_topic = nullptr;
+        const std::uint8_t* m_msg = nullptr;
+        std::size_t m_msgLen = 0U;
+        unsigned m_keepAlive = 0U;
+        MqttsnQoS m_qos = MqttsnQoS_AtMostOnceDelivery;
+        bool m_flag = false; // retain or clean session
+        CompleteFn m_cb = nullptr;
+        void* m_cbData = nullptr;
+        ThreadedClient* m_owner = nullptr;
+    };
+
+    bool post(Command&& cmd);
+    void run();
+    void drainCommands();
+    void startCommands();
+    MqttsnErrorCode startCommand(Command& cmd);
+    Command* allocActive(const Command& cmd);
+    void complete(Command* cmd, MqttsnErrorCode ec, MqttsnAsyncOpStatus status, MqttsnQoS qos);
+
+    static void asyncOpComplete(void* data, MqttsnAsyncOpStatus status);
+    static void subscribeComplete(void* data, MqttsnAsyncOpStatus status, MqttsnQoS qos);
+
+    UdpEventLoop m_loop;
+    details::MpscRing<Command> m_commands;
+    std::atomic<bool> m_wakeupPending{false};
+    std::atomic<bool> m_running{false};
+    int m_eventFd = -1;
+    int m_epollFd = -1;
+    std::thread m_thread;
+
+    // I/O thread only
+    std::deque<Command> m_backlog;
+    std::vector<std::unique_ptr<Command> > m_active;
+    std::vector<Command*> m_freeActive;
+};
+
+/// @brief Issues the requests of single application thread.
+/// @details All the member functions must be invoked on the same thread.
+///     The request functions return @ref MqttsnErrorCode_Busy when the
+///     requests ring is full or the completions ring would not have room
+///     for the completion report.
+class ThreadedClient::Producer
+{
+public:
+    ~Producer();
+
+    Producer(const Producer&) = delete;
+    Producer& operator=(const Producer&) = delete;
+
+    MqttsnErrorCode connect(
+        const char* clientId,
+        unsigned keepAlivePeriod,
+        bool cleanSession,
+        CompleteFn callback,
+        void* data);
+
+    MqttsnErrorCode disconnect(CompleteFn callback, void* data);
+
+    MqttsnErrorCode publish(
+        const char* topic,
+        const std::uint8_t* msg,
+        std::size_t msgLen,
+        MqttsnQoS qos,
+        bool retain,
+        CompleteFn callback,
+        void* data);
+
+    MqttsnErrorCode subscribe(const char* topic, MqttsnQoS qos, CompleteFn callback, void* data);
+
+    MqttsnErrorCode unsubscribe(const char* topic, CompleteFn callback, void* data);
+
+    /// @brief Descriptor (eventfd) readable when there are completions to report.
+    int fd() const
+    {
+        return m_ctx->m_eventFd;
+    }
+
+    /// @brief Invoke the callbacks of the completed requests.
+    /// @return Number of reported completions.
+    std::size_t poll();
+
+private:
+    friend class ThreadedClient;
+
+    Producer(ThreadedClient& owner, std::shared_ptr<ProducerCtx> ctx);
+    MqttsnErrorCode post(Command&& cmd);
+
+    ThreadedClient& m_owner;
+    std::shared_ptr<ProducerCtx> m_ctx;
+    std::size_t m_outstanding = 0U;
+};
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
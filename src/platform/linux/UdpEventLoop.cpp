@@ -0,0 +1,263 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#if defined(__linux__)
+
+#include "platform/linux/UdpEventLoop.h"
+#include "platform/linux/LinuxUtils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/timerfd.h>
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+UdpEventLoop::UdpEventLoop()
+{
+    std::memset(&m_gwAddr, 0, sizeof(m_gwAddr));
+    std::memset(&m_broadcastAddr, 0, sizeof(m_broadcastAddr));
+}
+
+UdpEventLoop::~UdpEventLoop()
+{
+    close();
+}
+
+bool UdpEventLoop::open(const char* gwHost, std::uint16_t gwPort, std::uint16_t localPort)
+{
+    close();
+
+    if (!details::resolveAddr(gwHost, gwPort, m_gwAddr)) {
+        return false;
+    }
+
+    m_broadcastAddr.sin_family = AF_INET;
+    m_broadcastAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    m_broadcastAddr.sin_port = htons(gwPort);
+
+    m_sockFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if ((m_sockFd < 0) || (m_timerFd < 0) || (m_epollFd < 0)) {
+        close();
+        return false;
+    }
+
+    if ((!details::bindUdpSocket(m_sockFd, localPort)) ||
+        (!details::addToEpoll(m_epollFd, m_sockFd)) ||
+        (!details::addToEpoll(m_epollFd, m_timerFd))) {
+        close();
+        return false;
+    }
+
+    m_client = mqttsn_client_new();
+    if (m_client == nullptr) {
+        close();
+        return false;
+    }
+
+    m_recvBuf.resize(RecvBatchSize * MaxDatagramSize);
+    mqttsn_client_set_next_tick_program_callback(m_client, &UdpEventLoop::programNextTick, this);
+    mqttsn_client_set_cancel_next_tick_wait_callback(m_client, &UdpEventLoop::cancelNextTick, this);
+    mqttsn_client_set_send_output_batch_callback(m_client, &UdpEventLoop::sendOutputBatch, this);
+    return true;
+}
+
+void UdpEventLoop::close()
+{
+    if (m_client != nullptr) {
+        mqttsn_client_free(m_client);
+        m_client = nullptr;
+    }
+
+    details::closeFd(m_epollFd);
+    details::closeFd(m_timerFd);
+    details::closeFd(m_sockFd);
+    m_timerActive = false;
+    m_running = false;
+}
+
+int UdpEventLoop::runOnce(int timeoutMs)
+{
+    if (m_epollFd < 0) {
+        return -1;
+    }
+
+    epoll_event events[2];
+    int count = epoll_wait(m_epollFd, events, 2, timeoutMs);
+    if (count < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int idx = 0; idx < count; ++idx) {
+        if (events[idx].data.fd == m_sockFd) {
+            readSocket();
+            continue;
+        }
+
+        if (events[idx].data.fd == m_timerFd) {
+            readTimer();
+            continue;
+        }
+    }
+
+    return count;
+}
+
+bool UdpEventLoop::run()
+{
+    m_running = true;
+    while (m_running) {
+        if (runOnce(-1) < 0) {
+            m_running = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+void UdpEventLoop::stop()
+{
+    m_running = false;
+}
+
+void UdpEventLoop::sendOutputBatch(void* data, const MqttsnOutputFrame* frames, unsigned count)
+{
+    auto* loop = reinterpret_cast<UdpEventLoop*>(data);
+    static const unsigned MaxBatch = 16U;
+    mmsghdr msgs[MaxBatch];
+    iovec iovs[MaxBatch];
+
+    while (0U < count) {
+        auto batchSize = std::min(count, MaxBatch);
+        std::memset(msgs, 0, sizeof(msgs[0]) * batchSize);
+        for (unsigned idx = 0U; idx < batchSize; ++idx) {
+            auto& frame = frames[idx];
+            auto* addr = frame.broadcast ? &loop->m_broadcastAddr : &loop->m_gwAddr;
+            iovs[idx].iov_base = const_cast<unsigned char*>(frame.buf);
+            iovs[idx].iov_len = frame.bufLen;
+            msgs[idx].msg_hdr.msg_name = addr;
+            msgs[idx].msg_hdr.msg_namelen = sizeof(*addr);
+            msgs[idx].msg_hdr.msg_iov = &iovs[idx];
+            msgs[idx].msg_hdr.msg_iovlen = 1;
+        }
+
+        // Datagrams not accepted by the socket are dropped, the client
+        // retransmits them when needed.
+        sendmmsg(loop->m_sockFd, msgs, batchSize, 0);
+        frames += batchSize;
+        count -= batchSize;
+    }
+}
+
+void UdpEventLoop::programNextTick(void* data, unsigned duration)
+{
+    auto* loop = reinterpret_cast<UdpEventLoop*>(data);
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = static_cast<time_t>(duration / 1000U);
+    spec.it_value.tv_nsec = static_cast<long>(duration % 1000U) * 1000000L;
+    if (duration == 0U) {
+        // Zero value disarms the timer
+        spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(loop->m_timerFd, 0, &spec, nullptr);
+    loop->m_timerStartMs = details::monotonicMs();
+    loop->m_timerDuration = duration;
+    loop->m_timerActive = true;
+}
+
+unsigned UdpEventLoop::cancelNextTick(void* data)
+{
+    auto* loop = reinterpret_cast<UdpEventLoop*>(data);
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    timerfd_settime(loop->m_timerFd, 0, &spec, nullptr);
+    loop->m_timerActive = false;
+
+    auto elapsed = details::monotonicMs() - loop->m_timerStartMs;
+    return static_cast<unsigned>(std::min<std::uint64_t>(elapsed, loop->m_timerDuration));
+}
+
+void UdpEventLoop::readSocket()
+{
+    mmsghdr msgs[RecvBatchSize];
+    iovec iovs[RecvBatchSize];
+    MqttsnDatagram datagrams[RecvBatchSize];
+
+    while (m_client != nullptr) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (unsigned idx = 0U; idx < RecvBatchSize; ++idx) {
+            iovs[idx].iov_base = &m_recvBuf[idx * MaxDatagramSize];
+            iovs[idx].iov_len = MaxDatagramSize;
+            msgs[idx].msg_hdr.msg_iov = &iovs[idx];
+            msgs[idx].msg_hdr.msg_iovlen = 1;
+        }
+
+        int count = recvmmsg(m_sockFd, msgs, RecvBatchSize, MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return;
+        }
+
+        unsigned datagramsCount = 0U;
+        for (int idx = 0; idx < count; ++idx) {
+            if ((msgs[idx].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+                continue;
+            }
+
+            auto& datagram = datagrams[datagramsCount];
+            datagram.buf = &m_recvBuf[static_cast<unsigned>(idx) * MaxDatagramSize];
+            datagram.bufLen = msgs[idx].msg_len;
+            ++datagramsCount;
+        }
+
+        mqttsn_client_process_datagrams(m_client, datagrams, datagramsCount);
+
+        if (static_cast<unsigned>(count) < RecvBatchSize) {
+            return;
+        }
+    }
+}
+
+void UdpEventLoop::readTimer()
+{
+    std::uint64_t expirations = 0U;
+    if (read(m_timerFd, &expirations, sizeof(expirations)) != static_cast<ssize_t>(sizeof(expirations))) {
+        // Re-programmed or cancelled after expiry
+        return;
+    }
+
+    if (!m_timerActive) {
+        return;
+    }
+
+    m_timerActive = false;
+    mqttsn_client_tick(m_client);
+}
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
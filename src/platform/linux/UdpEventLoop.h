@@ -0,0 +1,112 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstdint>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "client.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Event loop driving single MQTT-SN client over UDP on Linux.
+/// @details Owns the client handle, non-blocking UDP socket, timerfd and
+///     epoll instance. The I/O and timer callbacks of the client are set
+///     by open(). The application is expected to set the message report
+///     callback and call mqttsn_client_start() before running the loop.
+class UdpEventLoop
+{
+public:
+    UdpEventLoop();
+    ~UdpEventLoop();
+
+    UdpEventLoop(const UdpEventLoop&) = delete;
+    UdpEventLoop& operator=(const UdpEventLoop&) = delete;
+
+    /// @brief Allocate the client and open the socket.
+    /// @param[in] gwHost Host name or IPv4 address of the gateway.
+    /// @param[in] gwPort UDP port of the gateway, also used for broadcasts.
+    /// @param[in] localPort Local UDP port to bind to, 0 for any.
+    /// @return true on success
+    bool open(const char* gwHost, std::uint16_t gwPort, std::uint16_t localPort = 0U);
+
+    /// @brief Release all the resources, including the client.
+    void close();
+
+    MqttsnClientHandle client() const
+    {
+        return m_client;
+    }
+
+    /// @brief Descriptor of the epoll instance.
+    /// @details Can be added to other event loop, runOnce(0) is
+    ///     expected to be called when it becomes readable.
+    int fd() const
+    {
+        return m_epollFd;
+    }
+
+    /// @brief Wait for the events and dispatch them to the client.
+    /// @param[in] timeoutMs Maximal wait duration, -1 for infinite.
+    /// @return Number of handled events, -1 on error.
+    int runOnce(int timeoutMs);
+
+    /// @brief Run the loop until stop() is called.
+    /// @return false on error
+    bool run();
+
+    void stop();
+
+private:
+    static void sendOutputBatch(void* data, const MqttsnOutputFrame* frames, unsigned count);
+    static void programNextTick(void* data, unsigned duration);
+    static unsigned cancelNextTick(void* data);
+
+    void readSocket();
+    void readTimer();
+
+    static const unsigned RecvBatchSize = 16U;
+    static const unsigned MaxDatagramSize = 2048U;
+
+    MqttsnClientHandle m_client = nullptr;
+    int m_sockFd = -1;
+    int m_timerFd = -1;
+    int m_epollFd = -1;
+    sockaddr_in m_gwAddr;
+    sockaddr_in m_broadcastAddr;
+    std::uint64_t m_timerStartMs = 0U;
+    unsigned m_timerDuration = 0U;
+    bool m_timerActive = false;
+    bool m_running = false;
+    std::vector<unsigned char> m_recvBuf;
+};
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
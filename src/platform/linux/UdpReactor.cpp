@@ -0,0 +1,444 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#if defined(__linux__)
+
+#include "platform/linux/UdpReactor.h"
+#include "platform/linux/LinuxUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "timer_driver.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+namespace
+{
+
+bool samePeer(const sockaddr_in& first, const sockaddr_in& second)
+{
+    return
+        (first.sin_addr.s_addr == second.sin_addr.s_addr) &&
+        (first.sin_port == second.sin_port);
+}
+
+unsigned timerDriverClock(void* data)
+{
+    static_cast<void>(data);
+    return static_cast<unsigned>(details::monotonicMs());
+}
+
+}  // namespace
+
+struct UdpReactor::ClientCtx
+{
+    Shard* m_shard = nullptr;
+    MqttsnClientHandle m_client = nullptr;
+    int m_sockFd = -1;
+    sockaddr_in m_peerAddr;
+    sockaddr_in m_broadcastAddr;
+};
+
+struct UdpReactor::Shard
+{
+    typedef std::pair<ClientCtx*, ClientFunc> PostedFunc;
+
+    int m_timerFd = -1;
+    int m_eventFd = -1;
+    int m_epollFd = -1;
+    MqttsnTimerDriverHandle m_timerDriver = nullptr;
+    std::uint64_t m_timerFdExpiry = NoTimerFdExpiry;
+    std::vector<std::unique_ptr<ClientCtx> > m_clients;
+    std::unordered_map<int, ClientCtx*> m_sockets;
+    std::vector<unsigned char> m_recvBuf;
+    std::mutex m_postedLock;
+    std::vector<PostedFunc> m_posted;
+    std::thread m_thread;
+    std::atomic<bool> m_stopRequested;
+};
+
+UdpReactor::UdpReactor(unsigned shardsCount)
+{
+    shardsCount = std::max(shardsCount, 1U);
+    for (unsigned idx = 0U; idx < shardsCount; ++idx) {
+        m_shards.emplace_back(new Shard());
+    }
+}
+
+UdpReactor::~UdpReactor()
+{
+    close();
+}
+
+bool UdpReactor::open(std::uint16_t localPort)
+{
+    close();
+    for (auto& shard : m_shards) {
+        if (!openShard(*shard)) {
+            close();
+            return false;
+        }
+    }
+
+    m_localPort = localPort;
+    return true;
+}
+
+void UdpReactor::close()
+{
+    stop();
+    m_clients.clear();
+    for (auto& shard : m_shards) {
+        closeShard(*shard);
+    }
+}
+
+MqttsnClientHandle UdpReactor::addClient(const char* peerHost, std::uint16_t peerPort)
+{
+    if (m_running) {
+        return nullptr;
+    }
+
+    std::unique_ptr<ClientCtx> ctx(new ClientCtx());
+    std::memset(&ctx->m_peerAddr, 0, sizeof(ctx->m_peerAddr));
+    if (!details::resolveAddr(peerHost, peerPort, ctx->m_peerAddr)) {
+        return nullptr;
+    }
+
+    std::memset(&ctx->m_broadcastAddr, 0, sizeof(ctx->m_broadcastAddr));
+    ctx->m_broadcastAddr.sin_family = AF_INET;
+    ctx->m_broadcastAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    ctx->m_broadcastAddr.sin_port = htons(peerPort);
+
+    auto* shard = m_shards[m_clients.size() % m_shards.size()].get();
+    if (shard->m_epollFd < 0) {
+        return nullptr;
+    }
+
+    auto localPort = m_localPort;
+    if (localPort != 0U) {
+        localPort = static_cast<std::uint16_t>(localPort + m_clients.size());
+    }
+
+    ctx->m_sockFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ((ctx->m_sockFd < 0) ||
+        (!details::bindUdpSocket(ctx->m_sockFd, localPort))) {
+        details::closeFd(ctx->m_sockFd);
+        return nullptr;
+    }
+
+    ctx->m_client = mqttsn_client_new();
+    if (ctx->m_client == nullptr) {
+        details::closeFd(ctx->m_sockFd);
+        return nullptr;
+    }
+
+    if (!mqttsn_timer_driver_attach(shard->m_timerDriver, ctx->m_client)) {
+        mqttsn_client_free(ctx->m_client);
+        details::closeFd(ctx->m_sockFd);
+        return nullptr;
+    }
+
+    if (!details::addToEpoll(shard->m_epollFd, ctx->m_sockFd)) {
+        mqttsn_timer_driver_detach(shard->m_timerDriver, ctx->m_client);
+        mqttsn_client_free(ctx->m_client);
+        details::closeFd(ctx->m_sockFd);
+        return nullptr;
+    }
+
+    ctx->m_shard = shard;
+    mqttsn_client_set_send_output_batch_callback(ctx->m_client, &UdpReactor::sendOutputBatch, ctx.get());
+
+    auto* client = ctx->m_client;
+    shard->m_sockets[ctx->m_sockFd] = ctx.get();
+    m_clients[client] = ctx.get();
+    shard->m_clients.push_back(std::move(ctx));
+    return client;
+}
+
+std::size_t UdpReactor::clientsCount() const
+{
+    return m_clients.size();
+}
+
+bool UdpReactor::start()
+{
+    if (m_running) {
+        return false;
+    }
+
+    for (auto& shard : m_shards) {
+        if (shard->m_epollFd < 0) {
+            return false;
+        }
+    }
+
+    m_running = true;
+    for (auto& shard : m_shards) {
+        auto* shardPtr = shard.get();
+        shardPtr->m_stopRequested = false;
+        shardPtr->m_thread = std::thread([this, shardPtr]() { runShard(*shardPtr); });
+    }
+    return true;
+}
+
+void UdpReactor::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    for (auto& shard : m_shards) {
+        shard->m_stopRequested = true;
+        std::uint64_t value = 1U;
+        auto result = write(shard->m_eventFd, &value, sizeof(value));
+        static_cast<void>(result);
+    }
+
+    for (auto& shard : m_shards) {
+        if (shard->m_thread.joinable()) {
+            shard->m_thread.join();
+        }
+    }
+    m_running = false;
+}
+
+bool UdpReactor::post(MqttsnClientHandle client, ClientFunc&& func)
+{
+    auto iter = m_clients.find(client);
+    if (iter == m_clients.end()) {
+        return false;
+    }
+
+    auto* ctx = iter->second;
+    auto& shard = *ctx->m_shard;
+    {
+        std::lock_guard<std::mutex> guard(shard.m_postedLock);
+        shard.m_posted.emplace_back(ctx, std::move(func));
+    }
+
+    std::uint64_t value = 1U;
+    auto result = write(shard.m_eventFd, &value, sizeof(value));
+    static_cast<void>(result);
+    return true;
+}
+
+void UdpReactor::sendOutputBatch(void* data, const MqttsnOutputFrame* frames, unsigned count)
+{
+    auto* ctx = reinterpret_cast<ClientCtx*>(data);
+    static const unsigned MaxBatch = 16U;
+    mmsghdr msgs[MaxBatch];
+    iovec iovs[MaxBatch];
+
+    while (0U < count) {
+        auto batchSize = std::min(count, MaxBatch);
+        std::memset(msgs, 0, sizeof(msgs[0]) * batchSize);
+        for (unsigned idx = 0U; idx < batchSize; ++idx) {
+            auto& frame = frames[idx];
+            auto* addr = frame.broadcast ? &ctx->m_broadcastAddr : &ctx->m_peerAddr;
+            iovs[idx].iov_base = const_cast<unsigned char*>(frame.buf);
+            iovs[idx].iov_len = frame.bufLen;
+            msgs[idx].msg_hdr.msg_name = addr;
+            msgs[idx].msg_hdr.msg_namelen = sizeof(*addr);
+            msgs[idx].msg_hdr.msg_iov = &iovs[idx];
+            msgs[idx].msg_hdr.msg_iovlen = 1;
+        }
+
+        sendmmsg(ctx->m_sockFd, msgs, batchSize, 0);
+        frames += batchSize;
+        count -= batchSize;
+    }
+}
+
+bool UdpReactor::openShard(Shard& shard)
+{
+    shard.m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    shard.m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    shard.m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    shard.m_timerDriver = mqttsn_timer_driver_new(&timerDriverClock, nullptr);
+    if ((shard.m_timerFd < 0) ||
+        (shard.m_eventFd < 0) ||
+        (shard.m_epollFd < 0) ||
+        (shard.m_timerDriver == nullptr)) {
+        return false;
+    }
+
+    shard.m_recvBuf.resize(RecvBatchSize * MaxDatagramSize);
+    shard.m_timerFdExpiry = NoTimerFdExpiry;
+    return
+        details::addToEpoll(shard.m_epollFd, shard.m_timerFd) &&
+        details::addToEpoll(shard.m_epollFd, shard.m_eventFd);
+}
+
+void UdpReactor::closeShard(Shard& shard)
+{
+    for (auto& ctx : shard.m_clients) {
+        mqttsn_timer_driver_detach(shard.m_timerDriver, ctx->m_client);
+        mqttsn_client_free(ctx->m_client);
+        details::closeFd(ctx->m_sockFd);
+    }
+
+    shard.m_clients.clear();
+    shard.m_sockets.clear();
+    shard.m_posted.clear();
+    details::closeFd(shard.m_epollFd);
+    details::closeFd(shard.m_eventFd);
+    details::closeFd(shard.m_timerFd);
+    if (shard.m_timerDriver != nullptr) {
+        mqttsn_timer_driver_free(shard.m_timerDriver);
+        shard.m_timerDriver = nullptr;
+    }
+}
+
+void UdpReactor::runShard(Shard& shard)
+{
+    static const int MaxEvents = 64;
+    epoll_event events[MaxEvents];
+
+    updateTimer(shard, mqttsn_timer_driver_tick(shard.m_timerDriver));
+    while (!shard.m_stopRequested) {
+        int count = epoll_wait(shard.m_epollFd, events, MaxEvents, -1);
+        if ((count < 0) && (errno != EINTR)) {
+            break;
+        }
+
+        for (int idx = 0; idx < count; ++idx) {
+            auto fd = events[idx].data.fd;
+            if (fd == shard.m_timerFd) {
+                std::uint64_t expirations = 0U;
+                auto result = read(shard.m_timerFd, &expirations, sizeof(expirations));
+                static_cast<void>(result);
+                shard.m_timerFdExpiry = NoTimerFdExpiry;
+                continue;
+            }
+
+            if (fd == shard.m_eventFd) {
+                readEvents(shard);
+                continue;
+            }
+
+            auto iter = shard.m_sockets.find(fd);
+            if (iter != shard.m_sockets.end()) {
+                readSocket(shard, *iter->second);
+            }
+        }
+
+        updateTimer(shard, mqttsn_timer_driver_tick(shard.m_timerDriver));
+    }
+}
+
+void UdpReactor::readSocket(Shard& shard, ClientCtx& ctx)
+{
+    mmsghdr msgs[RecvBatchSize];
+    iovec iovs[RecvBatchSize];
+    sockaddr_in addrs[RecvBatchSize];
+    MqttsnDatagram datagrams[RecvBatchSize];
+
+    while (true) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (unsigned idx = 0U; idx < RecvBatchSize; ++idx) {
+            iovs[idx].iov_base = &shard.m_recvBuf[idx * MaxDatagramSize];
+            iovs[idx].iov_len = MaxDatagramSize;
+            msgs[idx].msg_hdr.msg_name = &addrs[idx];
+            msgs[idx].msg_hdr.msg_namelen = sizeof(addrs[idx]);
+            msgs[idx].msg_hdr.msg_iov = &iovs[idx];
+            msgs[idx].msg_hdr.msg_iovlen = 1;
+        }
+
+        int count = recvmmsg(ctx.m_sockFd, msgs, RecvBatchSize, MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return;
+        }
+
+        // All the datagrams received from the client's gateway are processed as a batch
+        unsigned batchSize = 0U;
+        for (int idx = 0; idx < count; ++idx) {
+            if (((msgs[idx].msg_hdr.msg_flags & MSG_TRUNC) != 0) ||
+                (!samePeer(addrs[idx], ctx.m_peerAddr))) {
+                continue;
+            }
+
+            auto& datagram = datagrams[batchSize];
+            datagram.buf = &shard.m_recvBuf[static_cast<unsigned>(idx) * MaxDatagramSize];
+            datagram.bufLen = msgs[idx].msg_len;
+            ++batchSize;
+        }
+
+        if (0U < batchSize) {
+            mqttsn_client_process_datagrams(ctx.m_client, datagrams, batchSize);
+        }
+
+        if (static_cast<unsigned>(count) < RecvBatchSize) {
+            return;
+        }
+    }
+}
+
+void UdpReactor::readEvents(Shard& shard)
+{
+    std::uint64_t value = 0U;
+    auto result = read(shard.m_eventFd, &value, sizeof(value));
+    static_cast<void>(result);
+
+    std::vector<Shard::PostedFunc> posted;
+    {
+        std::lock_guard<std::mutex> guard(shard.m_postedLock);
+        posted.swap(shard.m_posted);
+    }
+
+    for (auto& elem : posted) {
+        elem.second(elem.first->m_client);
+    }
+}
+
+void UdpReactor::updateTimer(Shard& shard, unsigned timeout)
+{
+    auto expiry = NoTimerFdExpiry;
+    if (timeout != MQTTSN_TIMER_DRIVER_NO_TIMEOUT) {
+        expiry = details::monotonicMs() + timeout;
+    }
+
+    if (expiry == shard.m_timerFdExpiry) {
+        return;
+    }
+
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    if (expiry != NoTimerFdExpiry) {
+        spec.it_value.tv_sec = static_cast<time_t>(expiry / 1000U);
+        spec.it_value.tv_nsec = static_cast<long>(expiry % 1000U) * 1000000L;
+    }
+
+    timerfd_settime(shard.m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    shard.m_timerFdExpiry = expiry;
+}
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
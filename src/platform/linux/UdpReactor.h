@@ -0,0 +1,123 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "client.h"
+
+namespace mqttsn
+{
+
+namespace client
+{
+
+/// @brief Event loop driving many MQTT-SN clients over UDP on Linux.
+/// @details The clients are sharded across the worker threads. Every shard
+///     owns timerfd and epoll instance, while every client owns its
+///     UDP socket registered in the epoll of its shard. The received
+///     datagrams are routed to the client by the socket they arrive on,
+///     so any number of clients may communicate with the same gateway.
+///     The time requests of all the clients of the shard are served by
+///     single timer driver (see timer_driver.h), and the timerfd is
+///     programmed only for its earliest event, i.e. one wakeup serves
+///     all the clients due at the same time.
+///
+///     The clients are added before start(). Any client API function may be
+///     invoked only on the thread of the owning shard, i.e. from within
+///     the client's callbacks or via post(), after start() is called.
+class UdpReactor
+{
+public:
+    typedef std::function<void (MqttsnClientHandle)> ClientFunc;
+
+    /// @brief Constructor
+    /// @param[in] shardsCount Number of shards (worker threads).
+    explicit UdpReactor(unsigned shardsCount = 1U);
+    ~UdpReactor();
+
+    UdpReactor(const UdpReactor&) = delete;
+    UdpReactor& operator=(const UdpReactor&) = delete;
+
+    /// @brief Open the event loop resources of all the shards.
+    /// @param[in] localPort Local UDP port the socket of the first added client
+    ///     binds to, the other clients use subsequent port numbers. 0 for any.
+    /// @return true on success
+    bool open(std::uint16_t localPort = 0U);
+
+    /// @brief Stop the workers and release all the resources, including the clients.
+    void close();
+
+    /// @brief Allocate new client communicating with the provided peer.
+    /// @details The I/O and timer callbacks of the client are set by the
+    ///     reactor, the message report callback needs to be set by the
+    ///     application.
+    /// @return Handle of the allocated client, NULL on error.
+    MqttsnClientHandle addClient(const char* peerHost, std::uint16_t peerPort);
+
+    std::size_t clientsCount() const;
+
+    /// @brief Spawn the worker threads.
+    bool start();
+
+    /// @brief Stop and join the worker threads.
+    void stop();
+
+    /// @brief Invoke the function on the thread of the shard owning the client.
+    /// @return false if the client is unknown.
+    bool post(MqttsnClientHandle client, ClientFunc&& func);
+
+private:
+    struct ClientCtx;
+    struct Shard;
+
+    static void sendOutputBatch(void* data, const MqttsnOutputFrame* frames, unsigned count);
+
+    bool openShard(Shard& shard);
+    void closeShard(Shard& shard);
+    void runShard(Shard& shard);
+    void readSocket(Shard& shard, ClientCtx& ctx);
+    void readEvents(Shard& shard);
+    void updateTimer(Shard& shard, unsigned timeout);
+
+    static const unsigned RecvBatchSize = 32U;
+    static const unsigned MaxDatagramSize = 2048U;
+    static const std::uint64_t NoTimerFdExpiry = ~static_cast<std::uint64_t>(0U);
+
+    std::vector<std::unique_ptr<Shard> > m_shards;
+    std::unordered_map<MqttsnClientHandle, ClientCtx*> m_clients;
+    std::uint16_t m_localPort = 0U;
+    bool m_running = false;
+};
+
+}  // namespace client
+
+}  // namespace mqttsn
+
+#endif // #if defined(__linux__)
@@ -0,0 +1,182 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "timer_driver.h"
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+#include "client.h"
+#include "details/TimingWheel.h"
+
+namespace
+{
+
+class TimerDriver
+{
+public:
+    TimerDriver(MqttsnTimerDriverClockFn clockFn, void* clockData)
+      : m_clockFn(clockFn),
+        m_clockData(clockData),
+        m_lastClock(clockFn(clockData)),
+        m_wheel(0U)
+    {
+    }
+
+    ~TimerDriver() noexcept = default;
+
+    bool attach(MqttsnClientHandle client)
+    {
+        auto& timer = m_timers[client];
+        if (!timer) {
+            timer.reset(new Timer);
+        }
+
+        timer->m_driver = this;
+        timer->m_client = client;
+        timer->m_entry.m_data = timer.get();
+        mqttsn_client_set_next_tick_program_callback(client, &TimerDriver::programNextTick, timer.get());
+        mqttsn_client_set_cancel_next_tick_wait_callback(client, &TimerDriver::cancelNextTick, timer.get());
+        return true;
+    }
+
+    void detach(MqttsnClientHandle client)
+    {
+        auto iter = m_timers.find(client);
+        if (iter == m_timers.end()) {
+            return;
+        }
+
+        m_wheel.cancel(iter->second->m_entry);
+        m_timers.erase(iter);
+    }
+
+    unsigned tick()
+    {
+        m_wheel.advance(
+            now(),
+            [](mqttsn::client::details::TimingWheelEntry& entry)
+            {
+                auto* timer = reinterpret_cast<Timer*>(entry.m_data);
+                mqttsn_client_tick(timer->m_client);
+            });
+
+        return nextTimeout();
+    }
+
+    unsigned nextTimeout()
+    {
+        auto expiry = m_wheel.nextEvent();
+        if (expiry == Wheel::NoExpiry) {
+            return MQTTSN_TIMER_DRIVER_NO_TIMEOUT;
+        }
+
+        auto currTime = now();
+        if (expiry <= currTime) {
+            return 0U;
+        }
+
+        return static_cast<unsigned>(
+            std::min<std::uint64_t>(expiry - currTime, MQTTSN_TIMER_DRIVER_NO_TIMEOUT - 1U));
+    }
+
+private:
+    typedef mqttsn::client::details::TimingWheel<> Wheel;
+
+    struct Timer
+    {
+        mqttsn::client::details::TimingWheelEntry m_entry;
+        TimerDriver* m_driver = nullptr;
+        MqttsnClientHandle m_client = nullptr;
+        std::uint64_t m_startTime = 0U;
+        unsigned m_duration = 0U;
+    };
+
+    static void programNextTick(void* data, unsigned duration)
+    {
+        auto* timer = reinterpret_cast<Timer*>(data);
+        auto& driver = *timer->m_driver;
+        timer->m_startTime = driver.now();
+        timer->m_duration = duration;
+        driver.m_wheel.schedule(timer->m_entry, timer->m_startTime + duration);
+    }
+
+    static unsigned cancelNextTick(void* data)
+    {
+        auto* timer = reinterpret_cast<Timer*>(data);
+        auto& driver = *timer->m_driver;
+        driver.m_wheel.cancel(timer->m_entry);
+        auto elapsed = driver.now() - timer->m_startTime;
+        return static_cast<unsigned>(std::min<std::uint64_t>(elapsed, timer->m_duration));
+    }
+
+    std::uint64_t now()
+    {
+        auto clock = m_clockFn(m_clockData);
+        m_now += static_cast<unsigned>(clock - m_lastClock);
+        m_lastClock = clock;
+        return m_now;
+    }
+
+    MqttsnTimerDriverClockFn m_clockFn = nullptr;
+    void* m_clockData = nullptr;
+    unsigned m_lastClock = 0U;
+    std::uint64_t m_now = 0U;
+    Wheel m_wheel;
+    std::unordered_map<MqttsnClientHandle, std::unique_ptr<Timer> > m_timers;
+};
+
+}  // namespace
+
+MqttsnTimerDriverHandle mqttsn_timer_driver_new(MqttsnTimerDriverClockFn clockFn, void* data)
+{
+    if (clockFn == nullptr) {
+        return nullptr;
+    }
+
+    return new TimerDriver(clockFn, data);
+}
+
+void mqttsn_timer_driver_free(MqttsnTimerDriverHandle driver)
+{
+    delete reinterpret_cast<TimerDriver*>(driver);
+}
+
+bool mqttsn_timer_driver_attach(MqttsnTimerDriverHandle driver, MqttsnClientHandle client)
+{
+    if ((driver == nullptr) || (client == nullptr)) {
+        return false;
+    }
+
+    return reinterpret_cast<TimerDriver*>(driver)->attach(client);
+}
+
+void mqttsn_timer_driver_detach(MqttsnTimerDriverHandle driver, MqttsnClientHandle client)
+{
+    reinterpret_cast<TimerDriver*>(driver)->detach(client);
+}
+
+unsigned mqttsn_timer_driver_tick(MqttsnTimerDriverHandle driver)
+{
+    return reinterpret_cast<TimerDriver*>(driver)->tick();
+}
+
+unsigned mqttsn_timer_driver_next_timeout(MqttsnTimerDriverHandle driver)
+{
+    return reinterpret_cast<TimerDriver*>(driver)->nextTimeout();
+}
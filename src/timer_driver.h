@@ -0,0 +1,98 @@
+//
+// Copyright 2016 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Functions of timer driver shared by multiple clients.
+/// @details The driver implements the time measurement callbacks
+///     (see mqttsn_client_set_next_tick_program_callback() and
+///     mqttsn_client_set_cancel_next_tick_wait_callback()) of the attached
+///     clients, keeping all the requests in a single hierarchical timing wheel.
+///     The host programs single timer for the value returned by
+///     mqttsn_timer_driver_tick() and calls the latter again on expiry,
+///     all the clients whose time measurement has expired are ticked at once.
+
+#pragma once
+
+#include "mqttsn/client/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // #ifdef __cplusplus
+
+/// @brief Handle of the timer driver.
+typedef void* MqttsnTimerDriverHandle;
+
+/// @brief Callback used by the timer driver to retrieve current time.
+/// @param[in] data Pointer to user data object, passed as last parameter to
+///     mqttsn_timer_driver_new() function.
+/// @return Current value of monotonic clock in @b milliseconds. The
+///     value is allowed to wrap around.
+typedef unsigned (*MqttsnTimerDriverClockFn)(void* data);
+
+/// @brief Value returned by mqttsn_timer_driver_tick() when there are no
+///     pending time measurements.
+#define MQTTSN_TIMER_DRIVER_NO_TIMEOUT 0xffffffffU
+
+/// @brief Allocate new timer driver.
+/// @param[in] clockFn Callback to retrieve current time, must @b NOT be NULL.
+/// @param[in] data Pointer to any user data structure. It will passed as one
+///     of the parameters in callback invocation. May be NULL.
+/// @return Handle of the allocated driver, NULL on failure.
+MqttsnTimerDriverHandle mqttsn_timer_driver_new(MqttsnTimerDriverClockFn clockFn, void* data);
+
+/// @brief Free previously allocated timer driver.
+/// @details All the attached clients need to be detached or freed beforehand.
+/// @param[in] driver Handle returned by mqttsn_timer_driver_new() function.
+void mqttsn_timer_driver_free(MqttsnTimerDriverHandle driver);
+
+/// @brief Attach client to the driver.
+/// @details Sets the next tick program and cancel callbacks of the client.
+///     Must be called before mqttsn_client_start().
+/// @param[in] driver Handle returned by mqttsn_timer_driver_new() function.
+/// @param[in] client Handle returned by mqttsn_client_new() function.
+/// @return true on success
+bool mqttsn_timer_driver_attach(MqttsnTimerDriverHandle driver, MqttsnClientHandle client);
+
+/// @brief Detach client from the driver.
+/// @details Must be called before the client is freed with mqttsn_client_free()
+///     and the driver is not used by the client afterwards. The time
+///     measurement callbacks of the client need to be set again (or the
+///     client re-attached) before its operation is resumed.
+/// @param[in] driver Handle returned by mqttsn_timer_driver_new() function.
+/// @param[in] client Handle of the attached client.
+void mqttsn_timer_driver_detach(MqttsnTimerDriverHandle driver, MqttsnClientHandle client);
+
+/// @brief Tick all the clients whose requested time measurement has expired.
+/// @details Invokes mqttsn_client_tick() for every due client.
+/// @param[in] driver Handle returned by mqttsn_timer_driver_new() function.
+/// @return Number of milliseconds until the next call to this function is
+///     required, @ref MQTTSN_TIMER_DRIVER_NO_TIMEOUT if there are no pending
+///     time measurements.
+unsigned mqttsn_timer_driver_tick(MqttsnTimerDriverHandle driver);
+
+/// @brief Number of milliseconds until the next call to mqttsn_timer_driver_tick()
+///     is required.
+/// @details Needs to be checked after any other client API function
+///     call because the client may request new time measurement.
+/// @param[in] driver Handle returned by mqttsn_timer_driver_new() function.
+/// @return Number of milliseconds, @ref MQTTSN_TIMER_DRIVER_NO_TIMEOUT if there
+///     are no pending time measurements.
+unsigned mqttsn_timer_driver_next_timeout(MqttsnTimerDriverHandle driver);
+
+#ifdef __cplusplus
+}
+#endif
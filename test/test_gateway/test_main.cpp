@@ -0,0 +1,421 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicGateway.h"
+#include "gateway/ParsedOptions.h"
+#include "gateway/option.h"
+
+namespace
+{
+
+typedef mqttsn::gateway::ParsedOptions<
+    mqttsn::gateway::option::SessionsLimit<4>,
+    mqttsn::gateway::option::TopicsLimit<4>,
+    mqttsn::gateway::option::MaxPendingInboundQos2<2>
+> GwOptions;
+
+typedef mqttsn::gateway::BasicGateway<GwOptions> Gateway;
+
+typedef mqttsn::gateway::ParsedOptions<
+    mqttsn::gateway::option::SessionsLimit<4>,
+    mqttsn::gateway::option::TopicsLimit<4>,
+    mqttsn::gateway::option::SessionTopicsLimit<2>
+> SessionTopicsGwOptions;
+
+typedef mqttsn::gateway::BasicGateway<SessionTopicsGwOptions> SessionTopicsGateway;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Connect = 0x04;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Register = 0x0a;
+const std::uint8_t MsgType_Regack = 0x0b;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Puback = 0x0d;
+const std::uint8_t MsgType_Pubcomp = 0x0e;
+const std::uint8_t MsgType_Pubrec = 0x0f;
+const std::uint8_t MsgType_Pubrel = 0x10;
+const std::uint8_t MsgType_Disconnect = 0x18;
+
+const std::uint8_t ReturnCode_Accepted = 0x00;
+const std::uint8_t ReturnCode_Congestion = 0x01;
+const std::uint8_t ReturnCode_InvalidTopicId = 0x02;
+
+const MqttsnGwPeerId FirstPeer = 1U;
+const MqttsnGwPeerId SecondPeer = 2U;
+
+struct Sent
+{
+    MqttsnGwPeerId m_peer;
+    Frame m_frame;
+};
+
+std::uint16_t getU16(const Frame& frame, std::size_t pos)
+{
+    return static_cast<std::uint16_t>((frame[pos] << 8) | frame[pos + 1]);
+}
+
+template <typename TGateway>
+struct BasicEnv
+{
+    TGateway m_gw;
+    std::vector<Sent> m_sent;
+    std::vector<std::string> m_published;
+    std::vector<MqttsnAsyncOpStatus> m_completed;
+    std::uint16_t m_msgId = 0U;
+
+    BasicEnv()
+    {
+        m_gw.setNextTickProgramCallback(&BasicEnv::programTick, this);
+        m_gw.setCancelNextTickWaitCallback(&BasicEnv::cancelTick, this);
+        m_gw.setSendOutputDataCallback(&BasicEnv::send, this);
+        m_gw.setPublishReportCallback(&BasicEnv::publishReport, this);
+        m_gw.setPublishCompleteReportCallback(&BasicEnv::publishComplete, this);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_gw.start());
+        m_sent.clear();
+    }
+
+    void inject(MqttsnGwPeerId peer, const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_gw.processData(peer, iter, frame.size());
+    }
+
+    void connect(MqttsnGwPeerId peer)
+    {
+        inject(peer, Frame{7, MsgType_Connect, 0x04, 0x01, 0, 60, 'c'});
+        TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, lastSent(peer, MsgType_Connack)[2]);
+    }
+
+    /// @return Regack frame
+    Frame registerTopic(MqttsnGwPeerId peer, const char* topic)
+    {
+        ++m_msgId;
+        Frame frame{
+            0,
+            MsgType_Register,
+            0,
+            0,
+            static_cast<std::uint8_t>(m_msgId >> 8),
+            static_cast<std::uint8_t>(m_msgId)};
+        frame.insert(frame.end(), topic, topic + std::strlen(topic));
+        frame[0] = static_cast<std::uint8_t>(frame.size());
+        inject(peer, frame);
+        auto regack = lastSent(peer, MsgType_Regack);
+        TEST_ASSERT_EQUAL_UINT(m_msgId, getU16(regack, 4));
+        return regack;
+    }
+
+    /// @return Puback frame
+    Frame publishQos1(MqttsnGwPeerId peer, std::uint16_t topicId, const char* data)
+    {
+        ++m_msgId;
+        Frame frame{
+            0,
+            MsgType_Publish,
+            0x20, // QoS1, normal topic ID
+            static_cast<std::uint8_t>(topicId >> 8),
+            static_cast<std::uint8_t>(topicId),
+            static_cast<std::uint8_t>(m_msgId >> 8),
+            static_cast<std::uint8_t>(m_msgId)};
+        frame.insert(frame.end(), data, data + std::strlen(data));
+        frame[0] = static_cast<std::uint8_t>(frame.size());
+        inject(peer, frame);
+        return lastSent(peer, MsgType_Puback);
+    }
+
+    void publishQos2(MqttsnGwPeerId peer, std::uint16_t topicId, std::uint16_t msgId, const char* data, bool dup = false)
+    {
+        Frame frame{
+            0,
+            MsgType_Publish,
+            static_cast<std::uint8_t>(dup ? 0xc0 : 0x40), // QoS2, normal topic ID
+            static_cast<std::uint8_t>(topicId >> 8),
+            static_cast<std::uint8_t>(topicId),
+            static_cast<std::uint8_t>(msgId >> 8),
+            static_cast<std::uint8_t>(msgId)};
+        frame.insert(frame.end(), data, data + std::strlen(data));
+        frame[0] = static_cast<std::uint8_t>(frame.size());
+        inject(peer, frame);
+    }
+
+    Frame lastSent(MqttsnGwPeerId peer, std::uint8_t type) const
+    {
+        for (auto iter = m_sent.rbegin(); iter != m_sent.rend(); ++iter) {
+            if ((iter->m_peer == peer) &&
+                (2U <= iter->m_frame.size()) &&
+                (iter->m_frame[1] == type)) {
+                return iter->m_frame;
+            }
+        }
+
+        TEST_FAIL_MESSAGE("Expected frame wasn't sent");
+        return Frame();
+    }
+
+    unsigned sentCount(MqttsnGwPeerId peer, std::uint8_t type) const
+    {
+        unsigned count = 0U;
+        for (auto& sent : m_sent) {
+            if ((sent.m_peer == peer) && (sent.m_frame[1] == type)) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, MqttsnGwPeerId peer, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<BasicEnv*>(data)->m_sent.push_back(Sent{peer, Frame(buf, buf + bufLen)});
+    }
+
+    static bool publishReport(void* data, MqttsnGwPeerId, const MqttsnMessageInfo* info)
+    {
+        reinterpret_cast<BasicEnv*>(data)->m_published.emplace_back(info->topic);
+        return true;
+    }
+
+    static void publishComplete(void* data, MqttsnGwPeerId, MqttsnAsyncOpStatus status)
+    {
+        reinterpret_cast<BasicEnv*>(data)->m_completed.push_back(status);
+    }
+};
+
+typedef BasicEnv<Gateway> Env;
+typedef BasicEnv<SessionTopicsGateway> SessionTopicsEnv;
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_register_and_publish()
+{
+    Env env;
+    env.connect(FirstPeer);
+    auto regack = env.registerTopic(FirstPeer, "sensor/temp");
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, regack[6]);
+    auto topicId = getU16(regack, 2);
+    TEST_ASSERT_TRUE(topicId != 0U);
+
+    // Same topic, same ID
+    TEST_ASSERT_EQUAL_UINT(topicId, getU16(env.registerTopic(FirstPeer, "sensor/temp"), 2));
+
+    auto puback = env.publishQos1(FirstPeer, topicId, "21");
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, puback[6]);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_published.size());
+    TEST_ASSERT_EQUAL_STRING("sensor/temp", env.m_published[0].c_str());
+
+    puback = env.publishQos1(FirstPeer, topicId + 1U, "21");
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_InvalidTopicId, puback[6]);
+}
+
+void test_full_registry_congestion()
+{
+    Env env;
+    env.connect(FirstPeer);
+
+    // One entry of the registry always remains evictable
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.registerTopic(FirstPeer, "a")[6]);
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.registerTopic(FirstPeer, "b")[6]);
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.registerTopic(FirstPeer, "c")[6]);
+    auto regack = env.registerTopic(FirstPeer, "d");
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Congestion, regack[6]);
+    TEST_ASSERT_EQUAL_UINT(0U, getU16(regack, 2));
+}
+
+void test_referenced_topic_not_evicted()
+{
+    Env env;
+    env.connect(FirstPeer);
+    env.connect(SecondPeer);
+
+    auto topicIdA = getU16(env.registerTopic(FirstPeer, "a"), 2);
+    auto topicIdB = getU16(env.registerTopic(FirstPeer, "b"), 2);
+    env.registerTopic(SecondPeer, "x");
+    env.registerTopic(SecondPeer, "y");
+
+    // The topics of the second client become evictable
+    env.inject(SecondPeer, Frame{2, MsgType_Disconnect});
+
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.registerTopic(FirstPeer, "c")[6]);
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.publishQos1(FirstPeer, topicIdA, "1")[6]);
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.publishQos1(FirstPeer, topicIdB, "2")[6]);
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_published.size());
+    TEST_ASSERT_EQUAL_STRING("a", env.m_published[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("b", env.m_published[1].c_str());
+}
+
+void test_referenced_id_not_reused()
+{
+    Env env;
+    env.connect(FirstPeer);
+    env.connect(SecondPeer);
+    auto topicIdA = getU16(env.registerTopic(FirstPeer, "a"), 2);
+
+    // Cycle through the whole topic ID space
+    char topic[16];
+    for (unsigned idx = 0U; idx < 0x10000; ++idx) {
+        std::snprintf(topic, sizeof(topic), "t%u", idx);
+        auto regack = env.registerTopic(SecondPeer, topic);
+        TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, regack[6]);
+        TEST_ASSERT_TRUE(getU16(regack, 2) != topicIdA);
+        env.inject(SecondPeer, Frame{7, MsgType_Connect, 0x04, 0x01, 0, 60, 'c'});
+    }
+
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.publishQos1(FirstPeer, topicIdA, "1")[6]);
+    TEST_ASSERT_EQUAL_STRING("a", env.m_published.back().c_str());
+}
+
+void test_publish_registers_topic_once()
+{
+    Env env;
+    env.connect(FirstPeer);
+    static const std::uint8_t Data[] = {'1'};
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Success,
+        env.m_gw.publish(FirstPeer, "out/topic", Data, sizeof(Data), MqttsnQoS_AtMostOnceDelivery, false));
+
+    auto reg = env.lastSent(FirstPeer, MsgType_Register);
+    auto topicId = getU16(reg, 2);
+    TEST_ASSERT_EQUAL_UINT(0U, env.sentCount(FirstPeer, MsgType_Publish));
+    env.inject(FirstPeer, Frame{7, MsgType_Regack, reg[2], reg[3], reg[4], reg[5], ReturnCode_Accepted});
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(FirstPeer, MsgType_Publish));
+    TEST_ASSERT_EQUAL_UINT(topicId, getU16(env.lastSent(FirstPeer, MsgType_Publish), 3));
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0]);
+
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Success,
+        env.m_gw.publish(FirstPeer, "out/topic", Data, sizeof(Data), MqttsnQoS_AtMostOnceDelivery, false));
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(FirstPeer, MsgType_Register));
+    TEST_ASSERT_EQUAL_UINT(2U, env.sentCount(FirstPeer, MsgType_Publish));
+}
+
+void test_rejected_registration_forgotten()
+{
+    Env env;
+    env.connect(FirstPeer);
+    static const std::uint8_t Data[] = {'1'};
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Success,
+        env.m_gw.publish(FirstPeer, "out/topic", Data, sizeof(Data), MqttsnQoS_AtMostOnceDelivery, false));
+
+    auto reg = env.lastSent(FirstPeer, MsgType_Register);
+    env.inject(FirstPeer, Frame{7, MsgType_Regack, reg[2], reg[3], reg[4], reg[5], ReturnCode_Congestion});
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Congestion, env.m_completed[0]);
+    TEST_ASSERT_EQUAL_UINT(0U, env.sentCount(FirstPeer, MsgType_Publish));
+
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Success,
+        env.m_gw.publish(FirstPeer, "out/topic", Data, sizeof(Data), MqttsnQoS_AtMostOnceDelivery, false));
+    TEST_ASSERT_EQUAL_UINT(2U, env.sentCount(FirstPeer, MsgType_Register));
+}
+
+void test_full_session_topics_congestion()
+{
+    SessionTopicsEnv env;
+    env.connect(FirstPeer);
+    auto topicIdA = getU16(env.registerTopic(FirstPeer, "a"), 2);
+    auto topicIdB = getU16(env.registerTopic(FirstPeer, "b"), 2);
+
+    // The registry has room, but the session doesn't
+    auto regack = env.registerTopic(FirstPeer, "c");
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Congestion, regack[6]);
+    TEST_ASSERT_EQUAL_UINT(0U, getU16(regack, 2));
+
+    static const std::uint8_t Data[] = {'1'};
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Busy,
+        env.m_gw.publish(FirstPeer, "c", Data, sizeof(Data), MqttsnQoS_AtMostOnceDelivery, false));
+
+    // Known IDs remain valid
+    TEST_ASSERT_EQUAL_UINT(topicIdA, getU16(env.registerTopic(FirstPeer, "a"), 2));
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.publishQos1(FirstPeer, topicIdA, "1")[6]);
+    TEST_ASSERT_EQUAL_UINT8(ReturnCode_Accepted, env.publishQos1(FirstPeer, topicIdB, "2")[6]);
+    TEST_ASSERT_EQUAL_STRING("a", env.m_published[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("b", env.m_published[1].c_str());
+}
+
+void test_interleaved_inbound_qos2()
+{
+    Env env;
+    env.connect(FirstPeer);
+    auto topicId = getU16(env.registerTopic(FirstPeer, "q2"), 2);
+
+    env.publishQos2(FirstPeer, topicId, 0x101, "1");
+    TEST_ASSERT_EQUAL_UINT(0x101, getU16(env.lastSent(FirstPeer, MsgType_Pubrec), 2));
+    env.publishQos2(FirstPeer, topicId, 0x202, "2");
+    TEST_ASSERT_EQUAL_UINT(0x202, getU16(env.lastSent(FirstPeer, MsgType_Pubrec), 2));
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_published.size());
+
+    // PUBREC of the first one was lost
+    env.publishQos2(FirstPeer, topicId, 0x101, "1", true);
+    TEST_ASSERT_EQUAL_UINT(3U, env.sentCount(FirstPeer, MsgType_Pubrec));
+    TEST_ASSERT_EQUAL_UINT(0x101, getU16(env.lastSent(FirstPeer, MsgType_Pubrec), 2));
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_published.size());
+
+    // No room for the third one, dropped without PUBREC
+    env.publishQos2(FirstPeer, topicId, 0x303, "3");
+    TEST_ASSERT_EQUAL_UINT(3U, env.sentCount(FirstPeer, MsgType_Pubrec));
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_published.size());
+
+    env.inject(FirstPeer, Frame{4, MsgType_Pubrel, 0x02, 0x02});
+    TEST_ASSERT_EQUAL_UINT(0x202, getU16(env.lastSent(FirstPeer, MsgType_Pubcomp), 2));
+
+    env.publishQos2(FirstPeer, topicId, 0x303, "3", true);
+    TEST_ASSERT_EQUAL_UINT(0x303, getU16(env.lastSent(FirstPeer, MsgType_Pubrec), 2));
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_published.size());
+
+    // The first one is still pending
+    env.publishQos2(FirstPeer, topicId, 0x101, "1", true);
+    TEST_ASSERT_EQUAL_UINT(0x101, getU16(env.lastSent(FirstPeer, MsgType_Pubrec), 2));
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_published.size());
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_register_and_publish);
+    RUN_TEST(test_full_registry_congestion);
+    RUN_TEST(test_referenced_topic_not_evicted);
+    RUN_TEST(test_referenced_id_not_reused);
+    RUN_TEST(test_publish_registers_topic_once);
+    RUN_TEST(test_rejected_registration_forgotten);
+    RUN_TEST(test_full_session_topics_congestion);
+    RUN_TEST(test_interleaved_inbound_qos2);
+    return UNITY_END();
+}
@@ -0,0 +1,231 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicClient.h"
+#include "ParsedOptions.h"
+#include "option.h"
+
+namespace
+{
+
+typedef mqttsn::client::ParsedOptions<
+    mqttsn::client::option::MaxPendingInboundQos2<4>
+> ClientOptions;
+
+typedef mqttsn::client::BasicClient<ClientOptions> Client;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Advertise = 0x00;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Pubrec = 0x0f;
+const std::uint8_t MsgType_Pubrel = 0x10;
+const std::uint8_t MsgType_Pubcomp = 0x0e;
+
+struct Env
+{
+    Client m_client;
+    std::vector<Frame> m_sent;
+    std::vector<std::string> m_reported;
+
+    Env()
+    {
+        m_client.setNextTickProgramCallback(&Env::programTick, this);
+        m_client.setCancelNextTickWaitCallback(&Env::cancelTick, this);
+        m_client.setSendOutputDataCallback(&Env::send, this);
+        m_client.setMessageReportCallback(&Env::report, this);
+        m_client.setSearchgwEnabled(false);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_client.start());
+
+        inject(Frame{5, MsgType_Advertise, 1, 0, 60});
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.connect("c", 60, true, nullptr, &Env::ignoreComplete, nullptr));
+        inject(Frame{3, MsgType_Connack, 0});
+        m_sent.clear();
+    }
+
+    void inject(const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_client.processData(iter, frame.size());
+    }
+
+    void publishQos2(std::uint16_t msgId, const char* data, bool dup = false)
+    {
+        Frame frame{
+            0,
+            MsgType_Publish,
+            static_cast<std::uint8_t>(0x42 | (dup ? 0x80 : 0x00)), // QoS2, short topic name
+            't',
+            't',
+            static_cast<std::uint8_t>(msgId >> 8),
+            static_cast<std::uint8_t>(msgId)};
+        frame.insert(frame.end(), data, data + std::strlen(data));
+        frame[0] = static_cast<std::uint8_t>(frame.size());
+        inject(frame);
+    }
+
+    void pubrel(std::uint16_t msgId)
+    {
+        inject(Frame{4, MsgType_Pubrel, static_cast<std::uint8_t>(msgId >> 8), static_cast<std::uint8_t>(msgId)});
+    }
+
+    unsigned sentCount(std::uint8_t type, std::uint16_t msgId) const
+    {
+        unsigned count = 0U;
+        for (auto& frame : m_sent) {
+            if ((frame.size() == 4U) &&
+                (frame[1] == type) &&
+                (frame[2] == static_cast<std::uint8_t>(msgId >> 8)) &&
+                (frame[3] == static_cast<std::uint8_t>(msgId))) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<Env*>(data)->m_sent.emplace_back(buf, buf + bufLen);
+    }
+
+    static void report(void* data, const MqttsnMessageInfo* info)
+    {
+        reinterpret_cast<Env*>(data)->m_reported.emplace_back(
+            reinterpret_cast<const char*>(info->msg), info->msgLen);
+    }
+
+    static void ignoreComplete(void*, MqttsnAsyncOpStatus) {}
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_colliding_msg_ids_both_delivered()
+{
+    Env env;
+    env.publishQos2(1U, "first");
+    env.publishQos2(5U, "second");
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubrec, 1U));
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubrec, 5U));
+
+    env.pubrel(1U);
+    env.pubrel(5U);
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubcomp, 1U));
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubcomp, 5U));
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_reported.size());
+    TEST_ASSERT_EQUAL_STRING("first", env.m_reported[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("second", env.m_reported[1].c_str());
+}
+
+void test_all_slots_busy_no_pubrec()
+{
+    Env env;
+    for (std::uint16_t msgId = 1U; msgId <= 4U; ++msgId) {
+        env.publishQos2(msgId, "busy");
+    }
+
+    env.publishQos2(9U, "extra");
+    TEST_ASSERT_EQUAL_UINT(0U, env.sentCount(MsgType_Pubrec, 9U));
+
+    // The pending ones are intact
+    for (std::uint16_t msgId = 1U; msgId <= 4U; ++msgId) {
+        env.pubrel(msgId);
+        TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubcomp, msgId));
+    }
+    TEST_ASSERT_EQUAL_UINT(4U, env.m_reported.size());
+
+    // Accepted once retried by the gateway
+    env.publishQos2(9U, "extra", true);
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubrec, 9U));
+    env.pubrel(9U);
+    TEST_ASSERT_EQUAL_UINT(5U, env.m_reported.size());
+    TEST_ASSERT_EQUAL_STRING("extra", env.m_reported[4].c_str());
+}
+
+void test_duplicate_reported_once()
+{
+    Env env;
+    env.publishQos2(3U, "once");
+    env.publishQos2(3U, "once", true);
+    TEST_ASSERT_EQUAL_UINT(2U, env.sentCount(MsgType_Pubrec, 3U));
+    env.pubrel(3U);
+    env.pubrel(3U);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reported.size());
+}
+
+void test_same_bucket_msg_ids_released_out_of_order()
+{
+    Env env;
+    env.publishQos2(1U, "a");
+    env.publishQos2(9U, "b");
+    env.publishQos2(17U, "c");
+    env.pubrel(9U);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reported.size());
+    TEST_ASSERT_EQUAL_STRING("b", env.m_reported[0].c_str());
+
+    // The remaining ones are still found after the one in between is gone
+    env.publishQos2(17U, "c", true);
+    env.publishQos2(1U, "a", true);
+    TEST_ASSERT_EQUAL_UINT(2U, env.sentCount(MsgType_Pubrec, 17U));
+    TEST_ASSERT_EQUAL_UINT(2U, env.sentCount(MsgType_Pubrec, 1U));
+    env.pubrel(17U);
+    env.pubrel(1U);
+    env.pubrel(17U);
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_reported.size());
+    TEST_ASSERT_EQUAL_STRING("c", env.m_reported[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("a", env.m_reported[2].c_str());
+
+    // The reported slots are reused, the oldest report first
+    for (std::uint16_t msgId = 25U; msgId <= 28U; ++msgId) {
+        env.publishQos2(msgId, "new");
+        TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubrec, msgId));
+    }
+    env.publishQos2(29U, "extra");
+    TEST_ASSERT_EQUAL_UINT(0U, env.sentCount(MsgType_Pubrec, 29U));
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_colliding_msg_ids_both_delivered);
+    RUN_TEST(test_all_slots_busy_no_pubrec);
+    RUN_TEST(test_duplicate_reported_once);
+    RUN_TEST(test_same_bucket_msg_ids_released_out_of_order);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "details/OutboundJournal.h"
+
+namespace
+{
+
+typedef mqttsn::client::details::OutboundJournal<std::string, std::vector<std::uint8_t>, 4U> Journal;
+
+struct MemStore
+{
+    std::vector<std::uint8_t> m_bytes;
+    unsigned m_outOfRange = 0U;
+    std::vector<unsigned short> m_dropped;
+    MqttsnJournalStore m_store;
+
+    MemStore(unsigned size, unsigned sectorSize)
+      : m_bytes(size, 0xffU)
+    {
+        m_store = MqttsnJournalStore();
+        m_store.size = size;
+        m_store.sectorSize = sectorSize;
+        m_store.read = &MemStore::read;
+        m_store.write = &MemStore::write;
+        m_store.data = this;
+    }
+
+    bool inRange(unsigned offset, unsigned len)
+    {
+        if ((m_bytes.size() < offset) || ((m_bytes.size() - offset) < len)) {
+            ++m_outOfRange;
+            return false;
+        }
+        return true;
+    }
+
+    static void read(void* data, unsigned offset, unsigned char* buf, unsigned len)
+    {
+        auto* thisPtr = reinterpret_cast<MemStore*>(data);
+        if (thisPtr->inRange(offset, len)) {
+            std::copy_n(&thisPtr->m_bytes[offset], len, buf);
+        }
+    }
+
+    static void write(void* data, unsigned offset, const unsigned char* buf, unsigned len)
+    {
+        auto* thisPtr = reinterpret_cast<MemStore*>(data);
+        if (thisPtr->inRange(offset, len)) {
+            std::copy_n(buf, len, &thisPtr->m_bytes[offset]);
+        }
+    }
+
+    static void dropped(void* data, unsigned short msgId)
+    {
+        reinterpret_cast<MemStore*>(data)->m_dropped.push_back(msgId);
+    }
+};
+
+void openJournal(Journal& journal, MemStore& mem)
+{
+    TEST_ASSERT_TRUE(journal.setStore(&mem.m_store));
+    journal.setDropReportCallback(&MemStore::dropped, &mem);
+    journal.open();
+}
+
+bool append(Journal& journal, std::uint16_t msgId, std::size_t dataLen)
+{
+    mqttsn::client::details::JournalRecord rec;
+    rec.m_msgId = msgId;
+    rec.m_kind = mqttsn::client::details::JournalTopicKind::Predefined;
+    std::vector<std::uint8_t> data(dataLen, static_cast<std::uint8_t>(msgId));
+    auto result = journal.append(msgId % 4U, rec, nullptr, 0U, data.data(), data.size());
+    journal.commit();
+    return result;
+}
+
+void checkReplay(Journal& journal, std::uint16_t msgId, std::size_t dataLen)
+{
+    std::size_t slotIdx = msgId % 4U;
+    TEST_ASSERT_TRUE(journal.replayPending(slotIdx));
+    auto rec = journal.loadReplay(slotIdx);
+    TEST_ASSERT_EQUAL_UINT(msgId, rec.m_msgId);
+    TEST_ASSERT_EQUAL_UINT(dataLen, journal.replayDataLen(slotIdx));
+    TEST_ASSERT_EQUAL_UINT(msgId, journal.replayData(slotIdx)[dataLen - 1U]);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_rollover_stays_within_store()
+{
+    MemStore mem(256U, 128U);
+    Journal journal;
+    openJournal(journal, mem);
+
+    TEST_ASSERT_TRUE(append(journal, 1U, 36U));
+    TEST_ASSERT_TRUE(append(journal, 2U, 36U));
+
+    // Both pending records are moved into the next sector, no room is left
+    TEST_ASSERT_FALSE(append(journal, 3U, 36U));
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_outOfRange);
+    TEST_ASSERT_EQUAL_UINT(1U, mem.m_dropped.size());
+    TEST_ASSERT_EQUAL_UINT(3U, mem.m_dropped[0]);
+
+    journal.markDone(1U);
+    journal.commit();
+    TEST_ASSERT_TRUE(append(journal, 5U, 36U));
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_outOfRange);
+
+    Journal reopened;
+    openJournal(reopened, mem);
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_outOfRange);
+    checkReplay(reopened, 2U, 36U);
+    checkReplay(reopened, 5U, 36U);
+    TEST_ASSERT_FALSE(reopened.replayPending(3U));
+}
+
+void test_many_rollovers()
+{
+    MemStore mem(512U, 128U);
+    Journal journal;
+    openJournal(journal, mem);
+
+    for (std::uint16_t msgId = 1U; msgId < 200U; ++msgId) {
+        TEST_ASSERT_TRUE(append(journal, msgId, 20U + (msgId % 17U)));
+        if (msgId % 3U != 0U) {
+            journal.markDone(msgId % 4U);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_outOfRange);
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_dropped.size());
+
+    Journal reopened;
+    openJournal(reopened, mem);
+    checkReplay(reopened, 198U, 20U + (198U % 17U));
+}
+
+void test_full_store_reports_dropped()
+{
+    MemStore mem(256U, 128U);
+    Journal journal;
+    openJournal(journal, mem);
+
+    TEST_ASSERT_TRUE(append(journal, 1U, 100U));
+    TEST_ASSERT_FALSE(append(journal, 2U, 100U));
+    TEST_ASSERT_FALSE(append(journal, 3U, 100U));
+    TEST_ASSERT_EQUAL_UINT(0U, mem.m_outOfRange);
+    TEST_ASSERT_EQUAL_UINT(2U, mem.m_dropped.size());
+    TEST_ASSERT_EQUAL_UINT(2U, mem.m_dropped[0]);
+    TEST_ASSERT_EQUAL_UINT(3U, mem.m_dropped[1]);
+
+    Journal reopened;
+    openJournal(reopened, mem);
+    checkReplay(reopened, 1U, 100U);
+}
+
+void test_too_big_record_reported()
+{
+    MemStore mem(256U, 128U);
+    Journal journal;
+    openJournal(journal, mem);
+
+    TEST_ASSERT_FALSE(append(journal, 7U, 200U));
+    TEST_ASSERT_EQUAL_UINT(1U, mem.m_dropped.size());
+    TEST_ASSERT_EQUAL_UINT(7U, mem.m_dropped[0]);
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_rollover_stays_within_store);
+    RUN_TEST(test_many_rollovers);
+    RUN_TEST(test_full_store_reports_dropped);
+    RUN_TEST(test_too_big_record_reported);
+    return UNITY_END();
+}
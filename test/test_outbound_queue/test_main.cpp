@@ -0,0 +1,436 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicClient.h"
+#include "ParsedOptions.h"
+#include "option.h"
+
+namespace
+{
+
+const std::size_t QueueLimit = 3U;
+
+typedef mqttsn::client::ParsedOptions<
+    mqttsn::client::option::OutboundQueueLimit<QueueLimit>,
+    mqttsn::client::option::MaxInflightPublishes<2>,
+    mqttsn::client::option::RegisteredTopicsLimit<2>
+> ClientOptions;
+
+typedef mqttsn::client::BasicClient<ClientOptions> Client;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Advertise = 0x00;
+const std::uint8_t MsgType_Connect = 0x04;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Register = 0x0a;
+const std::uint8_t MsgType_Regack = 0x0b;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Puback = 0x0d;
+const std::uint8_t MsgType_Subscribe = 0x12;
+const std::uint8_t MsgType_Suback = 0x13;
+
+const std::uint8_t RetCode_Accepted = 0x00;
+const std::uint8_t RetCode_Congestion = 0x01;
+
+const MqttsnTopicId TopicId = 0x0102;
+
+std::uint16_t getU16(const Frame& frame, std::size_t pos)
+{
+    return static_cast<std::uint16_t>((frame[pos] << 8) | frame[pos + 1]);
+}
+
+struct Completion
+{
+    unsigned m_id;
+    MqttsnAsyncOpStatus m_status;
+};
+
+struct Report
+{
+    unsigned m_count;
+    unsigned m_dropped;
+};
+
+struct Env;
+
+struct PublishCtx
+{
+    Env* m_env;
+    unsigned m_id;
+    std::uint8_t m_data;
+};
+
+struct Env
+{
+    Client m_client;
+    std::vector<Frame> m_sent;
+    std::vector<Completion> m_completed;
+    std::vector<Report> m_reports;
+    std::vector<PublishCtx> m_ctxs;
+
+    Env()
+    {
+        m_ctxs.reserve(16U);
+        m_client.setNextTickProgramCallback(&Env::programTick, this);
+        m_client.setCancelNextTickWaitCallback(&Env::cancelTick, this);
+        m_client.setSendOutputDataCallback(&Env::send, this);
+        m_client.setMessageReportCallback(&Env::report, this);
+        m_client.setOutboundQueueReportCallback(QueueLimit, &Env::queueReport, this);
+        m_client.setSearchgwEnabled(false);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_client.start());
+        inject(Frame{5, MsgType_Advertise, 1, 0, 60});
+    }
+
+    void connect()
+    {
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.connect("c", 60, true, nullptr, &Env::ignoreComplete, nullptr));
+        TEST_ASSERT_EQUAL_UINT8(MsgType_Connect, m_sent.back()[1]);
+        inject(Frame{3, MsgType_Connack, 0});
+    }
+
+    void inject(const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_client.processData(iter, frame.size());
+    }
+
+    // The single data byte of the message is its ID, kept until the
+    // publish is complete in case it is not queued
+    MqttsnErrorCode publishId(unsigned id)
+    {
+        auto* ctx = newCtx(id);
+        return m_client.publish(
+            TopicId, &ctx->m_data, 1U, MqttsnQoS_AtLeastOnceDelivery, false, &Env::publishComplete, ctx);
+    }
+
+    MqttsnErrorCode publishName(const char* topic, unsigned id)
+    {
+        auto* ctx = newCtx(id);
+        return m_client.publish(
+            topic, &ctx->m_data, 1U, MqttsnQoS_AtLeastOnceDelivery, false, &Env::publishComplete, ctx);
+    }
+
+    MqttsnErrorCode publishHandle(MqttsnTopicHandle handle, unsigned id)
+    {
+        auto* ctx = newCtx(id);
+        return m_client.publishHandle(
+            handle, &ctx->m_data, 1U, MqttsnQoS_AtLeastOnceDelivery, false, &Env::publishComplete, ctx);
+    }
+
+    void ack(std::uint8_t type, MqttsnTopicId topicId, std::uint16_t msgId, std::uint8_t retCode = RetCode_Accepted)
+    {
+        inject(Frame{
+            7,
+            type,
+            static_cast<std::uint8_t>(topicId >> 8),
+            static_cast<std::uint8_t>(topicId),
+            static_cast<std::uint8_t>(msgId >> 8),
+            static_cast<std::uint8_t>(msgId),
+            retCode});
+    }
+
+    /// @brief Acknowledge all the sent and not yet acknowledged REGISTER
+    ///     and PUBLISH messages, including the ones sent in response.
+    void ackAll()
+    {
+        for (std::size_t idx = m_acked; idx < m_sent.size(); ++idx) {
+            auto frame = m_sent[idx];
+            m_acked = idx + 1U;
+            if (frame[1] == MsgType_Register) {
+                std::string topic(frame.begin() + 6, frame.end());
+                auto topicId = static_cast<MqttsnTopicId>(0x1000 + topic[0]);
+                ack(MsgType_Regack, topicId, getU16(frame, 4));
+            }
+            else if (frame[1] == MsgType_Publish) {
+                ack(MsgType_Puback, getU16(frame, 3), getU16(frame, 5));
+            }
+        }
+    }
+
+    /// @return Data bytes of the sent PUBLISH messages.
+    std::vector<unsigned> publishedIds() const
+    {
+        std::vector<unsigned> result;
+        for (auto& frame : m_sent) {
+            if (frame[1] == MsgType_Publish) {
+                result.push_back(frame.back());
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::string> registeredTopics() const
+    {
+        std::vector<std::string> result;
+        for (auto& frame : m_sent) {
+            if (frame[1] == MsgType_Register) {
+                result.emplace_back(frame.begin() + 6, frame.end());
+            }
+        }
+        return result;
+    }
+
+    PublishCtx* newCtx(unsigned id)
+    {
+        m_ctxs.push_back(PublishCtx{this, id, static_cast<std::uint8_t>(id)});
+        return &m_ctxs.back();
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<Env*>(data)->m_sent.emplace_back(buf, buf + bufLen);
+    }
+
+    static void report(void*, const MqttsnMessageInfo*) {}
+
+    static void queueReport(void* data, unsigned count, unsigned dropped)
+    {
+        reinterpret_cast<Env*>(data)->m_reports.push_back(Report{count, dropped});
+    }
+
+    static void publishComplete(void* data, MqttsnAsyncOpStatus status)
+    {
+        auto* ctx = reinterpret_cast<PublishCtx*>(data);
+        ctx->m_env->m_completed.push_back(Completion{ctx->m_id, status});
+    }
+
+    static void ignoreComplete(void*, MqttsnAsyncOpStatus) {}
+
+    static void ignoreSubscribeComplete(void*, MqttsnAsyncOpStatus, MqttsnQoS) {}
+
+    std::size_t m_acked = 0U;
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_queued_while_disconnected()
+{
+    Env env;
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(1U));
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(2U));
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE(env.m_sent.empty());
+
+    env.connect();
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U, 2U}) == env.publishedIds());
+
+    env.ackAll();
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed[0].m_id);
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0].m_status);
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_completed[1].m_id);
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[1].m_status);
+}
+
+void test_queued_while_other_op_in_progress()
+{
+    Env env;
+    env.connect();
+    TEST_ASSERT_EQUAL_INT(
+        MqttsnErrorCode_Success,
+        env.m_client.subscribe(
+            TopicId, MqttsnQoS_AtLeastOnceDelivery, &Env::ignoreSubscribeComplete, nullptr));
+    auto subFrame = env.m_sent.back();
+    TEST_ASSERT_EQUAL_UINT8(MsgType_Subscribe, subFrame[1]);
+
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(1U));
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE(env.publishedIds().empty());
+
+    env.inject(Frame{
+        8, MsgType_Suback, 0x20,
+        static_cast<std::uint8_t>(TopicId >> 8), static_cast<std::uint8_t>(TopicId),
+        subFrame[3], subFrame[4], RetCode_Accepted});
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U}) == env.publishedIds());
+}
+
+void test_queued_while_throttled()
+{
+    Env env;
+    env.connect();
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(1U));
+    auto pubFrame = env.m_sent.back();
+    env.ack(MsgType_Puback, TopicId, getU16(pubFrame, 5), RetCode_Congestion);
+
+    // Free publish slot is available, but the gateway asked to hold off
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(2U));
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U}) == env.publishedIds());
+
+    // Retried after the hold off, the window is reduced to single message
+    for (unsigned count = 0U; (count < 100U) && (env.publishedIds().size() < 2U); ++count) {
+        env.m_client.tick();
+    }
+
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U, 1U}) == env.publishedIds());
+
+    env.ack(MsgType_Puback, TopicId, getU16(pubFrame, 5));
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0].m_status);
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U, 1U, 2U}) == env.publishedIds());
+}
+
+void test_fifo_across_topic_kinds()
+{
+    Env env;
+    auto handle = env.m_client.resolveTopic("h/b");
+    TEST_ASSERT_TRUE(handle != MQTTSN_INVALID_TOPIC_HANDLE);
+
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishHandle(handle, 1U));
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(2U));
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishName("n/a", 3U));
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_client.outboundQueueCount());
+
+    env.connect();
+
+    // Two publish slots, the third entry waits for one of them
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<std::string>{"h/b"}) == env.registeredTopics());
+    TEST_ASSERT_TRUE((std::vector<unsigned>{2U}) == env.publishedIds());
+
+    env.ackAll();
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE((std::vector<std::string>{"h/b", "n/a"}) == env.registeredTopics());
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_completed.size());
+    for (auto& completion : env.m_completed) {
+        TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, completion.m_status);
+    }
+
+    env.m_client.releaseTopic(handle);
+}
+
+void test_drop_oldest_reports_aborted()
+{
+    Env env;
+    for (unsigned id = 1U; id <= QueueLimit; ++id) {
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(id));
+    }
+
+    // High water mark reached
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reports.size());
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_reports[0].m_count);
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_reports[0].m_dropped);
+
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(4U));
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_client.outboundQueueCount());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed[0].m_id);
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Aborted, env.m_completed[0].m_status);
+
+    // Reported on drop and when the high water mark is reached again
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_reports.size());
+    TEST_ASSERT_EQUAL_UINT(QueueLimit - 1U, env.m_reports[1].m_count);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reports[1].m_dropped);
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_reports[2].m_count);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reports[2].m_dropped);
+
+    env.connect();
+    env.ackAll();
+    TEST_ASSERT_TRUE((std::vector<unsigned>{2U, 3U, 4U}) == env.publishedIds());
+    TEST_ASSERT_EQUAL_UINT(4U, env.m_completed.size());
+}
+
+void test_drop_newest_returns_busy()
+{
+    Env env;
+    env.m_client.setOutboundQueuePolicy(MqttsnOutboundQueuePolicy_DropNewest);
+    for (unsigned id = 1U; id <= QueueLimit; ++id) {
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(id));
+    }
+
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Busy, env.publishId(4U));
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Busy, env.publishId(5U));
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE(env.m_completed.empty());
+
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_reports.size());
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_reports[1].m_count);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_reports[1].m_dropped);
+    TEST_ASSERT_EQUAL_UINT(QueueLimit, env.m_reports[2].m_count);
+    TEST_ASSERT_EQUAL_UINT(2U, env.m_reports[2].m_dropped);
+
+    env.connect();
+    env.ackAll();
+    TEST_ASSERT_TRUE((std::vector<unsigned>{1U, 2U, 3U}) == env.publishedIds());
+}
+
+void test_stale_handle_reported_invalid_id()
+{
+    Env env;
+    auto handle = env.m_client.resolveTopic("h/b");
+    TEST_ASSERT_TRUE(handle != MQTTSN_INVALID_TOPIC_HANDLE);
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishHandle(handle, 1U));
+    TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, env.publishId(2U));
+
+    // Evicted by other topic after release
+    env.m_client.releaseTopic(handle);
+    env.m_client.releaseTopic(env.m_client.resolveTopic("x/1"));
+    auto otherHandle = env.m_client.resolveTopic("x/2");
+    TEST_ASSERT_TRUE(otherHandle != MQTTSN_INVALID_TOPIC_HANDLE);
+
+    env.connect();
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_client.outboundQueueCount());
+    TEST_ASSERT_TRUE(env.registeredTopics().empty());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed[0].m_id);
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_InvalidId, env.m_completed[0].m_status);
+
+    // The following entry is still published
+    TEST_ASSERT_TRUE((std::vector<unsigned>{2U}) == env.publishedIds());
+
+    env.m_client.releaseTopic(otherHandle);
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_queued_while_disconnected);
+    RUN_TEST(test_queued_while_other_op_in_progress);
+    RUN_TEST(test_queued_while_throttled);
+    RUN_TEST(test_fifo_across_topic_kinds);
+    RUN_TEST(test_drop_oldest_reports_aborted);
+    RUN_TEST(test_drop_newest_returns_busy);
+    RUN_TEST(test_stale_handle_reported_invalid_id);
+    return UNITY_END();
+}
@@ -0,0 +1,307 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicClient.h"
+#include "ParsedOptions.h"
+#include "option.h"
+
+namespace
+{
+
+const std::size_t InflightLimit = 4U;
+
+typedef mqttsn::client::ParsedOptions<
+    mqttsn::client::option::MaxInflightPublishes<InflightLimit>
+> ClientOptions;
+
+typedef mqttsn::client::BasicClient<ClientOptions> Client;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Advertise = 0x00;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Puback = 0x0d;
+const std::uint8_t MsgType_Pubcomp = 0x0e;
+const std::uint8_t MsgType_Pubrec = 0x0f;
+const std::uint8_t MsgType_Pubrel = 0x10;
+
+const std::uint8_t Flag_Dup = 0x80;
+
+const MqttsnTopicId TopicId = 0x0102;
+
+std::uint16_t getU16(const Frame& frame, std::size_t pos)
+{
+    return static_cast<std::uint16_t>((frame[pos] << 8) | frame[pos + 1]);
+}
+
+struct Completion
+{
+    unsigned m_id;
+    MqttsnAsyncOpStatus m_status;
+};
+
+struct Env;
+
+struct PublishCtx
+{
+    Env* m_env;
+    unsigned m_id;
+};
+
+struct Env
+{
+    Client m_client;
+    std::vector<Frame> m_sent;
+    std::vector<Completion> m_completed;
+    std::vector<PublishCtx> m_ctxs;
+
+    Env()
+    {
+        m_ctxs.reserve(16U);
+        m_client.setNextTickProgramCallback(&Env::programTick, this);
+        m_client.setCancelNextTickWaitCallback(&Env::cancelTick, this);
+        m_client.setSendOutputDataCallback(&Env::send, this);
+        m_client.setMessageReportCallback(&Env::report, this);
+        m_client.setSearchgwEnabled(false);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_client.start());
+
+        inject(Frame{5, MsgType_Advertise, 1, 0, 60});
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.connect("c", 60, true, nullptr, &Env::ignoreComplete, nullptr));
+        inject(Frame{3, MsgType_Connack, 0});
+        m_sent.clear();
+    }
+
+    void inject(const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_client.processData(iter, frame.size());
+    }
+
+    /// @return Message ID of the sent PUBLISH, 0 if rejected
+    std::uint16_t publish(unsigned id, MqttsnQoS qos = MqttsnQoS_AtLeastOnceDelivery)
+    {
+        static const std::uint8_t Data[] = {'d'};
+        m_ctxs.push_back(PublishCtx{this, id});
+        auto es =
+            m_client.publish(
+                TopicId, Data, sizeof(Data), qos, false, &Env::publishComplete, &m_ctxs.back());
+        if (es != MqttsnErrorCode_Success) {
+            return 0U;
+        }
+
+        auto& frame = m_sent.back();
+        TEST_ASSERT_EQUAL_UINT8(MsgType_Publish, frame[1]);
+        return getU16(frame, 5);
+    }
+
+    void puback(std::uint16_t msgId, MqttsnTopicId topicId = TopicId)
+    {
+        inject(Frame{
+            7,
+            MsgType_Puback,
+            static_cast<std::uint8_t>(topicId >> 8),
+            static_cast<std::uint8_t>(topicId),
+            static_cast<std::uint8_t>(msgId >> 8),
+            static_cast<std::uint8_t>(msgId),
+            0});
+    }
+
+    void ack(std::uint8_t type, std::uint16_t msgId)
+    {
+        inject(Frame{4, type, static_cast<std::uint8_t>(msgId >> 8), static_cast<std::uint8_t>(msgId)});
+    }
+
+    unsigned sentCount(std::uint8_t type) const
+    {
+        unsigned count = 0U;
+        for (auto& frame : m_sent) {
+            if (frame[1] == type) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<Env*>(data)->m_sent.emplace_back(buf, buf + bufLen);
+    }
+
+    static void report(void*, const MqttsnMessageInfo*) {}
+
+    static void publishComplete(void* data, MqttsnAsyncOpStatus status)
+    {
+        auto* ctx = reinterpret_cast<PublishCtx*>(data);
+        ctx->m_env->m_completed.push_back(Completion{ctx->m_id, status});
+    }
+
+    static void ignoreComplete(void*, MqttsnAsyncOpStatus) {}
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_out_of_order_completions()
+{
+    Env env;
+    auto msgId1 = env.publish(1U);
+    auto msgId2 = env.publish(2U);
+    auto msgId3 = env.publish(3U, MqttsnQoS_ExactlyOnceDelivery);
+    auto msgId4 = env.publish(4U);
+    TEST_ASSERT_TRUE((msgId1 != 0U) && (msgId2 != 0U) && (msgId3 != 0U) && (msgId4 != 0U));
+    TEST_ASSERT_EQUAL_UINT(4U, env.sentCount(MsgType_Publish));
+
+    env.puback(msgId4);
+    env.ack(MsgType_Pubrec, msgId3);
+    TEST_ASSERT_EQUAL_UINT(1U, env.sentCount(MsgType_Pubrel));
+    env.puback(msgId2);
+    env.ack(MsgType_Pubcomp, msgId3);
+    env.puback(msgId1);
+
+    TEST_ASSERT_EQUAL_UINT(4U, env.m_completed.size());
+    static const unsigned Order[] = {4U, 2U, 3U, 1U};
+    for (std::size_t idx = 0U; idx < env.m_completed.size(); ++idx) {
+        TEST_ASSERT_EQUAL_UINT(Order[idx], env.m_completed[idx].m_id);
+        TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[idx].m_status);
+    }
+}
+
+void test_unknown_and_stale_acks_ignored()
+{
+    Env env;
+    auto msgId = env.publish(1U);
+
+    // Maps to the same slot, but different message ID
+    env.puback(static_cast<std::uint16_t>(msgId + InflightLimit));
+    // Maps to a free slot
+    env.puback(static_cast<std::uint16_t>(msgId + 1U));
+    // Wrong topic ID
+    env.puback(msgId, TopicId + 1U);
+    // PUBCOMP without PUBREC
+    env.ack(MsgType_Pubcomp, msgId);
+    TEST_ASSERT_TRUE(env.m_completed.empty());
+
+    env.puback(msgId);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0].m_status);
+
+    // Acknowledged already
+    env.puback(msgId);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+}
+
+void test_msg_id_maps_to_free_slot()
+{
+    Env env;
+    std::uint16_t msgIds[InflightLimit] = {0U};
+    for (unsigned idx = 0U; idx < InflightLimit; ++idx) {
+        msgIds[idx] = env.publish(idx);
+        TEST_ASSERT_TRUE(msgIds[idx] != 0U);
+    }
+
+    // All the slots are busy
+    TEST_ASSERT_EQUAL_UINT(0U, env.publish(100U));
+
+    env.puback(msgIds[1]);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed[0].m_id);
+
+    // The next message ID maps to the freed slot, skipping the busy ones
+    auto msgId = env.publish(5U);
+    TEST_ASSERT_TRUE(msgId != 0U);
+    TEST_ASSERT_EQUAL_UINT(msgIds[1] % InflightLimit, msgId % InflightLimit);
+    for (auto busyMsgId : msgIds) {
+        TEST_ASSERT_TRUE(busyMsgId != msgId);
+    }
+
+    // The old message ID of the slot is stale now
+    env.puback(msgIds[1]);
+    TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+
+    env.puback(msgId);
+    env.puback(msgIds[0]);
+    TEST_ASSERT_EQUAL_UINT(3U, env.m_completed.size());
+    TEST_ASSERT_EQUAL_UINT(5U, env.m_completed[1].m_id);
+    TEST_ASSERT_EQUAL_UINT(0U, env.m_completed[2].m_id);
+}
+
+void test_retries_exhausted_frees_slot()
+{
+    Env env;
+    env.m_client.setRetryCount(2U);
+    for (unsigned idx = 0U; idx < InflightLimit; ++idx) {
+        TEST_ASSERT_TRUE(env.publish(idx) != 0U);
+    }
+
+    auto firstMsgId = getU16(env.m_sent.front(), 5);
+    for (unsigned count = 0U; (count < 100U) && (env.m_completed.size() < InflightLimit); ++count) {
+        env.m_client.tick();
+    }
+
+    TEST_ASSERT_EQUAL_UINT(InflightLimit, env.m_completed.size());
+    for (auto& completion : env.m_completed) {
+        TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_NoResponse, completion.m_status);
+    }
+
+    // Sent twice, the retransmission with DUP flag
+    TEST_ASSERT_EQUAL_UINT(InflightLimit * 2U, env.sentCount(MsgType_Publish));
+    for (std::size_t idx = InflightLimit; idx < env.m_sent.size(); ++idx) {
+        auto& frame = env.m_sent[idx];
+        if (frame[1] == MsgType_Publish) {
+            TEST_ASSERT_TRUE((frame[2] & Flag_Dup) != 0U);
+        }
+    }
+
+    // Late acknowledgement is ignored, the slots are free again
+    env.puback(firstMsgId);
+    TEST_ASSERT_EQUAL_UINT(InflightLimit, env.m_completed.size());
+    for (unsigned idx = 0U; idx < InflightLimit; ++idx) {
+        TEST_ASSERT_TRUE(env.publish(10U + idx) != 0U);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_out_of_order_completions);
+    RUN_TEST(test_unknown_and_stale_acks_ignored);
+    RUN_TEST(test_msg_id_maps_to_free_slot);
+    RUN_TEST(test_retries_exhausted_frees_slot);
+    return UNITY_END();
+}
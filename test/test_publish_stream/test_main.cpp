@@ -0,0 +1,242 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicClient.h"
+#include "ParsedOptions.h"
+#include "option.h"
+
+namespace
+{
+
+typedef mqttsn::client::ParsedOptions<
+    mqttsn::client::option::PublishStream
+> ClientOptions;
+
+typedef mqttsn::client::BasicClient<ClientOptions> Client;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Advertise = 0x00;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Puback = 0x0d;
+
+const std::uint8_t Flags_Qos1Predefined = 0x21;
+const std::uint8_t Flag_Dup = 0x80;
+
+const MqttsnTopicId TopicId = 0x0102;
+
+// Message type, flags, topic ID and message ID
+const std::size_t PublishHeaderLen = 1U + 1U + 2U + 2U;
+
+std::uint16_t getU16(const Frame& frame, std::size_t pos)
+{
+    return static_cast<std::uint16_t>((frame[pos] << 8) | frame[pos + 1]);
+}
+
+Frame makePayload(std::size_t len)
+{
+    Frame result(len);
+    for (std::size_t idx = 0U; idx < len; ++idx) {
+        result[idx] = static_cast<std::uint8_t>(idx * 7U + 1U);
+    }
+    return result;
+}
+
+Frame expectedPublish(std::uint8_t flags, std::uint16_t msgId, const Frame& payload)
+{
+    Frame result;
+    auto len = 1U + PublishHeaderLen + payload.size();
+    if (len <= 0xffU) {
+        result.push_back(static_cast<std::uint8_t>(len));
+    }
+    else {
+        len += 2U;
+        result.push_back(0x01);
+        result.push_back(static_cast<std::uint8_t>(len >> 8));
+        result.push_back(static_cast<std::uint8_t>(len));
+    }
+
+    result.push_back(MsgType_Publish);
+    result.push_back(flags);
+    result.push_back(static_cast<std::uint8_t>(TopicId >> 8));
+    result.push_back(static_cast<std::uint8_t>(TopicId));
+    result.push_back(static_cast<std::uint8_t>(msgId >> 8));
+    result.push_back(static_cast<std::uint8_t>(msgId));
+    result.insert(result.end(), payload.begin(), payload.end());
+    return result;
+}
+
+struct Env
+{
+    Client m_client;
+    std::vector<Frame> m_sent;
+    std::vector<MqttsnAsyncOpStatus> m_completed;
+
+    Env()
+    {
+        m_client.setNextTickProgramCallback(&Env::programTick, this);
+        m_client.setCancelNextTickWaitCallback(&Env::cancelTick, this);
+        m_client.setSendOutputDataCallback(&Env::send, this);
+        m_client.setMessageReportCallback(&Env::report, this);
+        m_client.setSearchgwEnabled(false);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_client.start());
+
+        inject(Frame{5, MsgType_Advertise, 1, 0, 60});
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.connect("c", 60, true, nullptr, &Env::ignoreComplete, nullptr));
+        inject(Frame{3, MsgType_Connack, 0});
+        m_sent.clear();
+    }
+
+    void inject(const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_client.processData(iter, frame.size());
+    }
+
+    /// @brief Stream the payload in chunks of the provided size.
+    const Frame& streamPublish(const Frame& payload, std::size_t chunkLen)
+    {
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.publishBegin(TopicId, MqttsnQoS_AtLeastOnceDelivery, false));
+
+        for (std::size_t pos = 0U; pos < payload.size(); pos += chunkLen) {
+            auto len = std::min(chunkLen, payload.size() - pos);
+            TEST_ASSERT_EQUAL_UINT(len, m_client.publishWrite(&payload[pos], len));
+        }
+
+        auto count = m_sent.size();
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.publishEnd(&Env::publishComplete, this));
+        TEST_ASSERT_EQUAL_UINT(count + 1U, m_sent.size());
+        return m_sent.back();
+    }
+
+    void puback(const Frame& pubFrame)
+    {
+        // Position of the message type
+        std::size_t pos = 1U;
+        if (pubFrame[0] == 0x01) {
+            pos = 3U;
+        }
+
+        inject(Frame{
+            7, MsgType_Puback,
+            pubFrame[pos + 2U], pubFrame[pos + 3U],
+            pubFrame[pos + 4U], pubFrame[pos + 5U],
+            0});
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<Env*>(data)->m_sent.emplace_back(buf, buf + bufLen);
+    }
+
+    static void report(void*, const MqttsnMessageInfo*) {}
+
+    static void publishComplete(void* data, MqttsnAsyncOpStatus status)
+    {
+        reinterpret_cast<Env*>(data)->m_completed.push_back(status);
+    }
+
+    static void ignoreComplete(void*, MqttsnAsyncOpStatus) {}
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_length_form_boundary()
+{
+    // Short form frame of 255 bytes, then the frame one byte longer
+    // written with long form
+    static const std::size_t PayloadLens[] = {247U, 248U, 249U, 250U};
+    for (auto payloadLen : PayloadLens) {
+        Env env;
+        auto payload = makePayload(payloadLen);
+        auto frame = env.streamPublish(payload, 100U);
+        auto msgId = getU16(frame, frame.size() - payloadLen - 2U);
+        TEST_ASSERT_TRUE(expectedPublish(Flags_Qos1Predefined, msgId, payload) == frame);
+
+        env.puback(frame);
+        TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+        TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0]);
+    }
+
+    Env env;
+    TEST_ASSERT_EQUAL_UINT(255U, env.streamPublish(makePayload(248U), 1U).size());
+    env.puback(env.m_sent.back());
+    auto& frame = env.streamPublish(makePayload(249U), 1U);
+    TEST_ASSERT_EQUAL_UINT(258U, frame.size());
+    TEST_ASSERT_EQUAL_UINT8(0x01, frame[0]);
+    TEST_ASSERT_EQUAL_UINT(258U, getU16(frame, 1));
+}
+
+void test_dup_retransmission_identical_payload()
+{
+    static const std::size_t PayloadLens[] = {10U, 248U, 249U, 600U};
+    for (auto payloadLen : PayloadLens) {
+        Env env;
+        env.m_client.setRetryCount(2U);
+        auto payload = makePayload(payloadLen);
+        auto first = env.streamPublish(payload, 64U);
+        auto msgId = getU16(first, first.size() - payloadLen - 2U);
+
+        for (unsigned count = 0U; (count < 100U) && (env.m_sent.size() < 2U); ++count) {
+            env.m_client.tick();
+        }
+
+        TEST_ASSERT_EQUAL_UINT(2U, env.m_sent.size());
+        TEST_ASSERT_TRUE(expectedPublish(Flags_Qos1Predefined, msgId, payload) == first);
+        TEST_ASSERT_TRUE(expectedPublish(Flags_Qos1Predefined | Flag_Dup, msgId, payload) == env.m_sent[1]);
+        TEST_ASSERT_TRUE(env.m_completed.empty());
+
+        env.puback(env.m_sent[1]);
+        TEST_ASSERT_EQUAL_UINT(1U, env.m_completed.size());
+        TEST_ASSERT_EQUAL_INT(MqttsnAsyncOpStatus_Successful, env.m_completed[0]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_length_form_boundary);
+    RUN_TEST(test_dup_retransmission_identical_payload);
+    return UNITY_END();
+}
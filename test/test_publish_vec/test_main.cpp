@@ -0,0 +1,175 @@
+//
+// Copyright 2016 - 2020 (C). Alex Robenko. All rights reserved.
+//
+
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "BasicClient.h"
+#include "ParsedOptions.h"
+#include "option.h"
+
+namespace
+{
+
+typedef mqttsn::client::ParsedOptions<> ClientOptions;
+
+typedef mqttsn::client::BasicClient<ClientOptions> Client;
+
+typedef std::vector<std::uint8_t> Frame;
+
+const std::uint8_t MsgType_Advertise = 0x00;
+const std::uint8_t MsgType_Connack = 0x05;
+const std::uint8_t MsgType_Publish = 0x0c;
+const std::uint8_t MsgType_Puback = 0x0d;
+
+const MqttsnTopicId TopicId = 0x0102;
+
+Frame makePayload(std::size_t len)
+{
+    Frame result(len);
+    for (std::size_t idx = 0U; idx < len; ++idx) {
+        result[idx] = static_cast<std::uint8_t>(idx * 7U + 1U);
+    }
+    return result;
+}
+
+struct Env
+{
+    Client m_client;
+    std::vector<Frame> m_sent;
+    std::vector<std::vector<MqttsnIoVec> > m_sentVecs;
+
+    explicit Env(bool vec)
+    {
+        m_client.setNextTickProgramCallback(&Env::programTick, this);
+        m_client.setCancelNextTickWaitCallback(&Env::cancelTick, this);
+        if (vec) {
+            m_client.setSendOutputVecCallback(&Env::sendVec, this);
+        }
+        else {
+            m_client.setSendOutputDataCallback(&Env::send, this);
+        }
+        m_client.setMessageReportCallback(&Env::report, this);
+        m_client.setSearchgwEnabled(false);
+        TEST_ASSERT_EQUAL_INT(MqttsnErrorCode_Success, m_client.start());
+
+        inject(Frame{5, MsgType_Advertise, 1, 0, 60});
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.connect("c", 60, true, nullptr, &Env::ignoreComplete, nullptr));
+        inject(Frame{3, MsgType_Connack, 0});
+        m_sent.clear();
+        m_sentVecs.clear();
+    }
+
+    void inject(const Frame& frame)
+    {
+        const std::uint8_t* iter = frame.data();
+        m_client.processData(iter, frame.size());
+    }
+
+    Frame publish(const Frame& payload, MqttsnQoS qos)
+    {
+        TEST_ASSERT_EQUAL_INT(
+            MqttsnErrorCode_Success,
+            m_client.publish(
+                TopicId, payload.data(), payload.size(), qos, false, &Env::ignoreComplete, nullptr));
+        TEST_ASSERT_FALSE(m_sent.empty());
+
+        auto frame = m_sent.back();
+        std::size_t pos = 1U;
+        if (frame[0] == 0x01) {
+            pos = 3U;
+        }
+
+        TEST_ASSERT_EQUAL_UINT8(MsgType_Publish, frame[pos]);
+        if (qos == MqttsnQoS_AtLeastOnceDelivery) {
+            inject(Frame{7, MsgType_Puback, frame[pos + 2U], frame[pos + 3U], frame[pos + 4U], frame[pos + 5U], 0});
+        }
+        return frame;
+    }
+
+    static void programTick(void*, unsigned) {}
+
+    static unsigned cancelTick(void*)
+    {
+        return 0U;
+    }
+
+    static void send(void* data, const unsigned char* buf, unsigned bufLen, bool)
+    {
+        reinterpret_cast<Env*>(data)->m_sent.emplace_back(buf, buf + bufLen);
+    }
+
+    static void sendVec(void* data, const MqttsnIoVec* vec, unsigned count, bool)
+    {
+        auto* env = reinterpret_cast<Env*>(data);
+        Frame frame;
+        for (unsigned idx = 0U; idx < count; ++idx) {
+            frame.insert(frame.end(), vec[idx].buf, vec[idx].buf + vec[idx].bufLen);
+        }
+        env->m_sent.push_back(frame);
+        env->m_sentVecs.emplace_back(vec, vec + count);
+    }
+
+    static void report(void*, const MqttsnMessageInfo*) {}
+
+    static void ignoreComplete(void*, MqttsnAsyncOpStatus) {}
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_vec_publish_matches_contiguous()
+{
+    // Frame of 255 bytes is the longest one with short length form
+    static const std::size_t PayloadLens[] = {1U, 247U, 248U, 249U, 250U, 600U};
+    static const MqttsnQoS Qos[] = {MqttsnQoS_AtMostOnceDelivery, MqttsnQoS_AtLeastOnceDelivery};
+    for (auto qos : Qos) {
+        Env contiguousEnv(false);
+        Env vecEnv(true);
+        for (auto payloadLen : PayloadLens) {
+            auto payload = makePayload(payloadLen);
+            auto expected = contiguousEnv.publish(payload, qos);
+            auto frame = vecEnv.publish(payload, qos);
+            TEST_ASSERT_TRUE(expected == frame);
+
+            // The payload is sent from the buffer of the caller
+            auto& vecs = vecEnv.m_sentVecs.back();
+            TEST_ASSERT_EQUAL_UINT(2U, vecs.size());
+            TEST_ASSERT_EQUAL_UINT(expected.size() - payloadLen, vecs[0].bufLen);
+            TEST_ASSERT_TRUE(vecs[1].buf == payload.data());
+            TEST_ASSERT_EQUAL_UINT(payloadLen, vecs[1].bufLen);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_vec_publish_matches_contiguous);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+// Converts the binary dump of MqttsnTraceEntry records (as retrieved with
+// mqttsn_client_get_trace() and written to a file as is) into Chrome trace
+// JSON, that can be opened in chrome://tracing or https://ui.perfetto.dev.
+//
+// Usage: trace2json <dump file> [cycles per microsecond] > trace.json
+//
+// When the cycles per microsecond value is provided, the event times are
+// calculated from the trace clock values instead of the library's
+// millisecond timestamps.
+
+// Includes
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "mqttsn/client/common.h"
+
+// Support functions
+
+static const char* opName(unsigned op)
+{
+    static const char* Names[] = {
+        "connect",
+        "disconnect",
+        "register",
+        "publish",
+        "subscribe",
+        "unsubscribe",
+        "will update",
+        "ping"
+    };
+    static_assert(sizeof(Names) / sizeof(Names[0]) == MqttsnStatsOp_ValuesLimit, "Names above are incorrect");
+
+    if (MqttsnStatsOp_ValuesLimit <= op) {
+        return "unknown";
+    }
+    return Names[op];
+}
+
+static const char* msgName(unsigned msgType)
+{
+    static const char* Names[MQTTSN_STATS_MSG_TYPES_LIMIT] = {
+        "ADVERTISE", "SEARCHGW", "GWINFO", nullptr,
+        "CONNECT", "CONNACK", "WILLTOPICREQ", "WILLTOPIC",
+        "WILLMSGREQ", "WILLMSG", "REGISTER", "REGACK",
+        "PUBLISH", "PUBACK", "PUBCOMP", "PUBREC",
+        "PUBREL", nullptr, "SUBSCRIBE", "SUBACK",
+        "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP",
+        "DISCONNECT", nullptr, "WILLTOPICUPD", "WILLTOPICRESP",
+        "WILLMSGUPD", "WILLMSGRESP"
+    };
+
+    if ((MQTTSN_STATS_MSG_TYPES_LIMIT <= msgType) || (Names[msgType] == nullptr)) {
+        return "UNKNOWN";
+    }
+    return Names[msgType];
+}
+
+static const char* statusName(unsigned status)
+{
+    static const char* Names[] = {
+        "invalid",
+        "successful",
+        "congestion",
+        "invalid id",
+        "not supported",
+        "no response",
+        "aborted"
+    };
+
+    if ((sizeof(Names) / sizeof(Names[0])) <= status) {
+        return "unknown";
+    }
+    return Names[status];
+}
+
+static void printEvent(const MqttsnTraceEntry& entry, double ts, bool& first)
+{
+    std::printf("%s\n", first ? "" : ",");
+    first = false;
+
+    static const unsigned OpsTid = 1U;
+    static const unsigned WireTid = 2U;
+    switch (entry.event) {
+    case MqttsnTraceEvent_OpStart:
+        std::printf(
+            "{\"name\":\"%s\",\"cat\":\"op\",\"ph\":\"b\",\"id\":%u,\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            opName(entry.op), entry.key, ts, OpsTid);
+        break;
+
+    case MqttsnTraceEvent_OpRetry:
+        std::printf(
+            "{\"name\":\"retry %s\",\"cat\":\"op\",\"ph\":\"n\",\"id\":%u,\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"attempt\":%u}}",
+            opName(entry.op), entry.key, ts, OpsTid, entry.arg);
+        break;
+
+    case MqttsnTraceEvent_OpComplete:
+        std::printf(
+            "{\"name\":\"%s\",\"cat\":\"op\",\"ph\":\"e\",\"id\":%u,\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"status\":\"%s\"}}",
+            opName(entry.op), entry.key, ts, OpsTid, statusName(entry.arg));
+        break;
+
+    case MqttsnTraceEvent_MsgSent:
+    case MqttsnTraceEvent_MsgReceived:
+        std::printf(
+            "{\"name\":\"%s %s\",\"cat\":\"msg\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            (entry.event == MqttsnTraceEvent_MsgSent) ? "->" : "<-",
+            msgName(entry.arg), ts, WireTid);
+        break;
+
+    case MqttsnTraceEvent_DataDropped:
+        std::printf(
+            "{\"name\":\"dropped\",\"cat\":\"msg\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            ts, WireTid);
+        break;
+
+    default:
+        std::printf(
+            "{\"name\":\"event %u\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            entry.event, ts, OpsTid);
+        break;
+    }
+}
+
+// Main
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <dump file> [cycles per microsecond]\n", argv[0]);
+        return 1;
+    }
+
+    double cyclesPerUs = 0.0;
+    if (2 < argc) {
+        cyclesPerUs = std::atof(argv[2]);
+    }
+
+    auto* file = std::fopen(argv[1], "rb");
+    if (file == nullptr) {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    std::vector<MqttsnTraceEntry> entries;
+    MqttsnTraceEntry entry;
+    while (std::fread(&entry, sizeof(entry), 1U, file) == 1U) {
+        entries.push_back(entry);
+    }
+    std::fclose(file);
+
+    std::printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    std::printf(
+        "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"operations\"}},"
+        "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"messages\"}}");
+
+    bool first = false;
+    unsigned long long elapsedCycles = 0U;
+    for (std::size_t idx = 0U; idx < entries.size(); ++idx) {
+        auto& curr = entries[idx];
+        double ts = static_cast<double>(curr.timestamp) * 1000.0;
+        if ((0.0 < cyclesPerUs) && (0U < idx)) {
+            // The counter is allowed to wrap around
+            elapsedCycles += static_cast<unsigned>(curr.cycles - entries[idx - 1U].cycles);
+        }
+
+        if (0.0 < cyclesPerUs) {
+            ts = (static_cast<double>(entries[0].timestamp) * 1000.0) +
+                 (static_cast<double>(elapsedCycles) / cyclesPerUs);
+        }
+
+        printEvent(curr, ts, first);
+    }
+
+    std::printf("\n]}\n");
+    return 0;
+}